@@ -0,0 +1,353 @@
+#include "alert.h"
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+AlertTable::AlertTable()
+{
+    mActiveCount = 0;
+    mEvaluated = 0;
+    mLastClose = std::numeric_limits<double>::quiet_NaN();
+}
+
+bool AlertTable::parse(const QString &text, AlertCondition *condition)
+{
+    QStringList parts = text.split(':');
+    bool isValid = false;
+    condition->level = 0;
+    condition->window = 0;
+    condition->threshold = 0;
+    if (parts.size() == 2 && parts.at(0) == "cross") {
+        condition->type = AlertCross;
+        condition->level = parts.at(1).toDouble(&isValid);
+        return isValid && std::isfinite(condition->level);
+    }
+    if (parts.size() != 3) {
+        return false;
+    }
+    if (parts.at(0) == "move") {
+        condition->type = AlertMove;
+    } else if (parts.at(0) == "volume") {
+        condition->type = AlertVolume;
+    } else {
+        return false;
+    }
+    bool isThresholdValid = false;
+    condition->window = parts.at(1).toInt(&isValid);
+    condition->threshold = parts.at(2).toDouble(&isThresholdValid);
+    if (!isValid || !isThresholdValid || condition->window <= 0) {
+        return false;
+    }
+    if (condition->type == AlertMove) {
+        condition->threshold /= 100;
+        return std::isfinite(condition->threshold) && condition->threshold != 0;
+    }
+    return std::isfinite(condition->threshold) && condition->threshold > 0;
+}
+
+QString AlertTable::toString(const AlertCondition &condition)
+{
+    switch (condition.type) {
+    case AlertMove:
+        return QString("move:%1:%2").arg(condition.window).arg(condition.threshold * 100);
+    case AlertVolume:
+        return QString("volume:%1:%2").arg(condition.window).arg(condition.threshold);
+    default:
+        return QString("cross:%1").arg(condition.level);
+    }
+}
+
+int AlertTable::add(const AlertCondition &condition)
+{
+    int alert = mConditions.size();
+    mConditions.push_back(condition);
+    mIsActive.push_back(false);
+    rearm(alert);
+    return alert;
+}
+
+const AlertCondition &AlertTable::condition(int alert) const
+{
+    return mConditions[alert];
+}
+
+bool AlertTable::isActive(int alert) const
+{
+    return mIsActive[alert];
+}
+
+void AlertTable::rearm(int alert)
+{
+    if (mIsActive[alert]) {
+        return;
+    }
+    mIsActive[alert] = true;
+    ++mActiveCount;
+    arm(alert);
+}
+
+size_t AlertTable::activeCount() const
+{
+    return mActiveCount;
+}
+
+const std::vector<AlertEvent> &AlertTable::events() const
+{
+    return mEvents;
+}
+
+void AlertTable::insert(std::vector<Entry> *entries, double threshold, int alert)
+{
+    // сработавшие чаще всего возвращаются близко к концу списка,
+    // поэтому сдвигается немного записей
+    auto position = std::upper_bound(
+        entries->begin(),
+        entries->end(),
+        threshold,
+        [](double value, const Entry &entry) { return value > entry.threshold; }
+    );
+    entries->insert(position, {threshold, alert});
+}
+
+void AlertTable::trigger(std::vector<Entry> *entries, double value, uint64_t index)
+{
+    while (!entries->empty() && entries->back().threshold <= value) {
+        int alert = entries->back().alert;
+        entries->pop_back();
+        mIsActive[alert] = false;
+        --mActiveCount;
+        mEvents.push_back({alert, index});
+    }
+}
+
+AlertTable::WindowGroup *AlertTable::group(std::vector<WindowGroup> *groups, int window)
+{
+    for (WindowGroup &group : *groups) {
+        if (group.window == window) {
+            return &group;
+        }
+    }
+    groups->push_back(WindowGroup());
+    groups->back().window = window;
+    groups->back().volumeSum = std::numeric_limits<double>::quiet_NaN();
+    return &groups->back();
+}
+
+void AlertTable::arm(int alert)
+{
+    const AlertCondition &condition = mConditions[alert];
+    switch (condition.type) {
+    case AlertCross:
+        if (std::isnan(mLastClose)) {
+            mPendingLevels.push_back({condition.level, alert});
+        } else if (condition.level > mLastClose) {
+            insert(&mRisingLevels, condition.level, alert);
+        } else {
+            insert(&mFallingLevels, -condition.level, alert);
+        }
+        break;
+    case AlertMove: {
+        WindowGroup *moveGroup = group(&mMoveGroups, condition.window);
+        if (condition.threshold > 0) {
+            insert(&moveGroup->rising, condition.threshold, alert);
+        } else {
+            insert(&moveGroup->falling, -condition.threshold, alert);
+        }
+        break;
+    }
+    case AlertVolume:
+        insert(&group(&mVolumeGroups, condition.window)->rising, condition.threshold, alert);
+        break;
+    }
+}
+
+void AlertTable::update(const DataSeries &dataSeries)
+{
+    mEvents.clear();
+    uint64_t size = dataSeries.size();
+    if (mActiveCount == 0) {
+        // ждать нечего, окна без оповещений больше не нужны
+        if (size > mEvaluated) {
+            mLastClose = dataSeries.at(size - 1).close;
+        }
+        mEvaluated = size;
+        mMoveGroups.clear();
+        mVolumeGroups.clear();
+        return;
+    }
+    for (; mEvaluated < size; ++mEvaluated) {
+        evaluate(dataSeries, mEvaluated);
+    }
+}
+
+void AlertTable::evaluate(const DataSeries &dataSeries, uint64_t index)
+{
+    const Candle &candle = dataSeries.at(index);
+    if (std::isnan(mLastClose)) {
+        // до первой свечи направление уровня считается от ее открытия,
+        // списки сортируются один раз, а не вставкой каждого уровня
+        mLastClose = candle.open;
+        for (const Entry &entry : mPendingLevels) {
+            if (entry.threshold > mLastClose) {
+                mRisingLevels.push_back(entry);
+            } else {
+                mFallingLevels.push_back({-entry.threshold, entry.alert});
+            }
+        }
+        mPendingLevels.clear();
+        auto isAfter = [](const Entry &a, const Entry &b) { return a.threshold > b.threshold; };
+        std::sort(mRisingLevels.begin(), mRisingLevels.end(), isAfter);
+        std::sort(mFallingLevels.begin(), mFallingLevels.end(), isAfter);
+    }
+    trigger(&mRisingLevels, candle.high, index);
+    trigger(&mFallingLevels, -candle.low, index);
+    for (WindowGroup &moveGroup : mMoveGroups) {
+        if (index < (uint64_t)moveGroup.window) {
+            continue;
+        }
+        double base = dataSeries.at(index - moveGroup.window).close;
+        if (base > 0) {
+            double move = candle.close / base - 1;
+            trigger(&moveGroup.rising, move, index);
+            trigger(&moveGroup.falling, -move, index);
+        }
+    }
+    for (WindowGroup &volumeGroup : mVolumeGroups) {
+        uint64_t window = volumeGroup.window;
+        if (std::isnan(volumeGroup.volumeSum)) {
+            volumeGroup.volumeSum = 0;
+            for (uint64_t i = index > window ? index - window : 0; i < index; ++i) {
+                volumeGroup.volumeSum += dataSeries.at(i).volume;
+            }
+        }
+        if (index >= window && volumeGroup.volumeSum > 0) {
+            double ratio = candle.volume * (double)window / volumeGroup.volumeSum;
+            trigger(&volumeGroup.rising, ratio, index);
+        }
+        volumeGroup.volumeSum += candle.volume;
+        if (index >= window) {
+            volumeGroup.volumeSum -= dataSeries.at(index - window).volume;
+        }
+    }
+    mLastClose = candle.close;
+}
+
+bool AlertBenchmark::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--bench-alerts");
+}
+
+int AlertBenchmark::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist price alerts benchmark");
+    parser.addHelpOption();
+    QCommandLineOption benchOption(
+        "bench-alerts",
+        "Append generated candles one by one and measure how long alerts are checked."
+    );
+    QCommandLineOption alertsOption(
+        "alerts",
+        "Active alerts, triggered alerts are armed again.",
+        "n",
+        "100000"
+    );
+    QCommandLineOption candlesOption(
+        "candles",
+        "Appended candles.",
+        "n",
+        "100000"
+    );
+    parser.addOption(benchOption);
+    parser.addOption(alertsOption);
+    parser.addOption(candlesOption);
+    parser.process(arguments);
+
+    bool isAlertsValid = false, isCandlesValid = false;
+    int alertCount = parser.value(alertsOption).toInt(&isAlertsValid);
+    int candleCount = parser.value(candlesOption).toInt(&isCandlesValid);
+    if (!isAlertsValid || alertCount <= 0) {
+        printMessage("Invalid alert count: " + parser.value(alertsOption));
+        return 1;
+    }
+    if (!isCandlesValid || candleCount < 2) {
+        printMessage("Invalid candle count: " + parser.value(candlesOption));
+        return 1;
+    }
+
+    // случайное блуждание цены около 100, уровни - в пределах 30% от нее,
+    // изменения и всплески объема - по нескольким окнам
+    BenchRandom random(1);
+    const double startPrice = 100;
+    const int windows[] = {5, 10, 20, 50, 100};
+    AlertTable alerts;
+    for (int i = 0; i < alertCount; ++i) {
+        AlertCondition condition;
+        condition.level = 0;
+        condition.window = windows[random.next() % 5];
+        condition.threshold = 0;
+        uint64_t kind = random.next() % 10;
+        if (kind < 8) {
+            condition.type = AlertCross;
+            condition.level = startPrice * random.uniform(0.7, 1.3);
+        } else if (kind == 8) {
+            condition.type = AlertMove;
+            condition.threshold = random.uniform(0.005, 0.05) *
+                (random.next() % 2 == 0 ? 1 : -1);
+        } else {
+            condition.type = AlertVolume;
+            condition.threshold = random.uniform(1.5, 5);
+        }
+        alerts.add(condition);
+    }
+
+    DataSeries dataSeries;
+    BenchSeriesGenerator generator(startPrice, 2);
+    std::vector<qint64> latencies;
+    latencies.reserve(candleCount);
+    uint64_t eventCount = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < candleCount; ++i) {
+        Candle candle = generator.next();
+        dataSeries.append(&candle, 1);
+        timer.start();
+        alerts.update(dataSeries);
+        qint64 elapsed = timer.nsecsElapsed();
+        // на первой свече раскладываются уровни, добавленные до нее,
+        // это не проверка свечи
+        if (i > 0) {
+            latencies.push_back(elapsed);
+        }
+        eventCount += alerts.events().size();
+        // сработавшие снова ставятся вне замера, чтобы оповещений
+        // оставалось столько же
+        for (const AlertEvent &event : alerts.events()) {
+            alerts.rearm(event.alert);
+        }
+    }
+
+    qint64 sum = 0;
+    for (qint64 latency : latencies) {
+        sum += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    QTextStream(stdout) << "{\"benchmark\":\"alerts\""
+        << ",\"alerts\":" << alertCount
+        << ",\"candles\":" << candleCount
+        << ",\"events\":" << (quint64)eventCount
+        << ",\"events_per_candle\":"
+        << QString::number((double)eventCount / candleCount, 'f', 2)
+        << ",\"avg_ns\":" << QString::number((double)sum / latencies.size(), 'f', 0)
+        << ",\"p50_ns\":" << latencies[latencies.size() / 2]
+        << ",\"p99_ns\":" << latencies[latencies.size() * 99 / 100]
+        << ",\"max_ns\":" << latencies.back()
+        << "}\n";
+    return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef ALERT_H
+#define ALERT_H
+
+#include "core.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <inttypes.h>
+#include <vector>
+
+enum AlertType {
+    // цена пересекла уровень level
+    AlertCross,
+    // закрытие изменилось на threshold (доля, < 0 - падение) за window свечей
+    AlertMove,
+    // объем свечи в threshold раз больше среднего объема window
+    // предыдущих свечей или больше того
+    AlertVolume
+};
+
+struct AlertCondition {
+    AlertType type;
+    double level;
+    int window;
+    double threshold;
+};
+
+// сработавшее оповещение
+struct AlertEvent {
+    int alert;
+    // свеча, на которой сработало оповещение
+    uint64_t index;
+};
+
+// оповещения по ряду одного инструмента, проверяются на каждой дописанной
+// свече: условия разложены по отсортированным спискам порогов, и
+// сработавшие всегда лежат в конце списка, поэтому свеча проверяется
+// за O(кол-во окон + кол-во сработавших), а не перебором всех оповещений;
+// сработавшее оповещение снимается
+class AlertTable
+{
+public:
+    AlertTable();
+    // условие вида cross:123.5, move:5:2.5 (рост на 2.5% за 5 свечей,
+    // -2.5 - падение) или volume:20:3 (объем в 3 раза больше среднего
+    // за 20 свечей)
+    static bool parse(const QString &text, AlertCondition *condition);
+    static QString toString(const AlertCondition &condition);
+    // номер оповещения, уровень сравнивается с последним проверенным
+    // закрытием: выше него - ждем роста, иначе падения
+    int add(const AlertCondition &condition);
+    const AlertCondition &condition(int alert) const;
+    bool isActive(int alert) const;
+    // снова ждать сработавшее оповещение, относительно последнего закрытия
+    void rearm(int alert);
+    // кол-во несработавших оповещений
+    size_t activeCount() const;
+    // проверить свечи, дописанные в ряд с прошлого вызова, сработавшие
+    // на них оповещения в events(); без оповещений свечи пропускаются
+    void update(const DataSeries &dataSeries);
+    const std::vector<AlertEvent> &events() const;
+private:
+    // порог и номер оповещения
+    struct Entry {
+        double threshold;
+        int alert;
+    };
+    // оповещения с одним окном
+    struct WindowGroup {
+        int window;
+        // пороги по убыванию, сработавшие снимаются с конца
+        std::vector<Entry> rising;
+        std::vector<Entry> falling;
+        // сумма объемов окна перед проверяемой свечой, NaN - еще не считалась
+        double volumeSum;
+    };
+
+    static void insert(std::vector<Entry> *entries, double threshold, int alert);
+    // снять с конца оповещения с порогом не больше value
+    void trigger(std::vector<Entry> *entries, double value, uint64_t index);
+    WindowGroup *group(std::vector<WindowGroup> *groups, int window);
+    // разложить оповещение по спискам
+    void arm(int alert);
+    void evaluate(const DataSeries &dataSeries, uint64_t index);
+
+    std::vector<AlertCondition> mConditions;
+    std::vector<bool> mIsActive;
+    size_t mActiveCount;
+    // уровни выше цены и ниже цены (с обратным знаком) по убыванию,
+    // уровни, добавленные до первой свечи, ждут ее
+    std::vector<Entry> mRisingLevels;
+    std::vector<Entry> mFallingLevels;
+    std::vector<Entry> mPendingLevels;
+    std::vector<WindowGroup> mMoveGroups;
+    std::vector<WindowGroup> mVolumeGroups;
+    // кол-во проверенных свечей и закрытие последней из них
+    uint64_t mEvaluated;
+    double mLastClose;
+    std::vector<AlertEvent> mEvents;
+};
+
+// замер времени проверки свечи при большом кол-ве оповещений
+class AlertBenchmark
+{
+public:
+    // запрошен ли замер в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // замер по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+};
+
+#endif // ALERT_H
@@ -0,0 +1,105 @@
+#include "alloccounter.h"
+
+#ifdef CHARTIST_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// счетчик своего потока, поэтому подсчет не требует синхронизации
+// и выделения памяти в других потоках не мешают измерению
+thread_local uint64_t allocationCount = 0;
+
+}
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    ++allocationCount;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    ++allocationCount;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    ++allocationCount;
+    return __libc_realloc(ptr, size);
+}
+
+}
+
+#else
+
+void *operator new(size_t size)
+{
+    ++allocationCount;
+    void *ptr = std::malloc(size != 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+#endif // __GLIBC__
+
+bool isAllocationCountEnabled()
+{
+    return true;
+}
+
+uint64_t threadAllocationCount()
+{
+    return allocationCount;
+}
+
+#else
+
+bool isAllocationCountEnabled()
+{
+    return false;
+}
+
+uint64_t threadAllocationCount()
+{
+    return 0;
+}
+
+#endif // CHARTIST_COUNT_ALLOCATIONS
+
+AllocationScope::AllocationScope()
+{
+    mStartCount = threadAllocationCount();
+}
+
+uint64_t AllocationScope::count() const
+{
+    return threadAllocationCount() - mStartCount;
+}
@@ -0,0 +1,22 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <inttypes.h>
+
+// подсчет выделений памяти в куче, включается сборкой с CONFIG += alloc_count:
+// с glibc перехватываются malloc, calloc и realloc (ими пользуются и Qt,
+// и operator new), на остальных платформах - только operator new
+bool isAllocationCountEnabled();
+// кол-во выделений памяти текущим потоком с его запуска, 0 без подсчета
+uint64_t threadAllocationCount();
+
+// кол-во выделений памяти текущим потоком за время жизни объекта
+class AllocationScope {
+public:
+    AllocationScope();
+    uint64_t count() const;
+private:
+    uint64_t mStartCount;
+};
+
+#endif // ALLOCCOUNTER_H
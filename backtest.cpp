@@ -0,0 +1,549 @@
+#include "backtest.h"
+#include "reader.h"
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <algorithm>
+#include <stdexcept>
+
+// кол-во наборов параметров, которые идут по свечам вместе, и кол-во свечей
+// в блоке: пока все прогоны группы проходят блок, его цены остаются в кэше
+static const int GroupSize = 16;
+static const uint64_t BlockSize = 4096;
+
+BacktestPrices::BacktestPrices(const FilteredView &candles, bool isHighLowNeeded)
+{
+    close.reserve(candles.size());
+    if (isHighLowNeeded) {
+        high.reserve(candles.size());
+        low.reserve(candles.size());
+        candles.forEach([this](const Candle &candle) {
+            close.push_back(candle.close);
+            high.push_back(candle.high);
+            low.push_back(candle.low);
+        });
+    } else {
+        candles.forEach([this](const Candle &candle) {
+            close.push_back(candle.close);
+        });
+    }
+}
+
+// максимум (или минимум) значений за window предыдущих свечей:
+// монотонная очередь в кольцевом буфере, O(1) в среднем на свечу
+class RollingExtremum
+{
+public:
+    void reset(int window, bool isMax)
+    {
+        mWindow = window;
+        mIsMax = isMax;
+        size_t capacity = 1;
+        while (capacity < (size_t)window + 2) {
+            capacity *= 2;
+        }
+        mIndexes.assign(capacity, 0);
+        mValues.assign(capacity, 0);
+        mMask = capacity - 1;
+        mHead = 0;
+        mTail = 0;
+    }
+
+    // значение по window свечам до следующей после последней добавленной
+    float value() const
+    {
+        return mValues[mHead & mMask];
+    }
+
+    void push(uint64_t index, float value)
+    {
+        // значения, которые новое уже не даст выбрать, отбрасываем
+        while (
+            mTail != mHead &&
+            (mIsMax ? mValues[(mTail - 1) & mMask] <= value :
+                mValues[(mTail - 1) & mMask] >= value)
+        ) {
+            --mTail;
+        }
+        mIndexes[mTail & mMask] = index;
+        mValues[mTail & mMask] = value;
+        ++mTail;
+        // вышедшие из окна следующей свечи отбрасываем сразу, иначе очередь
+        // переполнит буфер, пока значение не спрашивают
+        while (mIndexes[mHead & mMask] + mWindow <= index) {
+            ++mHead;
+        }
+    }
+private:
+    uint64_t mWindow;
+    bool mIsMax;
+    std::vector<uint64_t> mIndexes;
+    std::vector<float> mValues;
+    size_t mMask;
+    size_t mHead;
+    size_t mTail;
+};
+
+// прогон одной стратегии: состояние продвигается по диапазонам свечей,
+// поэтому прогоны группы проходят свечи одними и теми же блоками
+class BacktestRun
+{
+public:
+    void start(
+        const BacktestPrices *prices,
+        const BacktestParams &params,
+        std::vector<BacktestTrade> *trades
+    )
+    {
+        mPrices = prices;
+        mParams = params;
+        mTrades = trades;
+        mWarmup = qMax(params.fast, params.slow);
+        mPosition = 0;
+        mEntryIndex = 0;
+        mEntryPrice = 0;
+        mFastSum = 0;
+        mSlowSum = 0;
+        mEquity = 0;
+        mPeakEquity = 0;
+        mResult.params = params;
+        mResult.totalReturn = 0;
+        mResult.maxDrawdown = 0;
+        mResult.tradeCount = 0;
+        mResult.winCount = 0;
+        if (params.strategy == StrategyBreakout) {
+            mFastHigh.reset(params.fast, true);
+            mFastLow.reset(params.fast, false);
+            mSlowHigh.reset(params.slow, true);
+            mSlowLow.reset(params.slow, false);
+        }
+    }
+
+    void advance(uint64_t begin, uint64_t end)
+    {
+        if (mParams.strategy == StrategyMovingAverageCross) {
+            advanceMovingAverageCross(begin, end);
+        } else {
+            advanceBreakout(begin, end);
+        }
+    }
+
+    BacktestResult finish()
+    {
+        if (mPosition != 0) {
+            closePosition(mPrices->close.size() - 1);
+        }
+        return mResult;
+    }
+private:
+    void advanceMovingAverageCross(uint64_t begin, uint64_t end)
+    {
+        const float *close = mPrices->close.data();
+        uint64_t fast = mParams.fast;
+        uint64_t slow = mParams.slow;
+        // суммы держим в локальных, чтобы они жили в регистрах
+        double fastSum = mFastSum;
+        double slowSum = mSlowSum;
+        for (uint64_t i = begin; i < end; ++i) {
+            // суммы по окнам меняются на вошедшее и вышедшее закрытие,
+            // закрытия float складываются в double без потерь
+            fastSum += close[i];
+            slowSum += close[i];
+            if (i >= fast) {
+                fastSum -= close[i - fast];
+            }
+            if (i >= slow) {
+                slowSum -= close[i - slow];
+            }
+            if (i + 1 < mWarmup) {
+                continue;
+            }
+            // средние сравниваются без деления
+            int signal = fastSum * slow > slowSum * fast ? 1 : -1;
+            if (signal != mPosition) {
+                if (mPosition != 0) {
+                    closePosition(i);
+                }
+                openPosition(i, signal);
+            }
+        }
+        mFastSum = fastSum;
+        mSlowSum = slowSum;
+    }
+
+    void advanceBreakout(uint64_t begin, uint64_t end)
+    {
+        const float *close = mPrices->close.data();
+        const float *high = mPrices->high.data();
+        const float *low = mPrices->low.data();
+        for (uint64_t i = begin; i < end; ++i) {
+            if (i >= mWarmup) {
+                float price = close[i];
+                if (
+                    (mPosition > 0 && price < mSlowLow.value()) ||
+                    (mPosition < 0 && price > mSlowHigh.value())
+                ) {
+                    closePosition(i);
+                }
+                if (mPosition == 0) {
+                    if (price > mFastHigh.value()) {
+                        openPosition(i, 1);
+                    } else if (price < mFastLow.value()) {
+                        openPosition(i, -1);
+                    }
+                }
+            }
+            mFastHigh.push(i, high[i]);
+            mFastLow.push(i, low[i]);
+            mSlowHigh.push(i, high[i]);
+            mSlowLow.push(i, low[i]);
+        }
+    }
+
+    void openPosition(uint64_t index, int direction)
+    {
+        mPosition = direction;
+        mEntryIndex = index;
+        mEntryPrice = mPrices->close[index];
+    }
+
+    void closePosition(uint64_t index)
+    {
+        float exitPrice = mPrices->close[index];
+        double tradeReturn = mEntryPrice > 0 ?
+            mPosition * ((double)exitPrice / mEntryPrice - 1) : 0;
+        mResult.totalReturn += tradeReturn;
+        ++mResult.tradeCount;
+        if (tradeReturn > 0) {
+            ++mResult.winCount;
+        }
+        mEquity += tradeReturn;
+        mPeakEquity = qMax(mPeakEquity, mEquity);
+        mResult.maxDrawdown = qMax(mResult.maxDrawdown, mPeakEquity - mEquity);
+        if (mTrades != nullptr) {
+            BacktestTrade trade;
+            trade.entryIndex = mEntryIndex;
+            trade.exitIndex = index;
+            trade.entryPrice = mEntryPrice;
+            trade.exitPrice = exitPrice;
+            trade.direction = mPosition;
+            mTrades->push_back(trade);
+        }
+        mPosition = 0;
+    }
+
+    const BacktestPrices *mPrices;
+    BacktestParams mParams;
+    std::vector<BacktestTrade> *mTrades;
+    uint64_t mWarmup;
+    int mPosition;
+    uint64_t mEntryIndex;
+    float mEntryPrice;
+    double mFastSum;
+    double mSlowSum;
+    RollingExtremum mFastHigh;
+    RollingExtremum mFastLow;
+    RollingExtremum mSlowHigh;
+    RollingExtremum mSlowLow;
+    double mEquity;
+    double mPeakEquity;
+    BacktestResult mResult;
+};
+
+// прогон группы параметров [first, first + count) по блокам свечей
+static void runGroup(
+    const BacktestPrices &prices,
+    const std::vector<BacktestParams> &params,
+    size_t first,
+    size_t count,
+    std::vector<BacktestResult> *results
+)
+{
+    BacktestRun runs[GroupSize];
+    for (size_t k = 0; k < count; ++k) {
+        runs[k].start(&prices, params[first + k], nullptr);
+    }
+    uint64_t size = prices.close.size();
+    for (uint64_t begin = 0; begin < size; begin += BlockSize) {
+        uint64_t end = qMin(begin + BlockSize, size);
+        for (size_t k = 0; k < count; ++k) {
+            runs[k].advance(begin, end);
+        }
+    }
+    for (size_t k = 0; k < count; ++k) {
+        (*results)[first + k] = runs[k].finish();
+    }
+}
+
+static void checkParams(const BacktestParams &params)
+{
+    if (params.fast <= 0 || params.slow <= 0) {
+        throw std::logic_error("Backtest windows must be positive");
+    }
+}
+
+BacktestResult Backtest::runStrategy(
+    const DataSeries &dataSeries,
+    const BacktestParams &params,
+    std::vector<BacktestTrade> *trades
+)
+{
+    return runStrategy(FilteredView(DataView(&dataSeries)), params, trades);
+}
+
+BacktestResult Backtest::runStrategy(
+    const FilteredView &candles,
+    const BacktestParams &params,
+    std::vector<BacktestTrade> *trades
+)
+{
+    checkParams(params);
+    BacktestPrices prices(candles, params.strategy == StrategyBreakout);
+    BacktestRun run;
+    run.start(&prices, params, trades);
+    run.advance(0, prices.close.size());
+    return run.finish();
+}
+
+std::vector<BacktestResult> Backtest::sweep(
+    const DataSeries &dataSeries,
+    const std::vector<BacktestParams> &params
+)
+{
+    return sweep(FilteredView(DataView(&dataSeries)), params);
+}
+
+std::vector<BacktestResult> Backtest::sweep(
+    const FilteredView &candles,
+    const std::vector<BacktestParams> &params
+)
+{
+    bool isHighLowNeeded = false;
+    for (size_t k = 0; k < params.size(); ++k) {
+        checkParams(params[k]);
+        isHighLowNeeded = isHighLowNeeded || params[k].strategy == StrategyBreakout;
+    }
+    std::vector<BacktestResult> results(params.size());
+    if (params.empty()) {
+        return results;
+    }
+    BacktestPrices prices(candles, isHighLowNeeded);
+    // группы считаются параллельно, каждая пишет только свои результаты
+    int groupCount = (params.size() + GroupSize - 1) / GroupSize;
+    parallelFor(groupCount, [&](int group) {
+        size_t first = (size_t)group * GroupSize;
+        runGroup(prices, params, first, qMin<size_t>(GroupSize, params.size() - first), &results);
+    });
+    return results;
+}
+
+bool Backtest::parseParams(const QString &text, BacktestParams *params)
+{
+    QStringList parts = text.split(':');
+    if (parts.size() != 3) {
+        return false;
+    }
+    if (parts.at(0) == "ma") {
+        params->strategy = StrategyMovingAverageCross;
+    } else if (parts.at(0) == "breakout") {
+        params->strategy = StrategyBreakout;
+    } else {
+        return false;
+    }
+    bool isFastValid = false, isSlowValid = false;
+    params->fast = parts.at(1).toInt(&isFastValid);
+    params->slow = parts.at(2).toInt(&isSlowValid);
+    return isFastValid && isSlowValid && params->fast > 0 && params->slow > 0;
+}
+
+// диапазон окон вида from:to:step или одно значение
+static bool parseRange(const QString &text, std::vector<int> *values)
+{
+    QStringList parts = text.split(':');
+    if (parts.size() != 1 && parts.size() != 3) {
+        return false;
+    }
+    bool isFromValid = false;
+    int from = parts.at(0).toInt(&isFromValid);
+    int to = from;
+    int step = 1;
+    bool isToValid = true, isStepValid = true;
+    if (parts.size() == 3) {
+        to = parts.at(1).toInt(&isToValid);
+        step = parts.at(2).toInt(&isStepValid);
+    }
+    if (!isFromValid || !isToValid || !isStepValid || from <= 0 || to < from || step <= 0) {
+        return false;
+    }
+    values->clear();
+    for (int value = from; value <= to; value += step) {
+        values->push_back(value);
+    }
+    return true;
+}
+
+bool Backtest::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--backtest");
+}
+
+int Backtest::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist backtest parameter sweep");
+    parser.addHelpOption();
+    QCommandLineOption backtestOption(
+        "backtest",
+        "Run the strategy over the given CSV file for every parameter combination."
+    );
+    QCommandLineOption strategyOption(
+        "strategy",
+        "Strategy: ma (moving average cross) or breakout.",
+        "name",
+        "ma"
+    );
+    QCommandLineOption fastOption(
+        "fast",
+        "Fast window (ma) or entry channel (breakout) range.",
+        "from:to:step",
+        "5:50:5"
+    );
+    QCommandLineOption slowOption(
+        "slow",
+        "Slow window (ma) or exit channel (breakout) range.",
+        "from:to:step",
+        "20:200:10"
+    );
+    QCommandLineOption topOption(
+        "top",
+        "Number of best results to print.",
+        "n",
+        "10"
+    );
+    parser.addOption(backtestOption);
+    parser.addOption(strategyOption);
+    parser.addOption(fastOption);
+    parser.addOption(slowOption);
+    QCommandLineOption sessionOption(
+        "session",
+        "Test only on candles with time in the range, e.g. 100000-184000.",
+        "hhmmss-hhmmss"
+    );
+    parser.addOption(topOption);
+    parser.addOption(sessionOption);
+    parser.addPositionalArgument("file", "CSV file to test on.", "file");
+    parser.process(arguments);
+
+    BacktestStrategy strategy;
+    if (parser.value(strategyOption) == "ma") {
+        strategy = StrategyMovingAverageCross;
+    } else if (parser.value(strategyOption) == "breakout") {
+        strategy = StrategyBreakout;
+    } else {
+        printMessage("Unknown strategy: " + parser.value(strategyOption));
+        return 1;
+    }
+    std::vector<int> fastValues, slowValues;
+    if (!parseRange(parser.value(fastOption), &fastValues)) {
+        printMessage("Invalid fast range: " + parser.value(fastOption));
+        return 1;
+    }
+    if (!parseRange(parser.value(slowOption), &slowValues)) {
+        printMessage("Invalid slow range: " + parser.value(slowOption));
+        return 1;
+    }
+    int top = parser.value(topOption).toInt();
+    uint64_t sessionFrom = 0, sessionTo = 0;
+    if (parser.isSet(sessionOption)) {
+        QStringList session = parser.value(sessionOption).split('-');
+        bool isFromValid = false, isToValid = false;
+        if (session.size() == 2) {
+            sessionFrom = session.at(0).toULongLong(&isFromValid);
+            sessionTo = session.at(1).toULongLong(&isToValid);
+        }
+        if (!isFromValid || !isToValid || sessionFrom >= sessionTo) {
+            printMessage("Invalid session: " + parser.value(sessionOption));
+            return 1;
+        }
+    }
+    QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        printMessage("One file to test on is expected");
+        return 1;
+    }
+
+    std::vector<BacktestParams> params;
+    for (size_t f = 0; f < fastValues.size(); ++f) {
+        for (size_t s = 0; s < slowValues.size(); ++s) {
+            // быстрая средняя длиннее медленной - та же стратегия наоборот
+            if (strategy == StrategyMovingAverageCross && fastValues[f] >= slowValues[s]) {
+                continue;
+            }
+            BacktestParams combination;
+            combination.strategy = strategy;
+            combination.fast = fastValues[f];
+            combination.slow = slowValues[s];
+            params.push_back(combination);
+        }
+    }
+
+    std::vector<BacktestResult> results;
+    uint64_t candleCount = 0;
+    QElapsedTimer timer;
+    try {
+        DataSeries dataSeries;
+        Reader::readFromFile(files.at(0), &dataSeries);
+        // свечи вне сессии отбрасываются выбором без копирования
+        CandleSelection selection;
+        if (parser.isSet(sessionOption)) {
+            selection = CandleSelection::session(dataSeries, sessionFrom, sessionTo);
+        }
+        FilteredView candles(
+            DataView(&dataSeries),
+            parser.isSet(sessionOption) ? &selection : nullptr
+        );
+        candleCount = candles.size();
+        timer.start();
+        results = sweep(candles, params);
+    } catch (const std::exception &e) {
+        printMessage(files.at(0) + ": " + QString::fromLocal8Bit(e.what()));
+        return 2;
+    }
+    double seconds = timer.nsecsElapsed() / 1e9;
+    printMessage(
+        QString("%1 runs over %2 candles in %3 s (%4 M candles/s)")
+            .arg(params.size())
+            .arg(candleCount)
+            .arg(seconds, 0, 'f', 3)
+            .arg(seconds > 0 ? params.size() * candleCount / seconds / 1e6 : 0, 0, 'f', 0)
+    );
+
+    std::sort(
+        results.begin(),
+        results.end(),
+        [](const BacktestResult &a, const BacktestResult &b) {
+            return a.totalReturn > b.totalReturn;
+        }
+    );
+    QTextStream output(stdout);
+    output << "strategy,fast,slow,return %,max drawdown %,trades,win %\n";
+    for (size_t k = 0; k < results.size() && (int)k < top; ++k) {
+        const BacktestResult &result = results[k];
+        output << parser.value(strategyOption) << ","
+            << result.params.fast << ","
+            << result.params.slow << ","
+            << QString::number(result.totalReturn * 100, 'f', 2) << ","
+            << QString::number(result.maxDrawdown * 100, 'f', 2) << ","
+            << (quint64)result.tradeCount << ","
+            << QString::number(
+                result.tradeCount > 0 ? 100.0 * result.winCount / result.tradeCount : 0,
+                'f',
+                1
+            ) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+#include "core.h"
+#include "dataview.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+enum BacktestStrategy {
+    // пересечение скользящих средних закрытий за fast и slow свечей:
+    // в покупке, пока быстрая выше медленной, иначе в продаже
+    StrategyMovingAverageCross,
+    // пробой канала: вход, когда закрытие выходит за максимум или минимум
+    // предыдущих fast свечей, выход по каналу предыдущих slow свечей
+    StrategyBreakout
+};
+
+struct BacktestParams {
+    BacktestStrategy strategy;
+    int fast;
+    int slow;
+};
+
+// сделка: индексы свечей входа и выхода, direction = 1 - покупка, -1 - продажа
+struct BacktestTrade {
+    uint64_t entryIndex;
+    uint64_t exitIndex;
+    float entryPrice;
+    float exitPrice;
+    int direction;
+};
+
+struct BacktestResult {
+    BacktestParams params;
+    // сумма доходностей сделок в долях цены входа
+    double totalReturn;
+    // наибольшая просадка суммы доходностей закрытых сделок
+    double maxDrawdown;
+    uint64_t tradeCount;
+    uint64_t winCount;
+};
+
+// закрытия, максимумы и минимумы свечей подряд: прогоны стратегий читают
+// только нужные им колонки, одни на все прогоны перебора параметров,
+// максимумы и минимумы заполняются, только если нужны
+struct BacktestPrices {
+    BacktestPrices(const FilteredView &candles, bool isHighLowNeeded);
+    std::vector<float> close;
+    std::vector<float> high;
+    std::vector<float> low;
+};
+
+class Backtest
+{
+public:
+    // прогон стратегии, сделки записываются в trades, если он задан,
+    // позиция, открытая на последней свече, закрывается по ее закрытию
+    static BacktestResult runStrategy(
+        const DataSeries &dataSeries,
+        const BacktestParams &params,
+        std::vector<BacktestTrade> *trades = nullptr
+    );
+    // прогон по выбранным свечам, индексы сделок - номера свечей в candles
+    static BacktestResult runStrategy(
+        const FilteredView &candles,
+        const BacktestParams &params,
+        std::vector<BacktestTrade> *trades = nullptr
+    );
+    // прогоны всех наборов параметров на всех ядрах, результаты
+    // в порядке params
+    static std::vector<BacktestResult> sweep(
+        const DataSeries &dataSeries,
+        const std::vector<BacktestParams> &params
+    );
+    static std::vector<BacktestResult> sweep(
+        const FilteredView &candles,
+        const std::vector<BacktestParams> &params
+    );
+    // разбор стратегии вида ma:10:50 или breakout:20:10
+    static bool parseParams(const QString &text, BacktestParams *params);
+
+    // запрошен ли перебор параметров в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // перебор по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+};
+
+#endif // BACKTEST_H
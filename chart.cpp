@@ -0,0 +1,2641 @@
+#include "chart.h"
+#include "dialect.h"
+
+#include <QPainter>
+#include <QFontMetricsF>
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <math.h>
+
+ChartData::ChartData(
+    const DataSeries &dataSeries,
+    const PatternIndex &patternIndex,
+    const SessionIndex &sessionIndex,
+    const IndicatorSet &indicators
+)
+    : dataSeries(dataSeries.share()),
+      patternIndex(patternIndex),
+      sessionIndex(sessionIndex),
+      indicators(indicators.snapshot(&this->dataSeries))
+{
+}
+
+Chart::Chart(const DataSeries *dataSeries)
+{
+    mView = DataView(dataSeries);
+    mPatternIndex = nullptr;
+    mIndicators = nullptr;
+    mSessionIndex = nullptr;
+    mOverviewSize = 0;
+    mIsInteractive = false;
+
+    optShowLabelsWithMouse = true;
+    optSelectAreaWithMouse = true;
+    optShowVolumeGraph = true;
+    optShowScrollArea = true;
+    optShowSelectionStats = true;
+    optShowVolumeProfile = true;
+    optShowPatterns = true;
+
+    mDataXBounds = QPointF(-1000, 1000);
+    mDataYBounds = QPointF(0, 1);
+    mVolumeBounds = QPointF(0, 1);
+
+    mMousePos = QPoint(-1, -1);
+    mMouseGraphPressPos = QPoint(-1, -1);
+    mMouseGraphReleasePos = QPoint(-1, -1);
+    mIsMouseEnter = false;
+    mIsLmbMousePressed = false;
+    mIsMousePressInGraph = false;
+    mIsNeedRefitBounds = false;
+    mScrollAreaRect = QRect();
+    mPaintSize = QSize();
+    mCursorShape = Qt::ArrowCursor;
+
+    mAxisXBounds = QPoint(0, 0);
+    mAxisYBounds = QPoint(0, 0);
+    mBoundsPixelOffset = 0;
+    mBoundsDataSize = 0;
+    mDataRevision = 0;
+
+    mBackgroundBrush = QBrush(Qt::white);
+    mAxisPen = QPen(Qt::black, 1);
+    mMouseAxisPen = QPen(Qt::blue, 1);
+    mMouseAxisPen.setStyle(Qt::DashLine);
+    mMouseAxisVolumePen = QPen(Qt::red, 1);
+    mMouseAxisVolumePen.setStyle(Qt::DashLine);
+    mMouseLabelPen = QPen(Qt::blue, 1);
+    mMouseVolumeLabelPen = QPen(Qt::red, 1);
+    mMouseSelectAreaPen = QPen(Qt::darkBlue, 1);
+    mMouseSelectAreaPen.setStyle(Qt::DashLine);
+    mMouseSelectAreaLabelsPen = QPen(mMouseSelectAreaPen.color(), 1);
+    mMouseSelectAreaBrushAlpha = 80;
+    mCandlePen = QPen(Qt::black, 1);
+    mCandleUpBrush = QBrush(Qt::green);
+    mCandleDownBrush = QBrush(Qt::red);
+    mCandleBrushAlpha = 80;
+    mScrollBarPen = QPen(Qt::darkGray, 1);
+
+    QColor selectAreaColor = mMouseSelectAreaPen.color();
+    selectAreaColor.setAlpha(mMouseSelectAreaBrushAlpha);
+    mMouseSelectAreaBrush = QBrush(selectAreaColor, Qt::SolidPattern);
+    QColor upColor = mCandleUpBrush.color();
+    QColor downColor = mCandleDownBrush.color();
+    mCandleUpPen = QPen(upColor, 1);
+    mCandleDownPen = QPen(downColor, 1);
+    upColor.setAlpha(mCandleBrushAlpha);
+    downColor.setAlpha(mCandleBrushAlpha);
+    mVolumeUpPen = QPen(upColor, 1);
+    mVolumeDownPen = QPen(downColor, 1);
+    mVolumeUpBrush = QBrush(upColor, Qt::SolidPattern);
+    mVolumeDownBrush = QBrush(downColor, Qt::SolidPattern);
+    mVolumeProfileBrush = QBrush(QColor(0, 0, 160, 50), Qt::SolidPattern);
+    mTradeProfitPen = QPen(QColor(0, 160, 0), 2);
+    mTradeLossPen = QPen(QColor(200, 0, 0), 2);
+    mTradeLongBrush = QBrush(Qt::darkGreen, Qt::SolidPattern);
+    mTradeShortBrush = QBrush(Qt::darkRed, Qt::SolidPattern);
+    // доджи, молот, бычье и медвежье поглощение, внутренний бар,
+    // разрывы вверх и вниз
+    const QColor patternColors[PatternCount] = {
+        QColor(128, 128, 128),
+        QColor(200, 120, 0),
+        QColor(0, 150, 0),
+        QColor(200, 0, 0),
+        QColor(0, 120, 200),
+        QColor(0, 200, 160),
+        QColor(180, 0, 180)
+    };
+    for (int i = 0; i < PatternCount; ++i) {
+        mPatternBrushes[i] = QBrush(patternColors[i], Qt::SolidPattern);
+    }
+    const QColor indicatorColors[IndicatorPenCount] = {
+        QColor(0, 90, 220),
+        QColor(230, 120, 0),
+        QColor(150, 0, 200),
+        QColor(0, 150, 150)
+    };
+    for (int i = 0; i < IndicatorPenCount; ++i) {
+        mIndicatorPens[i] = QPen(indicatorColors[i], 1.5);
+    }
+    mSessionSeparatorPen = QPen(Qt::gray, 1);
+    mSessionSeparatorPen.setStyle(Qt::DotLine);
+
+    mAxisXLeftBorderLength = 0;
+    mAxisXRightBorderLength = 52;
+    mAxisYTopBorderLength = 0;
+    mAxisYBottomBorderLength = 20;
+    mAxisXDashCount = 10;
+    mAxisYDashCount = 10;
+    mAxisYVolumeDashCount = 4;
+    mAxisXDashLen = 4;
+    mAxisYDashLen = 4;
+    mAxisXDashSpace = 2;
+    mAxisYDashSpace = 4;
+    mAxisLabelHalfWidth = 20;
+    mAxisLabelHalfHeight = 5;
+    mAxisTimeLabelHalfWidth = 36;
+    mAxisTimeLabelSpace = 12;
+    mSessionSeparatorMinSpace = 6;
+    mMaxAxisLabelLength = 6;
+    mAxisLabelXAdditionalLength = 1;
+    mAxisLabelYAdditionalLength = 1;
+    mCandleStep = 17;
+    mBetweenCandlesWidth = 2;
+    mViewedCandleCount = 0;
+    mCandleOffsetFromEnd = 0;
+    mCandleMinWidth = 3;
+    mCandleMaxWidth = 50;
+    mAxisYVolumeHeight = 100;
+    mAxisYScrollBarHeight = 30;
+    mSelectionStatsWidth = 120;
+    mSelectionStatsLineHeight = 14;
+    mVolumeProfileWidth = 100;
+    mVolumeProfileBucketCount = 60;
+    mTradeMarkerSize = 5;
+    mPatternMarkerRadius = 2.5;
+    mPatternMarkerMinStep = 6;
+    mInteractiveCandleMinStep = 8;
+    mIndicatorMaxEvaluateCount = 1 << 20;
+}
+
+bool Chart::showLabelsWithMouse() const
+{
+    return optShowLabelsWithMouse;
+}
+
+void Chart::setShowLabelsWithMouse(bool newValue)
+{
+    if (optShowLabelsWithMouse != newValue) {
+        optShowLabelsWithMouse = newValue;
+    }
+}
+
+bool Chart::selectAreaWithMouse() const
+{
+    return optSelectAreaWithMouse;
+}
+
+void Chart::setSelectAreaWithMouse(bool newValue)
+{
+    if (optSelectAreaWithMouse != newValue) {
+        optSelectAreaWithMouse = newValue;
+    }
+}
+
+bool Chart::showVolumeGraph() const
+{
+    return optShowVolumeGraph;
+}
+
+void Chart::setShowVolumeGraph(bool newValue)
+{
+    if (optShowVolumeGraph != newValue) {
+        optShowVolumeGraph = newValue;
+        // меняется высота графика, подгоним диапазоны
+        mIsNeedRefitBounds = true;
+    }
+}
+
+bool Chart::showScrollArea() const
+{
+    return optShowScrollArea;
+}
+
+void Chart::setShowScrollArea(bool newValue)
+{
+    if (optShowScrollArea != newValue) {
+        optShowScrollArea = newValue;
+        // меняется высота графика, подгоним диапазоны
+        mIsNeedRefitBounds = true;
+    }
+}
+
+bool Chart::showSelectionStats() const
+{
+    return optShowSelectionStats;
+}
+
+void Chart::setShowSelectionStats(bool newValue)
+{
+    if (optShowSelectionStats != newValue) {
+        optShowSelectionStats = newValue;
+    }
+}
+
+bool Chart::showVolumeProfile() const
+{
+    return optShowVolumeProfile;
+}
+
+void Chart::setShowVolumeProfile(bool newValue)
+{
+    if (optShowVolumeProfile != newValue) {
+        optShowVolumeProfile = newValue;
+    }
+}
+
+const DataSeries *Chart::dataSeries() const
+{
+    return mView.dataSeries();
+}
+
+const DataView &Chart::view() const
+{
+    return mView;
+}
+
+void Chart::setView(const DataView &view)
+{
+    mView = view;
+    // другие свечи, подгоним диапазоны
+    mIsNeedRefitBounds = true;
+}
+
+// ширина тела свечи (шаг свечи за вычетом промежутка между свечами)
+float Chart::candleWidth() const
+{
+    return mCandleStep - mBetweenCandlesWidth;
+}
+
+void Chart::setCandleWidth(float newValue)
+{
+    float step = qBound(
+        candleMinStep(),
+        newValue + mBetweenCandlesWidth,
+        candleMaxStep()
+    );
+    if (mCandleStep != step) {
+        mCandleStep = step;
+        mIsNeedRefitBounds = true;
+    }
+}
+
+bool Chart::isInteractive() const
+{
+    return mIsInteractive;
+}
+
+void Chart::setInteractive(bool isInteractive)
+{
+    mIsInteractive = isInteractive;
+}
+
+float Chart::interactiveCandleMinStep() const
+{
+    return mInteractiveCandleMinStep;
+}
+
+// не меньше шага, с которого свечи рисуются и без взаимодействия
+void Chart::setInteractiveCandleMinStep(float newValue)
+{
+    mInteractiveCandleMinStep = qBound<float>(
+        mCandleMinWidth + mBetweenCandlesWidth,
+        newValue,
+        candleMaxStep()
+    );
+}
+
+bool Chart::showPatterns() const
+{
+    return optShowPatterns;
+}
+
+bool Chart::isPatternsDrawn() const
+{
+    return optShowPatterns && mCandleStep >= mPatternMarkerMinStep;
+}
+
+void Chart::setShowPatterns(bool newValue)
+{
+    if (optShowPatterns != newValue) {
+        optShowPatterns = newValue;
+    }
+}
+
+void Chart::setPatternIndex(const PatternIndex *patternIndex)
+{
+    mPatternIndex = patternIndex;
+}
+
+void Chart::setSessionIndex(const SessionIndex *sessionIndex)
+{
+    mSessionIndex = sessionIndex;
+}
+
+void Chart::setOverview(
+    const std::shared_ptr<const std::vector<Candle> > &candles,
+    uint64_t size
+)
+{
+    mOverview = candles;
+    mOverviewSize = size;
+    if (mOverview && !mOverview->empty()) {
+        mOverviewBounds = QPointF(mOverview->front().low, mOverview->front().high);
+        for (const Candle &candle : *mOverview) {
+            mOverviewBounds.setX(qMin<qreal>(mOverviewBounds.x(), candle.low));
+            mOverviewBounds.setY(qMax<qreal>(mOverviewBounds.y(), candle.high));
+        }
+    }
+}
+
+void Chart::setIndicators(const IndicatorSnapshot *indicators)
+{
+    mIndicators = indicators;
+}
+
+void Chart::setData(const ChartData *data)
+{
+    mView = mView.withSeries(&data->dataSeries);
+    mPatternIndex = &data->patternIndex;
+    mSessionIndex = &data->sessionIndex;
+    mIndicators = &data->indicators;
+}
+
+void Chart::setTrades(const std::shared_ptr<const std::vector<BacktestTrade> > &trades)
+{
+    mTrades = trades;
+}
+
+void Chart::setMousePos(const QPoint &pos)
+{
+    mMousePos = pos;
+}
+
+void Chart::setMouseEnter(bool isEnter)
+{
+    mIsMouseEnter = isEnter;
+}
+
+// команды выделения области применяются сразу по раскладке последнего
+// подготовленного кадра, то есть того, который видит пользователь
+void Chart::pressLeftButton(const QPoint &pos)
+{
+    mIsLmbMousePressed = true;
+    if (!optSelectAreaWithMouse) {
+        return;
+    }
+    if (
+        pos.x() >= mAxisXBounds.x() &&
+        pos.x() < mAxisXBounds.y() &&
+        pos.y() >= mAxisYBounds.x() &&
+        pos.y() < mAxisYBounds.y()
+    ) {
+        mMouseGraphPressPos = pos;
+        mIsMousePressInGraph = true;
+    } else {
+        mIsMousePressInGraph = false;
+    }
+}
+
+void Chart::releaseLeftButton(const QPoint &pos)
+{
+    mIsLmbMousePressed = false;
+    if (optSelectAreaWithMouse && mIsMousePressInGraph) {
+        mMouseGraphReleasePos = pos;
+    }
+}
+
+void Chart::clearSelectedArea()
+{
+    mMouseGraphPressPos = QPoint(-1, -1);
+    mMouseGraphReleasePos = QPoint(-1, -1);
+    mIsMousePressInGraph = false;
+}
+
+QRect Chart::scrollAreaRect() const
+{
+    return mScrollAreaRect;
+}
+
+Qt::CursorShape Chart::cursorShape() const
+{
+    return mCursorShape;
+}
+
+QBrush Chart::backgroundBrush() const
+{
+    return mBackgroundBrush;
+}
+
+// область, занятая осями мышки с метками в текущем положении мыши
+QRegion Chart::crosshairRegion() const
+{
+    int mx = mMousePos.x();
+    int my = mMousePos.y();
+    int axisMinY = mAxisYBounds.x();
+    int axisMaxY = mAxisYBounds.y();
+    if (
+        !optShowLabelsWithMouse ||
+        !mIsMouseEnter ||
+        mx < mAxisXBounds.x() ||
+        mx >= mAxisXBounds.y() ||
+        my < axisMinY
+    ) {
+        return QRegion();
+    }
+    if (my < axisMaxY) {
+        return getAxisLinesRegion(
+            mMousePos,
+            QPoint(axisMinY, axisMaxY),
+            optShowVolumeGraph ? mAxisYVolumeHeight : 0
+        );
+    }
+    if (optShowVolumeGraph && my < axisMaxY + mAxisYVolumeHeight) {
+        return getAxisLinesRegion(
+            mMousePos,
+            QPoint(axisMaxY, axisMaxY + mAxisYVolumeHeight),
+            0
+        );
+    }
+    return QRegion();
+}
+
+// область, занятая выделением на графике: оси с метками в обеих точках,
+// заливка между ними и надпись с пройденным расстоянием
+QRegion Chart::selectionRegion() const
+{
+    QRegion region;
+    if (!optSelectAreaWithMouse) {
+        return region;
+    }
+    QPoint mainYBounds = mAxisYBounds;
+    int offset = optShowVolumeGraph ? mAxisYVolumeHeight : 0;
+    QPoint pos1 = mMouseGraphPressPos;
+    if (pos1.x() != -1 && pos1.y() != -1) {
+        region += getAxisLinesRegion(pos1, mainYBounds, offset);
+    }
+    QPoint pos2 = getSelectionEndPos();
+    if (pos2.x() != -1 && pos2.y() != -1) {
+        region += getAxisLinesRegion(pos2, mainYBounds, offset);
+        region += getRectForSelectionLabel(pos2).adjusted(-1, -1, 1, 1);
+        region += QRect(pos1, pos2).normalized().adjusted(-1, -1, 1, 1);
+    }
+    return region;
+}
+
+// масштабирование в factor раз, точка anchorX графика остается на месте
+bool Chart::zoom(float factor, int anchorX)
+{
+    if (mGraphRect.isEmpty()) {
+        return false;
+    }
+    float step = qBound(candleMinStep(), mCandleStep * factor, candleMaxStep());
+    if (step == mCandleStep) {
+        return false;
+    }
+    // если точка вне графика - на месте остается правый край
+    int axisMaxX = mGraphRect.right() + 1;
+    if (anchorX < mGraphRect.left() || anchorX >= axisMaxX) {
+        anchorX = axisMaxX;
+    }
+    mCandleOffsetFromEnd += (axisMaxX - anchorX) / mCandleStep -
+        (axisMaxX - anchorX) / step;
+    if (mCandleOffsetFromEnd < 0) {
+        mCandleOffsetFromEnd = 0;
+    }
+    mCandleStep = step;
+    mIsNeedRefitBounds = true;
+    return true;
+}
+
+int Chart::pixelOffsetFromEnd() const
+{
+    return qRound(mCandleOffsetFromEnd * mCandleStep);
+}
+
+// наименьший шаг свечи: вся история помещается в график
+float Chart::candleMinStep() const
+{
+    float step = mCandleMinWidth + mBetweenCandlesWidth;
+    if (mView.size() > 0 && !mGraphRect.isEmpty()) {
+        // место крайней правой свечи не занимаем
+        float historyStep = 1.0 * mGraphRect.width() / (mView.size() + 1);
+        if (historyStep < step) {
+            step = historyStep;
+        }
+    }
+    return step;
+}
+
+float Chart::candleMaxStep() const
+{
+    return mCandleMaxWidth + mBetweenCandlesWidth;
+}
+
+// сдвиг окна просмотра на dx пикселей (положительный - в сторону истории)
+bool Chart::panByPixels(int dx)
+{
+    double maxOffset = (double)mView.size() - mViewedCandleCount;
+    if (maxOffset < 0) {
+        maxOffset = 0;
+    }
+    int pixelOffset = qBound(
+        0,
+        pixelOffsetFromEnd() + dx,
+        (int)floor(maxOffset * mCandleStep)
+    );
+    if (pixelOffset == pixelOffsetFromEnd()) {
+        return false;
+    }
+    mCandleOffsetFromEnd = pixelOffset / mCandleStep;
+    return true;
+}
+
+// завершение перетаскивания: диапазон по Y подгоняется под видимые свечи
+void Chart::finishPan()
+{
+    mIsNeedRefitBounds = true;
+}
+
+// перенос центра окна просмотра в точку x на скроллбаре
+bool Chart::scrollToScrollBarPosition(int x)
+{
+    if (mScrollAreaRect.isEmpty()) {
+        return false;
+    }
+    // на скроллбаре последние свечи справа
+    float ratio = 1.0 * (mScrollAreaRect.right() + 1 - x) / mScrollAreaRect.width();
+    // по выборке скроллбар показывает весь файл, окно дальше разобранного
+    // конца не уйдет
+    double centerIndex = ratio * (mOverview ? mOverviewSize : mView.size());
+    int pixelOffset = qRound((centerIndex - mViewedCandleCount / 2) * mCandleStep);
+    return panByPixels(pixelOffset - pixelOffsetFromEnd());
+}
+
+// сдвиг содержимого изображения по горизонтали на dx пикселей,
+// освободившаяся полоса остается с прежним содержимым
+static void scrollImageHorizontally(QImage *image, int dx)
+{
+    int width = image->width();
+    if (dx == 0 || qAbs(dx) >= width) {
+        return;
+    }
+    int bytesPerPixel = image->depth() / 8;
+    size_t movedBytes = (width - qAbs(dx)) * bytesPerPixel;
+    for (int y = 0; y < image->height(); ++y) {
+        uchar *line = image->scanLine(y);
+        if (dx > 0) {
+            memmove(line + dx * bytesPerPixel, line, movedBytes);
+        } else {
+            memmove(line, line - dx * bytesPerPixel, movedBytes);
+        }
+    }
+}
+
+ChartCache::ChartCache()
+{
+    candleStep = 0;
+    pixelOffset = 0;
+    dataBegin = 0;
+    dataSize = 0;
+    dataRevision = 0;
+    showVolumeGraph = false;
+    isInteractive = false;
+    isValid = false;
+}
+
+uint64_t ChartCache::memoryUsage() const
+{
+    uint64_t bytes = (uint64_t)image.bytesPerLine() * image.height();
+    bytes += (
+        upLines.capacity() +
+        downLines.capacity() +
+        upVolumeLines.capacity() +
+        downVolumeLines.capacity()
+    ) * sizeof(QLineF);
+    bytes += volumeProfile.volumes().capacity() * sizeof(double);
+    for (const std::vector<double> &column : indicatorScratch.columns) {
+        bytes += column.capacity() * sizeof(double);
+    }
+    for (const std::vector<float> &values : indicatorScratch.values) {
+        bytes += values.capacity() * sizeof(float);
+    }
+    bytes += indicatorPoints.capacity() * sizeof(QPointF);
+    return bytes;
+}
+
+void ChartCache::release()
+{
+    image = QImage();
+    isValid = false;
+    std::vector<QLineF>().swap(upLines);
+    std::vector<QLineF>().swap(downLines);
+    std::vector<QLineF>().swap(upVolumeLines);
+    std::vector<QLineF>().swap(downVolumeLines);
+    volumeProfile = VolumeProfile();
+    indicatorScratch = IndicatorScratch();
+    std::vector<QPointF>().swap(indicatorPoints);
+}
+
+// индексы свечей (от конца ряда), попадающих в полосу [x1, x2)
+void Chart::getCandlesInRange(
+    int x1,
+    int x2,
+    int axisMaxX,
+    int pixelOffset,
+    int *firstIndex,
+    int *lastIndex
+) const
+{
+    // свеча с индексом i занимает место левее
+    // xmax = axisMaxX - (i + 1) * mCandleStep + pixelOffset
+    double first = floor((axisMaxX + pixelOffset - x2) / mCandleStep) - 2;
+    double last = ceil((axisMaxX + pixelOffset - x1) / mCandleStep);
+    *firstIndex = (int)qMax(first, 0.0);
+    *lastIndex = (int)qMin(last, (double)mView.size() - 1);
+}
+
+// пересчет диапазонов значений по свечам [firstIndex, lastIndex] от конца ряда,
+// при isExpandOnly диапазоны только расширяются
+void Chart::updateDataBounds(int firstIndex, int lastIndex, bool isExpandOnly)
+{
+    // индексы от конца ряда переводим в индексы от начала
+    CandleRange range = mView.range(
+        mView.size() - 1 - lastIndex,
+        mView.size() - firstIndex
+    );
+    if (isExpandOnly) {
+        if (mDataYBounds.x() < range.low) {
+            range.low = mDataYBounds.x();
+        }
+        if (mDataYBounds.y() > range.high) {
+            range.high = mDataYBounds.y();
+        }
+        if (mVolumeBounds.y() > range.maxVolume) {
+            range.maxVolume = mVolumeBounds.y();
+        }
+    }
+    mDataYBounds = QPointF(range.low, range.high);
+    if (optShowVolumeGraph) {
+        mVolumeBounds = QPointF(0, range.maxVolume);
+    }
+}
+
+// обновление изображения графика свечей и объемов: при сдвиге окна просмотра
+// и дописывании свечей уже нарисованные пиксели сдвигаются, а рисуются
+// только открывшиеся свечи
+void Chart::updateGraphCache(
+    const QRect &graphRect,
+    const QPoint &axisYBounds,
+    ChartCache *cache
+) const
+{
+    int pixelOffset = pixelOffsetFromEnd();
+    int axisMinX = graphRect.left();
+    int axisMaxX = graphRect.right() + 1;
+    bool isCacheValid = cache->isValid &&
+        cache->rect == graphRect &&
+        cache->candleStep == mCandleStep &&
+        cache->dataYBounds == mDataYBounds &&
+        cache->volumeBounds == mVolumeBounds &&
+        cache->showVolumeGraph == optShowVolumeGraph &&
+        cache->dataBegin == mView.begin() &&
+        cache->dataRevision == mDataRevision &&
+        cache->dataSize <= mView.size() &&
+        // упрощенный кэш после взаимодействия перерисовывается целиком
+        (mIsInteractive || !cache->isInteractive);
+    int dx = pixelOffset - cache->pixelOffset;
+    // свечи отсчитываются от конца ряда, поэтому дописанные свечи сдвигают
+    // график влево на свое кол-во шагов; изображение сдвигается, только если
+    // это целое число пикселей, иначе края свечей выровнялись бы иначе
+    int appendShift = 0;
+    if (isCacheValid && cache->dataSize < mView.size()) {
+        double shift = (mView.size() - cache->dataSize) * (double)mCandleStep;
+        isCacheValid = dx == 0 && shift == floor(shift) && shift < graphRect.width();
+        if (isCacheValid) {
+            appendShift = shift;
+            dx = -appendShift;
+        }
+    }
+    if (isCacheValid && dx == 0) {
+        return;
+    }
+    QRect dirtyRect = graphRect;
+    if (cache->image.size() != graphRect.size()) {
+        cache->image = QImage(graphRect.size(), QImage::Format_ARGB32_Premultiplied);
+    }
+    bool isScrolled = isCacheValid && qAbs(dx) < graphRect.width();
+    if (isScrolled) {
+        scrollImageHorizontally(&cache->image, dx);
+        if (dx > 0) {
+            dirtyRect.setRight(axisMinX + dx - 1);
+        } else if (appendShift > 0) {
+            // на место свободного шага справа встает последняя из новых свечей,
+            // столбец на границе огибающей может делить старая и новая свечи
+            dirtyRect.setLeft(qMax(axisMinX, axisMaxX + dx - (int)ceil(mCandleStep) - 1));
+        } else {
+            dirtyRect.setLeft(axisMaxX + dx);
+        }
+    }
+
+    QPainter painter;
+    painter.begin(&cache->image);
+    painter.setRenderHint(QPainter::HighQualityAntialiasing, !mIsInteractive);
+    // рисуем в координатах виджета
+    painter.translate(-graphRect.left(), -graphRect.top());
+    painter.setClipRect(dirtyRect);
+    painter.fillRect(dirtyRect, mBackgroundBrush);
+    float candleDrawMinStep = mCandleMinWidth + mBetweenCandlesWidth;
+    if (mIsInteractive) {
+        candleDrawMinStep = qMax(candleDrawMinStep, mInteractiveCandleMinStep);
+    }
+    if (mCandleStep >= candleDrawMinStep) {
+        int firstIndex, lastIndex;
+        getCandlesInRange(
+            dirtyRect.left(),
+            dirtyRect.right() + 1,
+            axisMaxX,
+            pixelOffset,
+            &firstIndex,
+            &lastIndex
+        );
+        drawCandles(
+            &painter,
+            QPoint(axisMinX, axisMaxX),
+            axisYBounds,
+            firstIndex,
+            lastIndex
+        );
+    } else {
+        // свечи уже не различимы, рисуем огибающую по столбцам пикселей
+        drawDecimatedCandles(
+            &painter,
+            QPoint(axisMinX, axisMaxX),
+            axisYBounds,
+            dirtyRect.left(),
+            dirtyRect.right() + 1,
+            cache
+        );
+    }
+    painter.end();
+
+    cache->rect = graphRect;
+    cache->candleStep = mCandleStep;
+    cache->dataYBounds = mDataYBounds;
+    cache->volumeBounds = mVolumeBounds;
+    cache->showVolumeGraph = optShowVolumeGraph;
+    cache->dataBegin = mView.begin();
+    cache->dataSize = mView.size();
+    cache->dataRevision = mDataRevision;
+    cache->pixelOffset = pixelOffset;
+    // сдвинутые пиксели остаются нарисованными как раньше
+    cache->isInteractive = mIsInteractive || (isScrolled && cache->isInteractive);
+    cache->isValid = true;
+}
+
+void Chart::drawCandles(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    int firstIndex,
+    int lastIndex
+) const
+{
+    int pixelOffset = pixelOffsetFromEnd();
+    int axisMaxY = axisYBounds.y();
+    int candleWidth = qRound(mCandleStep) - mBetweenCandlesWidth;
+    painter->setPen(mCandlePen);
+    for (int i = firstIndex; i <= lastIndex; ++i) {
+        const Candle &currCandle = mView.fromEnd(i);
+        // место крайней правой свечи не занимаем,
+        // края свечей выравниваем по пикселям
+        int xmax = floor(axisXBounds.y() - (i + 1) * mCandleStep) + pixelOffset;
+        int xmin = xmax - candleWidth;
+        // так как ось Y расположена сверху вниз, а рисуем мы ее снизу вверх
+        // значения надо отображать "зеркально"
+        float xavg = (xmin + xmax) / 2;
+        // объем свечи
+        if (optShowVolumeGraph) {
+            // если включено график объемов, нужно помнить,
+            // что axisMaxY скорректирована, используем "реальный" axisMaxY
+            int axisMaxYReal = axisMaxY + mAxisYVolumeHeight;
+            float yvol = getCurrentAxisValue(
+                QPoint(0, mAxisYVolumeHeight),
+                mVolumeBounds,
+                currCandle.volume
+            );
+            QRectF volumeRect = QRectF(
+                QPointF(xmin, axisMaxYReal - yvol),
+                QPointF(xmax, axisMaxYReal)
+            );
+            painter->fillRect(
+                volumeRect,
+                currCandle.close > currCandle.open ?
+                    mVolumeUpBrush :
+                    mVolumeDownBrush
+            );
+        }
+        // тень свечи
+        QPoint yScale = axisYBounds;
+        float ymax = getCurrentAxisValue(yScale, mDataYBounds, currCandle.high);
+        float ymin = getCurrentAxisValue(yScale, mDataYBounds, currCandle.low);
+        float yopn = getCurrentAxisValue(yScale, mDataYBounds, currCandle.open);
+        float ycls = getCurrentAxisValue(yScale, mDataYBounds, currCandle.close);
+        painter->drawLine(
+            QPointF(xavg, yScale.y() - (ymin - yScale.x())),
+            QPointF(xavg, yScale.y() - (ymax - yScale.x()))
+        );
+        QRectF candleRect = QRectF(
+            QPointF(xmin, yScale.y() - (yopn - yScale.x())),
+            QPointF(xmax, yScale.y() - (ycls - yScale.x()))
+        );
+        // цветоное тело свечи
+        painter->fillRect(
+            candleRect,
+            currCandle.close > currCandle.open ? mCandleUpBrush : mCandleDownBrush
+        );
+        // контур свечи, при взаимодействии не рисуется
+        if (!mIsInteractive) {
+            painter->drawRect(candleRect);
+        }
+    }
+}
+
+// профиль объема по ценам видимых свечей: гистограмма объема по корзинам
+// цены у правого края графика цен, строится в кэше потока и при прокрутке
+// пересчитывается только по свечам, ушедшим и попавшим в окно просмотра
+void Chart::drawVolumeProfile(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    ChartCache *cache
+) const
+{
+    int64_t size = mView.size();
+    double priceRange = mDataYBounds.y() - mDataYBounds.x();
+    if (size == 0 || !(priceRange > 0)) {
+        return;
+    }
+    int firstIndex, lastIndex;
+    getCandlesInRange(
+        axisXBounds.x(),
+        axisXBounds.y(),
+        axisXBounds.y(),
+        pixelOffsetFromEnd(),
+        &firstIndex,
+        &lastIndex
+    );
+    if (firstIndex > lastIndex) {
+        return;
+    }
+    // индексы от конца ряда переводим в индексы от начала
+    VolumeProfile &profile = cache->volumeProfile;
+    profile.update(
+        mView.dataSeries(),
+        mView.begin() + size - 1 - lastIndex,
+        mView.begin() + size - firstIndex,
+        VolumeProfile::niceBucketSize(priceRange / mVolumeProfileBucketCount)
+    );
+    if (profile.maxVolume() <= 0) {
+        return;
+    }
+    const std::vector<double> &volumes = profile.volumes();
+    double bucketSize = profile.bucketSize();
+    for (size_t b = 0; b < volumes.size(); ++b) {
+        if (volumes[b] <= 0) {
+            continue;
+        }
+        // так как ось Y расположена сверху вниз, значения "зеркальные"
+        double low = (profile.firstBucket() + (int64_t)b) * bucketSize;
+        float ylow = axisYBounds.y() - (
+            getCurrentAxisValue(axisYBounds, mDataYBounds, low) - axisYBounds.x()
+        );
+        float yhigh = axisYBounds.y() - (
+            getCurrentAxisValue(axisYBounds, mDataYBounds, low + bucketSize) -
+            axisYBounds.x()
+        );
+        ylow = qMin<float>(ylow, axisYBounds.y());
+        yhigh = qMax<float>(yhigh, axisYBounds.x());
+        if (yhigh >= ylow) {
+            continue;
+        }
+        float width = volumes[b] / profile.maxVolume() * mVolumeProfileWidth;
+        painter->fillRect(
+            QRectF(
+                QPointF(axisXBounds.y() - width, yhigh),
+                QPointF(axisXBounds.y(), ylow)
+            ),
+            mVolumeProfileBrush
+        );
+    }
+}
+
+// шаг подписей оси времени в секундах или в месяцах
+struct TimeAxisInterval {
+    int64_t seconds;
+    int months;
+};
+
+static const TimeAxisInterval timeAxisIntervals[] = {
+    {1, 0}, {5, 0}, {15, 0}, {30, 0},
+    {60, 0}, {5 * 60, 0}, {15 * 60, 0}, {30 * 60, 0},
+    {3600, 0}, {2 * 3600, 0}, {4 * 3600, 0}, {6 * 3600, 0}, {12 * 3600, 0},
+    {86400, 0}, {2 * 86400, 0}, {7 * 86400, 0},
+    {0, 1}, {0, 3}, {0, 6}, {0, 12}, {0, 24}, {0, 60}, {0, 120}
+};
+
+// средняя длина месяца в секундах, для выбора шага подписей
+static const double MonthSeconds = 2629746;
+
+// ближайшая к seconds граница шага interval не раньше нее
+static int64_t ceilTimeToInterval(int64_t seconds, const TimeAxisInterval &interval)
+{
+    if (interval.months == 0) {
+        // недели отсчитываются от понедельника 1970-01-05
+        int64_t origin = interval.seconds % (7 * 86400) == 0 ? 4 * 86400 : 0;
+        int64_t shifted = seconds - origin;
+        int64_t count = shifted / interval.seconds + (shifted % interval.seconds > 0);
+        return count * interval.seconds + origin;
+    }
+    uint64_t date, time;
+    unixTimeToDateTime(qMax<int64_t>(seconds, 0), &date, &time);
+    // месяцы от начала нашей эры, не с начала месяца - следующий месяц
+    int64_t month = date / 10000 * 12 + date / 100 % 100 - 1;
+    if (date % 100 != 1 || time != 0) {
+        ++month;
+    }
+    month = (month + interval.months - 1) / interval.months * interval.months;
+    Candle candle = {};
+    candle.date = month / 12 * 10000 + (month % 12 + 1) * 100 + 1;
+    return candleSeconds(candle);
+}
+
+bool Chart::isTimeAxis() const
+{
+    return mSessionIndex != nullptr &&
+        mSessionIndex->size() > 0 &&
+        mSessionIndex->step() > 0;
+}
+
+// свеча с индексом ряда i занимает по x промежуток
+// [rightX - (viewEnd - i) * mCandleStep, rightX - (viewEnd - i - 1) * mCandleStep)
+int64_t Chart::getSeriesIndexAt(float x, const QPoint &axisXBounds) const
+{
+    double rightX = axisXBounds.y() + pixelOffsetFromEnd();
+    int64_t viewEnd = mView.begin() + mView.size();
+    return viewEnd - 1 - (int64_t)floor((rightX - x) / mCandleStep);
+}
+
+float Chart::getSeriesIndexX(int64_t index, const QPoint &axisXBounds) const
+{
+    double rightX = axisXBounds.y() + pixelOffsetFromEnd();
+    int64_t viewEnd = mView.begin() + mView.size();
+    return rightX - (viewEnd - index) * mCandleStep;
+}
+
+// линии начал сессий среди видимых свечей, сессии, начавшиеся ближе
+// mSessionSeparatorMinSpace пикселей к последней линии, пропускаются
+// двоичным поиском, поэтому стоимость зависит только от ширины графика
+void Chart::drawSessionSeparators(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds
+) const
+{
+    int64_t viewEnd = mView.begin() + mView.size();
+    int64_t first = qMax<int64_t>(getSeriesIndexAt(axisXBounds.x(), axisXBounds), mView.begin());
+    int64_t last = qMin<int64_t>(getSeriesIndexAt(axisXBounds.y() - 1, axisXBounds), viewEnd - 1);
+    if (first > last) {
+        return;
+    }
+    painter->setClipRect(mGraphRect, Qt::IntersectClip);
+    painter->setPen(mSessionSeparatorPen);
+    // первая сессия начинается с начала ряда, линия ей не нужна
+    size_t session = mSessionIndex->lowerBound(qMax<int64_t>(first, 1));
+    while (
+        session < mSessionIndex->size() &&
+        (int64_t)mSessionIndex->first(session) <= last
+    ) {
+        float x = getSeriesIndexX(mSessionIndex->first(session), axisXBounds);
+        painter->drawLine(QPointF(x, axisYBounds.x()), QPointF(x, axisYBounds.y()));
+        size_t next = mSessionIndex->lowerBound(
+            getSeriesIndexAt(x + mSessionSeparatorMinSpace, axisXBounds)
+        );
+        session = qMax(next, session + 1);
+    }
+}
+
+// риски и подписи оси X временем свечей: шаг подписей выбирается по
+// обычному шагу свечей так, чтобы подписи не налезали друг на друга,
+// границы шага переводятся в свечи индексом сессий (граница в разрыве
+// попадает на первую свечу следующей сессии), поэтому на кадр уходит
+// O(подписей * log сессий) независимо от длины истории
+void Chart::drawTimeAxis(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    const QRegion &region,
+    ChartCache *cache
+) const
+{
+    const DataSeries *dataSeries = mView.dataSeries();
+    int64_t viewEnd = qMin<int64_t>(
+        mView.begin() + mView.size(),
+        mSessionIndex->scannedCount()
+    );
+    int64_t first = qMax<int64_t>(getSeriesIndexAt(axisXBounds.x(), axisXBounds), mView.begin());
+    int64_t last = qMin<int64_t>(getSeriesIndexAt(axisXBounds.y() - 1, axisXBounds), viewEnd - 1);
+    if (first > last) {
+        return;
+    }
+    int spacing = 2*mAxisTimeLabelHalfWidth + mAxisTimeLabelSpace;
+    double minSeconds = spacing * mSessionIndex->step() / mCandleStep;
+    int intervalCount = sizeof(timeAxisIntervals) / sizeof(timeAxisIntervals[0]);
+    int k = 0;
+    while (
+        k < intervalCount - 1 && (
+            timeAxisIntervals[k].months > 0 ?
+            timeAxisIntervals[k].months * MonthSeconds :
+            timeAxisIntervals[k].seconds
+        ) < minSeconds
+    ) {
+        ++k;
+    }
+    const TimeAxisInterval &interval = timeAxisIntervals[k];
+    bool isIntraday = interval.months == 0 && interval.seconds < 86400;
+
+    // смена дня (года) относительно прошлой подписи подписывается датой (годом)
+    const Candle &firstCandle = dataSeries->at(first);
+    uint64_t prevDate = firstCandle.date < 1000000 ? firstCandle.date + 20000000 : firstCandle.date;
+    float lastX = axisXBounds.x() - spacing;
+    int64_t time = ceilTimeToInterval(candleSeconds(firstCandle), interval);
+    // свечи ближе spacing пропускаются, но не бесконечно
+    int maxStepCount = 4 * ((axisXBounds.y() - axisXBounds.x()) / spacing + 2);
+    char label[LabelSize];
+    for (int i = 0; i < maxStepCount; ++i) {
+        int64_t index = mSessionIndex->indexAt(*dataSeries, time);
+        if (index > last) {
+            break;
+        }
+        const Candle &candle = dataSeries->at(index);
+        float x = getSeriesIndexX(index, axisXBounds) + mCandleStep / 2;
+        if (x - lastX >= spacing) {
+            painter->drawLine(
+                QPointF(x, axisYBounds.y()),
+                QPointF(x, axisYBounds.y() + mAxisXDashLen)
+            );
+            uint64_t date = candle.date < 1000000 ? candle.date + 20000000 : candle.date;
+            QRect labelRect = getRectForAxisLabel(qRound(x), axisXBounds, axisYBounds, true);
+            // подписи вне перерисовываемой области не формируем
+            if (region.intersects(labelRect)) {
+                TimeLabelFormat format;
+                if (isIntraday) {
+                    format = date != prevDate ? TimeLabelDay : TimeLabelMinute;
+                } else if (date / 10000 != prevDate / 10000) {
+                    format = TimeLabelYear;
+                } else {
+                    format = interval.months == 0 ? TimeLabelDay : TimeLabelMonth;
+                }
+                makeTimeLabel(candle.date, candle.time, format, label);
+                drawLabel(painter, labelRect, Qt::AlignCenter, label, cache);
+            }
+            prevDate = date;
+            lastX = x;
+        }
+        time = ceilTimeToInterval(candleSeconds(candle) + 1, interval);
+    }
+}
+
+// метки свечных моделей видимых свечей: по кружку на каждую модель свечи
+// столбиком над ее максимумом, найденные свечи ищутся двоичным поиском,
+// поэтому стоимость зависит только от кол-ва видимых свечей
+void Chart::drawPatterns(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds
+) const
+{
+    int64_t size = mView.size();
+    int firstIndex, lastIndex;
+    getCandlesInRange(
+        axisXBounds.x(),
+        axisXBounds.y(),
+        axisXBounds.y(),
+        pixelOffsetFromEnd(),
+        &firstIndex,
+        &lastIndex
+    );
+    if (size == 0 || firstIndex > lastIndex) {
+        return;
+    }
+    // индексы от конца среза переводим в индексы ряда, индекс моделей
+    // может отставать от ряда, пока поток интерфейса его не обновил
+    int64_t viewEnd = mView.begin() + size;
+    uint64_t begin = viewEnd - 1 - lastIndex;
+    uint64_t end = qMin<uint64_t>(viewEnd - firstIndex, mPatternIndex->scannedCount());
+    painter->setClipRect(mGraphRect, Qt::IntersectClip);
+    painter->setPen(Qt::NoPen);
+    double rightX = axisXBounds.y() + pixelOffsetFromEnd();
+    float markerStep = 2 * mPatternMarkerRadius + 1;
+    for (
+        size_t hit = mPatternIndex->lowerBound(begin);
+        hit < mPatternIndex->size() && mPatternIndex->index(hit) < end;
+        ++hit
+    ) {
+        uint64_t index = mPatternIndex->index(hit);
+        int patterns = mPatternIndex->patterns(hit);
+        // центр свечи с индексом i ряда:
+        // rightX - (viewEnd - i + 0.5) * mCandleStep
+        float x = rightX - (viewEnd - (int64_t)index + 0.5) * mCandleStep;
+        float y = axisYBounds.y() - (
+            getCurrentAxisValue(axisYBounds, mDataYBounds, mView.dataSeries()->at(index).high) -
+            axisYBounds.x()
+        ) - mPatternMarkerRadius - 2;
+        for (int bit = 0; bit < PatternCount; ++bit) {
+            if ((patterns & (1 << bit)) == 0) {
+                continue;
+            }
+            painter->setBrush(mPatternBrushes[bit]);
+            painter->drawEllipse(QPointF(x, y), mPatternMarkerRadius, mPatternMarkerRadius);
+            y -= markerStep;
+        }
+    }
+    painter->setBrush(Qt::NoBrush);
+}
+
+// сделки видимых свечей: линия от входа к выходу цветом результата сделки,
+// при крупных свечах еще и треугольник входа вершиной по направлению сделки
+void Chart::drawTrades(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds
+) const
+{
+    int64_t size = mView.size();
+    int firstIndex, lastIndex;
+    getCandlesInRange(
+        axisXBounds.x(),
+        axisXBounds.y(),
+        axisXBounds.y(),
+        pixelOffsetFromEnd(),
+        &firstIndex,
+        &lastIndex
+    );
+    if (size == 0 || firstIndex > lastIndex) {
+        return;
+    }
+    // индексы от конца среза переводим в индексы ряда
+    int64_t viewEnd = mView.begin() + size;
+    uint64_t begin = viewEnd - 1 - lastIndex;
+    uint64_t end = viewEnd - firstIndex;
+    // сделки не пересекаются, поэтому и входы, и выходы идут по возрастанию
+    std::vector<BacktestTrade>::const_iterator trade = std::lower_bound(
+        mTrades->begin(),
+        mTrades->end(),
+        begin,
+        [](const BacktestTrade &trade, uint64_t index) {
+            return trade.exitIndex < index;
+        }
+    );
+    // линии сделок, начатых или законченных за краем, обрезаем по графику
+    painter->setClipRect(mGraphRect, Qt::IntersectClip);
+    double rightX = axisXBounds.y() + pixelOffsetFromEnd();
+    bool isMarkersVisible = mCandleStep >= 2 * mTradeMarkerSize - 2;
+    for (; trade != mTrades->end() && trade->entryIndex < end; ++trade) {
+        // центр свечи с индексом i ряда:
+        // rightX - (viewEnd - i + 0.5) * mCandleStep
+        QPointF entry(
+            rightX - (viewEnd - (int64_t)trade->entryIndex + 0.5) * mCandleStep,
+            axisYBounds.y() - (
+                getCurrentAxisValue(axisYBounds, mDataYBounds, trade->entryPrice) -
+                axisYBounds.x()
+            )
+        );
+        QPointF exit(
+            rightX - (viewEnd - (int64_t)trade->exitIndex + 0.5) * mCandleStep,
+            axisYBounds.y() - (
+                getCurrentAxisValue(axisYBounds, mDataYBounds, trade->exitPrice) -
+                axisYBounds.x()
+            )
+        );
+        bool isProfit = trade->direction * (trade->exitPrice - trade->entryPrice) > 0;
+        painter->setPen(isProfit ? mTradeProfitPen : mTradeLossPen);
+        painter->drawLine(entry, exit);
+        if (!isMarkersVisible) {
+            continue;
+        }
+        // покупка - треугольник вершиной вверх под ценой входа,
+        // продажа - вершиной вниз над ней
+        float tip = trade->direction > 0 ? 1 : -1;
+        QPointF marker[3] = {
+            QPointF(entry.x(), entry.y() + tip),
+            QPointF(entry.x() - mTradeMarkerSize, entry.y() + tip * (1 + 2 * mTradeMarkerSize)),
+            QPointF(entry.x() + mTradeMarkerSize, entry.y() + tip * (1 + 2 * mTradeMarkerSize))
+        };
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(trade->direction > 0 ? mTradeLongBrush : mTradeShortBrush);
+        painter->drawPolygon(marker, 3);
+    }
+    painter->setBrush(Qt::NoBrush);
+}
+
+// линии индикаторов по видимым свечам: значения берутся из вычисленной
+// в фоне истории, остальные считаются по видимым свечам с нужной им
+// историей; наложенные индикаторы рисуются в ценах свечей, остальные -
+// в масштабе своих видимых значений, при шаге свечи меньше пикселя
+// берется одна свеча на столбец, NaN разрывает линию
+void Chart::drawIndicators(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    ChartCache *cache
+) const
+{
+    int64_t size = mView.size();
+    int firstIndex, lastIndex;
+    getCandlesInRange(
+        axisXBounds.x(),
+        axisXBounds.y(),
+        axisXBounds.y(),
+        pixelOffsetFromEnd(),
+        &firstIndex,
+        &lastIndex
+    );
+    if (size == 0 || firstIndex > lastIndex) {
+        return;
+    }
+    int64_t viewEnd = mView.begin() + size;
+    uint64_t begin = viewEnd - 1 - lastIndex;
+    uint64_t end = viewEnd - firstIndex;
+    // длинный диапазон без готовой истории не считаем, дождемся ее
+    uint64_t computed = qBound(begin, mIndicators->historySize(), end);
+    if (end - computed > mIndicatorMaxEvaluateCount) {
+        return;
+    }
+    IndicatorScratch *scratch = &cache->indicatorScratch;
+    mIndicators->evaluate(begin, end, scratch);
+    painter->setClipRect(mGraphRect, Qt::IntersectClip);
+    painter->setBrush(Qt::NoBrush);
+    double rightX = axisXBounds.y() + pixelOffsetFromEnd();
+    uint64_t stride = mCandleStep < 1 ? (uint64_t)(1 / mCandleStep) : 1;
+    std::vector<QPointF> &points = cache->indicatorPoints;
+    for (int e = 0; e < mIndicators->size(); ++e) {
+        const std::vector<float> &values = scratch->values[e];
+        QPointF bounds = mDataYBounds;
+        if (!mIndicators->isOverlay(e)) {
+            float low = std::numeric_limits<float>::max();
+            float high = std::numeric_limits<float>::lowest();
+            for (float value : values) {
+                if (std::isfinite(value)) {
+                    low = qMin(low, value);
+                    high = qMax(high, value);
+                }
+            }
+            if (low > high) {
+                continue;
+            }
+            if (low == high) {
+                low -= 1;
+                high += 1;
+            }
+            bounds = QPointF(low, high);
+        }
+        painter->setPen(mIndicatorPens[e % IndicatorPenCount]);
+        points.clear();
+        // свечи с индексами, кратными шагу, чтоб при прокрутке
+        // выбирались те же свечи
+        for (uint64_t i = end - 1 - (end - 1) % stride; i >= begin; i -= stride) {
+            float value = values[i - begin];
+            if (std::isfinite(value)) {
+                float x = rightX - (viewEnd - (int64_t)i + 0.5) * mCandleStep;
+                float y = axisYBounds.y() - (
+                    getCurrentAxisValue(axisYBounds, bounds, value) - axisYBounds.x()
+                );
+                points.push_back(QPointF(x, y));
+            } else if (!points.empty()) {
+                painter->drawPolyline(points.data(), points.size());
+                points.clear();
+            }
+            if (i < stride) {
+                break;
+            }
+        }
+        if (!points.empty()) {
+            painter->drawPolyline(points.data(), points.size());
+        }
+    }
+}
+
+// рисование огибающей свечей по столбцам пикселей [x1, x2): для каждого
+// столбца берутся открытие первой, закрытие последней, максимум и минимум
+// попавших в него свечей, поэтому стоимость зависит только от ширины
+void Chart::drawDecimatedCandles(
+    QPainter *painter,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    int x1,
+    int x2,
+    ChartCache *cache
+) const
+{
+    cache->upLines.clear();
+    cache->downLines.clear();
+    cache->upVolumeLines.clear();
+    cache->downVolumeLines.clear();
+    double rightX = axisXBounds.y() + pixelOffsetFromEnd();
+    int64_t size = mView.size();
+    int axisMaxYReal = axisYBounds.y() + mAxisYVolumeHeight;
+    for (int x = x1; x < x2; ++x) {
+        // в столбец попадают свечи с центром в [x, x + 1), центр свечи
+        // с индексом i от конца ряда: rightX - (i + 1.5) * mCandleStep
+        int64_t first = floor((rightX - x - 1) / mCandleStep - 1.5) + 1;
+        int64_t last = floor((rightX - x) / mCandleStep - 1.5);
+        if (first < 0) {
+            first = 0;
+        }
+        if (last >= size) {
+            last = size - 1;
+        }
+        if (first > last) {
+            continue;
+        }
+        // индексы от конца ряда переводим в индексы от начала
+        uint64_t begin = size - 1 - last;
+        uint64_t end = size - first;
+        CandleRange range = mView.range(begin, end);
+        float open = mView.at(begin).open;
+        float close = mView.at(end - 1).close;
+        bool isUp = close > open;
+        float xavg = x + 0.5;
+        float ymax = getCurrentAxisValue(axisYBounds, mDataYBounds, range.high);
+        float ymin = getCurrentAxisValue(axisYBounds, mDataYBounds, range.low);
+        (isUp ? cache->upLines : cache->downLines).push_back(QLineF(
+            xavg, axisYBounds.y() - (ymin - axisYBounds.x()),
+            xavg, axisYBounds.y() - (ymax - axisYBounds.x())
+        ));
+        if (optShowVolumeGraph) {
+            // столбец объема закрашивается до наибольшего объема в нем
+            float yvol = getCurrentAxisValue(
+                QPoint(0, mAxisYVolumeHeight),
+                mVolumeBounds,
+                range.maxVolume
+            );
+            (isUp ? cache->upVolumeLines : cache->downVolumeLines).push_back(
+                QLineF(xavg, axisMaxYReal, xavg, axisMaxYReal - yvol)
+            );
+        }
+    }
+    painter->setPen(mCandleUpPen);
+    painter->drawLines(cache->upLines.data(), cache->upLines.size());
+    painter->setPen(mCandleDownPen);
+    painter->drawLines(cache->downLines.data(), cache->downLines.size());
+    if (optShowVolumeGraph) {
+        painter->setPen(mVolumeUpPen);
+        painter->drawLines(
+            cache->upVolumeLines.data(),
+            cache->upVolumeLines.size()
+        );
+        painter->setPen(mVolumeDownPen);
+        painter->drawLines(
+            cache->downVolumeLines.data(),
+            cache->downVolumeLines.size()
+        );
+    }
+}
+
+// отрисовка в painter: подготовка состояния и рисование кадра целиком
+void Chart::paint(QPainter *painter, const QRect &rect)
+{
+    prepare(rect.size(), ChartAllChanges);
+    render(painter, rect, QRegion(rect), &mCache);
+}
+
+// подготовка состояния графика к отрисовке кадра размером size: раскладка,
+// диапазоны значений на осях и выбор курсора, пересчитывается только то,
+// что зависит от изменений changes (набор ChartChange), выполняется быстро,
+// поэтому может вызываться в потоке интерфейса
+void Chart::prepare(const QSize &size, int changes)
+{
+    int minX = 0;
+    int minY = 0;
+    int maxX = size.width();
+    int maxY = size.height();
+    if (size != mPaintSize) {
+        mPaintSize = size;
+        changes |= ChartLayoutChange;
+    }
+    // при изменении данных или раскладки подгоняем диапазоны под все свечи
+    if (changes & ChartDataChange) {
+        ++mDataRevision;
+    }
+    if (changes & (ChartDataChange | ChartLayoutChange)) {
+        mIsNeedRefitBounds = true;
+    }
+    int axisMinX = minX + mAxisXLeftBorderLength;
+    int axisMinY = minY + mAxisYTopBorderLength;
+    int axisMaxX = maxX - mAxisXRightBorderLength;
+    int axisMaxY = maxY - mAxisYBottomBorderLength;
+    if (optShowVolumeGraph) {
+        // если включено отображение графика объема, то
+        // сократим область графика по высоте
+        axisMaxY -= mAxisYVolumeHeight;
+    }
+
+    // пересчитаем кол-во видимых свечей
+    // (при изменении окна просмотра, раскладки или данных)
+    bool isViewChanged = (changes & (
+        ChartDataChange | ChartAppendChange | ChartViewportChange | ChartLayoutChange
+    )) != 0;
+    if (isViewChanged && mView.size() > 0) {
+        // при уменьшении окна шаг свечи может оказаться меньше допустимого
+        mGraphRect = QRect(QPoint(axisMinX, axisMinY), QPoint(axisMaxX - 1, axisMaxY));
+        mCandleStep = qBound(candleMinStep(), mCandleStep, candleMaxStep());
+        // место крайней правой свечи не занимаем
+        mViewedCandleCount = (axisMaxX - axisMinX - mCandleStep) / mCandleStep;
+        if (mViewedCandleCount > (int)mView.size()) {
+            mViewedCandleCount = mView.size();
+        }
+        // окно просмотра не должно выходить за начало истории
+        if (mCandleOffsetFromEnd > (int)mView.size() - mViewedCandleCount) {
+            mCandleOffsetFromEnd = mView.size() - mViewedCandleCount;
+        }
+    }
+
+    // пересчитаем диапазоны значений на осях
+    int pixelOffset = pixelOffsetFromEnd();
+    if (isViewChanged && mView.size() > 0) {
+        // дописанные свечи входят в график справа, диапазоны подгоняются
+        // заново, только если новые свечи в них не помещаются, иначе кэш
+        // графика сдвигается, а не перерисовывается целиком
+        if (!mIsNeedRefitBounds && mView.size() > mBoundsDataSize) {
+            uint64_t appended = mView.size() - mBoundsDataSize;
+            int firstIndex = mCandleOffsetFromEnd;
+            int lastIndex = qMin<uint64_t>(
+                firstIndex + qMin<uint64_t>(appended, mViewedCandleCount),
+                mView.size() - 1
+            );
+            CandleRange range = mView.range(
+                mView.size() - 1 - lastIndex,
+                mView.size() - firstIndex
+            );
+            mIsNeedRefitBounds = range.low < mDataYBounds.x() ||
+                range.high > mDataYBounds.y() ||
+                (optShowVolumeGraph && range.maxVolume > mVolumeBounds.y());
+        }
+        if (mIsNeedRefitBounds) {
+            // подгоняем диапазоны под все видимые свечи
+            mIsNeedRefitBounds = false;
+            int firstIndex = mCandleOffsetFromEnd;
+            updateDataBounds(
+                firstIndex,
+                qMin(firstIndex + mViewedCandleCount, (int)mView.size() - 1),
+                false
+            );
+        } else if (pixelOffset != mBoundsPixelOffset) {
+            // во время прокрутки диапазоны только расширяются
+            // по открывшимся свечам, чтоб не перерисовывать весь график
+            int x1, x2;
+            if (pixelOffset > mBoundsPixelOffset) {
+                x1 = axisMinX;
+                x2 = axisMinX + pixelOffset - mBoundsPixelOffset;
+            } else {
+                x1 = axisMaxX - (mBoundsPixelOffset - pixelOffset);
+                x2 = axisMaxX;
+            }
+            int firstIndex, lastIndex;
+            getCandlesInRange(
+                qMax(x1, axisMinX),
+                qMin(x2, axisMaxX),
+                axisMaxX,
+                pixelOffset,
+                &firstIndex,
+                &lastIndex
+            );
+            updateDataBounds(firstIndex, lastIndex, true);
+        }
+        mBoundsPixelOffset = pixelOffset;
+        mBoundsDataSize = mView.size();
+        float offsetX = pixelOffset / mCandleStep;
+        mDataXBounds = QPointF(-mViewedCandleCount - offsetX, -offsetX);
+    }
+
+    // если отображается область скролла и кол-во видимых свечей меньше общего
+    // кол-ва свечей, то сократим область графика по высоте
+    if (
+        optShowScrollArea &&
+        (mViewedCandleCount < (int)mView.size() || (mOverview && !mOverview->empty()))
+    ) {
+        // если отображается область скролла,
+        // то сократим область графика по высоте
+        axisMaxY -= mAxisYScrollBarHeight;
+        mScrollAreaRect = QRect(
+            QPoint(axisMinX, maxY - mAxisYScrollBarHeight),
+            QPoint(axisMaxX - 1, maxY - 1)
+        );
+    } else {
+        mScrollAreaRect = QRect();
+    }
+
+    // ось Х рисуем под графиком объема, если он задан
+    int offset = optShowVolumeGraph ? mAxisYVolumeHeight : 0;
+    mAxisXBounds = QPoint(axisMinX, axisMaxX);
+    mAxisYBounds = QPoint(axisMinY, axisMaxY);
+    mGraphRect = QRect(
+        QPoint(axisMinX, axisMinY),
+        QPoint(axisMaxX - 1, axisMaxY + offset - 1)
+    );
+
+    // над графиком и графиком объема курсор в виде перекрестия
+    if (optShowLabelsWithMouse) {
+        int mx = mMousePos.x();
+        int my = mMousePos.y();
+        if (
+            mIsMouseEnter &&
+            mx >= axisMinX &&
+            mx < axisMaxX &&
+            my >= axisMinY &&
+            my < axisMaxY + offset
+        ) {
+            mCursorShape = Qt::CrossCursor;
+        } else {
+            mCursorShape = Qt::ArrowCursor;
+        }
+    }
+}
+
+// рисование подготовленного кадра, состояние графика не меняется,
+// меняется только кэш, поэтому копию графика можно рисовать в другом потоке,
+// перерисовывается только область region, остальное в painter не трогается
+void Chart::render(
+    QPainter *painter,
+    const QRect &rect,
+    const QRegion &region,
+    ChartCache *cache
+) const
+{
+    painter->setClipRegion(region);
+    // сотрем все предыдущее залив область фоном
+    painter->fillRect(rect, mBackgroundBrush);
+
+    int maxY = rect.height();
+    int axisMinX = mAxisXBounds.x();
+    int axisMaxX = mAxisXBounds.y();
+    int axisMinY = mAxisYBounds.x();
+    int axisMaxY = mAxisYBounds.y();
+    // ось Х рисуем под графиком объема, если он задан
+    int offset = optShowVolumeGraph ? mAxisYVolumeHeight : 0;
+
+    // нарисуем график из кэша, дорисовав в нем только изменившиеся свечи
+    if (
+        axisMaxX > axisMinX &&
+        axisMaxY + offset > axisMinY &&
+        region.intersects(mGraphRect)
+    ) {
+        updateGraphCache(mGraphRect, QPoint(axisMinY, axisMaxY), cache);
+        painter->drawImage(mGraphRect.topLeft(), cache->image);
+        if (optShowVolumeProfile) {
+            drawVolumeProfile(
+                painter,
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                cache
+            );
+        }
+        if (isTimeAxis() && mSessionIndex->size() > 1) {
+            drawSessionSeparators(
+                painter,
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY + offset)
+            );
+            painter->setClipRegion(region);
+        }
+        if (
+            isPatternsDrawn() &&
+            mPatternIndex != nullptr &&
+            mPatternIndex->size() > 0
+        ) {
+            drawPatterns(
+                painter,
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY)
+            );
+            painter->setClipRegion(region);
+        }
+        if (mTrades && !mTrades->empty()) {
+            drawTrades(
+                painter,
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY)
+            );
+            painter->setClipRegion(region);
+        }
+        if (mIndicators != nullptr && mIndicators->size() > 0) {
+            drawIndicators(
+                painter,
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                cache
+            );
+            painter->setClipRegion(region);
+        }
+    }
+
+    // нарисуем оси
+    painter->setPen(mAxisPen);
+    painter->drawLine(
+        QPoint(axisMinX, axisMaxY + offset),
+        QPoint(axisMaxX, axisMaxY + offset)
+    );
+    painter->drawLine(
+        QPoint(axisMaxX, axisMinY),
+        QPoint(axisMaxX, axisMaxY + offset)
+    );
+
+    // нарисуем риски и данные на осях координат
+    // (не забываем про смещение оси вниз, если рисуется объем)
+    char label[LabelSize];
+    if (isTimeAxis()) {
+        drawTimeAxis(
+            painter,
+            QPoint(axisMinX, axisMaxX),
+            QPoint(axisMinY, axisMaxY + offset),
+            region,
+            cache
+        );
+    } else {
+        float deltaX = 1.0 * (axisMaxX - axisMinX) / mAxisXDashCount;
+        float dataDeltaX = (mDataXBounds.y() - mDataXBounds.x()) / mAxisXDashCount;
+        for (int i = 1; i < mAxisXDashCount; ++i) {
+            float x = axisMinX + i*deltaX;
+            painter->drawLine(QPointF(x, axisMaxY + offset), QPointF(x, axisMaxY + offset + mAxisXDashLen));
+            QRect labelRect = QRect(
+                QPoint(
+                    x - mAxisLabelHalfWidth,
+                    axisMaxY + offset + mAxisXDashLen + mAxisXDashSpace
+                ),
+                QPoint(
+                    x + mAxisLabelHalfWidth,
+                    axisMaxY + offset + mAxisXDashLen + 2*mAxisLabelHalfHeight + mAxisXDashSpace
+                )
+            );
+            // подписи вне перерисовываемой области не формируем
+            if (region.intersects(labelRect)) {
+                makeAxisLabel(mDataXBounds.x() + i*dataDeltaX, label);
+                drawLabel(painter, labelRect, Qt::AlignCenter, label, cache);
+            }
+        }
+    }
+    float deltaY = 1.0 * (axisMaxY - axisMinY) / mAxisYDashCount;
+    float dataDeltaY = (mDataYBounds.y() - mDataYBounds.x()) / mAxisYDashCount;
+    for (int i = 1; i < mAxisYDashCount; ++i) {
+        float y = axisMaxY - (axisMinY + i*deltaY);
+        painter->drawLine(QPointF(axisMaxX, y), QPointF(axisMaxX + mAxisYDashLen, y));
+        QRect labelRect = QRect(
+            QPoint(
+                axisMaxX + mAxisYDashLen + mAxisYDashSpace,
+                y - mAxisLabelHalfHeight
+            ),
+            QPoint(
+                axisMaxX + mAxisYDashLen + 2*mAxisLabelHalfWidth + mAxisYDashSpace,
+                y + mAxisLabelHalfHeight
+            )
+        );
+        if (region.intersects(labelRect)) {
+            makeAxisLabel(mDataYBounds.x() + i*dataDeltaY, label);
+            drawLabel(painter, labelRect, Qt::AlignLeft, label, cache);
+        }
+    }
+    // риски графика объема
+    if (optShowVolumeGraph) {
+        float deltaY = 1.0 * mAxisYVolumeHeight / mAxisYVolumeDashCount;
+        float dataDeltaY = (mVolumeBounds.y() - mVolumeBounds.x()) / mAxisYVolumeDashCount;
+        for (int i = 1; i < mAxisYVolumeDashCount; ++i) {
+            float y = axisMaxY + mAxisYVolumeHeight - i*deltaY;
+            painter->drawLine(QPointF(axisMaxX, y), QPointF(axisMaxX + mAxisYDashLen, y));
+            QRect labelRect = QRect(
+                QPoint(
+                    axisMaxX + mAxisYDashLen + mAxisYDashSpace,
+                    y - mAxisLabelHalfHeight
+                ),
+                QPoint(
+                    axisMaxX + mAxisYDashLen + 2*mAxisLabelHalfWidth + mAxisYDashSpace,
+                    y + mAxisLabelHalfHeight
+                )
+            );
+            if (region.intersects(labelRect)) {
+                makeAxisLabel(mVolumeBounds.x() + i*dataDeltaY, label);
+                drawLabel(painter, labelRect, Qt::AlignLeft, label, cache);
+            }
+        }
+    }
+
+    // нарисуем выделение области на графике
+    if (optSelectAreaWithMouse) {
+        int mx1 = mMouseGraphPressPos.x();
+        int my1 = mMouseGraphPressPos.y();
+        if (mx1 != -1 && my1 != -1) {
+            // оси и риски
+            drawAxisLines(
+                painter,
+                mMouseSelectAreaPen,
+                mMouseSelectAreaLabelsPen,
+                QPoint(mx1, my1),
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                offset,
+                true
+            );
+            // метки на осях координат
+            drawAxisLabels(
+                painter,
+                QPoint(mx1, my1),
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                mDataYBounds,
+                offset,
+                cache
+            );
+        }
+        QPoint pos2 = getSelectionEndPos();
+        int mx2 = pos2.x();
+        int my2 = pos2.y();
+        if (mx2 != -1 && my2 != -1) {
+            // оси и риски
+            drawAxisLines(
+                painter,
+                mMouseSelectAreaPen,
+                mMouseSelectAreaLabelsPen,
+                QPoint(mx2, my2),
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                offset,
+                true
+            );
+            // метки на осях координат
+            drawAxisLabels(
+                painter,
+                QPoint(mx2, my2),
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                mDataYBounds,
+                offset,
+                cache
+            );
+            // найти пройденное расстояние, для отображения на графике
+            float xVal1 = getCurrentDataValue(
+                QPoint(axisMinX, axisMaxX),
+                mDataXBounds,
+                mx1
+            );
+            float yVal1 = getCurrentDataValue(
+                QPoint(axisMinY, axisMaxY),
+                mDataYBounds,
+                my1
+            );
+            float xVal2 = getCurrentDataValue(
+                QPoint(axisMinX, axisMaxX),
+                mDataXBounds,
+                mx2
+            );
+            float yVal2 = getCurrentDataValue(
+                QPoint(axisMinY, axisMaxY),
+                mDataYBounds,
+                my2
+            );
+            // зальем область между метками
+            painter->fillRect(
+                QRect(QPoint(mx1, my1), QPoint(mx2, my2)),
+                mMouseSelectAreaBrush
+            );
+            // рисуем значения в точке отпускания кнопки мыши
+            char selectionLabel[2*LabelSize];
+            int length = makeAxisLabel(qAbs(xVal2 - xVal1), selectionLabel);
+            selectionLabel[length] = ';';
+            makeAxisLabel(qAbs(yVal2 - yVal1), selectionLabel + length + 1);
+            if (optShowSelectionStats) {
+                drawSelectionStats(
+                    painter,
+                    getRectForSelectionLabel(pos2),
+                    selectionLabel,
+                    mx1,
+                    mx2,
+                    cache
+                );
+            } else {
+                drawLabel(
+                    painter,
+                    getRectForSelectionLabel(pos2),
+                    Qt::AlignCenter,
+                    selectionLabel,
+                    cache
+                );
+            }
+        }
+    }
+
+    // нарисуем оси курсора мыши с метками текущих значений
+    if (optShowLabelsWithMouse) {
+        int mx = mMousePos.x();
+        int my = mMousePos.y();
+        if (mx >= axisMinX &&
+            mx < axisMaxX &&
+            my >= axisMinY &&
+            my < axisMaxY &&
+            mIsMouseEnter
+        ) {
+            // если включено выделение области мышкой, и нажата кнопка мыши
+            // не будем рисовать оси и риски, потому что они затрутся
+            if (optSelectAreaWithMouse && mIsLmbMousePressed) {
+                painter->setPen(mMouseSelectAreaLabelsPen);
+            } else {
+                // оси и риски
+                drawAxisLines(
+                    painter,
+                    mMouseAxisPen,
+                    mMouseLabelPen,
+                    QPoint(mx, my),
+                    QPoint(axisMinX, axisMaxX),
+                    QPoint(axisMinY, axisMaxY),
+                    offset
+                );
+                // метки на осях координат
+                drawAxisLabels(
+                    painter,
+                    QPoint(mx, my),
+                    QPoint(axisMinX, axisMaxX),
+                    QPoint(axisMinY, axisMaxY),
+                    mDataYBounds,
+                    offset,
+                    cache
+                );
+            }
+        } else if (optShowVolumeGraph &&
+            mx >= axisMinX &&
+            mx < axisMaxX &&
+            my >= axisMaxY &&
+            my < axisMaxY + mAxisYVolumeHeight &&
+            mIsMouseEnter
+        ) {
+            // если отображаем график объема и находимся в его области
+            // оси и риски
+            drawAxisLines(
+                painter,
+                mMouseAxisVolumePen,
+                mMouseVolumeLabelPen,
+                QPoint(mx, my),
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMinY, axisMaxY),
+                offset
+            );
+            // метки на осях координат
+            drawAxisLabels(
+                painter,
+                QPoint(mx, my),
+                QPoint(axisMinX, axisMaxX),
+                QPoint(axisMaxY, axisMaxY + mAxisYVolumeHeight),
+                mVolumeBounds,
+                0,
+                cache
+            );
+        }
+    }
+
+    // нарисуем скроллбар, если нужно и он попал в перерисовываемую область
+    if (optShowScrollArea && region.intersects(mScrollAreaRect)) {
+        QPoint xScale = QPoint (axisMinX, axisMaxX);
+        QPoint yScale = QPoint(maxY - mAxisYScrollBarHeight, maxY);
+        if (mOverview && !mOverview->empty()) {
+            drawOverview(painter, xScale, yScale);
+        } else if (mViewedCandleCount < (int)mView.size()) {
+            float scaledCandleWidth = 1.0 * (xScale.y() - xScale.x()) /
+                mView.size();
+            int mergedCounter = 1;
+            if (scaledCandleWidth < 1) {
+                mergedCounter = ceil(1 / scaledCandleWidth);
+                scaledCandleWidth *= mergedCounter;
+            }
+            // рисуем с конца графика
+            float startX = xScale.y();
+            uint64_t size = mView.size();
+            int windowsCount = ceil(1.0 * size / mergedCounter);
+            QPointF dataBounds = QPointF(
+                mView.globalLow(),
+                mView.globalHigh()
+            );
+            for (int i = 0; i < windowsCount; ++i) {
+                // упрощенная свеча окна из индекса диапазонов, количество свечей
+                // в окнах округлено, поэтому последнее окно может быть неполным
+                uint64_t end = size - (uint64_t)i * mergedCounter;
+                uint64_t begin = end > (uint64_t)mergedCounter ?
+                    end - mergedCounter : 0;
+                CandleRange range = mView.range(begin, end);
+                float high = range.high;
+                float low = range.low;
+                float open = mView.at(begin).open;
+                float close = mView.at(end - 1).close;
+                // определим цвет свечи по разнице открытия и закрытия
+                bool isUp = close > open;
+                // скроллбар расположен в самом низу виджета, поэтому область для
+                // рисования определяем от самого низа
+                float ymax = getCurrentAxisValue(yScale, dataBounds, high);
+                float ymin = getCurrentAxisValue(yScale, dataBounds, low);
+                QRectF candleRect = QRectF(
+                    QPointF(
+                        startX,
+                        yScale.y() - (ymax - yScale.x())
+                    ),
+                    QPointF(
+                        startX - scaledCandleWidth,
+                        yScale.y() - (ymin - yScale.x())
+                    )
+                );
+                // цветоное тело свечи
+                painter->fillRect(
+                    candleRect,
+                    isUp ? mCandleUpBrush : mCandleDownBrush
+                );
+                // контур свечи
+                painter->setPen(isUp ? mCandleUpPen : mCandleDownPen);
+                painter->drawRect(candleRect);
+                // скорректируем текущую координату для рисования
+                startX -= scaledCandleWidth;
+            }
+            // нарисуем текущее отображаемое окно на скроллбаре
+            float areaWidth = 1.0 * mViewedCandleCount / mView.size() *
+                (xScale.y() - xScale.x());
+            float areaStart = mCandleOffsetFromEnd / mView.size() *
+                (xScale.y() - xScale.x());
+            // рисуем с правого края, поэтому координаты по Х инвертим
+            painter->setPen(mScrollBarPen);
+            painter->drawRect(
+                QRectF(
+                    QPointF(xScale.y() - areaStart, yScale.y() - 1),
+                    QPointF(xScale.y() - areaStart - areaWidth, yScale.x())
+                )
+            );
+        }
+    }
+
+}
+
+// скроллбар по выборке строк файла: по свече на строку выборки, окно
+// просмотра отмечается относительно оценки кол-ва свечей во всем файле
+void Chart::drawOverview(
+    QPainter *painter,
+    const QPoint &xScale,
+    const QPoint &yScale
+) const
+{
+    const std::vector<Candle> &candles = *mOverview;
+    float width = xScale.y() - xScale.x();
+    float candleWidth = width / candles.size();
+    for (size_t i = 0; i < candles.size(); ++i) {
+        const Candle &candle = candles[i];
+        bool isUp = candle.close > candle.open;
+        float ymax = getCurrentAxisValue(yScale, mOverviewBounds, candle.high);
+        float ymin = getCurrentAxisValue(yScale, mOverviewBounds, candle.low);
+        QRectF candleRect = QRectF(
+            QPointF(xScale.x() + i * candleWidth, yScale.y() - (ymax - yScale.x())),
+            QPointF(xScale.x() + (i + 1) * candleWidth, yScale.y() - (ymin - yScale.x()))
+        );
+        painter->fillRect(candleRect, isUp ? mCandleUpBrush : mCandleDownBrush);
+        painter->setPen(isUp ? mCandleUpPen : mCandleDownPen);
+        painter->drawRect(candleRect);
+    }
+    double size = qMax<double>(mOverviewSize, mView.size());
+    float areaWidth = mViewedCandleCount / size * width;
+    float areaStart = mCandleOffsetFromEnd / size * width;
+    painter->setPen(mScrollBarPen);
+    painter->drawRect(
+        QRectF(
+            QPointF(xScale.y() - areaStart, yScale.y() - 1),
+            QPointF(xScale.y() - areaStart - areaWidth, yScale.x())
+        )
+    );
+}
+
+// подпись значения на оси в label (места не меньше LabelSize): число с шестью
+// знаками после точки, как у QString::number(value, 'f'), длинные подписи
+// укорачиваются, короткие дополняются пробелами, возвращается длина подписи,
+// формируется без выделения памяти и без учета локали
+int Chart::makeAxisLabel(const float value, char *label) const
+{
+    int length = 0;
+    if (value != value) {
+        memcpy(label, "nan", 3);
+        length = 3;
+    } else if (qAbs(value) > std::numeric_limits<float>::max()) {
+        memcpy(label, value < 0 ? "-inf" : "inf", value < 0 ? 4 : 3);
+        length = value < 0 ? 4 : 3;
+    } else {
+        if (std::signbit(value)) {
+            label[length++] = '-';
+        }
+        double absValue = qAbs((double)value);
+        if (absValue < 1e13) {
+            // цифры в обратном порядке, младшие шесть - дробная часть
+            char digits[LabelSize];
+            int count = 0;
+            uint64_t scaled = absValue * 1e6 + 0.5;
+            while (count < 7 || scaled != 0) {
+                digits[count++] = '0' + scaled % 10;
+                scaled /= 10;
+            }
+            for (int i = count - 1; i >= 0; --i) {
+                label[length++] = digits[i];
+                if (i == 6) {
+                    label[length++] = '.';
+                }
+            }
+        } else {
+            // у таких больших float дробной части нет, а целое число
+            // форматируется без точки, поэтому от локали не зависит
+            length += snprintf(label + length, LabelSize - 8, "%.0f", absValue);
+            memcpy(label + length, ".000000", 7);
+            length += 7;
+        }
+    }
+    if (length > mMaxAxisLabelLength) {
+        const char *dot = (const char *)memchr(label, '.', length);
+        if (dot != nullptr) {
+            int dotPos = dot - label;
+            while (length > mMaxAxisLabelLength && dotPos < length - 2) {
+                --length;
+            }
+            while (label[length - 1] == '0' && dotPos < length - 2) {
+                --length;
+            }
+        }
+    } else {
+        while (length <= mMaxAxisLabelLength) {
+            label[length++] = ' ';
+        }
+    }
+    label[length] = 0;
+    return length;
+}
+
+// две цифры числа в label
+static inline int appendTwoDigits(char *label, int length, uint64_t value)
+{
+    label[length++] = '0' + value / 10 % 10;
+    label[length++] = '0' + value % 10;
+    return length;
+}
+
+// подпись времени на оси X в label (места не меньше LabelSize) по дате
+// YYYYMMDD (или YYMMDD) и времени HHMMSS, формируется без выделения
+// памяти, возвращается длина подписи
+int Chart::makeTimeLabel(
+    uint64_t date,
+    uint64_t time,
+    TimeLabelFormat format,
+    char *label
+) const
+{
+    uint64_t year = date / 10000;
+    if (year < 100) {
+        year += 2000;
+    }
+    uint64_t month = date / 100 % 100;
+    uint64_t day = date % 100;
+    int length = 0;
+    if (format == TimeLabelDay || format == TimeLabelFull || format == TimeLabelDate) {
+        length = appendTwoDigits(label, length, day);
+        label[length++] = '.';
+        length = appendTwoDigits(label, length, month);
+    }
+    if (format == TimeLabelMonth) {
+        length = appendTwoDigits(label, length, month);
+    }
+    if (format == TimeLabelFull) {
+        label[length++] = '.';
+        length = appendTwoDigits(label, length, year);
+        label[length++] = ' ';
+    }
+    if (format == TimeLabelMonth || format == TimeLabelDate) {
+        label[length++] = '.';
+    }
+    if (format == TimeLabelMonth || format == TimeLabelYear || format == TimeLabelDate) {
+        length = appendTwoDigits(label, length, year / 100);
+        length = appendTwoDigits(label, length, year);
+    }
+    if (format == TimeLabelMinute || format == TimeLabelFull) {
+        length = appendTwoDigits(label, length, time / 10000);
+        label[length++] = ':';
+        length = appendTwoDigits(label, length, time / 100);
+    }
+    label[length] = 0;
+    return length;
+}
+
+// символы подписей для шрифта и цвета пера painter, рисуются один раз
+// на каждый цвет, дальше берутся из кэша
+const ChartLabelGlyphs &Chart::getLabelGlyphs(
+    QPainter *painter,
+    ChartCache *cache
+) const
+{
+    const QFont &font = painter->font();
+    QRgb color = painter->pen().color().rgba();
+    for (size_t i = 0; i < cache->labelGlyphs.size(); ++i) {
+        const ChartLabelGlyphs &glyphs = cache->labelGlyphs[i];
+        if (glyphs.color == color && glyphs.font == font) {
+            return glyphs;
+        }
+    }
+    QPaintDevice *device = painter->device();
+    QFontMetricsF metrics(font, device);
+    cache->labelGlyphs.push_back(ChartLabelGlyphs());
+    ChartLabelGlyphs &glyphs = cache->labelGlyphs.back();
+    glyphs.font = font;
+    glyphs.color = color;
+    glyphs.ascent = metrics.ascent();
+    glyphs.height = metrics.height();
+    for (int i = 0; i < 128; ++i) {
+        glyphs.glyphX[i] = -1;
+        glyphs.glyphWidth[i] = 0;
+        glyphs.advance[i] = 0;
+    }
+    // в подписях печатные символы ASCII
+    int width = 0;
+    for (int c = ' '; c <= '~'; ++c) {
+        glyphs.advance[c] = metrics.horizontalAdvance(QChar(c));
+        if (c != ' ') {
+            // символ может выступать за свою ширину, поэтому берем с запасом
+            glyphs.glyphX[c] = width;
+            glyphs.glyphWidth[c] = ceil(glyphs.advance[c]) + 2*LabelGlyphMargin;
+            width += glyphs.glyphWidth[c];
+        }
+    }
+    glyphs.image = QImage(
+        width,
+        ceil(glyphs.height),
+        QImage::Format_ARGB32_Premultiplied
+    );
+    // разрешение как у устройства, чтобы размер шрифта совпал
+    glyphs.image.setDotsPerMeterX(qRound(device->logicalDpiX() / 0.0254));
+    glyphs.image.setDotsPerMeterY(qRound(device->logicalDpiY() / 0.0254));
+    glyphs.image.fill(Qt::transparent);
+    QPainter glyphPainter(&glyphs.image);
+    glyphPainter.setFont(font);
+    glyphPainter.setPen(painter->pen().color());
+    for (int c = ' ' + 1; c <= '~'; ++c) {
+        glyphPainter.drawText(
+            QPointF(glyphs.glyphX[c] + LabelGlyphMargin, glyphs.ascent),
+            QString(QChar(c))
+        );
+    }
+    glyphPainter.end();
+    return glyphs;
+}
+
+// рисование подписи text в rect, выровненной как у drawText (по центру
+// или по левому верхнему краю), из заранее нарисованных символов, поэтому
+// раскладка текста не нужна, подпись обрезается по rect
+void Chart::drawLabel(
+    QPainter *painter,
+    const QRect &rect,
+    int flags,
+    const char *text,
+    ChartCache *cache
+) const
+{
+    const ChartLabelGlyphs &glyphs = getLabelGlyphs(painter, cache);
+    float width = 0;
+    for (const char *c = text; *c != 0; ++c) {
+        if ((unsigned char)*c < 128) {
+            width += glyphs.advance[(int)*c];
+        }
+    }
+    float x = rect.left();
+    float y = rect.top();
+    if (flags & Qt::AlignHCenter) {
+        x += (rect.width() - width) / 2;
+    }
+    if (flags & Qt::AlignVCenter) {
+        y += (rect.height() - glyphs.height) / 2;
+    }
+    for (const char *c = text; *c != 0; ++c) {
+        int code = (unsigned char)*c;
+        if (code >= 128) {
+            continue;
+        }
+        if (glyphs.glyphX[code] >= 0) {
+            QRect target = QRect(
+                qRound(x) - LabelGlyphMargin,
+                qRound(y),
+                glyphs.glyphWidth[code],
+                glyphs.image.height()
+            );
+            QRect visible = target.intersected(rect);
+            if (!visible.isEmpty()) {
+                painter->drawImage(
+                    visible.topLeft(),
+                    glyphs.image,
+                    QRect(
+                        glyphs.glyphX[code] + visible.left() - target.left(),
+                        visible.top() - target.top(),
+                        visible.width(),
+                        visible.height()
+                    )
+                );
+            }
+        }
+        x += glyphs.advance[code];
+    }
+}
+
+float Chart::getCurrentDataValue(
+    const QPoint &axisBounds,
+    const QPointF &dataBounds,
+    const int currentAxisValue
+) const
+{
+    if (currentAxisValue != axisBounds.x()) {
+        return (dataBounds.y() - dataBounds.x()) *
+            (currentAxisValue - axisBounds.x()) /
+            (axisBounds.y() - axisBounds.x()) +
+            dataBounds.x();
+    } else {
+        return dataBounds.x();
+    }
+}
+
+float Chart::getCurrentAxisValue(
+    const QPoint &axisBounds,
+    const QPointF &dataBounds,
+    const float currentDataValue
+) const
+{
+    return 1.0 * (currentDataValue - dataBounds.x()) /
+        (dataBounds.y() - dataBounds.x()) *
+        (axisBounds.y() - axisBounds.x()) +
+        axisBounds.x();
+}
+
+QRect Chart::getRectForAxisLabel(
+    int val,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    bool isAxisLabelX
+) const
+{
+    QPoint lefttop, rightbottom;
+    if (isAxisLabelX) {
+        int halfWidth = isTimeAxis() ? mAxisTimeLabelHalfWidth : mAxisLabelHalfWidth;
+        lefttop = QPoint(
+            val - halfWidth,
+            axisYBounds.y() + mAxisXDashLen + mAxisXDashSpace
+        );
+        rightbottom = QPoint(
+            val + halfWidth,
+            axisYBounds.y() + mAxisXDashLen + 2*mAxisLabelHalfHeight + mAxisXDashSpace
+        );
+        // область вывода не выводим за границы графика
+        if (lefttop.x() <= axisXBounds.x() + 1) {
+            lefttop.setX(axisXBounds.x() + 1);
+            rightbottom.setX(lefttop.x() + 2*halfWidth);
+        }
+        if (rightbottom.x() >= axisXBounds.y() - 1) {
+            rightbottom.setX(axisXBounds.y() - 1);
+            lefttop.setX(rightbottom.x() - 2*halfWidth);
+        }
+    } else {
+        lefttop = QPoint(
+            axisXBounds.y() + mAxisYDashLen + mAxisYDashSpace,
+            val - mAxisLabelHalfHeight
+        );
+        rightbottom = QPoint(
+            axisXBounds.y() + mAxisYDashLen + 2*mAxisLabelHalfWidth + mAxisYDashSpace,
+            val + mAxisLabelHalfHeight
+        );
+        // область вывода не выводим за границы графика
+        if (lefttop.y() <= axisYBounds.x() + 1) {
+            lefttop.setY(axisYBounds.x() + 1);
+            rightbottom.setY(lefttop.y() + 2*mAxisLabelHalfHeight);
+        }
+        if (rightbottom.y() >= axisYBounds.y() - 1) {
+            rightbottom.setY(axisYBounds.y() - 1);
+            lefttop.setY(rightbottom.y() - 2*mAxisLabelHalfHeight);
+        }
+    }
+    return QRect(lefttop, rightbottom);
+}
+
+QRect Chart::getOuterRectForAxisLabel(
+    const QRect &labelRect
+) const
+{
+    return QRect(
+        QPoint(
+            labelRect.topLeft().x() - mAxisLabelXAdditionalLength,
+            labelRect.topLeft().y() - mAxisLabelYAdditionalLength
+        ),
+        QPoint(
+            labelRect.bottomRight().x() + mAxisLabelXAdditionalLength,
+            labelRect.bottomRight().y() + mAxisLabelYAdditionalLength
+        )
+    );
+}
+
+// конечная точка выделения: положение мыши, пока лкм нажата,
+// иначе точка отпускания, (-1, -1) если выделения нет
+QPoint Chart::getSelectionEndPos() const
+{
+    int mx2 = mIsLmbMousePressed && mIsMousePressInGraph ?
+        mMousePos.x() : mMouseGraphReleasePos.x();
+    int my2 = mIsLmbMousePressed && mIsMousePressInGraph ?
+        mMousePos.y() : mMouseGraphReleasePos.y();
+    if (mx2 == -1 || my2 == -1) {
+        return QPoint(-1, -1);
+    }
+    // оси выделенной области не должны выходить за основные оси
+    // поэтому скорректируем их значение, если нужно
+    return QPoint(
+        qBound(mAxisXBounds.x(), mx2, mAxisXBounds.y() - 1),
+        qBound(mAxisYBounds.x(), my2, mAxisYBounds.y() - 1)
+    );
+}
+
+// область вывода надписи выделения (или рамки статистики выделения)
+// правее и ниже пересечения осей
+QRect Chart::getRectForSelectionLabel(const QPoint &pos) const
+{
+    int axisMaxX = mAxisXBounds.y();
+    int axisMaxY = mAxisYBounds.y();
+    int width = 4*mAxisLabelHalfWidth;
+    int height = 2*mAxisLabelHalfHeight;
+    if (optShowSelectionStats) {
+        width = mSelectionStatsWidth;
+        height = SelectionStatsLineCount*mSelectionStatsLineHeight;
+    }
+    QPoint lefttop = QPoint(
+        pos.x() + 1,
+        pos.y()
+    );
+    QPoint rightbottom = QPoint(
+        pos.x() + width + 1,
+        pos.y() + height
+    );
+    // надпись не выходит за область графика (lefttop не проверяем на
+    // границы, поскольку изначально пробуем отображать метку правее и ниже)
+    if (rightbottom.x() >= axisMaxX - 1) {
+        rightbottom.setX(axisMaxX - 1);
+        lefttop.setX(rightbottom.x() - width);
+    }
+    if (rightbottom.y() >= axisMaxY - 1) {
+        rightbottom.setY(axisMaxY - 1);
+        lefttop.setY(rightbottom.y() - height);
+    }
+    return QRect(lefttop, rightbottom);
+}
+
+// свечи под отрезком [x1, x2] графика, индексы [begin, end) от начала ряда
+void Chart::getSelectedCandles(
+    int x1,
+    int x2,
+    uint64_t *begin,
+    uint64_t *end
+) const
+{
+    // свеча с индексом i от конца ряда занимает место левее
+    // xmax = axisMaxX - (i + 1) * mCandleStep + pixelOffset
+    double rightX = mAxisXBounds.y() + pixelOffsetFromEnd();
+    int64_t size = mView.size();
+    int64_t first = floor((rightX - x2) / mCandleStep) - 1;
+    int64_t last = floor((rightX - x1) / mCandleStep) - 1;
+    first = qMax<int64_t>(first, 0);
+    last = qMin<int64_t>(last, size - 1);
+    if (first > last) {
+        *begin = *end = 0;
+        return;
+    }
+    // индексы от конца ряда переводим в индексы от начала
+    *begin = size - 1 - last;
+    *end = size - first;
+}
+
+// строка статистики выделения "name value" в line (места не меньше
+// LabelSize + 16): значение как на осях или целым числом
+int Chart::makeStatsLine(
+    char *line,
+    const char *name,
+    double value,
+    bool isInteger,
+    const char *suffix
+) const
+{
+    int length = strlen(name);
+    memcpy(line, name, length);
+    line[length++] = ' ';
+    if (isInteger) {
+        char digits[24];
+        int count = 0;
+        uint64_t integer = value > 0 ? value + 0.5 : 0;
+        do {
+            digits[count++] = '0' + integer % 10;
+            integer /= 10;
+        } while (integer != 0);
+        while (count > 0) {
+            line[length++] = digits[--count];
+        }
+    } else {
+        length += makeAxisLabel(value, line + length);
+        while (line[length - 1] == ' ') {
+            --length;
+        }
+    }
+    int suffixLength = strlen(suffix);
+    memcpy(line + length, suffix, suffixLength);
+    length += suffixLength;
+    line[length] = 0;
+    return length;
+}
+
+// рамка со статистикой свечей под выделением [x1, x2]: первой строкой
+// расстояние между метками, дальше статистика диапазона свечей, которая
+// считается за O(1) по префиксным суммам, поэтому не зависит от ширины
+// выделения и успевает за обновлением данных
+void Chart::drawSelectionStats(
+    QPainter *painter,
+    const QRect &rect,
+    const char *distanceLabel,
+    int x1,
+    int x2,
+    ChartCache *cache
+) const
+{
+    painter->fillRect(rect, mBackgroundBrush);
+    painter->drawRect(rect);
+    QRect lineRect = QRect(
+        rect.left() + 2,
+        rect.top(),
+        rect.width() - 4,
+        mSelectionStatsLineHeight
+    );
+    drawLabel(painter, lineRect, Qt::AlignCenter, distanceLabel, cache);
+
+    uint64_t begin, end;
+    getSelectedCandles(qMin(x1, x2), qMax(x1, x2), &begin, &end);
+    CandleStats stats = mView.stats(begin, end);
+    char line[LabelSize + 16];
+    int flags = Qt::AlignLeft | Qt::AlignVCenter;
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    makeStatsLine(line, "CANDLES", stats.count, true);
+    drawLabel(painter, lineRect, flags, line, cache);
+    if (stats.count == 0) {
+        return;
+    }
+    // подписи заглавными, чтобы строки не обрезались по нижнему краю
+    float change = stats.open != 0 ?
+        (stats.close - stats.open) / stats.open * 100 : 0;
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    makeStatsLine(line, "HIGH", stats.high, false);
+    drawLabel(painter, lineRect, flags, line, cache);
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    makeStatsLine(line, "LOW", stats.low, false);
+    drawLabel(painter, lineRect, flags, line, cache);
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    makeStatsLine(line, "CHANGE", change, false, "%");
+    drawLabel(painter, lineRect, flags, line, cache);
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    // дробные объемы (например, у криптовалют) показываем с дробной частью
+    makeStatsLine(line, "VOLUME", stats.volume, stats.volume >= 1000);
+    drawLabel(painter, lineRect, flags, line, cache);
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    makeStatsLine(line, "VWAP", stats.vwap, false);
+    drawLabel(painter, lineRect, flags, line, cache);
+    lineRect.translate(0, mSelectionStatsLineHeight);
+    makeStatsLine(line, "AVG RANGE", stats.averageRange, false);
+    drawLabel(painter, lineRect, flags, line, cache);
+}
+
+// область осей с рисками и метками, проведенных через точку pos
+// (как их рисуют drawAxisLines и drawAxisLabels), с запасом на сглаживание
+QRegion Chart::getAxisLinesRegion(
+    const QPoint &pos,
+    const QPoint &labelYBounds,
+    int labelOffset
+) const
+{
+    int axisMinX = mAxisXBounds.x();
+    int axisMaxX = mAxisXBounds.y();
+    int axisMinY = mAxisYBounds.x();
+    int axisMaxY = mAxisYBounds.y();
+    int offset = optShowVolumeGraph ? mAxisYVolumeHeight : 0;
+    QRegion region;
+    region += QRect(
+        QPoint(pos.x() - 1, axisMinY),
+        QPoint(pos.x() + 1, axisMaxY + offset + mAxisXDashLen + 1)
+    );
+    region += QRect(
+        QPoint(axisMinX, pos.y() - 1),
+        QPoint(axisMaxX + mAxisYDashLen + 1, pos.y() + 1)
+    );
+    QRect labelRect = getRectForAxisLabel(
+        pos.x(),
+        mAxisXBounds,
+        QPoint(labelYBounds.x(), labelYBounds.y() + labelOffset),
+        true
+    );
+    region += getOuterRectForAxisLabel(labelRect).adjusted(-1, -1, 1, 1);
+    labelRect = getRectForAxisLabel(pos.y(), mAxisXBounds, labelYBounds, false);
+    region += getOuterRectForAxisLabel(labelRect).adjusted(-1, -1, 1, 1);
+    return region;
+}
+
+void Chart::drawAxisLabels(
+    QPainter *painter,
+    const QPoint &pos,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    const QPointF dataYBounds,
+    int offset,
+    ChartCache *cache
+) const
+{
+    char label[LabelSize];
+    // нарисуем метку на оси Х
+    QRect labelRect = getRectForAxisLabel(
+        pos.x(),
+        axisXBounds,
+        QPoint(axisYBounds.x(), axisYBounds.y() + offset),
+        true
+    );
+    QRect biggerRect = getOuterRectForAxisLabel(labelRect);
+    painter->fillRect(biggerRect, mBackgroundBrush);
+    painter->drawRect(biggerRect);
+    if (isTimeAxis()) {
+        // время свечи под курсором, за концами ряда - с обычным шагом
+        int64_t seconds = mSessionIndex->timeAt(
+            *mView.dataSeries(),
+            getSeriesIndexAt(pos.x(), axisXBounds)
+        );
+        uint64_t date, time;
+        unixTimeToDateTime(qMax<int64_t>(seconds, 0), &date, &time);
+        makeTimeLabel(
+            date,
+            time,
+            mSessionIndex->step() < 86400 ? TimeLabelFull : TimeLabelDate,
+            label
+        );
+    } else {
+        float valueX = getCurrentDataValue(
+            axisXBounds,
+            mDataXBounds,
+            pos.x()
+        );
+        makeAxisLabel(valueX, label);
+    }
+    drawLabel(painter, labelRect, Qt::AlignCenter, label, cache);
+    // нарисуем метку на оси Y
+    labelRect = getRectForAxisLabel(
+        pos.y(),
+        axisXBounds,
+        axisYBounds,
+        false
+    );
+    biggerRect = getOuterRectForAxisLabel(labelRect);
+    painter->fillRect(biggerRect, mBackgroundBrush);
+    painter->drawRect(biggerRect);
+    // так как ось Y расположена сверху вниз, а рисуем мы ее снизу вверх
+    // значения надо отображать "зеркально"
+    float valueY = getCurrentDataValue(
+        axisYBounds,
+        dataYBounds,
+        axisYBounds.y() - (pos.y() - axisYBounds.x())
+    );
+    makeAxisLabel(valueY, label);
+    drawLabel(painter, labelRect, Qt::AlignCenter, label, cache);
+}
+
+// оси рисуются пером axisPen (пунктиром), риски - пером axisLabelsPen
+void Chart::drawAxisLines(
+    QPainter *painter,
+    const QPen &axisPen,
+    const QPen &axisLabelsPen,
+    const QPoint &pos,
+    const QPoint &axisXBounds,
+    const QPoint &axisYBounds,
+    int offset,
+    bool isDrawDashs
+) const
+{
+    painter->setPen(axisPen);
+    // оси
+    painter->drawLine(
+        QPoint(pos.x(), axisYBounds.x()),
+        QPoint(pos.x(), axisYBounds.y() + offset + mAxisXDashLen)
+    );
+    painter->drawLine(
+        QPoint(axisXBounds.x(), pos.y()),
+        QPoint(axisXBounds.y() + mAxisYDashLen, pos.y())
+    );
+    painter->setPen(axisLabelsPen);
+    // риски
+    if (isDrawDashs) {
+        painter->drawLine(
+            QPoint(pos.x(), axisYBounds.y() + offset),
+            QPoint(pos.x(), axisYBounds.y() + offset + mAxisXDashLen)
+        );
+        painter->drawLine(
+            QPoint(axisXBounds.y(), pos.y()),
+            QPoint(axisXBounds.y() + mAxisYDashLen, pos.y())
+        );
+    }
+}
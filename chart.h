@@ -0,0 +1,502 @@
+#ifndef CHART_H
+#define CHART_H
+
+#include "core.h"
+#include "dataview.h"
+#include "volumeprofile.h"
+#include "backtest.h"
+#include "patternindex.h"
+#include "indicator.h"
+#include "sessionindex.h"
+
+#include <QBrush>
+#include <QPen>
+#include <QFont>
+#include <QString>
+#include <QPoint>
+#include <QRect>
+#include <QRegion>
+#include <QSize>
+#include <QPointF>
+#include <QRectF>
+#include <QImage>
+#include <QLineF>
+
+#include <memory>
+#include <vector>
+
+class QPainter;
+
+// изменения состояния графика, по которым при подготовке кадра
+// пересчитывается только то, что от них зависит
+enum ChartChange {
+    ChartNoChange = 0x00,
+    // изменились данные ряда
+    ChartDataChange = 0x01,
+    // сдвиг или масштаб окна просмотра
+    ChartViewportChange = 0x02,
+    // размер графика или состав его областей
+    ChartLayoutChange = 0x04,
+    // оси мышки с метками
+    ChartCrosshairChange = 0x08,
+    // выделенная мышкой область
+    ChartSelectionChange = 0x10,
+    // скроллбар с уменьшенной историей
+    ChartMinimapChange = 0x20,
+    // к ряду дописаны свечи, прежние свечи не менялись
+    ChartAppendChange = 0x40,
+    ChartAllChanges = 0x7f
+};
+
+// символы подписей на осях, заранее нарисованные шрифтом font цветом color,
+// подписи собираются из них без раскладки текста и выделений памяти
+struct ChartLabelGlyphs {
+    QFont font;
+    QRgb color;
+    QImage image;
+    float ascent;
+    float height;
+    // начало символа в image (-1, если символа нет), ширина его картинки
+    // и сдвиг до следующего символа по кодам символов
+    int glyphX[128];
+    int glyphWidth[128];
+    float advance[128];
+};
+
+// кэш отрисованного графика свечей и объемов,
+// у каждого потока, рисующего график, свой кэш
+struct ChartCache {
+    ChartCache();
+    // занятая кэшем память в байтах
+    uint64_t memoryUsage() const;
+    // освободить изображение и буферы, кэш строится заново при отрисовке
+    void release();
+    QImage image;
+    QRect rect;
+    QPointF dataYBounds;
+    QPointF volumeBounds;
+    float candleStep;
+    int pixelOffset;
+    uint64_t dataBegin;
+    uint64_t dataSize;
+    uint64_t dataRevision;
+    bool showVolumeGraph;
+    // часть изображения нарисована упрощенно во время взаимодействия
+    bool isInteractive;
+    bool isValid;
+    // буферы линий огибающей свечей, переиспользуются между кадрами
+    std::vector<QLineF> upLines;
+    std::vector<QLineF> downLines;
+    std::vector<QLineF> upVolumeLines;
+    std::vector<QLineF> downVolumeLines;
+    // символы подписей по цветам текста
+    std::vector<ChartLabelGlyphs> labelGlyphs;
+    // профиль объема по ценам видимых свечей
+    VolumeProfile volumeProfile;
+    // значения индикаторов по видимым свечам и точки их линий
+    IndicatorScratch indicatorScratch;
+    std::vector<QPointF> indicatorPoints;
+};
+
+// снимок данных графика: ряд, его индексы и индикаторы разделяют блоки
+// с исходными без копирования, поэтому снимок делается на каждый кадр,
+// и кадр по нему рисуется в другом потоке без блокировки, пока исходные
+// данные дописываются; исходные индексы и индикаторы должны жить дольше
+struct ChartData {
+    ChartData(
+        const DataSeries &dataSeries,
+        const PatternIndex &patternIndex,
+        const SessionIndex &sessionIndex,
+        const IndicatorSet &indicators
+    );
+    ChartData(const ChartData &) = delete;
+    ChartData &operator=(const ChartData &) = delete;
+    DataSeries dataSeries;
+    PatternIndex patternIndex;
+    SessionIndex sessionIndex;
+    IndicatorSnapshot indicators;
+};
+
+// отрисовка графика свечей, не привязанная к виджету, поэтому может рисовать
+// в любой QPainter, а ее копию можно рисовать в другом потоке
+class Chart
+{
+public:
+    Chart(const DataSeries *dataSeries);
+    const DataSeries *dataSeries() const;
+    // рисуемые свечи: по умолчанию весь ряд, срез задает часть истории,
+    // индексы свечей графика идут от начала среза
+    const DataView &view() const;
+    void setView(const DataView &view);
+    bool showLabelsWithMouse() const;
+    void setShowLabelsWithMouse(bool newValue);
+    bool selectAreaWithMouse() const;
+    void setSelectAreaWithMouse(bool newValue);
+    bool showVolumeGraph() const;
+    void setShowVolumeGraph(bool newValue);
+    bool showScrollArea() const;
+    void setShowScrollArea(bool newValue);
+    bool showSelectionStats() const;
+    void setShowSelectionStats(bool newValue);
+    bool showVolumeProfile() const;
+    void setShowVolumeProfile(bool newValue);
+    bool showPatterns() const;
+    void setShowPatterns(bool newValue);
+    // рисуются ли отметки моделей при текущем шаге свечей
+    bool isPatternsDrawn() const;
+    float candleWidth() const;
+    void setCandleWidth(float newValue);
+    // упрощенная отрисовка, пока пользователь масштабирует или двигает
+    // график: без сглаживания и контуров свечей, огибающая вместо свечей
+    // уже при шаге свечи меньше interactiveCandleMinStep, после
+    // взаимодействия кэш графика перерисовывается полностью
+    bool isInteractive() const;
+    void setInteractive(bool isInteractive);
+    float interactiveCandleMinStep() const;
+    void setInteractiveCandleMinStep(float newValue);
+    // сделки прогона стратегии, рисуются метками входа и выхода,
+    // копии графика делят один список
+    void setTrades(const std::shared_ptr<const std::vector<BacktestTrade> > &trades);
+    // найденные свечные модели ряда, рисуются метками над свечами,
+    // индекс меняется вместе с рядом
+    void setPatternIndex(const PatternIndex *patternIndex);
+    // пользовательские индикаторы, рисуются линиями по видимым свечам
+    void setIndicators(const IndicatorSnapshot *indicators);
+    // рисовать по снимку данных: тот же срез снимка ряда, индексы
+    // и индикаторы снимка, снимок должен жить, пока график рисует
+    void setData(const ChartData *data);
+    // торговые сессии ряда: ось X подписывается временем свечей, разрывы
+    // между сессиями сжаты, начала сессий отмечаются линиями,
+    // индекс меняется вместе с рядом
+    void setSessionIndex(const SessionIndex *sessionIndex);
+    // упрощенная история для скроллбара, пока ряд содержит только конец
+    // файла: строки выборки равномерно по файлу и оценка кол-ва свечей
+    // в нем, без выборки скроллбар рисуется по ряду
+    void setOverview(
+        const std::shared_ptr<const std::vector<Candle> > &candles,
+        uint64_t size
+    );
+
+    void setMousePos(const QPoint &pos);
+    void setMouseEnter(bool isEnter);
+    void pressLeftButton(const QPoint &pos);
+    void releaseLeftButton(const QPoint &pos);
+    void clearSelectedArea();
+    bool zoom(float factor, int anchorX);
+    bool panByPixels(int dx);
+    void finishPan();
+    bool scrollToScrollBarPosition(int x);
+    QRect scrollAreaRect() const;
+    Qt::CursorShape cursorShape() const;
+    QBrush backgroundBrush() const;
+    QRegion crosshairRegion() const;
+    QRegion selectionRegion() const;
+
+    void paint(QPainter *painter, const QRect &rect);
+    void prepare(const QSize &size, int changes);
+    void render(
+        QPainter *painter,
+        const QRect &rect,
+        const QRegion &region,
+        ChartCache *cache
+    ) const;
+private:
+    // место под подпись значения на оси с завершающим нулем
+    static const int LabelSize = 64;
+    // запас по краям картинки символа подписи
+    static const int LabelGlyphMargin = 2;
+    // строк в рамке статистики выделения
+    static const int SelectionStatsLineCount = 8;
+    // кол-во цветов линий индикаторов
+    static const int IndicatorPenCount = 4;
+    // виды подписей времени: hh:mm, dd.mm, mm.yyyy, yyyy,
+    // dd.mm.yy hh:mm и dd.mm.yyyy
+    enum TimeLabelFormat {
+        TimeLabelMinute,
+        TimeLabelDay,
+        TimeLabelMonth,
+        TimeLabelYear,
+        TimeLabelFull,
+        TimeLabelDate
+    };
+
+    int pixelOffsetFromEnd() const;
+    float candleMinStep() const;
+    float candleMaxStep() const;
+    void getCandlesInRange(
+        int x1,
+        int x2,
+        int axisMaxX,
+        int pixelOffset,
+        int *firstIndex,
+        int *lastIndex
+    ) const;
+    void updateDataBounds(int firstIndex, int lastIndex, bool isExpandOnly);
+    void updateGraphCache(
+        const QRect &graphRect,
+        const QPoint &axisYBounds,
+        ChartCache *cache
+    ) const;
+    void drawCandles(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        int firstIndex,
+        int lastIndex
+    ) const;
+    void drawVolumeProfile(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        ChartCache *cache
+    ) const;
+    void drawPatterns(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds
+    ) const;
+    void drawTrades(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds
+    ) const;
+    void drawIndicators(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        ChartCache *cache
+    ) const;
+    void drawDecimatedCandles(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        int x1,
+        int x2,
+        ChartCache *cache
+    ) const;
+    int makeAxisLabel(const float value, char *label) const;
+    int makeTimeLabel(
+        uint64_t date,
+        uint64_t time,
+        TimeLabelFormat format,
+        char *label
+    ) const;
+    // подписывается ли ось X временем по индексу сессий
+    bool isTimeAxis() const;
+    // индекс ряда свечи под точкой x и левый край свечи с индексом ряда,
+    // индексы могут быть за концами ряда
+    int64_t getSeriesIndexAt(float x, const QPoint &axisXBounds) const;
+    float getSeriesIndexX(int64_t index, const QPoint &axisXBounds) const;
+    void drawOverview(
+        QPainter *painter,
+        const QPoint &xScale,
+        const QPoint &yScale
+    ) const;
+    void drawSessionSeparators(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds
+    ) const;
+    void drawTimeAxis(
+        QPainter *painter,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        const QRegion &region,
+        ChartCache *cache
+    ) const;
+    const ChartLabelGlyphs &getLabelGlyphs(
+        QPainter *painter,
+        ChartCache *cache
+    ) const;
+    void drawLabel(
+        QPainter *painter,
+        const QRect &rect,
+        int flags,
+        const char *text,
+        ChartCache *cache
+    ) const;
+    float getCurrentDataValue(
+        const QPoint &axisBounds,
+        const QPointF &dataBounds,
+        const int currentAxisValue
+    ) const;
+    float getCurrentAxisValue(
+        const QPoint &axisBounds,
+        const QPointF &dataBounds,
+        const float currentDataValue
+    ) const;
+    QRect getRectForAxisLabel(
+        int val,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        bool isAxisLabelX
+    ) const;
+    QRect getOuterRectForAxisLabel(
+        const QRect &labelRect
+    ) const;
+    QPoint getSelectionEndPos() const;
+    QRect getRectForSelectionLabel(const QPoint &pos) const;
+    void getSelectedCandles(
+        int x1,
+        int x2,
+        uint64_t *begin,
+        uint64_t *end
+    ) const;
+    int makeStatsLine(
+        char *line,
+        const char *name,
+        double value,
+        bool isInteger,
+        const char *suffix = ""
+    ) const;
+    void drawSelectionStats(
+        QPainter *painter,
+        const QRect &rect,
+        const char *distanceLabel,
+        int x1,
+        int x2,
+        ChartCache *cache
+    ) const;
+    QRegion getAxisLinesRegion(
+        const QPoint &pos,
+        const QPoint &labelYBounds,
+        int labelOffset
+    ) const;
+    void drawAxisLabels(
+        QPainter *painter,
+        const QPoint &pos,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds, const QPointF dataYBounds,
+        int offset,
+        ChartCache *cache
+    ) const;
+    void drawAxisLines(
+        QPainter *painter,
+        const QPen &axisPen,
+        const QPen &axisLabelsPen,
+        const QPoint &pos,
+        const QPoint &axisXBounds,
+        const QPoint &axisYBounds,
+        int offset,
+        bool isDrawDashs=true
+    ) const;
+
+    DataView mView;
+    // сделки по возрастанию индексов свечей ряда
+    std::shared_ptr<const std::vector<BacktestTrade> > mTrades;
+    const PatternIndex *mPatternIndex;
+    const IndicatorSnapshot *mIndicators;
+    const SessionIndex *mSessionIndex;
+    std::shared_ptr<const std::vector<Candle> > mOverview;
+    uint64_t mOverviewSize;
+    QPointF mOverviewBounds;
+
+    QPointF mDataXBounds;
+    QPointF mDataYBounds;
+    QPointF mVolumeBounds;
+    QPoint mMousePos;
+    QPoint mMouseGraphPressPos;
+    QPoint mMouseGraphReleasePos;
+    bool mIsMouseEnter;
+    bool mIsLmbMousePressed;
+    bool mIsMousePressInGraph;
+    bool mIsNeedRefitBounds;
+    QRect mScrollAreaRect;
+    QSize mPaintSize;
+    Qt::CursorShape mCursorShape;
+
+    QRect mGraphRect;
+    QPoint mAxisXBounds;
+    QPoint mAxisYBounds;
+    int mBoundsPixelOffset;
+    uint64_t mBoundsDataSize;
+    // номер замены данных: кэш графика сдвигается на дописанные свечи,
+    // только если данные с тех пор не заменялись
+    uint64_t mDataRevision;
+    ChartCache mCache;
+
+    QBrush mBackgroundBrush;
+    QPen mAxisPen;
+    QPen mMouseAxisPen;
+    QPen mMouseAxisVolumePen;
+    QPen mMouseLabelPen;
+    QPen mMouseVolumeLabelPen;
+    QPen mMouseSelectAreaPen;
+    int mMouseSelectAreaBrushAlpha;
+    QPen mMouseSelectAreaLabelsPen;
+    QBrush mMouseSelectAreaBrush;
+    QPen mCandlePen;
+    QPen mScrollBarPen;
+    QBrush mCandleUpBrush;
+    QBrush mCandleDownBrush;
+    int mCandleBrushAlpha;
+    // перья и кисти, производные от цветов свечей, создаются заранее,
+    // чтобы не выделять память при каждом кадре
+    QPen mCandleUpPen;
+    QPen mCandleDownPen;
+    QPen mVolumeUpPen;
+    QPen mVolumeDownPen;
+    QBrush mVolumeUpBrush;
+    QBrush mVolumeDownBrush;
+    QBrush mVolumeProfileBrush;
+    QPen mTradeProfitPen;
+    QPen mTradeLossPen;
+    QBrush mTradeLongBrush;
+    QBrush mTradeShortBrush;
+    // кисти меток моделей по номерам битов CandlePattern
+    QBrush mPatternBrushes[PatternCount];
+    QPen mIndicatorPens[IndicatorPenCount];
+    QPen mSessionSeparatorPen;
+
+    int mAxisXLeftBorderLength;
+    int mAxisXRightBorderLength;
+    int mAxisYTopBorderLength;
+    int mAxisYBottomBorderLength;
+    int mAxisXDashCount;
+    int mAxisYDashCount;
+    int mAxisYVolumeDashCount;
+    int mAxisXDashLen;
+    int mAxisYDashLen;
+    int mAxisXDashSpace;
+    int mAxisYDashSpace;
+    int mAxisLabelHalfWidth;
+    int mAxisLabelHalfHeight;
+    // подписи времени шире числовых, между ними не меньше mAxisTimeLabelSpace
+    int mAxisTimeLabelHalfWidth;
+    int mAxisTimeLabelSpace;
+    // линии начал сессий ближе этого кол-ва пикселей не рисуются
+    int mSessionSeparatorMinSpace;
+    int mMaxAxisLabelLength;
+    int mAxisLabelXAdditionalLength;
+    int mAxisLabelYAdditionalLength;
+    float mCandleStep;
+    int mBetweenCandlesWidth;
+    int mViewedCandleCount;
+    int mCandleMinWidth;
+    int mCandleMaxWidth;
+    int mAxisYVolumeHeight;
+    int mAxisYScrollBarHeight;
+    int mSelectionStatsWidth;
+    int mSelectionStatsLineHeight;
+    int mVolumeProfileWidth;
+    int mVolumeProfileBucketCount;
+    int mTradeMarkerSize;
+    float mPatternMarkerRadius;
+    float mPatternMarkerMinStep;
+    float mInteractiveCandleMinStep;
+    // наибольшее кол-во свечей, по которым индикаторы считаются при
+    // отрисовке, пока их история не вычислена в фоне
+    uint64_t mIndicatorMaxEvaluateCount;
+    double mCandleOffsetFromEnd;
+    bool mIsInteractive;
+
+    bool optShowLabelsWithMouse;
+    bool optSelectAreaWithMouse;
+    bool optShowVolumeGraph;
+    bool optShowScrollArea;
+    bool optShowSelectionStats;
+    bool optShowVolumeProfile;
+    bool optShowPatterns;
+};
+
+#endif // CHART_H
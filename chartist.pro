@@ -1,14 +1,80 @@
-QT += core widgets
+QT += core widgets network
 
 HEADERS = \
     widget.h \
+    chart.h \
+    exporter.h \
+    renderthread.h \
+    framebench.h \
+    framescheduler.h \
     window.h \
     reader.h \
-    core.h
+    core.h \
+    lod.h \
+    prefixsum.h \
+    volumeprofile.h \
+    dialect.h \
+    csvscan.h \
+    decompressor.h \
+    alloccounter.h \
+    ringbuffer.h \
+    replay.h \
+    feedclient.h \
+    correlation.h \
+    backtest.h \
+    patternindex.h \
+    dataview.h \
+    loadbench.h \
+    indicator.h \
+    alert.h \
+    memory.h \
+    sessionindex.h \
+    chunkedvector.h \
+    commandline.h
 
 SOURCES = \
     main.cpp \
     widget.cpp \
+    chart.cpp \
+    exporter.cpp \
+    renderthread.cpp \
+    framebench.cpp \
+    framescheduler.cpp \
     window.cpp \
     reader.cpp \
-    core.cpp
+    core.cpp \
+    lod.cpp \
+    prefixsum.cpp \
+    volumeprofile.cpp \
+    dialect.cpp \
+    csvscan.cpp \
+    decompressor.cpp \
+    alloccounter.cpp \
+    replay.cpp \
+    feedclient.cpp \
+    correlation.cpp \
+    backtest.cpp \
+    patternindex.cpp \
+    dataview.cpp \
+    loadbench.cpp \
+    indicator.cpp \
+    alert.cpp \
+    memory.cpp \
+    sessionindex.cpp \
+    commandline.cpp
+
+# сжатые файлы с данными: gzip и zstd, если библиотеки найдены
+CONFIG += link_pkgconfig
+packagesExist(zlib) {
+    PKGCONFIG += zlib
+    DEFINES += CHARTIST_ZLIB
+}
+packagesExist(libzstd) {
+    PKGCONFIG += libzstd
+    DEFINES += CHARTIST_ZSTD
+}
+
+# подсчет выделений памяти при рисовании кадра: qmake CONFIG+=alloc_count
+alloc_count {
+    DEFINES += CHARTIST_COUNT_ALLOCATIONS
+}
@@ -0,0 +1,187 @@
+#ifndef CHUNKEDVECTOR_H
+#define CHUNKEDVECTOR_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+// вектор, растущий блоками по ChunkSize элементов: заполненные блоки
+// не переносятся, а блоки разделяются копиями вектора по счетчику ссылок,
+// поэтому копия стоит O(кол-во блоков), а не O(n); разделяемый блок перед
+// изменением копируется, так что копии друг друга не видят; копия
+// может читаться в другом потоке, пока исходный вектор дописывают
+template<typename T, uint64_t ChunkSize>
+class ChunkedVector {
+public:
+    class const_iterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef int64_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        const_iterator() : mVector(nullptr), mIndex(0) {}
+        const_iterator(const ChunkedVector *vector, uint64_t index)
+            : mVector(vector), mIndex(index)
+        {
+        }
+        const T &operator*() const { return (*mVector)[mIndex]; }
+        const T *operator->() const { return &(*mVector)[mIndex]; }
+        const T &operator[](difference_type n) const { return (*mVector)[mIndex + n]; }
+        const_iterator &operator++() { ++mIndex; return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; ++mIndex; return it; }
+        const_iterator &operator--() { --mIndex; return *this; }
+        const_iterator operator--(int) { const_iterator it = *this; --mIndex; return it; }
+        const_iterator &operator+=(difference_type n) { mIndex += n; return *this; }
+        const_iterator &operator-=(difference_type n) { mIndex -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(mVector, mIndex + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(mVector, mIndex - n); }
+        difference_type operator-(const const_iterator &other) const
+        {
+            return (difference_type)mIndex - (difference_type)other.mIndex;
+        }
+        bool operator==(const const_iterator &other) const { return mIndex == other.mIndex; }
+        bool operator!=(const const_iterator &other) const { return mIndex != other.mIndex; }
+        bool operator<(const const_iterator &other) const { return mIndex < other.mIndex; }
+        bool operator>(const const_iterator &other) const { return mIndex > other.mIndex; }
+        bool operator<=(const const_iterator &other) const { return mIndex <= other.mIndex; }
+        bool operator>=(const const_iterator &other) const { return mIndex >= other.mIndex; }
+    private:
+        const ChunkedVector *mVector;
+        uint64_t mIndex;
+    };
+
+    ChunkedVector() : mSize(0) {}
+
+    uint64_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return mSize == 0;
+    }
+
+    const T &operator[](uint64_t index) const
+    {
+        return (*mChunks[index / ChunkSize])[index % ChunkSize];
+    }
+
+    const T &back() const
+    {
+        return mChunks.back()->back();
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, mSize);
+    }
+
+    // блоки: chunkData(i) - элементы [i * ChunkSize, ...),
+    // в блоке chunkSize(i) элементов
+    uint64_t chunkCount() const
+    {
+        return mChunks.size();
+    }
+
+    const T *chunkData(uint64_t chunk) const
+    {
+        return mChunks[chunk]->data();
+    }
+
+    uint64_t chunkSize(uint64_t chunk) const
+    {
+        return mChunks[chunk]->size();
+    }
+
+    void append(const T *data, uint64_t size)
+    {
+        uint64_t appended = 0;
+        while (appended < size) {
+            if (mChunks.empty() || mChunks.back()->size() == ChunkSize) {
+                mChunks.push_back(std::make_shared<Chunk>());
+            }
+            uint64_t chunkSize = mChunks.back()->size();
+            uint64_t count = std::min<uint64_t>(size - appended, ChunkSize - chunkSize);
+            // емкость последнего блока растет вдвое до ChunkSize
+            Chunk &chunk = detach(mChunks.size() - 1, chunkSize + count);
+            chunk.insert(chunk.end(), data + appended, data + appended + count);
+            appended += count;
+        }
+        mSize += size;
+    }
+
+    void push_back(const T &value)
+    {
+        append(&value, 1);
+    }
+
+    // заменить элемент index
+    void set(uint64_t index, const T &value)
+    {
+        detach(index / ChunkSize, 0)[index % ChunkSize] = value;
+    }
+
+    void clear()
+    {
+        std::vector<std::shared_ptr<Chunk>>().swap(mChunks);
+        mSize = 0;
+    }
+
+    void swap(ChunkedVector &other)
+    {
+        mChunks.swap(other.mChunks);
+        std::swap(mSize, other.mSize);
+    }
+
+    // занятая память в байтах, блоки, общие с копиями, учитываются
+    // в каждой из них; заполненные блоки не растут дальше ChunkSize
+    uint64_t memoryUsage() const
+    {
+        uint64_t bytes = mChunks.capacity() * sizeof(std::shared_ptr<Chunk>);
+        if (!mChunks.empty()) {
+            bytes += ((mChunks.size() - 1) * ChunkSize + mChunks.back()->capacity()) * sizeof(T);
+        }
+        return bytes;
+    }
+private:
+    typedef std::vector<T> Chunk;
+
+    // блок chunk, который можно менять, с емкостью не меньше size:
+    // блок, разделяемый с копией, заменяется своей копией
+    Chunk &detach(uint64_t chunk, uint64_t size)
+    {
+        std::shared_ptr<Chunk> &data = mChunks[chunk];
+        uint64_t capacity = std::max<uint64_t>(size, data->size());
+        if (data.use_count() > 1) {
+            std::shared_ptr<Chunk> copy = std::make_shared<Chunk>();
+            copy->reserve(std::max<uint64_t>(
+                capacity,
+                std::min<uint64_t>(2 * data->size(), ChunkSize)
+            ));
+            copy->assign(data->begin(), data->end());
+            data = copy;
+        } else if (capacity > data->capacity()) {
+            data->reserve(std::min<uint64_t>(
+                std::max<uint64_t>(capacity, 2 * data->capacity()),
+                ChunkSize
+            ));
+        }
+        return *data;
+    }
+
+    uint64_t mSize;
+    std::vector<std::shared_ptr<Chunk>> mChunks;
+};
+
+#endif // CHUNKEDVECTOR_H
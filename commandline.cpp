@@ -0,0 +1,76 @@
+#include "commandline.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+
+#include <cstring>
+#include <vector>
+
+static QMutex outputMutex;
+
+bool isOptionRequested(int argc, char *argv[], const char *option)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], option) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void printMessage(const QString &message)
+{
+    QMutexLocker locker(&outputMutex);
+    QTextStream(stderr) << message << "\n";
+}
+
+BenchRandom::BenchRandom(uint64_t seed) : mState(seed)
+{
+}
+
+uint64_t BenchRandom::next()
+{
+    mState = mState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return mState >> 33;
+}
+
+double BenchRandom::uniform(double from, double to)
+{
+    return from + (to - from) * (next() % 1000000) / 1e6;
+}
+
+BenchSeriesGenerator::BenchSeriesGenerator(double startPrice, uint64_t seed)
+    : mRandom(seed), mStartPrice(startPrice), mPrice(startPrice), mIndex(0)
+{
+}
+
+Candle BenchSeriesGenerator::next()
+{
+    Candle candle;
+    candle.date = 20170101 + mIndex / 1440;
+    candle.time = (mIndex % 1440) / 60 * 10000 + (mIndex % 60) * 100;
+    candle.open = mPrice;
+    mPrice = qBound(
+        mStartPrice * 0.6,
+        mPrice * mRandom.uniform(0.999, 1.001),
+        mStartPrice * 1.4
+    );
+    candle.close = mPrice;
+    candle.high = qMax(candle.open, candle.close) * mRandom.uniform(1, 1.0005);
+    candle.low = qMin(candle.open, candle.close) * mRandom.uniform(0.9995, 1);
+    candle.volume = mRandom.next() % 100 == 0 ?
+        mRandom.uniform(1000, 10000) : mRandom.uniform(100, 1000);
+    ++mIndex;
+    return candle;
+}
+
+void BenchSeriesGenerator::append(DataSeries *dataSeries, uint64_t count)
+{
+    std::vector<Candle> candles;
+    candles.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        candles.push_back(next());
+    }
+    dataSeries->append(candles.data(), candles.size());
+}
@@ -0,0 +1,46 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include "core.h"
+
+#include <QString>
+
+#include <inttypes.h>
+
+// общее для режимов запуска без окна: экспорта, повтора, отчетов и замеров
+
+// есть ли аргумент option (например "--export") в командной строке
+bool isOptionRequested(int argc, char *argv[], const char *option);
+
+// сообщение в stderr, можно печатать из нескольких потоков
+void printMessage(const QString &message);
+
+// одинаковые от запуска к запуску случайные числа
+class BenchRandom
+{
+public:
+    explicit BenchRandom(uint64_t seed);
+    uint64_t next();
+    // равномерно в [from, to)
+    double uniform(double from, double to);
+private:
+    uint64_t mState;
+};
+
+// минутные свечи случайного блуждания цены около startPrice (в пределах 40%)
+// с редкими всплесками объема, одинаковые от запуска к запуску
+class BenchSeriesGenerator
+{
+public:
+    explicit BenchSeriesGenerator(double startPrice = 100, uint64_t seed = 1);
+    Candle next();
+    // count следующих свечей в конец ряда
+    void append(DataSeries *dataSeries, uint64_t count);
+private:
+    BenchRandom mRandom;
+    double mStartPrice;
+    double mPrice;
+    uint64_t mIndex;
+};
+
+#endif // COMMANDLINE_H
@@ -1,45 +1,93 @@
 #include "core.h"
 
-#include <cstdlib>
-#include <stdexcept>
+#include <QtGlobal>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+
+#include <exception>
+#include <utility>
 #include <math.h>
 
+const uint64_t DataSeries::ChunkSize;
+
 DataSeries::DataSeries()
+    : mMemory(MemorySeries), mIndexMemory(MemorySeriesIndexes)
+{
+    mIsAccounted = true;
+    mGlobalHigh = 0;
+    mGlobalLow = INFINITY;
+}
+
+DataSeries::DataSeries(DataSeries &&other)
+    : mMemory(MemorySeries), mIndexMemory(MemorySeriesIndexes)
 {
-    mSize = 0;
-    mData = nullptr;
+    mIsAccounted = true;
     mGlobalHigh = 0;
     mGlobalLow = INFINITY;
+    *this = std::move(other);
 }
 
-DataSeries::~DataSeries()
+DataSeries &DataSeries::operator=(DataSeries &&other)
 {
-    free(mData);
-    mData = nullptr;
+    if (this != &other) {
+        mCandles.clear();
+        mCandles.swap(other.mCandles);
+        mIsAccounted = other.mIsAccounted;
+        mGlobalHigh = other.mGlobalHigh;
+        mGlobalLow = other.mGlobalLow;
+        mDecimationIndex = std::move(other.mDecimationIndex);
+        mPrefixSumIndex = std::move(other.mPrefixSumIndex);
+        // перемещенный ряд остается пустым
+        other.mGlobalHigh = 0;
+        other.mGlobalLow = INFINITY;
+        other.mDecimationIndex.clear();
+        other.mPrefixSumIndex.clear();
+        updateMemoryUsage();
+        other.updateMemoryUsage();
+    }
+    return *this;
+}
+
+DataSeries DataSeries::share() const
+{
+    DataSeries series;
+    series.mCandles = mCandles;
+    series.mIsAccounted = false;
+    series.mGlobalHigh = mGlobalHigh;
+    series.mGlobalLow = mGlobalLow;
+    series.mDecimationIndex = mDecimationIndex;
+    series.mPrefixSumIndex = mPrefixSumIndex;
+    return series;
 }
 
 uint64_t DataSeries::size() const
 {
-    return mSize;
+    return mCandles.size();
+}
+
+uint64_t DataSeries::chunkCount() const
+{
+    return mCandles.chunkCount();
+}
+
+const Candle *DataSeries::chunkData(uint64_t chunk) const
+{
+    return mCandles.chunkData(chunk);
 }
 
-const Candle * DataSeries::data() const
+uint64_t DataSeries::chunkSize(uint64_t chunk) const
 {
-    return mData;
+    return mCandles.chunkSize(chunk);
 }
 
 void DataSeries::append(const Candle *data, uint64_t size)
 {
-    if (mSize == 0) {
-        mData = (Candle *)malloc(size * sizeof(Candle));
-    } else {
-        mData = (Candle *)realloc((void *)mData, (mSize + size) * sizeof(Candle));
-    }
-    if (mData == nullptr) {
-        throw std::runtime_error("Can't append data to DataSeries");
-    }
     for (uint64_t i = 0; i < size; ++i) {
-        mData[mSize + i] = data[i];
         if (data[i].high > mGlobalHigh) {
             mGlobalHigh = data[i].high;
         }
@@ -47,7 +95,11 @@ void DataSeries::append(const Candle *data, uint64_t size)
             mGlobalLow = data[i].low;
         }
     }
-    mSize += size;
+    // блок, разделяемый со снимком ряда, копируется перед дописыванием
+    mCandles.append(data, size);
+    mDecimationIndex.update(*this);
+    mPrefixSumIndex.update(*this);
+    updateMemoryUsage();
 }
 
 float DataSeries::globalHigh() const
@@ -59,3 +111,156 @@ float DataSeries::globalLow() const
 {
     return mGlobalLow;
 }
+
+CandleRange DataSeries::range(uint64_t first, uint64_t last) const
+{
+    return mDecimationIndex.query(*this, first, last);
+}
+
+CandleStats DataSeries::stats(uint64_t first, uint64_t last) const
+{
+    CandleStats stats;
+    stats.count = last > first ? last - first : 0;
+    if (stats.count == 0) {
+        stats.open = stats.close = stats.high = stats.low = 0;
+        stats.volume = stats.vwap = stats.averageRange = 0;
+        return stats;
+    }
+    CandleRange range = mDecimationIndex.query(*this, first, last);
+    CandleSums sums = mPrefixSumIndex.query(first, last);
+    stats.open = at(first).open;
+    stats.close = at(last - 1).close;
+    stats.high = range.high;
+    stats.low = range.low;
+    stats.volume = sums.volume;
+    stats.vwap = sums.volume > 0 ? sums.priceVolume / sums.volume : 0;
+    stats.averageRange = sums.range / stats.count;
+    return stats;
+}
+
+uint64_t DataSeries::memoryUsage() const
+{
+    return mCandles.memoryUsage();
+}
+
+uint64_t DataSeries::indexMemoryUsage() const
+{
+    return mDecimationIndex.memoryUsage() + mPrefixSumIndex.memoryUsage();
+}
+
+void DataSeries::updateMemoryUsage()
+{
+    mMemory.setUsage(mIsAccounted ? memoryUsage() : 0);
+    mIndexMemory.setUsage(mIsAccounted ? indexMemoryUsage() : 0);
+}
+
+// общие данные parallelFor: задачи пула, начавшие после окончания вызова,
+// находят счетчик исчерпанным и function не вызывают
+struct ParallelFor {
+    std::function<void(int)> function;
+    int partCount;
+    QAtomicInteger<int> nextPart;
+    QMutex mutex;
+    QWaitCondition doneCondition;
+    int doneCount;
+    std::exception_ptr error;
+
+    // обработать части, пока они не кончатся
+    void process()
+    {
+        forever {
+            int part = nextPart.fetchAndAddOrdered(1);
+            if (part >= partCount) {
+                return;
+            }
+            std::exception_ptr partError;
+            try {
+                function(part);
+            } catch (...) {
+                partError = std::current_exception();
+            }
+            QMutexLocker locker(&mutex);
+            if (partError && !error) {
+                error = partError;
+            }
+            if (++doneCount == partCount) {
+                doneCondition.wakeAll();
+            }
+        }
+    }
+};
+
+class ParallelForTask : public QRunnable
+{
+public:
+    ParallelForTask(const std::shared_ptr<ParallelFor> &parallel)
+        : mParallel(parallel)
+    {
+    }
+
+    void run() override
+    {
+        mParallel->process();
+    }
+private:
+    std::shared_ptr<ParallelFor> mParallel;
+};
+
+void parallelFor(int partCount, const std::function<void(int)> &function)
+{
+    if (partCount <= 0) {
+        return;
+    }
+    std::shared_ptr<ParallelFor> parallel(new ParallelFor());
+    parallel->function = function;
+    parallel->partCount = partCount;
+    parallel->nextPart.store(0);
+    parallel->doneCount = 0;
+    int taskCount = qMin(QThread::idealThreadCount(), partCount) - 1;
+    for (int i = 0; i < taskCount; ++i) {
+        QThreadPool::globalInstance()->start(new ParallelForTask(parallel));
+    }
+    parallel->process();
+    QMutexLocker locker(&parallel->mutex);
+    while (parallel->doneCount < partCount) {
+        parallel->doneCondition.wait(&parallel->mutex);
+    }
+    if (parallel->error) {
+        std::rethrow_exception(parallel->error);
+    }
+}
+
+int parallelPartCount(uint64_t size, uint64_t minPartSize, uint64_t maxPartSize)
+{
+    uint64_t partCount = 4 * QThread::idealThreadCount();
+    if (partCount > size / minPartSize) {
+        partCount = size / minPartSize;
+    }
+    uint64_t maxPartCount = size / maxPartSize + (size % maxPartSize != 0);
+    if (partCount < maxPartCount) {
+        partCount = maxPartCount;
+    }
+    return qMax<uint64_t>(partCount, 1);
+}
+
+void parallelFor(
+    uint64_t begin,
+    uint64_t end,
+    uint64_t minPartSize,
+    const std::function<void(int, uint64_t, uint64_t)> &function
+)
+{
+    if (begin >= end) {
+        return;
+    }
+    // частей не больше, чем элементов, поэтому пустых частей нет
+    uint64_t size = end - begin;
+    int partCount = parallelPartCount(size, minPartSize);
+    parallelFor(partCount, [&](int part) {
+        function(
+            part,
+            begin + size * part / partCount,
+            begin + size * (part + 1) / partCount
+        );
+    });
+}
@@ -1,8 +1,16 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include "chunkedvector.h"
+#include "lod.h"
+#include "prefixsum.h"
+#include "memory.h"
+
 #include <inttypes.h>
+#include <functional>
 #include <string>
+#include <memory>
+#include <vector>
 
 struct Candle {
     uint64_t date;
@@ -14,20 +22,102 @@ struct Candle {
     float volume;
 };
 
+// статистика по диапазону свечей
+struct CandleStats {
+    uint64_t count;
+    // открытие первой и закрытие последней свечи
+    float open;
+    float close;
+    float high;
+    float low;
+    double volume;
+    // средневзвешенная по объему типичная цена
+    double vwap;
+    // средний размах high - low
+    double averageRange;
+};
+
+// свечи и индексы хранятся блоками, записанные свечи не меняются,
+// а заполненные блоки не переносятся, поэтому блоки могут разделяться
+// несколькими рядами, ряд только перемещается, общие свечи дает share()
 class DataSeries {
 public:
+    // кол-во свечей в блоке (степень двойки)
+    static const uint64_t ChunkSize = 1 << 16;
+
     DataSeries();
-    ~DataSeries();
+    DataSeries(DataSeries &&other);
+    DataSeries &operator=(DataSeries &&other);
+    DataSeries(const DataSeries &) = delete;
+    DataSeries &operator=(const DataSeries &) = delete;
+    // снимок ряда за O(кол-во блоков): свечи и индексы не копируются,
+    // дописывание в любой из рядов другой не меняет, поэтому снимок
+    // читается в другом потоке без блокировки; блоки уже учтены исходным
+    // рядом, и снимок в учет памяти не входит
+    DataSeries share() const;
     void append(const Candle *data, uint64_t size);
     uint64_t size() const;
-    const Candle *data() const;
+    const Candle &at(uint64_t index) const;
+    // блоки свечей: chunkData(i) - свечи [i * ChunkSize, ...),
+    // в блоке chunkSize(i) свечей
+    uint64_t chunkCount() const;
+    const Candle *chunkData(uint64_t chunk) const;
+    uint64_t chunkSize(uint64_t chunk) const;
     float globalHigh() const;
     float globalLow() const;
+    // максимум, минимум и наибольший объем по свечам [first, last)
+    CandleRange range(uint64_t first, uint64_t last) const;
+    // статистика по свечам [first, last): суммы за O(1) по префиксным
+    // суммам, максимум и минимум за O(log n) по пирамиде диапазонов
+    CandleStats stats(uint64_t first, uint64_t last) const;
+    // занятая свечами и индексами память в байтах, блоки, общие с другими
+    // рядами, учитываются в каждом из них
+    uint64_t memoryUsage() const;
+    uint64_t indexMemoryUsage() const;
 private:
-    uint64_t mSize;
-    Candle *mData;
+    // сообщить занятую память в учет
+    void updateMemoryUsage();
+
+    // последний блок может быть заполнен не до конца, его емкость растет
+    // вдвое до ChunkSize, пока блок не разделяется с другим рядом
+    ChunkedVector<Candle, ChunkSize> mCandles;
+    bool mIsAccounted;
     float mGlobalHigh;
     float mGlobalLow;
+    DecimationIndex mDecimationIndex;
+    PrefixSumIndex mPrefixSumIndex;
+    MemoryAccount mMemory;
+    MemoryAccount mIndexMemory;
 };
 
+inline const Candle &DataSeries::at(uint64_t index) const
+{
+    return mCandles[index];
+}
+
+// выполнить function(part) для частей [0, partCount): части разбирают
+// по счетчику и вызвавший поток, и потоки пула, поэтому вызов не ждет
+// свободных потоков пула и не зависает, если сам выполняется в пуле;
+// возвращается, когда выполнены все части, первое исключение из частей
+// выбрасывается после этого
+void parallelFor(int partCount, const std::function<void(int)> &function);
+
+// кол-во частей для разбиения size элементов между потоками: частей больше,
+// чем потоков, чтобы потоки, начавшие позже, успели забрать свою долю,
+// но части не меньше minPartSize и не больше maxPartSize
+int parallelPartCount(
+    uint64_t size,
+    uint64_t minPartSize,
+    uint64_t maxPartSize = UINT64_MAX
+);
+
+// выполнить function(part, first, last) для parallelPartCount(end - begin,
+// minPartSize) равных частей [first, last) диапазона [begin, end)
+void parallelFor(
+    uint64_t begin,
+    uint64_t end,
+    uint64_t minPartSize,
+    const std::function<void(int, uint64_t, uint64_t)> &function
+);
+
 #endif // CORE_H
@@ -0,0 +1,513 @@
+#include "correlation.h"
+#include "dataview.h"
+#include "reader.h"
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <stdexcept>
+#include <utility>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CORRELATION_SSE2
+#include <emmintrin.h>
+#endif
+
+const size_t CorrelationMatrix::BlockSize;
+const uint64_t CorrelationMatrix::ParallelMinWork;
+
+// кол-во доходностей, произведения которых копятся во float,
+// перед тем как добавиться к суммам в double
+static const uint64_t TimeChunkSize = 1024;
+
+#ifdef CORRELATION_SSE2
+static inline float horizontalSum(__m128 value)
+{
+    __m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(value, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+#endif
+
+static inline float sumValues(const float *x, uint64_t size)
+{
+    uint64_t k = 0;
+    float result = 0;
+#ifdef CORRELATION_SSE2
+    __m128 sum = _mm_setzero_ps();
+    for (; k + 4 <= size; k += 4) {
+        sum = _mm_add_ps(sum, _mm_loadu_ps(x + k));
+    }
+    result = horizontalSum(sum);
+#endif
+    for (; k < size; ++k) {
+        result += x[k];
+    }
+    return result;
+}
+
+// сумма произведений x[k] * y[k]
+static inline float dotProduct(const float *x, const float *y, uint64_t size)
+{
+    uint64_t k = 0;
+    float result = 0;
+#ifdef CORRELATION_SSE2
+    __m128 sum = _mm_setzero_ps();
+    for (; k + 4 <= size; k += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(y + k)));
+    }
+    result = horizontalSum(sum);
+#endif
+    for (; k < size; ++k) {
+        result += x[k] * y[k];
+    }
+    return result;
+}
+
+// восемь сумм произведений сразу: x0 и x1 с каждым из y[0..3],
+// каждая загруженная четверка доходностей используется 2 или 4 раза
+static inline void dotProducts2x4(
+    const float *x0,
+    const float *x1,
+    const float *const *y,
+    uint64_t size,
+    float *result
+)
+{
+    uint64_t k = 0;
+    for (int n = 0; n < 8; ++n) {
+        result[n] = 0;
+    }
+#ifdef CORRELATION_SSE2
+    __m128 sums[8];
+    for (int n = 0; n < 8; ++n) {
+        sums[n] = _mm_setzero_ps();
+    }
+    for (; k + 4 <= size; k += 4) {
+        __m128 a0 = _mm_loadu_ps(x0 + k);
+        __m128 a1 = _mm_loadu_ps(x1 + k);
+        __m128 b = _mm_loadu_ps(y[0] + k);
+        sums[0] = _mm_add_ps(sums[0], _mm_mul_ps(a0, b));
+        sums[4] = _mm_add_ps(sums[4], _mm_mul_ps(a1, b));
+        b = _mm_loadu_ps(y[1] + k);
+        sums[1] = _mm_add_ps(sums[1], _mm_mul_ps(a0, b));
+        sums[5] = _mm_add_ps(sums[5], _mm_mul_ps(a1, b));
+        b = _mm_loadu_ps(y[2] + k);
+        sums[2] = _mm_add_ps(sums[2], _mm_mul_ps(a0, b));
+        sums[6] = _mm_add_ps(sums[6], _mm_mul_ps(a1, b));
+        b = _mm_loadu_ps(y[3] + k);
+        sums[3] = _mm_add_ps(sums[3], _mm_mul_ps(a0, b));
+        sums[7] = _mm_add_ps(sums[7], _mm_mul_ps(a1, b));
+    }
+    for (int n = 0; n < 8; ++n) {
+        result[n] = horizontalSum(sums[n]);
+    }
+#endif
+    for (; k < size; ++k) {
+        for (int n = 0; n < 4; ++n) {
+            result[n] += x0[k] * y[n][k];
+            result[4 + n] += x1[k] * y[n][k];
+        }
+    }
+}
+
+// накопление сумм по парам блоков рядов, пары блоков считаются
+// параллельно, каждая пара блоков пишет только свои суммы
+struct CorrelationBuild {
+    std::vector<const float *> rows;
+    uint64_t size;
+    double sign;
+    size_t instrumentCount;
+    size_t blockSize;
+    std::vector<std::pair<size_t, size_t> > blocks;
+    double *sums;
+    double *crossSums;
+
+    void processBlock(size_t blockI, size_t blockJ)
+    {
+        size_t n = instrumentCount;
+        size_t i0 = blockI * blockSize;
+        size_t i1 = qMin(i0 + blockSize, n);
+        size_t j0 = blockJ * blockSize;
+        size_t j1 = qMin(j0 + blockSize, n);
+        float partial[8];
+        for (uint64_t t = 0; t < size; t += TimeChunkSize) {
+            uint64_t length = qMin(TimeChunkSize, size - t);
+            for (size_t i = i0; i < i1; i += 2) {
+                for (size_t j = j0; j < j1; j += 4) {
+                    // нужна только верхняя половина матрицы: j >= i
+                    if (j + 4 <= i) {
+                        continue;
+                    }
+                    if (i + 2 <= i1 && j + 4 <= j1) {
+                        const float *y[4] = {
+                            rows[j] + t, rows[j + 1] + t, rows[j + 2] + t, rows[j + 3] + t
+                        };
+                        dotProducts2x4(rows[i] + t, rows[i + 1] + t, y, length, partial);
+                        for (int a = 0; a < 2; ++a) {
+                            for (int b = 0; b < 4; ++b) {
+                                crossSums[(i + a) * n + j + b] += sign * partial[4 * a + b];
+                            }
+                        }
+                        continue;
+                    }
+                    for (size_t a = i; a < qMin(i + 2, i1); ++a) {
+                        for (size_t b = j; b < qMin(j + 4, j1); ++b) {
+                            crossSums[a * n + b] +=
+                                sign * dotProduct(rows[a] + t, rows[b] + t, length);
+                        }
+                    }
+                }
+            }
+            if (blockI == blockJ) {
+                for (size_t i = i0; i < i1; ++i) {
+                    sums[i] += sign * sumValues(rows[i] + t, length);
+                }
+            }
+        }
+    }
+};
+
+CorrelationMatrix::CorrelationMatrix()
+{
+    mWindow = 0;
+    clear();
+}
+
+int CorrelationMatrix::window() const
+{
+    return mWindow;
+}
+
+// вышедшие из окна доходности не хранятся, поэтому при смене окна
+// все считается заново при следующем обновлении
+void CorrelationMatrix::setWindow(int newValue)
+{
+    if (newValue < 0) {
+        throw std::logic_error("Correlation window can't be negative");
+    }
+    if (newValue != mWindow) {
+        mWindow = newValue;
+        clear();
+    }
+}
+
+void CorrelationMatrix::clear()
+{
+    mSeries.clear();
+    mCursors.clear();
+    mLastCloses.clear();
+    mHasLastBar = false;
+    mReturns.clear();
+    mReturnsOffset = 0;
+    mAlignedCount = 0;
+    mWindowBegin = 0;
+    mSums.clear();
+    mCrossSums.clear();
+    mIsSumsValid = false;
+    mIncrementalCount = 0;
+}
+
+size_t CorrelationMatrix::instrumentCount() const
+{
+    return mSeries.size();
+}
+
+uint64_t CorrelationMatrix::alignedCount() const
+{
+    return mAlignedCount;
+}
+
+uint64_t CorrelationMatrix::windowSize() const
+{
+    return mAlignedCount - mWindowBegin;
+}
+
+void CorrelationMatrix::update(const std::vector<const DataSeries *> &series)
+{
+    if (series != mSeries) {
+        clear();
+        mSeries = series;
+        mCursors.assign(series.size(), 0);
+        mLastCloses.assign(series.size(), 0);
+        mReturns.resize(series.size());
+    }
+    uint64_t oldAlignedCount = mAlignedCount;
+    uint64_t oldWindowBegin = mWindowBegin;
+    align();
+    if (mWindow > 0 && mAlignedCount > (uint64_t)mWindow) {
+        mWindowBegin = mAlignedCount - mWindow;
+    }
+    uint64_t added = mAlignedCount - oldAlignedCount;
+    uint64_t removed = mWindowBegin - oldWindowBegin;
+    size_t n = mSeries.size();
+    if (
+        !mIsSumsValid ||
+        added + removed >= windowSize() ||
+        mIncrementalCount + added + removed > 16 * windowSize()
+    ) {
+        // полный пересчет по окну, когда он не дороже обновления
+        mSums.assign(n, 0);
+        mCrossSums.assign(n * n, 0);
+        accumulate(mWindowBegin, mAlignedCount, 1);
+        mIsSumsValid = true;
+        mIncrementalCount = 0;
+    } else {
+        accumulate(oldAlignedCount, mAlignedCount, 1);
+        accumulate(oldWindowBegin, mWindowBegin, -1);
+        mIncrementalCount += added + removed;
+    }
+    trim();
+}
+
+// выравнивание: времена баров, которые есть во всех рядах, - пересечение
+// времен свечей после курсоров, ряды идут по возрастанию времени и
+// просматриваются подряд по одному, свечи после последнего общего бара
+// остаются до следующего обновления, их пара может еще прийти
+void CorrelationMatrix::align()
+{
+    size_t n = mSeries.size();
+    if (n == 0) {
+        return;
+    }
+    std::vector<uint64_t> keys;
+    const DataSeries *first = mSeries[0];
+    keys.reserve(first->size() - mCursors[0]);
+    for (uint64_t k = mCursors[0]; k < first->size(); ++k) {
+        keys.push_back(candleTimeKey(first->at(k)));
+    }
+    for (size_t s = 1; s < n && !keys.empty(); ++s) {
+        const DataSeries *series = mSeries[s];
+        size_t count = 0;
+        uint64_t k = mCursors[s];
+        for (size_t i = 0; i < keys.size() && k < series->size();) {
+            uint64_t key = candleTimeKey(series->at(k));
+            if (key < keys[i]) {
+                ++k;
+            } else if (key > keys[i]) {
+                ++i;
+            } else {
+                keys[count++] = keys[i++];
+                ++k;
+            }
+        }
+        keys.resize(count);
+    }
+    if (keys.empty()) {
+        return;
+    }
+    // доходности по закрытиям общих баров
+    for (size_t s = 0; s < n; ++s) {
+        const DataSeries *series = mSeries[s];
+        std::vector<float> &returns = mReturns[s];
+        returns.reserve(returns.size() + keys.size());
+        uint64_t k = mCursors[s];
+        float lastClose = mLastCloses[s];
+        bool hasLastBar = mHasLastBar;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            while (candleTimeKey(series->at(k)) != keys[i]) {
+                ++k;
+            }
+            float close = series->at(k).close;
+            if (hasLastBar) {
+                float logReturn = 0;
+                if (close > 0 && lastClose > 0) {
+                    logReturn = log((double)close / lastClose);
+                }
+                returns.push_back(logReturn);
+            }
+            lastClose = close;
+            hasLastBar = true;
+            ++k;
+        }
+        mCursors[s] = k;
+        mLastCloses[s] = lastClose;
+    }
+    mAlignedCount += mHasLastBar ? keys.size() : keys.size() - 1;
+    mHasLastBar = true;
+}
+
+void CorrelationMatrix::accumulate(uint64_t first, uint64_t last, double sign)
+{
+    size_t n = mSeries.size();
+    if (first >= last || n == 0) {
+        return;
+    }
+    CorrelationBuild build;
+    build.rows.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        build.rows[i] = mReturns[i].data() + (first - mReturnsOffset);
+    }
+    build.size = last - first;
+    build.sign = sign;
+    build.instrumentCount = n;
+    build.blockSize = BlockSize;
+    size_t blockCount = (n + BlockSize - 1) / BlockSize;
+    for (size_t blockI = 0; blockI < blockCount; ++blockI) {
+        for (size_t blockJ = blockI; blockJ < blockCount; ++blockJ) {
+            build.blocks.push_back(std::make_pair(blockI, blockJ));
+        }
+    }
+    build.sums = mSums.data();
+    build.crossSums = mCrossSums.data();
+    auto processBlock = [&build](int block) {
+        build.processBlock(build.blocks[block].first, build.blocks[block].second);
+    };
+    // небольшие обновления считаются в вызывающем потоке
+    if ((uint64_t)n * n / 2 * build.size >= ParallelMinWork) {
+        parallelFor(build.blocks.size(), processBlock);
+    } else {
+        for (size_t block = 0; block < build.blocks.size(); ++block) {
+            processBlock(block);
+        }
+    }
+}
+
+// доходности, вышедшие из окна, сдвигаются, когда их накопилось не меньше,
+// чем доходностей в окне, так что каждая сдвигается в среднем не больше раза
+void CorrelationMatrix::trim()
+{
+    uint64_t unused = mWindowBegin - mReturnsOffset;
+    if (unused == 0 || unused < windowSize()) {
+        return;
+    }
+    for (size_t s = 0; s < mReturns.size(); ++s) {
+        mReturns[s].erase(mReturns[s].begin(), mReturns[s].begin() + unused);
+    }
+    mReturnsOffset = mWindowBegin;
+}
+
+double CorrelationMatrix::covariance(size_t i, size_t j) const
+{
+    uint64_t size = windowSize();
+    if (!mIsSumsValid || size < 2) {
+        return 0;
+    }
+    if (i > j) {
+        std::swap(i, j);
+    }
+    size_t n = mSeries.size();
+    return (mCrossSums[i * n + j] - mSums[i] * mSums[j] / size) / (size - 1);
+}
+
+double CorrelationMatrix::correlation(size_t i, size_t j) const
+{
+    double varianceI = covariance(i, i);
+    double varianceJ = covariance(j, j);
+    if (varianceI <= 0 || varianceJ <= 0) {
+        return 0;
+    }
+    return qBound(-1.0, covariance(i, j) / sqrt(varianceI * varianceJ), 1.0);
+}
+
+bool CorrelationReport::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--correlation");
+}
+
+int CorrelationReport::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist correlation of log returns between data files");
+    parser.addHelpOption();
+    QCommandLineOption correlationOption(
+        "correlation",
+        "Write the correlation matrix of the given CSV files as CSV."
+    );
+    QCommandLineOption windowOption(
+        QStringList() << "w" << "window",
+        "Rolling window in aligned bars, 0 for the whole history.",
+        "bars",
+        "0"
+    );
+    QCommandLineOption outputOption(
+        QStringList() << "o" << "output",
+        "Output CSV file (stdout by default).",
+        "file"
+    );
+    parser.addOption(correlationOption);
+    parser.addOption(windowOption);
+    parser.addOption(outputOption);
+    parser.addPositionalArgument("files", "CSV files of the instruments.", "files...");
+    parser.process(arguments);
+
+    bool isWindowValid = false;
+    int window = parser.value(windowOption).toInt(&isWindowValid);
+    if (!isWindowValid || window < 0) {
+        printMessage("Invalid window: " + parser.value(windowOption));
+        return 1;
+    }
+    QStringList files = parser.positionalArguments();
+    if (files.size() < 2) {
+        printMessage("At least two files are expected");
+        return 1;
+    }
+
+    // файлы читаются параллельно
+    std::vector<DataSeries> dataSeries(files.size());
+    std::vector<QString> errors(files.size());
+    QElapsedTimer timer;
+    timer.start();
+    parallelFor(files.size(), [&](int i) {
+        try {
+            Reader::readFromFile(files.at(i), &dataSeries[i]);
+        } catch (const std::exception &e) {
+            errors[i] = QString::fromLocal8Bit(e.what());
+        }
+    });
+    for (int i = 0; i < files.size(); ++i) {
+        if (!errors[i].isEmpty()) {
+            printMessage(files.at(i) + ": " + errors[i]);
+            return 2;
+        }
+    }
+    double readSeconds = timer.nsecsElapsed() / 1e9;
+
+    timer.restart();
+    std::vector<const DataSeries *> series;
+    for (size_t i = 0; i < dataSeries.size(); ++i) {
+        series.push_back(&dataSeries[i]);
+    }
+    CorrelationMatrix matrix;
+    matrix.setWindow(window);
+    matrix.update(series);
+    printMessage(
+        QString("%1 instruments, %2 aligned returns, %3 in window: read in %4 s, computed in %5 s")
+            .arg(matrix.instrumentCount())
+            .arg(matrix.alignedCount())
+            .arg(matrix.windowSize())
+            .arg(readSeconds, 0, 'f', 3)
+            .arg(timer.nsecsElapsed() / 1e9, 0, 'f', 3)
+    );
+
+    QFile outputFile;
+    QTextStream output(stdout);
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            printMessage("Can't write " + parser.value(outputOption));
+            return 2;
+        }
+        output.setDevice(&outputFile);
+    }
+    QStringList names;
+    for (const QString &fileName : files) {
+        names << QFileInfo(fileName).completeBaseName();
+    }
+    output << "instrument," << names.join(",") << "\n";
+    for (size_t i = 0; i < matrix.instrumentCount(); ++i) {
+        output << names.at(i);
+        for (size_t j = 0; j < matrix.instrumentCount(); ++j) {
+            output << "," << QString::number(matrix.correlation(i, j), 'f', 4);
+        }
+        output << "\n";
+    }
+    return 0;
+}
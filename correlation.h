@@ -0,0 +1,78 @@
+#ifndef CORRELATION_H
+#define CORRELATION_H
+
+#include "core.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+// скользящие ковариации и корреляции логарифмических доходностей нескольких
+// рядов: ряды выравниваются по времени (берутся только бары, которые есть
+// во всех рядах), суммы доходностей и их попарных произведений по окну
+// считаются блоками на всех ядрах и при появлении новых баров обновляются
+// добавлением вошедших в окно и вычитанием вышедших из него баров
+class CorrelationMatrix
+{
+public:
+    CorrelationMatrix();
+    // размер окна в барах, 0 - вся история
+    int window() const;
+    void setWindow(int newValue);
+    // дописать бары, добавленные в ряды с прошлого вызова, и обновить
+    // суммы по окну, для другого набора рядов все считается заново,
+    // ряды должны жить до следующего вызова
+    void update(const std::vector<const DataSeries *> &series);
+    void clear();
+    size_t instrumentCount() const;
+    // кол-во выровненных доходностей всего и в окне
+    uint64_t alignedCount() const;
+    uint64_t windowSize() const;
+    double covariance(size_t i, size_t j) const;
+    double correlation(size_t i, size_t j) const;
+private:
+    // кол-во рядов в блоке матрицы, блоки считаются параллельно
+    static const size_t BlockSize = 16;
+    // наименьшее кол-во умножений, которое стоит делить между потоками
+    static const uint64_t ParallelMinWork = 1 << 22;
+
+    void align();
+    // добавление (sign = 1) или вычитание (sign = -1) доходностей [first, last)
+    void accumulate(uint64_t first, uint64_t last, double sign);
+    // отбрасываем доходности, вышедшие из окна
+    void trim();
+
+    int mWindow;
+    std::vector<const DataSeries *> mSeries;
+    // индекс следующей невыровненной свечи ряда
+    std::vector<uint64_t> mCursors;
+    // закрытие последнего выровненного бара ряда
+    std::vector<float> mLastCloses;
+    bool mHasLastBar;
+    // доходности рядов, mReturns[i][0] - доходность номер mReturnsOffset
+    std::vector<std::vector<float> > mReturns;
+    uint64_t mReturnsOffset;
+    uint64_t mAlignedCount;
+    // окно: доходности [mWindowBegin, mAlignedCount)
+    uint64_t mWindowBegin;
+    // сумма доходностей ряда и сумма произведений пары рядов по окну
+    std::vector<double> mSums;
+    std::vector<double> mCrossSums;
+    bool mIsSumsValid;
+    // кол-во доходностей, добавленных и вычтенных с последнего полного
+    // пересчета: погрешность вычитаний копится, поэтому пересчет повторяется
+    uint64_t mIncrementalCount;
+};
+
+// таблица корреляций по файлам из командной строки в CSV
+class CorrelationReport
+{
+public:
+    // запрошен ли расчет корреляций в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // расчет по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+};
+
+#endif // CORRELATION_H
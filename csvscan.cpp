@@ -0,0 +1,54 @@
+#include "csvscan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSVSCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+const double csvDecimalPowers[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const uint64_t csvIntegerPowers[9] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+// поиск разделителей delimiter и переводов строк в [data, data + size):
+// по 64 байта сравниваются сразу, совпадения собираются в битовую маску,
+// по которой выписываются смещения, остаток проверяется побайтно
+size_t scanCsvStructure(
+    const char *data,
+    size_t size,
+    char delimiter,
+    uint32_t *positions
+)
+{
+    size_t count = 0;
+    size_t i = 0;
+#ifdef CSVSCAN_SSE2
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i newlines = _mm_set1_epi8('\n');
+    for (; i + 64 <= size; i += 64) {
+        uint64_t mask = 0;
+        for (int j = 0; j < 4; ++j) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i + 16 * j));
+            __m128i hits = _mm_or_si128(
+                _mm_cmpeq_epi8(chunk, delimiters),
+                _mm_cmpeq_epi8(chunk, newlines)
+            );
+            mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(hits) << (16 * j);
+        }
+        while (mask != 0) {
+            positions[count++] = (uint32_t)(i + csvCountTrailingZeros(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == delimiter || data[i] == '\n') {
+            positions[count++] = (uint32_t)i;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,164 @@
+#ifndef CSVSCAN_H
+#define CSVSCAN_H
+
+#include <QByteArray>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// поиск разделителей delimiter и переводов строк в [data, data + size),
+// их смещения записываются в positions (места не меньше size),
+// возвращается количество найденных позиций
+size_t scanCsvStructure(
+    const char *data,
+    size_t size,
+    char delimiter,
+    uint32_t *positions
+);
+
+inline int csvCountTrailingZeros(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+#ifdef _M_X64
+    _BitScanForward64(&index, value);
+#else
+    if (!_BitScanForward(&index, (unsigned long)value)) {
+        _BitScanForward(&index, (unsigned long)(value >> 32));
+        index += 32;
+    }
+#endif
+    return index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// сколько байт после разбираемых строк должно быть доступно для чтения:
+// цифры разбираются словами по 8 байт
+static const int csvScanPadding = 16;
+
+// степени десяти, точно представимые в double
+extern const double csvDecimalPowers[23];
+// степени десяти для частей числа до 8 цифр
+extern const uint64_t csvIntegerPowers[9];
+
+// разбор от 1 до 8 цифр [begin, begin + size) за несколько умножений,
+// после begin должно быть доступно 8 байт
+inline bool parseCsvEightDigits(const char *begin, int size, uint64_t *value)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    uint64_t word;
+    memcpy(&word, begin, 8);
+    // лишние байты отбрасываем, недостающие старшие разряды - нули
+    word <<= 8 * (8 - size);
+    if (size < 8) {
+        word |= 0x3030303030303030ull >> (8 * size);
+    }
+    if ((
+        (word & 0xF0F0F0F0F0F0F0F0ull) |
+        (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)
+    ) != 0x3333333333333333ull) {
+        return false;
+    }
+    // попарно складываем соседние разряды: 1, 2, затем 4 цифры
+    word = (word & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    word = (word & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    *value = (uint32_t)((word & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+    return true;
+#else
+    uint64_t result = 0;
+    for (int i = 0; i < size; ++i) {
+        unsigned digit = (unsigned char)begin[i] - '0';
+        if (digit >= 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *value = result;
+    return true;
+#endif
+}
+
+// первая точка в [begin, end) или nullptr, точка ищется словами по 8 байт,
+// после end должно быть доступно 8 байт
+inline const char *findCsvDot(const char *begin, const char *end)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    int size = end - begin;
+    for (int offset = 0; offset < size; offset += 8) {
+        uint64_t word;
+        memcpy(&word, begin + offset, 8);
+        // нулевые байты на месте точек, младший найденный - точно первый
+        word ^= 0x2E2E2E2E2E2E2E2Eull;
+        uint64_t zeros = (word - 0x0101010101010101ull) & ~word &
+            0x8080808080808080ull;
+        if (zeros != 0) {
+            int index = offset + csvCountTrailingZeros(zeros) / 8;
+            return index < size ? begin + index : nullptr;
+        }
+    }
+    return nullptr;
+#else
+    return (const char *)memchr(begin, '.', end - begin);
+#endif
+}
+
+// разбор числа [begin, end) в float: для чисел вида [-]ddd[.ddd], у которых
+// мантисса и степень десяти точно представимы в double, частное округляется
+// один раз и затем переводится во float, как и в QByteArray::toFloat,
+// поэтому результат совпадает с ним до бита, остальные записи разбираются
+// через QByteArray::toFloat, после end должно быть доступно csvScanPadding байт
+inline bool parseCsvFloat(const char *begin, const char *end, float *value)
+{
+    const char *pos = begin;
+    bool isNegative = pos < end && *pos == '-';
+    if (isNegative) {
+        ++pos;
+    }
+    const char *dot = findCsvDot(pos, end);
+    int intDigits = (dot != nullptr ? dot : end) - pos;
+    int fraction = dot != nullptr ? end - dot - 1 : 0;
+    uint64_t mantissa = 0;
+    bool isParsed = false;
+    if (intDigits > 0 && (dot == nullptr || fraction > 0)) {
+        uint64_t intValue;
+        uint64_t fractionValue = 0;
+        if (
+            intDigits <= 8 &&
+            fraction <= 8 &&
+            parseCsvEightDigits(pos, intDigits, &intValue) &&
+            (fraction == 0 || parseCsvEightDigits(dot + 1, fraction, &fractionValue))
+        ) {
+            // обе части словами по 8 байт
+            mantissa = intValue * csvIntegerPowers[fraction] + fractionValue;
+            isParsed = true;
+        } else if (intDigits + fraction <= 19 && fraction <= 22) {
+            // длинные числа по одной цифре
+            isParsed = true;
+            for (const char *digit = pos; digit < end && isParsed; ++digit) {
+                if (digit == dot) {
+                    continue;
+                }
+                unsigned d = (unsigned char)*digit - '0';
+                isParsed = d < 10;
+                mantissa = mantissa * 10 + d;
+            }
+        }
+    }
+    if (isParsed && mantissa <= ((uint64_t)1 << 53)) {
+        double result = (double)mantissa / csvDecimalPowers[fraction];
+        *value = (float)(isNegative ? -result : result);
+        return true;
+    }
+    bool ok;
+    *value = QByteArray::fromRawData(begin, end - begin).toFloat(&ok);
+    return ok;
+}
+
+#endif // CSVSCAN_H
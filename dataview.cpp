@@ -0,0 +1,300 @@
+#include "dataview.h"
+
+#include <algorithm>
+#include <limits>
+
+DataView::DataView()
+{
+    mDataSeries = nullptr;
+    mBegin = 0;
+    mEnd = 0;
+    mIsToSeriesEnd = false;
+}
+
+DataView::DataView(const DataSeries *dataSeries)
+{
+    mDataSeries = dataSeries;
+    mBegin = 0;
+    mEnd = 0;
+    mIsToSeriesEnd = true;
+}
+
+DataView::DataView(const DataSeries *dataSeries, uint64_t begin, uint64_t end)
+{
+    mDataSeries = dataSeries;
+    mBegin = begin;
+    mEnd = qMax(begin, end);
+    mIsToSeriesEnd = false;
+}
+
+const DataSeries *DataView::dataSeries() const
+{
+    return mDataSeries;
+}
+
+uint64_t DataView::begin() const
+{
+    return mBegin;
+}
+
+uint64_t DataView::end() const
+{
+    return mBegin + size();
+}
+
+bool DataView::isEmpty() const
+{
+    return size() == 0;
+}
+
+float DataView::open(uint64_t index) const
+{
+    return at(index).open;
+}
+
+float DataView::high(uint64_t index) const
+{
+    return at(index).high;
+}
+
+float DataView::low(uint64_t index) const
+{
+    return at(index).low;
+}
+
+float DataView::close(uint64_t index) const
+{
+    return at(index).close;
+}
+
+float DataView::volume(uint64_t index) const
+{
+    return at(index).volume;
+}
+
+uint64_t DataView::timeKey(uint64_t index) const
+{
+    return candleTimeKey(at(index));
+}
+
+DataView DataView::slice(uint64_t first, uint64_t last) const
+{
+    uint64_t viewSize = size();
+    first = qMin(first, viewSize);
+    last = qMin(last, viewSize);
+    return DataView(mDataSeries, mBegin + first, mBegin + qMax(first, last));
+}
+
+DataView DataView::withSeries(const DataSeries *dataSeries) const
+{
+    DataView view = *this;
+    view.mDataSeries = dataSeries;
+    return view;
+}
+
+uint64_t DataView::lowerBound(uint64_t key) const
+{
+    uint64_t first = 0;
+    uint64_t count = size();
+    while (count > 0) {
+        uint64_t half = count / 2;
+        if (timeKey(first + half) < key) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+DataView DataView::timeSlice(uint64_t fromKey, uint64_t toKey) const
+{
+    return slice(lowerBound(fromKey), lowerBound(toKey));
+}
+
+const Candle *DataView::contiguous(uint64_t index, uint64_t *count) const
+{
+    uint64_t seriesIndex = mBegin + index;
+    uint64_t chunk = seriesIndex / DataSeries::ChunkSize;
+    uint64_t offset = seriesIndex % DataSeries::ChunkSize;
+    *count = qMin(mDataSeries->chunkSize(chunk) - offset, size() - index);
+    return mDataSeries->chunkData(chunk) + offset;
+}
+
+float DataView::globalHigh() const
+{
+    if (mIsToSeriesEnd && mBegin == 0) {
+        return mDataSeries->globalHigh();
+    }
+    return isEmpty() ? std::numeric_limits<float>::lowest() : range(0, size()).high;
+}
+
+float DataView::globalLow() const
+{
+    if (mIsToSeriesEnd && mBegin == 0) {
+        return mDataSeries->globalLow();
+    }
+    return isEmpty() ? std::numeric_limits<float>::max() : range(0, size()).low;
+}
+
+CandleRange DataView::range(uint64_t first, uint64_t last) const
+{
+    return mDataSeries->range(mBegin + first, mBegin + last);
+}
+
+CandleStats DataView::stats(uint64_t first, uint64_t last) const
+{
+    return mDataSeries->stats(mBegin + first, mBegin + last);
+}
+
+CandleSelection::CandleSelection()
+{
+    mSize = 0;
+}
+
+void CandleSelection::reset(uint64_t size)
+{
+    mSize = size;
+    mWords.assign((size + 63) / 64, 0);
+    mRanks.assign(mWords.size() + 1, 0);
+}
+
+void CandleSelection::setSelected(uint64_t index, bool isSelected)
+{
+    uint64_t bit = 1ULL << (index % 64);
+    if (isSelected) {
+        mWords[index / 64] |= bit;
+    } else {
+        mWords[index / 64] &= ~bit;
+    }
+}
+
+void CandleSelection::updateRanks()
+{
+    mRanks.resize(mWords.size() + 1);
+    mRanks[0] = 0;
+    for (size_t i = 0; i < mWords.size(); ++i) {
+        mRanks[i + 1] = mRanks[i] + qPopulationCount(mWords[i]);
+    }
+}
+
+uint64_t CandleSelection::size() const
+{
+    return mSize;
+}
+
+bool CandleSelection::isSelected(uint64_t index) const
+{
+    return (word(index / 64) >> (index % 64)) & 1;
+}
+
+uint64_t CandleSelection::rank(uint64_t index) const
+{
+    if (index >= mSize) {
+        return mRanks.back();
+    }
+    uint64_t mask = (1ULL << (index % 64)) - 1;
+    return mRanks[index / 64] + qPopulationCount(mWords[index / 64] & mask);
+}
+
+uint64_t CandleSelection::select(uint64_t number) const
+{
+    // последнее слово, до которого выбрано не больше number свечей
+    size_t word = std::upper_bound(mRanks.begin(), mRanks.end(), number) -
+        mRanks.begin() - 1;
+    uint64_t bits = mWords[word];
+    for (uint64_t skip = number - mRanks[word]; skip > 0; --skip) {
+        bits &= bits - 1;
+    }
+    return word * 64 + qCountTrailingZeroBits(bits);
+}
+
+uint64_t CandleSelection::word(uint64_t word) const
+{
+    return word < mWords.size() ? mWords[word] : 0;
+}
+
+CandleSelection CandleSelection::session(
+    const DataSeries &dataSeries,
+    uint64_t fromTime,
+    uint64_t toTime
+)
+{
+    CandleSelection selection;
+    selection.reset(dataSeries.size());
+    // слово собирается из сравнений без ветвлений
+    for (uint64_t word = 0; word < selection.mWords.size(); ++word) {
+        uint64_t first = word * 64;
+        uint64_t count = qMin<uint64_t>(64, dataSeries.size() - first);
+        uint64_t bits = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t time = dataSeries.at(first + i).time;
+            bits |= (uint64_t)((time >= fromTime) & (time < toTime)) << i;
+        }
+        selection.mWords[word] = bits;
+    }
+    selection.updateRanks();
+    return selection;
+}
+
+FilteredView::FilteredView(const DataView &view, const CandleSelection *selection)
+    : mView(view), mSelection(selection)
+{
+    if (mSelection == nullptr) {
+        mRankOffset = 0;
+        mSize = mView.size();
+    } else {
+        mRankOffset = mSelection->rank(mView.begin());
+        mSize = mSelection->rank(mView.end()) - mRankOffset;
+    }
+}
+
+const DataView &FilteredView::view() const
+{
+    return mView;
+}
+
+uint64_t FilteredView::size() const
+{
+    return mSize;
+}
+
+const Candle &FilteredView::at(uint64_t index) const
+{
+    if (mSelection == nullptr) {
+        return mView.at(index);
+    }
+    return mView.dataSeries()->at(mSelection->select(mRankOffset + index));
+}
+
+CandleStats FilteredView::stats() const
+{
+    if (mSelection == nullptr) {
+        return mView.stats(0, mView.size());
+    }
+    // у выбранных свечей префиксных сумм нет, считаем проходом по ним
+    CandleStats stats;
+    stats.count = mSize;
+    stats.open = stats.close = stats.high = stats.low = 0;
+    stats.volume = stats.vwap = stats.averageRange = 0;
+    if (mSize == 0) {
+        return stats;
+    }
+    stats.open = at(0).open;
+    stats.close = at(mSize - 1).close;
+    stats.high = std::numeric_limits<float>::lowest();
+    stats.low = std::numeric_limits<float>::max();
+    double priceVolume = 0;
+    double range = 0;
+    forEach([&](const Candle &candle) {
+        stats.high = qMax(stats.high, candle.high);
+        stats.low = qMin(stats.low, candle.low);
+        stats.volume += candle.volume;
+        priceVolume += (candle.high + candle.low + candle.close) / 3.0 * candle.volume;
+        range += candle.high - candle.low;
+    });
+    stats.vwap = stats.volume > 0 ? priceVolume / stats.volume : 0;
+    stats.averageRange = range / mSize;
+    return stats;
+}
@@ -0,0 +1,177 @@
+#ifndef DATAVIEW_H
+#define DATAVIEW_H
+
+#include "core.h"
+
+#include <QtAlgorithms>
+
+#include <inttypes.h>
+#include <vector>
+
+// ключ времени свечи вида yyyymmddhhmmss, год из двух цифр считается 20xx,
+// ключи сравниваются так же, как время свечей
+inline uint64_t candleTimeKey(const Candle &candle)
+{
+    uint64_t date = candle.date < 1000000 ? candle.date + 20000000 : candle.date;
+    return date * 1000000 + candle.time;
+}
+
+// срез ряда без копирования свечей: свечи [begin, end) ряда с индексами
+// от начала среза, срез всего ряда растет вместе с рядом, ряд должен
+// жить дольше среза
+class DataView {
+public:
+    DataView();
+    // весь ряд, включая свечи, которые будут дописаны
+    explicit DataView(const DataSeries *dataSeries);
+    // свечи [begin, end) ряда
+    DataView(const DataSeries *dataSeries, uint64_t begin, uint64_t end);
+    const DataSeries *dataSeries() const;
+    // индексы начала и конца среза в ряду
+    uint64_t begin() const;
+    uint64_t end() const;
+    uint64_t size() const;
+    bool isEmpty() const;
+    const Candle &at(uint64_t index) const;
+    // свеча с индексом index от конца среза
+    const Candle &fromEnd(uint64_t index) const;
+    float open(uint64_t index) const;
+    float high(uint64_t index) const;
+    float low(uint64_t index) const;
+    float close(uint64_t index) const;
+    float volume(uint64_t index) const;
+    uint64_t timeKey(uint64_t index) const;
+    // свечи [first, last) среза
+    DataView slice(uint64_t first, uint64_t last) const;
+    // тот же срез другого ряда, например снимка этого ряда (DataSeries::share)
+    DataView withSeries(const DataSeries *dataSeries) const;
+    // свечи с ключами времени [fromKey, toKey), свечи ряда идут по времени
+    DataView timeSlice(uint64_t fromKey, uint64_t toKey) const;
+    // свечи, лежащие в памяти подряд с index: указатель на свечу index
+    // и их кол-во в count
+    const Candle *contiguous(uint64_t index, uint64_t *count) const;
+    // максимум и минимум всех свечей среза
+    float globalHigh() const;
+    float globalLow() const;
+    // как у ряда, по свечам [first, last) среза
+    CandleRange range(uint64_t first, uint64_t last) const;
+    CandleStats stats(uint64_t first, uint64_t last) const;
+private:
+    // индекс первой свечи среза с ключом времени не меньше key
+    uint64_t lowerBound(uint64_t key) const;
+
+    const DataSeries *mDataSeries;
+    uint64_t mBegin;
+    uint64_t mEnd;
+    bool mIsToSeriesEnd;
+};
+
+inline uint64_t DataView::size() const
+{
+    if (mDataSeries == nullptr) {
+        return 0;
+    }
+    return mIsToSeriesEnd ? mDataSeries->size() - mBegin : mEnd - mBegin;
+}
+
+inline const Candle &DataView::at(uint64_t index) const
+{
+    return mDataSeries->at(mBegin + index);
+}
+
+inline const Candle &DataView::fromEnd(uint64_t index) const
+{
+    return mDataSeries->at(mBegin + size() - 1 - index);
+}
+
+// выбор свечей ряда битами по индексам свечей в ряду, с кол-вом
+// выбранных свечей до каждого слова, поэтому кол-во выбранных в диапазоне
+// считается за O(1), а выбранная свеча по номеру находится за O(log n)
+class CandleSelection {
+public:
+    CandleSelection();
+    // size свечей, ни одна не выбрана
+    void reset(uint64_t size);
+    void setSelected(uint64_t index, bool isSelected);
+    // пересчитать кол-ва по словам после setSelected
+    void updateRanks();
+    uint64_t size() const;
+    bool isSelected(uint64_t index) const;
+    // кол-во выбранных свечей [0, index)
+    uint64_t rank(uint64_t index) const;
+    // индекс выбранной свечи номер number от начала
+    uint64_t select(uint64_t number) const;
+    // слово битов номер word, свеча i - бит i % 64 слова i / 64
+    uint64_t word(uint64_t word) const;
+
+    // свечи ряда со временем (hhmmss) в [fromTime, toTime),
+    // например основная торговая сессия
+    static CandleSelection session(
+        const DataSeries &dataSeries,
+        uint64_t fromTime,
+        uint64_t toTime
+    );
+private:
+    uint64_t mSize;
+    std::vector<uint64_t> mWords;
+    // кол-во выбранных свечей в словах до слова i
+    std::vector<uint64_t> mRanks;
+};
+
+// выбранные свечи среза: свечи не копируются, номер выбранной свечи
+// переводится в индекс ряда по кол-вам выбранных по словам
+class FilteredView {
+public:
+    // без выбора в срез попадают все свечи
+    FilteredView(const DataView &view, const CandleSelection *selection = nullptr);
+    const DataView &view() const;
+    uint64_t size() const;
+    const Candle &at(uint64_t index) const;
+    // вызвать function(const Candle &) для выбранных свечей по порядку,
+    // по словам битов выбора без поиска каждой свечи
+    template<typename Function>
+    void forEach(Function function) const;
+    CandleStats stats() const;
+private:
+    DataView mView;
+    const CandleSelection *mSelection;
+    // кол-во выбранных свечей до начала среза
+    uint64_t mRankOffset;
+    uint64_t mSize;
+};
+
+template<typename Function>
+void FilteredView::forEach(Function function) const
+{
+    uint64_t begin = mView.begin();
+    uint64_t end = begin + mView.size();
+    if (mSelection == nullptr) {
+        uint64_t index = 0;
+        while (index < mView.size()) {
+            uint64_t count;
+            const Candle *data = mView.contiguous(index, &count);
+            for (uint64_t i = 0; i < count; ++i) {
+                function(data[i]);
+            }
+            index += count;
+        }
+        return;
+    }
+    const DataSeries *dataSeries = mView.dataSeries();
+    for (uint64_t word = begin / 64; word * 64 < end; ++word) {
+        uint64_t bits = mSelection->word(word);
+        // биты вне среза отбрасываем
+        if (word * 64 < begin) {
+            bits &= ~0ULL << (begin % 64);
+        }
+        if (word * 64 + 64 > end) {
+            bits &= ~0ULL >> (word * 64 + 64 - end);
+        }
+        while (bits != 0) {
+            function(dataSeries->at(word * 64 + qCountTrailingZeroBits(bits)));
+            bits &= bits - 1;
+        }
+    }
+}
+
+#endif // DATAVIEW_H
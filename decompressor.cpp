@@ -0,0 +1,334 @@
+#include "decompressor.h"
+
+#include <QMutexLocker>
+
+#include <cstring>
+
+#ifdef CHARTIST_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CHARTIST_ZSTD
+#include <zstd.h>
+#endif
+
+// поток распаковки
+class Decompressor::Worker : public QThread
+{
+public:
+    Worker(Decompressor *decompressor)
+        : mDecompressor(decompressor)
+    {
+    }
+protected:
+    void run() override
+    {
+        mDecompressor->decompress();
+    }
+private:
+    Decompressor *mDecompressor;
+};
+
+Decompressor::Format Decompressor::detectFormat(QIODevice *source)
+{
+    QByteArray magic = source->peek(4);
+    if (magic.size() >= 2 && (uchar)magic[0] == 0x1f && (uchar)magic[1] == 0x8b) {
+        return Gzip;
+    }
+    if (
+        magic.size() == 4 &&
+        (uchar)magic[0] == 0x28 &&
+        (uchar)magic[1] == 0xb5 &&
+        (uchar)magic[2] == 0x2f &&
+        (uchar)magic[3] == 0xfd
+    ) {
+        return Zstd;
+    }
+    return NoCompression;
+}
+
+// поддержка форматов зависит от библиотек, найденных при сборке
+bool Decompressor::isSupported(Format format)
+{
+    switch (format) {
+    case NoCompression:
+        return true;
+    case Gzip:
+#ifdef CHARTIST_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case Zstd:
+#ifdef CHARTIST_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+Decompressor::Decompressor(QIODevice *source, Format format, QObject *parent)
+    : QIODevice(parent)
+{
+    mSource = source;
+    mFormat = format;
+    mWorker = new Worker(this);
+    mBlockSize = 1 << 20;
+    mQueueLimit = 4;
+    mIsFinished = false;
+    mIsAbort = false;
+    mBlockPos = 0;
+}
+
+Decompressor::~Decompressor()
+{
+    stop();
+    delete mWorker;
+}
+
+bool Decompressor::open(OpenMode mode)
+{
+    if ((mode & WriteOnly) || !isSupported(mFormat)) {
+        return false;
+    }
+    if (!QIODevice::open(mode)) {
+        return false;
+    }
+    mWorker->start();
+    return true;
+}
+
+void Decompressor::close()
+{
+    stop();
+    QIODevice::close();
+}
+
+bool Decompressor::isSequential() const
+{
+    return true;
+}
+
+// конец данных известен, только когда распаковка закончена и очередь пуста
+bool Decompressor::atEnd() const
+{
+    if (!QIODevice::atEnd() || mBlockPos < mBlock.size()) {
+        return false;
+    }
+    QMutexLocker locker(&mMutex);
+    return mIsFinished && mQueue.isEmpty();
+}
+
+qint64 Decompressor::bytesAvailable() const
+{
+    return QIODevice::bytesAvailable() + mBlock.size() - mBlockPos;
+}
+
+// чтение ждет распакованный блок, 0 - данные закончились
+qint64 Decompressor::readData(char *data, qint64 maxSize)
+{
+    qint64 readSize = 0;
+    while (readSize < maxSize) {
+        if (mBlockPos == mBlock.size()) {
+            if (readSize > 0) {
+                // отдаем то, что есть, не дожидаясь следующего блока
+                QMutexLocker locker(&mMutex);
+                if (mQueue.isEmpty()) {
+                    break;
+                }
+            }
+            QMutexLocker locker(&mMutex);
+            while (mQueue.isEmpty() && !mIsFinished) {
+                mNotEmpty.wait(&mMutex);
+            }
+            if (mQueue.isEmpty()) {
+                if (!mError.isEmpty()) {
+                    setErrorString(mError);
+                    return readSize > 0 ? readSize : -1;
+                }
+                break;
+            }
+            mBlock = mQueue.dequeue();
+            mBlockPos = 0;
+            mNotFull.wakeOne();
+        }
+        int size = qMin<qint64>(maxSize - readSize, mBlock.size() - mBlockPos);
+        memcpy(data + readSize, mBlock.constData() + mBlockPos, size);
+        mBlockPos += size;
+        readSize += size;
+    }
+    return readSize;
+}
+
+qint64 Decompressor::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+// остановка потока распаковки, если он еще работает
+void Decompressor::stop()
+{
+    mMutex.lock();
+    mIsAbort = true;
+    mNotFull.wakeOne();
+    mMutex.unlock();
+    mWorker->wait();
+}
+
+// очередь ограничена, поэтому распаковка ждет, пока разбор не заберет блоки
+bool Decompressor::pushBlock(const QByteArray &block)
+{
+    QMutexLocker locker(&mMutex);
+    while (mQueue.size() >= mQueueLimit && !mIsAbort) {
+        mNotFull.wait(&mMutex);
+    }
+    if (mIsAbort) {
+        return false;
+    }
+    mQueue.enqueue(block);
+    mNotEmpty.wakeOne();
+    return true;
+}
+
+void Decompressor::finish(const QString &error)
+{
+    QMutexLocker locker(&mMutex);
+    mIsFinished = true;
+    mError = error;
+    mNotEmpty.wakeOne();
+}
+
+void Decompressor::decompress()
+{
+    if (mFormat == Gzip) {
+        decompressGzip();
+    } else if (mFormat == Zstd) {
+        decompressZstd();
+    } else {
+        finish(QStringLiteral("Unsupported compression format"));
+    }
+}
+
+void Decompressor::decompressGzip()
+{
+#ifdef CHARTIST_ZLIB
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 15 + 32: окно 32 КБ, заголовок gzip или zlib определяется сам
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        finish(QStringLiteral("Can't initialize gzip decompression"));
+        return;
+    }
+    QByteArray input(mBlockSize, Qt::Uninitialized);
+    QByteArray output(mBlockSize, Qt::Uninitialized);
+    QString error;
+    int outputSize = 0;
+    bool isStreamEnd = false;
+    for (;;) {
+        if (stream.avail_in == 0) {
+            qint64 readSize = mSource->read(input.data(), input.size());
+            if (readSize < 0) {
+                error = mSource->errorString();
+                break;
+            }
+            if (readSize == 0) {
+                if (!isStreamEnd) {
+                    error = QStringLiteral("Unexpected end of gzip data");
+                }
+                break;
+            }
+            stream.next_in = (Bytef *)input.data();
+            stream.avail_in = readSize;
+        }
+        stream.next_out = (Bytef *)output.data() + outputSize;
+        stream.avail_out = output.size() - outputSize;
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            error = QString::fromLatin1(stream.msg != nullptr ? stream.msg : "Corrupted gzip data");
+            break;
+        }
+        outputSize = output.size() - stream.avail_out;
+        isStreamEnd = result == Z_STREAM_END;
+        if (isStreamEnd) {
+            // файл может состоять из нескольких склеенных архивов
+            inflateReset(&stream);
+        }
+        if (outputSize == output.size()) {
+            if (!pushBlock(output)) {
+                break;
+            }
+            output = QByteArray(mBlockSize, Qt::Uninitialized);
+            outputSize = 0;
+        }
+    }
+    inflateEnd(&stream);
+    if (error.isEmpty() && outputSize > 0) {
+        output.resize(outputSize);
+        pushBlock(output);
+    }
+    finish(error);
+#else
+    finish(QStringLiteral("gzip is not supported in this build"));
+#endif
+}
+
+void Decompressor::decompressZstd()
+{
+#ifdef CHARTIST_ZSTD
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream))) {
+        ZSTD_freeDStream(stream);
+        finish(QStringLiteral("Can't initialize zstd decompression"));
+        return;
+    }
+    QByteArray input(mBlockSize, Qt::Uninitialized);
+    QByteArray output(mBlockSize, Qt::Uninitialized);
+    QString error;
+    ZSTD_inBuffer in = {input.constData(), 0, 0};
+    ZSTD_outBuffer out = {output.data(), (size_t)output.size(), 0};
+    // 0 - кадр закончен
+    size_t hint = 1;
+    for (;;) {
+        if (in.pos == in.size) {
+            qint64 readSize = mSource->read(input.data(), input.size());
+            if (readSize < 0) {
+                error = mSource->errorString();
+                break;
+            }
+            if (readSize == 0) {
+                if (hint != 0) {
+                    error = QStringLiteral("Unexpected end of zstd data");
+                }
+                break;
+            }
+            in.src = input.constData();
+            in.size = readSize;
+            in.pos = 0;
+        }
+        hint = ZSTD_decompressStream(stream, &out, &in);
+        if (ZSTD_isError(hint)) {
+            error = QString::fromLatin1(ZSTD_getErrorName(hint));
+            break;
+        }
+        if (out.pos == out.size) {
+            if (!pushBlock(output)) {
+                break;
+            }
+            output = QByteArray(mBlockSize, Qt::Uninitialized);
+            out.dst = output.data();
+            out.pos = 0;
+        }
+    }
+    ZSTD_freeDStream(stream);
+    if (error.isEmpty() && out.pos > 0) {
+        output.resize(out.pos);
+        pushBlock(output);
+    }
+    finish(error);
+#else
+    finish(QStringLiteral("zstd is not supported in this build"));
+#endif
+}
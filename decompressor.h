@@ -0,0 +1,66 @@
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <QIODevice>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QByteArray>
+#include <QString>
+
+// распаковка сжатого файла в отдельном потоке: поток распаковки читает
+// источник и кладет распакованные блоки в ограниченную очередь, а чтение
+// из устройства забирает их, поэтому распаковка и разбор идут одновременно
+class Decompressor : public QIODevice
+{
+    Q_OBJECT
+public:
+    enum Format {
+        NoCompression,
+        Gzip,
+        Zstd
+    };
+    // формат сжатия по первым байтам источника, источник не читается
+    static Format detectFormat(QIODevice *source);
+    static bool isSupported(Format format);
+
+    Decompressor(QIODevice *source, Format format, QObject *parent = nullptr);
+    ~Decompressor();
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+private:
+    class Worker;
+    // выполняется в потоке распаковки
+    void decompress();
+    void decompressGzip();
+    void decompressZstd();
+    // false, если чтение остановлено
+    bool pushBlock(const QByteArray &block);
+    void finish(const QString &error = QString());
+    void stop();
+
+    QIODevice *mSource;
+    Format mFormat;
+    Worker *mWorker;
+    int mBlockSize;
+    int mQueueLimit;
+    mutable QMutex mMutex;
+    QWaitCondition mNotEmpty;
+    QWaitCondition mNotFull;
+    QQueue<QByteArray> mQueue;
+    bool mIsFinished;
+    bool mIsAbort;
+    QString mError;
+    // используются только читающим потоком
+    QByteArray mBlock;
+    int mBlockPos;
+};
+
+#endif // DECOMPRESSOR_H
@@ -0,0 +1,84 @@
+#include "dialect.h"
+
+// перевод времени unix в дату YYYYMMDD и время HHMMSS
+// (дни переводятся в дату по григорианскому календарю)
+void unixTimeToDateTime(uint64_t seconds, uint64_t *date, uint64_t *time)
+{
+    uint64_t days = seconds / 86400;
+    uint64_t daySeconds = seconds % 86400;
+    *time = daySeconds / 3600 * 10000 + daySeconds % 3600 / 60 * 100 +
+        daySeconds % 60;
+    // отсчитываем от 0000-03-01, чтоб високосный день был в конце года
+    uint64_t z = days + 719468;
+    uint64_t era = z / 146097;
+    uint64_t dayOfEra = z - era * 146097;
+    uint64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 -
+        dayOfEra / 146096) / 365;
+    uint64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 -
+        yearOfEra / 100);
+    uint64_t monthFromMarch = (5 * dayOfYear + 2) / 153;
+    uint64_t day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    uint64_t month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    uint64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+    *date = year * 10000 + month * 100 + day;
+}
+
+// время свечи в секундах от 1970-01-01 по дате YYYYMMDD (или YYMMDD)
+// и времени HHMMSS, обратный к unixTimeToDateTime перевод
+int64_t candleSeconds(const Candle &candle)
+{
+    int64_t year = candle.date / 10000;
+    int64_t month = candle.date / 100 % 100;
+    int64_t day = candle.date % 100;
+    if (year < 100) {
+        year += 2000;
+    }
+    // дни от 1970-01-01 по григорианскому календарю, год с марта
+    year -= month <= 2 ? 1 : 0;
+    int64_t era = year / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 +
+        day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 +
+        dayOfYear;
+    int64_t days = era * 146097 + dayOfEra - 719468;
+    int64_t time = candle.time;
+    return days * 86400 + time / 10000 * 3600 + time / 100 % 100 * 60 +
+        time % 100;
+}
+
+// нормализованный символ заголовка, 0 - символ не учитывается
+static char normalizeHeaderChar(char c)
+{
+    if (c == '<' || c == '>' || c == ' ' || c == '"') {
+        return 0;
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 'a';
+    }
+    return c;
+}
+
+// совпадает ли строка заголовка с ожидаемой без учета регистра,
+// пробелов, кавычек и угловых скобок
+bool isDialectHeader(const QByteArray &line, const char *header)
+{
+    const char *pos = line.constData();
+    const char *end = pos + line.size();
+    for (;;) {
+        while (pos < end && normalizeHeaderChar(*pos) == 0) {
+            ++pos;
+        }
+        while (*header != 0 && normalizeHeaderChar(*header) == 0) {
+            ++header;
+        }
+        if (pos == end || *header == 0) {
+            return pos == end && *header == 0;
+        }
+        if (normalizeHeaderChar(*pos) != normalizeHeaderChar(*header)) {
+            return false;
+        }
+        ++pos;
+        ++header;
+    }
+}
@@ -0,0 +1,326 @@
+#ifndef DIALECT_H
+#define DIALECT_H
+
+#include "core.h"
+#include "csvscan.h"
+
+#include <QByteArray>
+
+// назначение колонки файла с данными
+enum DialectColumn {
+    // колонка пропускается
+    ColumnSkip,
+    // дата цифрами, разделители пропускаются: 170329, 2017-03-29, 2017.03.29
+    ColumnDate,
+    // время цифрами, разделители пропускаются: 100000, 10:00:00
+    ColumnTime,
+    // дата и время в одной колонке: 2017-03-29 10:00:00
+    ColumnDateTime,
+    // секунды (или миллисекунды) от 1970-01-01 UTC
+    ColumnUnixTime,
+    ColumnOpen,
+    ColumnHigh,
+    ColumnLow,
+    ColumnClose,
+    ColumnVolume
+};
+
+// разбор числа из цифр поля [begin, end), допускаются разделители даты
+// и времени, которые пропускаются, поля до 8 цифр без разделителей
+// разбираются словом целиком
+inline bool parseDialectDigits(
+    const char *begin,
+    const char *end,
+    uint64_t *value,
+    int *digits
+)
+{
+    int size = end - begin;
+    if (size > 0 && size <= 8 && parseCsvEightDigits(begin, size, value)) {
+        *digits = size;
+        return true;
+    }
+    uint64_t result = 0;
+    int count = 0;
+    for (const char *pos = begin; pos < end; ++pos) {
+        unsigned digit = (unsigned char)*pos - '0';
+        if (digit < 10) {
+            result = result * 10 + digit;
+            ++count;
+        } else if (
+            *pos != '-' && *pos != '.' && *pos != '/' &&
+            *pos != ':' && *pos != ' ' && *pos != 'T'
+        ) {
+            return false;
+        }
+    }
+    *value = result;
+    *digits = count;
+    return count > 0;
+}
+
+// перевод времени unix в дату YYYYMMDD и время HHMMSS
+void unixTimeToDateTime(uint64_t seconds, uint64_t *date, uint64_t *time);
+
+// время свечи в секундах от 1970-01-01, год из двух цифр считается 20xx
+int64_t candleSeconds(const Candle &candle);
+
+// совпадает ли строка заголовка с ожидаемой без учета регистра,
+// пробелов и угловых скобок
+bool isDialectHeader(const QByteArray &line, const char *header);
+
+// разбор одного поля, для каждого назначения колонки своя специализация,
+// поэтому при разборе строки нет ветвлений по назначению колонок
+template<int Column>
+struct DialectField;
+
+template<>
+struct DialectField<ColumnSkip> {
+    static bool parse(const char *, const char *, Candle *)
+    {
+        return true;
+    }
+};
+
+template<>
+struct DialectField<ColumnDate> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        int digits;
+        return parseDialectDigits(begin, end, &candle->date, &digits);
+    }
+};
+
+template<>
+struct DialectField<ColumnTime> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        int digits;
+        return parseDialectDigits(begin, end, &candle->time, &digits);
+    }
+};
+
+template<>
+struct DialectField<ColumnDateTime> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        uint64_t value;
+        int digits;
+        if (!parseDialectDigits(begin, end, &value, &digits) || digits < 8) {
+            return false;
+        }
+        // первые 8 цифр - дата YYYYMMDD, остальные - время
+        uint64_t divider = 1;
+        for (int i = 8; i < digits; ++i) {
+            divider *= 10;
+        }
+        candle->date = value / divider;
+        candle->time = value % divider;
+        return true;
+    }
+};
+
+template<>
+struct DialectField<ColumnUnixTime> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        uint64_t value;
+        int digits;
+        if (!parseDialectDigits(begin, end, &value, &digits)) {
+            return false;
+        }
+        // 13 и более цифр - миллисекунды
+        if (digits >= 13) {
+            value /= 1000;
+        }
+        unixTimeToDateTime(value, &candle->date, &candle->time);
+        return true;
+    }
+};
+
+template<>
+struct DialectField<ColumnOpen> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        return parseCsvFloat(begin, end, &candle->open);
+    }
+};
+
+template<>
+struct DialectField<ColumnHigh> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        return parseCsvFloat(begin, end, &candle->high);
+    }
+};
+
+template<>
+struct DialectField<ColumnLow> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        return parseCsvFloat(begin, end, &candle->low);
+    }
+};
+
+template<>
+struct DialectField<ColumnClose> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        return parseCsvFloat(begin, end, &candle->close);
+    }
+};
+
+template<>
+struct DialectField<ColumnVolume> {
+    static bool parse(const char *begin, const char *end, Candle *candle)
+    {
+        return parseCsvFloat(begin, end, &candle->volume);
+    }
+};
+
+// разбор строки с колонками Columns, разделенными Delimiter, по позициям
+// разделителей, найденным scanCsvStructure, рекурсия по колонкам
+// разворачивается на этапе компиляции
+template<char Delimiter, int... Columns>
+struct DialectLine;
+
+template<char Delimiter, int Column>
+struct DialectLine<Delimiter, Column> {
+    static const char delimiter = Delimiter;
+    static const int columnCount = 1;
+    // разбор строки, начинающейся в begin, по смещениям separators
+    // разделителей в data, строка заканчивается переводом строки
+    static bool parseFields(
+        const char *data,
+        const char *begin,
+        const uint32_t *separators,
+        Candle *candle
+    )
+    {
+        const char *end = data + *separators;
+        if (*end != '\n') {
+            return false;
+        }
+        if (end > begin && end[-1] == '\r') {
+            --end;
+        }
+        return DialectField<Column>::parse(begin, end, candle);
+    }
+};
+
+template<char Delimiter, int Column, int... Rest>
+struct DialectLine<Delimiter, Column, Rest...> {
+    static const char delimiter = Delimiter;
+    static const int columnCount = 1 + sizeof...(Rest);
+    static bool parseFields(
+        const char *data,
+        const char *begin,
+        const uint32_t *separators,
+        Candle *candle
+    )
+    {
+        const char *end = data + *separators;
+        if (*end != Delimiter) {
+            return false;
+        }
+        return DialectField<Column>::parse(begin, end, candle) &&
+            DialectLine<Delimiter, Rest...>::parseFields(
+                data,
+                end + 1,
+                separators + 1,
+                candle
+            );
+    }
+};
+
+// описания форматов файлов: разделитель и назначение колонок задаются
+// параметрами DialectLine, header - строка заголовка или nullptr
+
+// формат по умолчанию: DATE,TIME,OPEN,HIGH,LOW,CLOSE,VOL без заголовка
+struct NativeDialect : DialectLine<',',
+    ColumnDate, ColumnTime, ColumnOpen, ColumnHigh, ColumnLow, ColumnClose,
+    ColumnVolume
+> {
+    static const char *header()
+    {
+        return nullptr;
+    }
+};
+
+// формат по умолчанию без объема
+struct NativeNoVolumeDialect : DialectLine<',',
+    ColumnDate, ColumnTime, ColumnOpen, ColumnHigh, ColumnLow, ColumnClose
+> {
+    static const char *header()
+    {
+        return nullptr;
+    }
+};
+
+// выгрузка Финама с тикером и периодом
+struct FinamDialect : DialectLine<',',
+    ColumnSkip, ColumnSkip, ColumnDate, ColumnTime, ColumnOpen, ColumnHigh,
+    ColumnLow, ColumnClose, ColumnVolume
+> {
+    static const char *header()
+    {
+        return "<TICKER>,<PER>,<DATE>,<TIME>,<OPEN>,<HIGH>,<LOW>,<CLOSE>,<VOL>";
+    }
+};
+
+// выгрузка Финама с разделителем ';'
+struct FinamSemicolonDialect : DialectLine<';',
+    ColumnSkip, ColumnSkip, ColumnDate, ColumnTime, ColumnOpen, ColumnHigh,
+    ColumnLow, ColumnClose, ColumnVolume
+> {
+    static const char *header()
+    {
+        return "<TICKER>;<PER>;<DATE>;<TIME>;<OPEN>;<HIGH>;<LOW>;<CLOSE>;<VOL>";
+    }
+};
+
+// формат по умолчанию с заголовком
+struct FinamShortDialect : DialectLine<',',
+    ColumnDate, ColumnTime, ColumnOpen, ColumnHigh, ColumnLow, ColumnClose,
+    ColumnVolume
+> {
+    static const char *header()
+    {
+        return "<DATE>,<TIME>,<OPEN>,<HIGH>,<LOW>,<CLOSE>,<VOL>";
+    }
+};
+
+// выгрузка MetaTrader с табуляцией, тиковый объем и спред пропускаются
+struct MetaTraderDialect : DialectLine<'\t',
+    ColumnDate, ColumnTime, ColumnOpen, ColumnHigh, ColumnLow, ColumnClose,
+    ColumnSkip, ColumnVolume, ColumnSkip
+> {
+    static const char *header()
+    {
+        return "<DATE>\t<TIME>\t<OPEN>\t<HIGH>\t<LOW>\t<CLOSE>\t<TICKVOL>\t<VOL>\t<SPREAD>";
+    }
+};
+
+// дневные свечи Yahoo, скорректированное закрытие пропускается
+struct YahooDialect : DialectLine<',',
+    ColumnDate, ColumnOpen, ColumnHigh, ColumnLow, ColumnClose, ColumnSkip,
+    ColumnVolume
+> {
+    static const char *header()
+    {
+        return "Date,Open,High,Low,Close,Adj Close,Volume";
+    }
+};
+
+// выгрузка бирж со временем unix
+struct UnixTimeDialect : DialectLine<',',
+    ColumnUnixTime, ColumnOpen, ColumnHigh, ColumnLow, ColumnClose,
+    ColumnVolume
+> {
+    static const char *header()
+    {
+        return "time,open,high,low,close,volume";
+    }
+};
+
+#endif // DIALECT_H
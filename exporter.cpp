@@ -0,0 +1,236 @@
+#include "exporter.h"
+#include "chart.h"
+#include "reader.h"
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QThread>
+#include <QAtomicInteger>
+
+#include <limits>
+#include <stdexcept>
+
+// время вида yyyymmdd или yyyymmddhhmmss в ключ времени свечи
+static bool parseTimeKey(const QString &text, uint64_t *key)
+{
+    bool isValid = false;
+    uint64_t value = text.toULongLong(&isValid);
+    if (!isValid || (text.size() != 8 && text.size() != 14)) {
+        return false;
+    }
+    *key = text.size() == 8 ? value * 1000000 : value;
+    return true;
+}
+
+// задача экспорта одного файла для пула потоков
+class ExportTask : public QRunnable
+{
+public:
+    ExportTask(
+        const QString &fileName,
+        const QString &imageFileName,
+        const ExportOptions &options,
+        QAtomicInteger<int> *failedCount
+    )
+    {
+        mFileName = fileName;
+        mImageFileName = imageFileName;
+        mOptions = options;
+        mFailedCount = failedCount;
+    }
+
+    void run() override
+    {
+        try {
+            Exporter::exportChart(mFileName, mImageFileName, mOptions);
+            printMessage(mFileName + " -> " + mImageFileName);
+        } catch (const std::exception &e) {
+            mFailedCount->fetchAndAddOrdered(1);
+            printMessage(mFileName + ": " + QString::fromLocal8Bit(e.what()));
+        }
+    }
+private:
+    QString mFileName;
+    QString mImageFileName;
+    ExportOptions mOptions;
+    QAtomicInteger<int> *mFailedCount;
+};
+
+bool Exporter::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--export");
+}
+
+int Exporter::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist batch export of charts to PNG");
+    parser.addHelpOption();
+    QCommandLineOption exportOption(
+        "export",
+        "Render charts of the given CSV files to PNG without a display."
+    );
+    QCommandLineOption outputDirOption(
+        QStringList() << "o" << "output-dir",
+        "Directory for PNG files.",
+        "dir",
+        "."
+    );
+    QCommandLineOption sizeOption(
+        QStringList() << "s" << "size",
+        "Image size.",
+        "WxH",
+        "1280x720"
+    );
+    QCommandLineOption candleWidthOption(
+        "candle-width",
+        "Candle body width in pixels.",
+        "px",
+        "15"
+    );
+    QCommandLineOption noVolumeOption("no-volume", "Hide the volume graph.");
+    QCommandLineOption noScrollAreaOption("no-scroll-area", "Hide the scroll area.");
+    QCommandLineOption fromOption(
+        "from",
+        "Export candles starting at this time.",
+        "yyyymmdd[hhmmss]"
+    );
+    QCommandLineOption toOption(
+        "to",
+        "Export candles before this time.",
+        "yyyymmdd[hhmmss]"
+    );
+    QCommandLineOption jobsOption(
+        QStringList() << "j" << "jobs",
+        "Number of parallel jobs (all cores by default).",
+        "n"
+    );
+    parser.addOption(exportOption);
+    parser.addOption(outputDirOption);
+    parser.addOption(sizeOption);
+    parser.addOption(candleWidthOption);
+    parser.addOption(noVolumeOption);
+    parser.addOption(noScrollAreaOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(jobsOption);
+    parser.addPositionalArgument("files", "CSV files to export.", "files...");
+    parser.process(arguments);
+
+    ExportOptions options;
+    QStringList size = parser.value(sizeOption).split('x');
+    bool isWidthValid = false, isHeightValid = false;
+    if (size.size() == 2) {
+        options.size = QSize(
+            size.at(0).toInt(&isWidthValid),
+            size.at(1).toInt(&isHeightValid)
+        );
+    }
+    if (!isWidthValid || !isHeightValid || options.size.isEmpty()) {
+        printMessage("Invalid image size: " + parser.value(sizeOption));
+        return 1;
+    }
+    bool isCandleWidthValid = false;
+    options.candleWidth = parser.value(candleWidthOption).toFloat(&isCandleWidthValid);
+    if (!isCandleWidthValid || options.candleWidth <= 0) {
+        printMessage("Invalid candle width: " + parser.value(candleWidthOption));
+        return 1;
+    }
+    options.showVolumeGraph = !parser.isSet(noVolumeOption);
+    options.showScrollArea = !parser.isSet(noScrollAreaOption);
+    options.fromKey = 0;
+    options.toKey = std::numeric_limits<uint64_t>::max();
+    if (parser.isSet(fromOption) && !parseTimeKey(parser.value(fromOption), &options.fromKey)) {
+        printMessage("Invalid start time: " + parser.value(fromOption));
+        return 1;
+    }
+    if (parser.isSet(toOption) && !parseTimeKey(parser.value(toOption), &options.toKey)) {
+        printMessage("Invalid end time: " + parser.value(toOption));
+        return 1;
+    }
+
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        printMessage("No files to export");
+        return 1;
+    }
+    QDir outputDir(parser.value(outputDirOption));
+    if (!outputDir.mkpath(".")) {
+        printMessage("Can't create output directory " + parser.value(outputDirOption));
+        return 1;
+    }
+
+    // картинка называется по имени файла, файлы с одним именем из разных
+    // каталогов перезаписали бы картинки друг друга
+    QStringList imageFileNames;
+    QHash<QString, QString> sourceFileNames;
+    for (const QString &fileName : files) {
+        QString imageFileName = outputDir.filePath(
+            QFileInfo(fileName).completeBaseName() + ".png"
+        );
+        if (sourceFileNames.contains(imageFileName)) {
+            printMessage(
+                sourceFileNames.value(imageFileName) + " and " + fileName +
+                " would both be exported to " + imageFileName
+            );
+            return 1;
+        }
+        sourceFileNames.insert(imageFileName, fileName);
+        imageFileNames << imageFileName;
+    }
+
+    QThreadPool pool;
+    if (parser.isSet(jobsOption) && parser.value(jobsOption).toInt() > 0) {
+        pool.setMaxThreadCount(parser.value(jobsOption).toInt());
+    } else {
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+    }
+    QAtomicInteger<int> failedCount(0);
+    for (int i = 0; i < files.size(); ++i) {
+        pool.start(new ExportTask(files.at(i), imageFileNames.at(i), options, &failedCount));
+    }
+    pool.waitForDone();
+    return failedCount.loadAcquire() == 0 ? 0 : 2;
+}
+
+void Exporter::exportChart(
+    const QString &fileName,
+    const QString &imageFileName,
+    const ExportOptions &options
+)
+{
+    DataSeries dataSeries;
+    Reader::readFromFile(fileName, &dataSeries);
+
+    SessionIndex sessionIndex;
+    sessionIndex.update(dataSeries);
+
+    Chart chart(&dataSeries);
+    chart.setSessionIndex(&sessionIndex);
+    if (options.fromKey != 0 || options.toKey != std::numeric_limits<uint64_t>::max()) {
+        chart.setView(DataView(&dataSeries).timeSlice(options.fromKey, options.toKey));
+    }
+    chart.setShowLabelsWithMouse(false);
+    chart.setSelectAreaWithMouse(false);
+    chart.setShowVolumeGraph(options.showVolumeGraph);
+    chart.setShowScrollArea(options.showScrollArea);
+    chart.setCandleWidth(options.candleWidth);
+
+    QImage image(options.size, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter;
+    painter.begin(&image);
+    painter.setRenderHint(QPainter::HighQualityAntialiasing);
+    chart.paint(&painter, image.rect());
+    painter.end();
+    if (!image.save(imageFileName, "PNG")) {
+        throw std::runtime_error("Can't save chart image");
+    }
+}
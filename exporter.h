@@ -0,0 +1,38 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QSize>
+
+#include <inttypes.h>
+
+// параметры отрисовки графика при экспорте
+struct ExportOptions {
+    QSize size;
+    float candleWidth;
+    bool showVolumeGraph;
+    bool showScrollArea;
+    // рисуются только свечи с ключами времени [fromKey, toKey)
+    uint64_t fromKey;
+    uint64_t toKey;
+};
+
+// пакетный экспорт графиков в PNG без дисплея,
+// файлы загружаются и рисуются параллельно
+class Exporter
+{
+public:
+    // запрошен ли режим экспорта в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // экспорт по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+    // загрузка данных из CSV файла и отрисовка графика в PNG файл
+    static void exportChart(
+        const QString &fileName,
+        const QString &imageFileName,
+        const ExportOptions &options
+    );
+};
+
+#endif // EXPORTER_H
@@ -0,0 +1,85 @@
+#include "feedclient.h"
+
+#include <QTcpSocket>
+
+#include <cstring>
+#include <vector>
+
+FeedClient::FeedClient(const QString &host, quint16 port, QObject *parent)
+    : QThread(parent), mBuffer(1 << 16)
+{
+    mHost = host;
+    mPort = port;
+    mIsNotified = false;
+}
+
+FeedClient::~FeedClient()
+{
+    requestInterruption();
+    wait();
+}
+
+size_t FeedClient::take(FeedMessage *messages, size_t size)
+{
+    // флаг сбрасываем до чтения: что придет после, вызовет новый сигнал
+    mIsNotified.store(false);
+    return mBuffer.pop(messages, size);
+}
+
+void FeedClient::notify()
+{
+    if (!mIsNotified.exchange(true)) {
+        emit messagesAvailable();
+    }
+}
+
+void FeedClient::run()
+{
+    QTcpSocket socket;
+    socket.connectToHost(mHost, mPort);
+    if (!socket.waitForConnected(5000)) {
+        emit finished(socket.errorString());
+        return;
+    }
+    // сообщения могут прийти не целиком, хвост ждет следующего чтения
+    std::vector<char> data(1 << 20);
+    size_t dataSize = 0;
+    std::vector<FeedMessage> messages;
+    QString error;
+    while (!isInterruptionRequested()) {
+        if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(100)) {
+            if (socket.state() != QAbstractSocket::ConnectedState) {
+                break;
+            }
+            continue;
+        }
+        qint64 readSize = socket.read(data.data() + dataSize, data.size() - dataSize);
+        if (readSize < 0) {
+            error = socket.errorString();
+            break;
+        }
+        dataSize += readSize;
+        size_t count = dataSize / sizeof(FeedMessage);
+        messages.resize(count);
+        memcpy(
+            (void *)messages.data(),
+            data.data(),
+            count * sizeof(FeedMessage)
+        );
+        dataSize -= count * sizeof(FeedMessage);
+        memmove(data.data(), data.data() + count * sizeof(FeedMessage), dataSize);
+        // буфер полон - ждем, пока интерфейс заберет свечи, пока мы ждем,
+        // сокет не читается и повтор притормаживает
+        size_t pushed = 0;
+        while (pushed < count && !isInterruptionRequested()) {
+            size_t size = mBuffer.push(messages.data() + pushed, count - pushed);
+            pushed += size;
+            if (size > 0) {
+                notify();
+            } else {
+                QThread::usleep(200);
+            }
+        }
+    }
+    emit finished(error);
+}
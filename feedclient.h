@@ -0,0 +1,38 @@
+#ifndef FEEDCLIENT_H
+#define FEEDCLIENT_H
+
+#include "replay.h"
+#include "ringbuffer.h"
+
+#include <QThread>
+#include <QString>
+
+#include <atomic>
+
+// прием потока свечей от повтора (chartist --replay) в отдельном потоке:
+// принятые сообщения кладутся в кольцевой буфер без блокировок, откуда
+// поток интерфейса забирает их пачкой на каждый кадр
+class FeedClient : public QThread
+{
+    Q_OBJECT
+public:
+    FeedClient(const QString &host, quint16 port, QObject *parent = nullptr);
+    ~FeedClient();
+    // забрать до size пришедших сообщений, вызывается только одним потоком
+    size_t take(FeedMessage *messages, size_t size);
+signals:
+    // в буфере появились сообщения, сигнал не повторяется, пока их не заберут
+    void messagesAvailable();
+    void finished(const QString &error);
+protected:
+    void run() override;
+private:
+    void notify();
+
+    QString mHost;
+    quint16 mPort;
+    SpscRingBuffer<FeedMessage> mBuffer;
+    std::atomic<bool> mIsNotified;
+};
+
+#endif // FEEDCLIENT_H
@@ -0,0 +1,193 @@
+#include "framebench.h"
+#include "renderthread.h"
+#include "alloccounter.h"
+#include "sessionindex.h"
+#include "commandline.h"
+
+#include <QEventLoop>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QTextStream>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+bool FrameBenchmark::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--bench-frames");
+}
+
+// запрос кадра по снимку данных, как у виджета, и ожидание, пока поток
+// отрисовки его нарисует
+static void renderFrame(
+    RenderThread *renderThread,
+    const Chart &chart,
+    const std::shared_ptr<const ChartData> &data,
+    const QSize &size,
+    const QRegion &region
+)
+{
+    QEventLoop loop;
+    QObject::connect(renderThread, &RenderThread::frameReady, &loop, &QEventLoop::quit);
+    renderThread->requestFrame(chart, data, size, region);
+    loop.exec();
+}
+
+int FrameBenchmark::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist frame allocations benchmark");
+    parser.addHelpOption();
+    QCommandLineOption benchOption(
+        "bench-frames",
+        "Move the crosshair over a generated chart and count heap allocations per frame."
+    );
+    QCommandLineOption candlesOption(
+        "candles",
+        "Candles in the generated series.",
+        "n",
+        "100000"
+    );
+    QCommandLineOption framesOption(
+        "frames",
+        "Measured frames.",
+        "n",
+        "1000"
+    );
+    QCommandLineOption sizeOption(
+        QStringList() << "s" << "size",
+        "Frame size.",
+        "WxH",
+        "1280x720"
+    );
+    parser.addOption(benchOption);
+    parser.addOption(candlesOption);
+    parser.addOption(framesOption);
+    parser.addOption(sizeOption);
+    parser.process(arguments);
+
+    bool isCandlesValid = false, isFramesValid = false;
+    int candleCount = parser.value(candlesOption).toInt(&isCandlesValid);
+    int frameCount = parser.value(framesOption).toInt(&isFramesValid);
+    QStringList sizeParts = parser.value(sizeOption).split('x');
+    QSize size;
+    if (sizeParts.size() == 2) {
+        size = QSize(sizeParts.at(0).toInt(), sizeParts.at(1).toInt());
+    }
+    if (!isCandlesValid || candleCount <= 0) {
+        printMessage("Invalid candle count: " + parser.value(candlesOption));
+        return 1;
+    }
+    if (!isFramesValid || frameCount <= 0) {
+        printMessage("Invalid frame count: " + parser.value(framesOption));
+        return 1;
+    }
+    if (size.width() < 200 || size.height() < 200) {
+        printMessage("Invalid frame size: " + parser.value(sizeOption));
+        return 1;
+    }
+
+    // случайное блуждание цены около 100, одинаковое от запуска к запуску
+    DataSeries dataSeries;
+    BenchSeriesGenerator().append(&dataSeries, candleCount);
+    SessionIndex sessionIndex;
+    sessionIndex.update(dataSeries);
+    PatternIndex patternIndex;
+    patternIndex.update(dataSeries);
+    IndicatorSet indicators;
+    indicators.setDataSeries(&dataSeries);
+
+    Chart chart(&dataSeries);
+    chart.setSessionIndex(&sessionIndex);
+    chart.setMouseEnter(true);
+    chart.setMousePos(QPoint(size.width() / 2, size.height() / 2));
+    chart.prepare(size, ChartAllChanges);
+
+    // первые кадры заполняют кэш отрисовки и атлас символов подписей,
+    // в замер идут кадры, где меняются только оси мышки
+    RenderThread renderThread;
+    renderFrame(
+        &renderThread,
+        chart,
+        std::make_shared<ChartData>(dataSeries, patternIndex, sessionIndex, indicators),
+        size,
+        QRegion(QRect(QPoint(0, 0), size))
+    );
+    const int warmupFrames = 10;
+    std::vector<uint64_t> allocations;
+    std::vector<qint64> frameTimes;
+    allocations.reserve(frameCount);
+    frameTimes.reserve(frameCount);
+    int firstAllocatingFrame = -1;
+    for (int i = 0; i < warmupFrames + frameCount; ++i) {
+        // оси мышки обходят график с разным шагом по x и y
+        QPoint pos(
+            20 + (i * 37) % (size.width() - 40),
+            20 + (i * 23) % (size.height() - 40)
+        );
+        QRegion region = chart.crosshairRegion();
+        chart.setMousePos(pos);
+        region += chart.crosshairRegion();
+        chart.prepare(size, ChartCrosshairChange);
+        renderFrame(
+            &renderThread,
+            chart,
+            std::make_shared<ChartData>(dataSeries, patternIndex, sessionIndex, indicators),
+            size,
+            region
+        );
+        if (i < warmupFrames) {
+            continue;
+        }
+        allocations.push_back(renderThread.lastFrameAllocations());
+        frameTimes.push_back(renderThread.lastFrameTime());
+        if (allocations.back() != 0 && firstAllocatingFrame < 0) {
+            firstAllocatingFrame = i - warmupFrames;
+        }
+    }
+
+    uint64_t allocationSum = 0;
+    for (uint64_t count : allocations) {
+        allocationSum += count;
+    }
+    qint64 timeSum = 0;
+    for (qint64 frameTime : frameTimes) {
+        timeSum += frameTime;
+    }
+    std::sort(frameTimes.begin(), frameTimes.end());
+    QTextStream output(stdout);
+    output << "{\"benchmark\":\"crosshair_frames\""
+        << ",\"candles\":" << candleCount
+        << ",\"frames\":" << frameCount
+        << ",\"width\":" << size.width()
+        << ",\"height\":" << size.height()
+        << ",\"avg_ns\":" << QString::number((double)timeSum / frameTimes.size(), 'f', 0)
+        << ",\"p50_ns\":" << frameTimes[frameTimes.size() / 2]
+        << ",\"p99_ns\":" << frameTimes[frameTimes.size() * 99 / 100]
+        << ",\"allocations\":";
+    if (isAllocationCountEnabled()) {
+        output << (quint64)allocationSum
+            << ",\"max_frame_allocations\":"
+            << (quint64)*std::max_element(allocations.begin(), allocations.end());
+    } else {
+        output << "null";
+    }
+    output << "}\n";
+    output.flush();
+
+    if (!isAllocationCountEnabled()) {
+        printMessage("Allocations are counted only when built with CONFIG+=alloc_count");
+        return 0;
+    }
+    // кадр, в котором сдвинулись только оси мышки, не должен выделять память
+    if (firstAllocatingFrame >= 0) {
+        printMessage(
+            QString("Frame %1 allocated memory %2 times, crosshair frames must not allocate")
+                .arg(firstAllocatingFrame)
+                .arg((quint64)allocations[firstAllocatingFrame])
+        );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef FRAMEBENCH_H
+#define FRAMEBENCH_H
+
+#include <QString>
+#include <QStringList>
+
+// замер кадров, в которых двигаются только оси мышки: рисует сгенерированный
+// ряд в потоке отрисовки и печатает выделения памяти и время кадров строкой
+// JSON; в сборке с CONFIG += alloc_count кадр с выделениями памяти считается
+// ошибкой
+class FrameBenchmark
+{
+public:
+    // запрошен ли замер в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // замер по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+};
+
+#endif // FRAMEBENCH_H
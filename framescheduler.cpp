@@ -0,0 +1,52 @@
+#include "framescheduler.h"
+
+FrameScheduler::FrameScheduler(QObject *parent)
+    : QObject(parent)
+{
+    mChanges = 0;
+    mFrameInterval = 16;
+    mTimer = new QTimer(this);
+    mTimer->setSingleShot(true);
+    mTimer->setTimerType(Qt::PreciseTimer);
+    connect(mTimer, &QTimer::timeout, this, &FrameScheduler::onTimer);
+}
+
+int FrameScheduler::frameInterval() const
+{
+    return mFrameInterval;
+}
+
+void FrameScheduler::setFrameInterval(int msec)
+{
+    mFrameInterval = qMax(1, msec);
+}
+
+void FrameScheduler::invalidate(int changes, const QRegion &region)
+{
+    // изменения, не задевшие ни одного пикселя, кадра не требуют
+    if (changes == 0 || region.isEmpty()) {
+        return;
+    }
+    mChanges |= changes;
+    mDirtyRegion += region;
+    if (mTimer->isActive()) {
+        return;
+    }
+    // после долгого простоя кадр рисуется сразу,
+    // иначе - не раньше, чем через период после предыдущего
+    int delay = 0;
+    if (mLastFrameTimer.isValid()) {
+        delay = qMax(0, mFrameInterval - (int)mLastFrameTimer.elapsed());
+    }
+    mTimer->start(delay);
+}
+
+void FrameScheduler::onTimer()
+{
+    int changes = mChanges;
+    QRegion region = mDirtyRegion;
+    mChanges = 0;
+    mDirtyRegion = QRegion();
+    mLastFrameTimer.start();
+    emit frameRequested(changes, region);
+}
@@ -0,0 +1,34 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QRegion>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// планировщик кадров: копит изменения состояния графика (набор ChartChange)
+// и области, которые нужно перерисовать, и запрашивает не больше одного
+// кадра за период обновления экрана, поэтому серия событий мыши
+// между кадрами сливается в один кадр
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    FrameScheduler(QObject *parent = nullptr);
+    int frameInterval() const;
+    void setFrameInterval(int msec);
+    // отметить изменения changes, затрагивающие область region
+    void invalidate(int changes, const QRegion &region);
+signals:
+    void frameRequested(int changes, const QRegion &region);
+private slots:
+    void onTimer();
+private:
+    int mChanges;
+    QRegion mDirtyRegion;
+    QTimer *mTimer;
+    QElapsedTimer mLastFrameTimer;
+    int mFrameInterval;
+};
+
+#endif // FRAMESCHEDULER_H
@@ -0,0 +1,899 @@
+#include "indicator.h"
+
+#include <QByteArray>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// наибольшее окно функций по свечам
+static const int MaxWindow = 1 << 20;
+// кол-во свечей, которое фоновое вычисление истории считает за раз,
+// между блоками проверяется, не остановлено ли оно
+static const uint64_t HistoryBlockSize = 1 << 16;
+
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+// функции выражений: имя, операция и кол-во аргументов,
+// второй аргумент функций по свечам - окно
+struct IndicatorFunction {
+    const char *name;
+    IndicatorOpCode code;
+    int argumentCount;
+};
+
+static const IndicatorFunction indicatorFunctions[] = {
+    {"sma", IndicatorOpSma, 2},
+    {"stdev", IndicatorOpStdev, 2},
+    {"sum", IndicatorOpSum, 2},
+    {"highest", IndicatorOpHighest, 2},
+    {"lowest", IndicatorOpLowest, 2},
+    {"ref", IndicatorOpRef, 2},
+    {"abs", IndicatorOpAbs, 1},
+    {"sqrt", IndicatorOpSqrt, 1},
+    {"log", IndicatorOpLog, 1}
+};
+
+static const struct {
+    const char *name;
+    IndicatorOpCode code;
+} indicatorColumns[] = {
+    {"open", IndicatorOpOpen},
+    {"high", IndicatorOpHigh},
+    {"low", IndicatorOpLow},
+    {"close", IndicatorOpClose},
+    {"volume", IndicatorOpVolume}
+};
+
+static bool isUnaryOp(IndicatorOpCode code)
+{
+    return code == IndicatorOpNeg || code == IndicatorOpAbs ||
+        code == IndicatorOpSqrt || code == IndicatorOpLog;
+}
+
+static bool isBinaryOp(IndicatorOpCode code)
+{
+    return code == IndicatorOpAdd || code == IndicatorOpSub ||
+        code == IndicatorOpMul || code == IndicatorOpDiv;
+}
+
+static double applyUnaryOp(IndicatorOpCode code, double x)
+{
+    switch (code) {
+    case IndicatorOpNeg:
+        return -x;
+    case IndicatorOpAbs:
+        return std::fabs(x);
+    case IndicatorOpSqrt:
+        return std::sqrt(x);
+    default:
+        return std::log(x);
+    }
+}
+
+static double applyBinaryOp(IndicatorOpCode code, double x, double y)
+{
+    switch (code) {
+    case IndicatorOpAdd:
+        return x + y;
+    case IndicatorOpSub:
+        return x - y;
+    case IndicatorOpMul:
+        return x * y;
+    default:
+        return x / y;
+    }
+}
+
+// разбор выражения рекурсивным спуском сразу в операции программы:
+// sum := product (('+' | '-') product)*
+// product := unary (('*' | '/') unary)*
+// unary := '-' unary | primary
+// primary := number | column | function '(' sum (',' sum)* ')' | '(' sum ')'
+class IndicatorCompiler
+{
+public:
+    IndicatorCompiler(const QString &text, IndicatorProgram *program)
+        : mText(text.toLatin1()), mPos(0), mProgram(program)
+    {
+    }
+
+    // номер операции, дающей значение выражения
+    int compile()
+    {
+        int op = parseSum();
+        skipSpaces();
+        if (mPos < mText.size()) {
+            fail("Unexpected character");
+        }
+        return op;
+    }
+private:
+    [[noreturn]] void fail(const char *message) const
+    {
+        throw std::logic_error(
+            QString("%1 at position %2").arg(message).arg(mPos + 1).toStdString()
+        );
+    }
+
+    void skipSpaces()
+    {
+        while (mPos < mText.size() && (mText.at(mPos) == ' ' || mText.at(mPos) == '\t')) {
+            ++mPos;
+        }
+    }
+
+    bool take(char c)
+    {
+        skipSpaces();
+        if (mPos < mText.size() && mText.at(mPos) == c) {
+            ++mPos;
+            return true;
+        }
+        return false;
+    }
+
+    // добавление операции: операции над константами сразу вычисляются,
+    // уже имеющаяся в программе такая же операция переиспользуется
+    int addOp(IndicatorOpCode code, int a, int b, int window, double constant)
+    {
+        std::vector<IndicatorOp> &ops = mProgram->ops;
+        if (isUnaryOp(code) && ops[a].code == IndicatorOpConstant) {
+            return addOp(IndicatorOpConstant, -1, -1, 0, applyUnaryOp(code, ops[a].constant));
+        }
+        if (
+            isBinaryOp(code) &&
+            ops[a].code == IndicatorOpConstant &&
+            ops[b].code == IndicatorOpConstant
+        ) {
+            return addOp(
+                IndicatorOpConstant,
+                -1,
+                -1,
+                0,
+                applyBinaryOp(code, ops[a].constant, ops[b].constant)
+            );
+        }
+        // программа короткая, поэтому ищем перебором
+        for (size_t i = 0; i < ops.size(); ++i) {
+            const IndicatorOp &op = ops[i];
+            if (
+                op.code == code && op.a == a && op.b == b && op.window == window &&
+                (code != IndicatorOpConstant || op.constant == constant)
+            ) {
+                return i;
+            }
+        }
+        IndicatorOp op;
+        op.code = code;
+        op.a = a;
+        op.b = b;
+        op.window = window;
+        op.constant = constant;
+        ops.push_back(op);
+        return ops.size() - 1;
+    }
+
+    int parseSum()
+    {
+        int op = parseProduct();
+        forever {
+            if (take('+')) {
+                op = addOp(IndicatorOpAdd, op, parseProduct(), 0, 0);
+            } else if (take('-')) {
+                op = addOp(IndicatorOpSub, op, parseProduct(), 0, 0);
+            } else {
+                return op;
+            }
+        }
+    }
+
+    int parseProduct()
+    {
+        int op = parseUnary();
+        forever {
+            if (take('*')) {
+                op = addOp(IndicatorOpMul, op, parseUnary(), 0, 0);
+            } else if (take('/')) {
+                op = addOp(IndicatorOpDiv, op, parseUnary(), 0, 0);
+            } else {
+                return op;
+            }
+        }
+    }
+
+    int parseUnary()
+    {
+        if (take('-')) {
+            return addOp(IndicatorOpNeg, parseUnary(), -1, 0, 0);
+        }
+        return parsePrimary();
+    }
+
+    int parsePrimary()
+    {
+        skipSpaces();
+        if (mPos >= mText.size()) {
+            fail("Unexpected end of expression");
+        }
+        if (take('(')) {
+            int op = parseSum();
+            if (!take(')')) {
+                fail("Expected ')'");
+            }
+            return op;
+        }
+        char c = mText.at(mPos);
+        if ((c >= '0' && c <= '9') || c == '.') {
+            const char *begin = mText.constData() + mPos;
+            char *end;
+            double value = strtod(begin, &end);
+            if (end == begin) {
+                fail("Invalid number");
+            }
+            mPos += end - begin;
+            return addOp(IndicatorOpConstant, -1, -1, 0, value);
+        }
+        int nameBegin = mPos;
+        while (
+            mPos < mText.size() &&
+            (isalnum((unsigned char)mText.at(mPos)) || mText.at(mPos) == '_')
+        ) {
+            ++mPos;
+        }
+        if (mPos == nameBegin) {
+            fail("Unexpected character");
+        }
+        QByteArray name = mText.mid(nameBegin, mPos - nameBegin).toLower();
+        for (const auto &column : indicatorColumns) {
+            if (name == column.name) {
+                return addOp(column.code, -1, -1, 0, 0);
+            }
+        }
+        for (const IndicatorFunction &function : indicatorFunctions) {
+            if (name == function.name) {
+                return parseCall(function);
+            }
+        }
+        mPos = nameBegin;
+        fail("Unknown name");
+    }
+
+    int parseCall(const IndicatorFunction &function)
+    {
+        if (!take('(')) {
+            fail("Expected '('");
+        }
+        int a = parseSum();
+        if (function.argumentCount == 1) {
+            if (!take(')')) {
+                fail("Expected ')'");
+            }
+            return addOp(function.code, a, -1, 0, 0);
+        }
+        if (!take(',')) {
+            fail("Expected ','");
+        }
+        int windowPos = mPos;
+        int window = parseSum();
+        const IndicatorOp &windowOp = mProgram->ops[window];
+        if (
+            windowOp.code != IndicatorOpConstant ||
+            windowOp.constant != std::floor(windowOp.constant) ||
+            windowOp.constant < 1 ||
+            windowOp.constant > MaxWindow
+        ) {
+            mPos = windowPos;
+            fail("Window must be a positive integer constant");
+        }
+        if (!take(')')) {
+            fail("Expected ')'");
+        }
+        return addOp(function.code, a, -1, (int)windowOp.constant, 0);
+    }
+
+    QByteArray mText;
+    int mPos;
+    IndicatorProgram *mProgram;
+};
+
+// удаление операций, не нужных ни одному выражению (например, констант,
+// свернутых в одну), с перенумерацией аргументов
+static void removeUnusedOps(IndicatorProgram *program)
+{
+    std::vector<IndicatorOp> &ops = program->ops;
+    std::vector<int> newIndexes(ops.size(), -1);
+    for (int output : program->outputs) {
+        newIndexes[output] = 0;
+    }
+    for (size_t i = ops.size(); i-- > 0;) {
+        if (newIndexes[i] < 0) {
+            continue;
+        }
+        if (ops[i].a >= 0) {
+            newIndexes[ops[i].a] = 0;
+        }
+        if (ops[i].b >= 0) {
+            newIndexes[ops[i].b] = 0;
+        }
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (newIndexes[i] < 0) {
+            continue;
+        }
+        newIndexes[i] = count;
+        IndicatorOp op = ops[i];
+        op.a = op.a >= 0 ? newIndexes[op.a] : -1;
+        op.b = op.b >= 0 ? newIndexes[op.b] : -1;
+        ops[count++] = op;
+    }
+    ops.resize(count);
+    for (int &output : program->outputs) {
+        output = newIndexes[output];
+    }
+}
+
+// кол-во свечей до начала диапазона, нужное каждой операции: операции
+// идут после своих аргументов, поэтому считаем от выражений к колонкам
+static void updateLookbacks(IndicatorProgram *program)
+{
+    const std::vector<IndicatorOp> &ops = program->ops;
+    std::vector<uint64_t> &lookbacks = program->lookbacks;
+    lookbacks.assign(ops.size(), 0);
+    for (size_t i = ops.size(); i-- > 0;) {
+        const IndicatorOp &op = ops[i];
+        uint64_t lookback = lookbacks[i];
+        if (op.code == IndicatorOpRef) {
+            lookback += op.window;
+        } else if (op.window > 0) {
+            lookback += op.window - 1;
+        }
+        if (op.a >= 0) {
+            lookbacks[op.a] = qMax(lookbacks[op.a], lookback);
+        }
+        if (op.b >= 0) {
+            lookbacks[op.b] = qMax(lookbacks[op.b], lookback);
+        }
+    }
+}
+
+// колонка свечей [begin, last) ряда, по блокам свечей подряд
+static void loadCandleColumn(
+    const DataSeries &dataSeries,
+    float Candle::*field,
+    uint64_t begin,
+    uint64_t last,
+    double *out
+)
+{
+    uint64_t index = begin;
+    while (index < last) {
+        uint64_t chunk = index / DataSeries::ChunkSize;
+        uint64_t offset = index % DataSeries::ChunkSize;
+        uint64_t count = qMin(dataSeries.chunkSize(chunk) - offset, last - index);
+        const Candle *candles = dataSeries.chunkData(chunk) + offset;
+        for (uint64_t i = 0; i < count; ++i) {
+            out[i] = candles[i].*field;
+        }
+        out += count;
+        index += count;
+    }
+}
+
+template<typename Function>
+static void mapColumn(double *out, const double *x, uint64_t count, Function function)
+{
+    for (uint64_t i = 0; i < count; ++i) {
+        out[i] = function(x[i]);
+    }
+}
+
+template<typename Function>
+static void mapColumns(
+    double *out,
+    const double *x,
+    const double *y,
+    uint64_t count,
+    Function function
+)
+{
+    for (uint64_t i = 0; i < count; ++i) {
+        out[i] = function(x[i], y[i]);
+    }
+}
+
+// сумма, среднее или стандартное отклонение по окну: суммы значений
+// и квадратов скользят по столбцу, NaN в окне дает NaN
+static void rollingSums(
+    IndicatorOpCode code,
+    const double *x,
+    uint64_t from,
+    uint64_t begin,
+    uint64_t last,
+    uint64_t window,
+    double *out
+)
+{
+    double sum = 0;
+    double sumSquares = 0;
+    uint64_t nanCount = 0;
+    for (uint64_t j = from; j < last; ++j) {
+        double value = x[j - from];
+        if (std::isnan(value)) {
+            ++nanCount;
+        } else {
+            sum += value;
+            sumSquares += value * value;
+        }
+        if (j >= from + window) {
+            double old = x[j - window - from];
+            if (std::isnan(old)) {
+                --nanCount;
+            } else {
+                sum -= old;
+                sumSquares -= old * old;
+            }
+        }
+        if (j < begin) {
+            continue;
+        }
+        double result = NaN;
+        if (j + 1 >= window && nanCount == 0) {
+            if (code == IndicatorOpSum) {
+                result = sum;
+            } else if (code == IndicatorOpSma) {
+                result = sum / window;
+            } else {
+                double mean = sum / window;
+                result = std::sqrt(qMax(0.0, sumSquares / window - mean * mean));
+            }
+        }
+        out[j - begin] = result;
+    }
+}
+
+// максимум или минимум по окну: монотонная очередь индексов
+static void rollingExtremum(
+    bool isMax,
+    const double *x,
+    uint64_t from,
+    uint64_t begin,
+    uint64_t last,
+    uint64_t window,
+    std::vector<uint64_t> *queue,
+    double *out
+)
+{
+    queue->resize(last - from);
+    uint64_t *indexes = queue->data();
+    size_t head = 0;
+    size_t tail = 0;
+    // индекс последнего NaN + 1, 0 - NaN не было
+    uint64_t nanEnd = 0;
+    for (uint64_t j = from; j < last; ++j) {
+        double value = x[j - from];
+        if (std::isnan(value)) {
+            nanEnd = j + 1;
+        } else {
+            while (
+                tail > head &&
+                (isMax ? x[indexes[tail - 1] - from] <= value : x[indexes[tail - 1] - from] >= value)
+            ) {
+                --tail;
+            }
+            indexes[tail++] = j;
+        }
+        while (head < tail && indexes[head] + window <= j) {
+            ++head;
+        }
+        if (j < begin) {
+            continue;
+        }
+        bool isValid = j + 1 >= window && nanEnd + window <= j + 1 && head < tail;
+        out[j - begin] = isValid ? x[indexes[head] - from] : NaN;
+    }
+}
+
+void IndicatorSet::evaluateProgram(
+    const IndicatorProgram &program,
+    const DataSeries &dataSeries,
+    uint64_t first,
+    uint64_t last,
+    IndicatorScratch *scratch
+)
+{
+    size_t opCount = program.ops.size();
+    scratch->columns.resize(opCount);
+    scratch->columnBegins.resize(opCount);
+    // столбец аргумента с индекса ряда index, аргументу нужно не меньше
+    // истории, чем операции, поэтому его столбец начинается не позже
+    auto input = [scratch](int op, uint64_t index) {
+        return scratch->columns[op].data() + (index - scratch->columnBegins[op]);
+    };
+    for (size_t i = 0; i < opCount; ++i) {
+        const IndicatorOp &op = program.ops[i];
+        uint64_t lookback = program.lookbacks[i];
+        uint64_t begin = first > lookback ? first - lookback : 0;
+        uint64_t count = last - begin;
+        std::vector<double> &column = scratch->columns[i];
+        column.resize(count);
+        scratch->columnBegins[i] = begin;
+        double *out = column.data();
+        uint64_t window = op.window;
+        // начало окна первой свечи столбца
+        uint64_t from = window > 0 && begin >= window - 1 ? begin - (window - 1) : 0;
+        switch (op.code) {
+        case IndicatorOpOpen:
+            loadCandleColumn(dataSeries, &Candle::open, begin, last, out);
+            break;
+        case IndicatorOpHigh:
+            loadCandleColumn(dataSeries, &Candle::high, begin, last, out);
+            break;
+        case IndicatorOpLow:
+            loadCandleColumn(dataSeries, &Candle::low, begin, last, out);
+            break;
+        case IndicatorOpClose:
+            loadCandleColumn(dataSeries, &Candle::close, begin, last, out);
+            break;
+        case IndicatorOpVolume:
+            loadCandleColumn(dataSeries, &Candle::volume, begin, last, out);
+            break;
+        case IndicatorOpConstant:
+            std::fill(out, out + count, op.constant);
+            break;
+        case IndicatorOpAdd:
+            mapColumns(out, input(op.a, begin), input(op.b, begin), count,
+                [](double x, double y) { return x + y; });
+            break;
+        case IndicatorOpSub:
+            mapColumns(out, input(op.a, begin), input(op.b, begin), count,
+                [](double x, double y) { return x - y; });
+            break;
+        case IndicatorOpMul:
+            mapColumns(out, input(op.a, begin), input(op.b, begin), count,
+                [](double x, double y) { return x * y; });
+            break;
+        case IndicatorOpDiv:
+            mapColumns(out, input(op.a, begin), input(op.b, begin), count,
+                [](double x, double y) { return x / y; });
+            break;
+        case IndicatorOpNeg:
+            mapColumn(out, input(op.a, begin), count, [](double x) { return -x; });
+            break;
+        case IndicatorOpAbs:
+            mapColumn(out, input(op.a, begin), count, [](double x) { return std::fabs(x); });
+            break;
+        case IndicatorOpSqrt:
+            mapColumn(out, input(op.a, begin), count, [](double x) { return std::sqrt(x); });
+            break;
+        case IndicatorOpLog:
+            mapColumn(out, input(op.a, begin), count, [](double x) { return std::log(x); });
+            break;
+        case IndicatorOpSma:
+        case IndicatorOpStdev:
+        case IndicatorOpSum:
+            rollingSums(op.code, input(op.a, from), from, begin, last, window, out);
+            break;
+        case IndicatorOpHighest:
+        case IndicatorOpLowest:
+            rollingExtremum(
+                op.code == IndicatorOpHighest,
+                input(op.a, from),
+                from,
+                begin,
+                last,
+                window,
+                &scratch->queue,
+                out
+            );
+            break;
+        case IndicatorOpRef: {
+            const double *x = scratch->columns[op.a].data();
+            uint64_t inputBegin = scratch->columnBegins[op.a];
+            for (uint64_t j = begin; j < last; ++j) {
+                out[j - begin] = j >= window ? x[j - window - inputBegin] : NaN;
+            }
+            break;
+        }
+        }
+    }
+    scratch->values.resize(program.outputs.size());
+    for (size_t e = 0; e < program.outputs.size(); ++e) {
+        std::vector<float> &values = scratch->values[e];
+        values.resize(last - first);
+        const double *x = input(program.outputs[e], first);
+        for (uint64_t i = 0; i < last - first; ++i) {
+            values[i] = x[i];
+        }
+    }
+}
+
+// вычисление всей истории в фоне по снимку ряда, поэтому ряд дописывается
+// без ожидания вычисления; значения свечей до computedSize готовы
+// и больше не меняются, поэтому читаются без блокировки
+struct IndicatorHistory {
+    IndicatorSet *indicatorSet;
+    IndicatorProgram program;
+    DataSeries dataSeries;
+    uint64_t size;
+    std::vector<std::vector<float> > values;
+    QAtomicInteger<quint64> computedSize;
+    QAtomicInteger<int> isAbort;
+    QMutex mutex;
+    QWaitCondition doneCondition;
+    bool isDone;
+
+    void process()
+    {
+        IndicatorScratch scratch;
+        for (uint64_t first = 0; first < size; first += HistoryBlockSize) {
+            uint64_t last = qMin(first + HistoryBlockSize, size);
+            if (isAbort.loadAcquire()) {
+                finish();
+                return;
+            }
+            IndicatorSet::evaluateProgram(program, dataSeries, first, last, &scratch);
+            for (size_t e = 0; e < values.size(); ++e) {
+                std::copy(
+                    scratch.values[e].begin(),
+                    scratch.values[e].end(),
+                    values[e].begin() + first
+                );
+            }
+            computedSize.storeRelease(last);
+        }
+        emit indicatorSet->historyReady();
+        finish();
+    }
+
+    void finish()
+    {
+        QMutexLocker locker(&mutex);
+        isDone = true;
+        doneCondition.wakeAll();
+    }
+
+    void wait()
+    {
+        QMutexLocker locker(&mutex);
+        while (!isDone) {
+            doneCondition.wait(&mutex);
+        }
+    }
+};
+
+class IndicatorHistoryTask : public QRunnable
+{
+public:
+    IndicatorHistoryTask(const std::shared_ptr<IndicatorHistory> &history)
+        : mHistory(history)
+    {
+    }
+
+    void run() override
+    {
+        mHistory->process();
+    }
+private:
+    std::shared_ptr<IndicatorHistory> mHistory;
+};
+
+// значения выражений по свечам [first, last): готовое в истории начало
+// диапазона копируется, остальное считается
+static void evaluateWithHistory(
+    const IndicatorProgram &program,
+    const DataSeries *dataSeries,
+    const IndicatorHistory *history,
+    uint64_t first,
+    uint64_t last,
+    IndicatorScratch *scratch
+)
+{
+    uint64_t computed = history != nullptr ? history->computedSize.loadAcquire() : 0;
+    uint64_t split = qBound(first, computed, last);
+    if (split < last && dataSeries != nullptr) {
+        IndicatorSet::evaluateProgram(program, *dataSeries, split, last, scratch);
+    } else {
+        scratch->values.resize(program.outputs.size());
+        for (std::vector<float> &values : scratch->values) {
+            values.clear();
+        }
+    }
+    for (size_t e = 0; e < scratch->values.size(); ++e) {
+        std::vector<float> &values = scratch->values[e];
+        uint64_t evaluatedCount = values.size();
+        values.resize(last - first, NaN);
+        if (split == first) {
+            continue;
+        }
+        std::copy_backward(
+            values.begin(),
+            values.begin() + evaluatedCount,
+            values.begin() + (split - first) + evaluatedCount
+        );
+        const std::vector<float> &historyValues = history->values[e];
+        std::copy(historyValues.begin() + first, historyValues.begin() + split, values.begin());
+    }
+}
+
+IndicatorSnapshot::IndicatorSnapshot()
+{
+    mIndicatorSet = nullptr;
+    mDataSeries = nullptr;
+}
+
+int IndicatorSnapshot::size() const
+{
+    return mIsOverlay.size();
+}
+
+bool IndicatorSnapshot::isOverlay(int expression) const
+{
+    return mIsOverlay[expression];
+}
+
+void IndicatorSnapshot::evaluate(uint64_t first, uint64_t last, IndicatorScratch *scratch) const
+{
+    if (mIndicatorSet != nullptr) {
+        mIndicatorSet->markHistoryUsed((bool)mHistory);
+    }
+    if (mProgram) {
+        evaluateWithHistory(*mProgram, mDataSeries, mHistory.get(), first, last, scratch);
+    }
+}
+
+uint64_t IndicatorSnapshot::historySize() const
+{
+    return mHistory ? mHistory->computedSize.loadAcquire() : 0;
+}
+
+IndicatorSet::IndicatorSet(QObject *parent)
+    : QObject(parent), mMemory(MemoryIndicators)
+{
+    mDataSeries = nullptr;
+    mProgram = std::make_shared<IndicatorProgram>();
+    mIsHistoryRequested.store(0);
+    // начало диапазонов потом считается при отрисовке, историю можно
+    // запустить заново
+    mMemory.setEvictable([this]() {
+        stopHistory();
+        mHistory.reset();
+    });
+}
+
+IndicatorSet::~IndicatorSet()
+{
+    // фоновое вычисление читает ряд и набор, дождемся его
+    stopHistory();
+}
+
+void IndicatorSet::setDataSeries(const DataSeries *dataSeries)
+{
+    stopHistory();
+    mHistory.reset();
+    mMemory.setUsage(0);
+    mDataSeries = dataSeries;
+}
+
+int IndicatorSet::add(const QString &text, bool isOverlay)
+{
+    // при ошибке программа остается прежней
+    IndicatorProgram program = *mProgram;
+    int output = IndicatorCompiler(text, &program).compile();
+    program.outputs.push_back(output);
+    removeUnusedOps(&program);
+    updateLookbacks(&program);
+    // вычисленная история относится к прежней программе
+    stopHistory();
+    mHistory.reset();
+    mMemory.setUsage(0);
+    mProgram = std::make_shared<IndicatorProgram>(program);
+    mTexts << text;
+    mIsOverlay.push_back(isOverlay);
+    return mTexts.size() - 1;
+}
+
+int IndicatorSet::size() const
+{
+    return mTexts.size();
+}
+
+QString IndicatorSet::text(int expression) const
+{
+    return mTexts.at(expression);
+}
+
+bool IndicatorSet::isOverlay(int expression) const
+{
+    return mIsOverlay[expression];
+}
+
+const IndicatorProgram &IndicatorSet::program() const
+{
+    return *mProgram;
+}
+
+void IndicatorSet::evaluate(uint64_t first, uint64_t last, IndicatorScratch *scratch) const
+{
+    markHistoryUsed((bool)mHistory);
+    evaluateWithHistory(*mProgram, mDataSeries, mHistory.get(), first, last, scratch);
+}
+
+IndicatorSnapshot IndicatorSet::snapshot(const DataSeries *dataSeries) const
+{
+    IndicatorSnapshot snapshot;
+    snapshot.mIndicatorSet = this;
+    snapshot.mDataSeries = dataSeries;
+    snapshot.mProgram = mProgram;
+    snapshot.mIsOverlay = mIsOverlay;
+    snapshot.mHistory = mHistory;
+    return snapshot;
+}
+
+void IndicatorSet::markHistoryUsed(bool hasHistory) const
+{
+    mMemory.touch();
+    if (!hasHistory) {
+        mIsHistoryRequested.storeRelease(1);
+    }
+}
+
+void IndicatorSet::startHistory()
+{
+    stopHistory();
+    mHistory.reset();
+    mMemory.setUsage(0);
+    mIsHistoryRequested.storeRelease(0);
+    if (mDataSeries == nullptr || mProgram->outputs.empty()) {
+        return;
+    }
+    mHistory = std::make_shared<IndicatorHistory>();
+    mHistory->indicatorSet = this;
+    mHistory->program = *mProgram;
+    mHistory->dataSeries = mDataSeries->share();
+    mHistory->size = mHistory->dataSeries.size();
+    mHistory->values.resize(mProgram->outputs.size());
+    for (std::vector<float> &values : mHistory->values) {
+        values.resize(mHistory->size);
+    }
+    mMemory.setUsage(mHistory->values.size() * mHistory->size * sizeof(float));
+    mHistory->computedSize.storeRelease(0);
+    mHistory->isAbort.storeRelease(0);
+    mHistory->isDone = false;
+    QThreadPool::globalInstance()->start(new IndicatorHistoryTask(mHistory));
+}
+
+// вычисленное до остановки остается годным
+void IndicatorSet::stopHistory()
+{
+    if (mHistory) {
+        mHistory->isAbort.storeRelease(1);
+        mHistory->wait();
+    }
+}
+
+bool IndicatorSet::hasHistory() const
+{
+    return (bool)mHistory;
+}
+
+bool IndicatorSet::isHistoryRequested() const
+{
+    return mIsHistoryRequested.loadAcquire() != 0;
+}
+
+uint64_t IndicatorSet::historySize() const
+{
+    return mHistory ? mHistory->computedSize.loadAcquire() : 0;
+}
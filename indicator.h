@@ -0,0 +1,168 @@
+#ifndef INDICATOR_H
+#define INDICATOR_H
+
+#include "core.h"
+#include "memory.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QAtomicInteger>
+
+#include <inttypes.h>
+#include <memory>
+#include <vector>
+
+// операции программы индикаторов, каждая дает столбец значений по свечам
+enum IndicatorOpCode {
+    // колонки свечей
+    IndicatorOpOpen,
+    IndicatorOpHigh,
+    IndicatorOpLow,
+    IndicatorOpClose,
+    IndicatorOpVolume,
+    IndicatorOpConstant,
+    IndicatorOpAdd,
+    IndicatorOpSub,
+    IndicatorOpMul,
+    IndicatorOpDiv,
+    IndicatorOpNeg,
+    IndicatorOpAbs,
+    IndicatorOpSqrt,
+    IndicatorOpLog,
+    // по окну из window свечей: среднее, стандартное отклонение, сумма,
+    // максимум и минимум
+    IndicatorOpSma,
+    IndicatorOpStdev,
+    IndicatorOpSum,
+    IndicatorOpHighest,
+    IndicatorOpLowest,
+    // значение window свечей назад
+    IndicatorOpRef
+};
+
+struct IndicatorOp {
+    IndicatorOpCode code;
+    // номера операций-аргументов, -1 - аргумента нет
+    int a;
+    int b;
+    int window;
+    double constant;
+};
+
+// программа выражений: операции по порядку вычисления, одинаковые
+// подвыражения разных выражений вычисляются одной операцией
+struct IndicatorProgram {
+    std::vector<IndicatorOp> ops;
+    // сколько свечей до начала запрошенного диапазона нужно операции
+    std::vector<uint64_t> lookbacks;
+    // операции, дающие значения выражений
+    std::vector<int> outputs;
+};
+
+// буферы вычисления программы, переиспользуются между вызовами
+struct IndicatorScratch {
+    // столбцы операций и индексы ряда, с которых они начинаются
+    std::vector<std::vector<double> > columns;
+    std::vector<uint64_t> columnBegins;
+    // монотонная очередь индексов для максимума и минимума
+    std::vector<uint64_t> queue;
+    // значения выражений по свечам [first, last) последнего вычисления
+    std::vector<std::vector<float> > values;
+};
+
+struct IndicatorHistory;
+class IndicatorSet;
+
+// индикаторы на момент снимка для отрисовки в другом потоке: программа
+// и вычисленная история разделяются с набором, поэтому набор меняется
+// и его история выбрасывается, пока по снимку рисуют; значения считаются
+// по снимку ряда; набор и ряд должны жить дольше снимка
+class IndicatorSnapshot {
+public:
+    IndicatorSnapshot();
+    int size() const;
+    bool isOverlay(int expression) const;
+    // как у IndicatorSet, использование и нехватка истории отмечаются
+    // у набора
+    void evaluate(uint64_t first, uint64_t last, IndicatorScratch *scratch) const;
+    uint64_t historySize() const;
+private:
+    friend class IndicatorSet;
+
+    const IndicatorSet *mIndicatorSet;
+    const DataSeries *mDataSeries;
+    std::shared_ptr<const IndicatorProgram> mProgram;
+    std::vector<bool> mIsOverlay;
+    std::shared_ptr<const IndicatorHistory> mHistory;
+};
+
+// пользовательские индикаторы - выражения над колонками свечей, например
+// (close - sma(close, 20)) / stdev(close, 20): выражение разбирается один раз
+// и компилируется в программу, которая вычисляется столбцами по диапазону
+// свечей, а не обходом дерева по каждой свече; сначала считается только
+// запрошенный (видимый) диапазон с нужной ему историей, вся история
+// считается в фоне, и готовые ее значения потом просто копируются; при
+// нехватке бюджета памяти вычисленная история выбрасывается
+class IndicatorSet : public QObject
+{
+    Q_OBJECT
+public:
+    IndicatorSet(QObject *parent = nullptr);
+    ~IndicatorSet();
+    // ряд должен жить дольше набора, история считается по снимку ряда
+    // (DataSeries::share), поэтому ряд дописывается, пока она считается
+    void setDataSeries(const DataSeries *dataSeries);
+    // разбор и компиляция выражения, номер выражения,
+    // std::logic_error с описанием ошибки при неверном выражении;
+    // isOverlay - рисовать в ценах свечей, иначе в своем масштабе
+    int add(const QString &text, bool isOverlay);
+    int size() const;
+    QString text(int expression) const;
+    bool isOverlay(int expression) const;
+    const IndicatorProgram &program() const;
+    // значения всех выражений по свечам ряда [first, last)
+    // в scratch->values, NaN - значения нет (не хватает истории),
+    // отмечает историю использованной, а выброшенную - нужной отрисовке
+    void evaluate(uint64_t first, uint64_t last, IndicatorScratch *scratch) const;
+    // снимок набора, значения которого считаются по снимку ряда dataSeries
+    IndicatorSnapshot snapshot(const DataSeries *dataSeries) const;
+    // фоновое вычисление всей истории ряда на момент запуска
+    void startHistory();
+    void stopHistory();
+    // запущено ли вычисление истории и не выброшена ли она
+    bool hasHistory() const;
+    // выброшенная история понадобилась отрисовке и ее стоит запустить заново
+    bool isHistoryRequested() const;
+    // кол-во свечей от начала ряда, по которым значения уже вычислены
+    uint64_t historySize() const;
+
+    // вычисление программы по свечам ряда [first, last)
+    static void evaluateProgram(
+        const IndicatorProgram &program,
+        const DataSeries &dataSeries,
+        uint64_t first,
+        uint64_t last,
+        IndicatorScratch *scratch
+    );
+signals:
+    // вся история вычислена, вызывается из фонового потока
+    void historyReady();
+private:
+    friend class IndicatorSnapshot;
+
+    // отметить историю использованной, а выброшенную - нужной отрисовке
+    void markHistoryUsed(bool hasHistory) const;
+
+    const DataSeries *mDataSeries;
+    // заменяется целиком при добавлении выражения, снимки делят программу
+    std::shared_ptr<const IndicatorProgram> mProgram;
+    QStringList mTexts;
+    std::vector<bool> mIsOverlay;
+    std::shared_ptr<IndicatorHistory> mHistory;
+    // отмечается в потоке отрисовки, сбрасывается запуском истории
+    mutable QAtomicInteger<int> mIsHistoryRequested;
+    MemoryAccount mMemory;
+};
+
+#endif // INDICATOR_H
@@ -0,0 +1,671 @@
+#include "loadbench.h"
+#include "reader.h"
+#include "dialect.h"
+#include "decompressor.h"
+#include "alloccounter.h"
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef CHARTIST_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CHARTIST_ZSTD
+#include <zstd.h>
+#endif
+
+// размер блока, которым сгенерированные строки пишутся в файл
+static const int writeBlockSize = 1 << 20;
+
+// форматы, в которых генерируются файлы
+enum BenchDialect {
+    BenchNative,
+    BenchFinam,
+    BenchMetaTrader,
+    BenchYahoo,
+    BenchUnixTime,
+    BenchDialectCount
+};
+
+static const char *const benchDialectNames[BenchDialectCount] = {
+    "native",
+    "finam",
+    "metatrader",
+    "yahoo",
+    "unixtime"
+};
+
+static const char *benchDialectHeader(BenchDialect dialect)
+{
+    switch (dialect) {
+    case BenchFinam:
+        return FinamDialect::header();
+    case BenchMetaTrader:
+        return MetaTraderDialect::header();
+    case BenchYahoo:
+        return YahooDialect::header();
+    case BenchUnixTime:
+        return UnixTimeDialect::header();
+    default:
+        return NativeDialect::header();
+    }
+}
+
+static const char *const compressionNames[] = {"none", "gzip", "zstd"};
+
+// запись файла с данными со сжатием или без
+class BenchFileWriter
+{
+public:
+    BenchFileWriter(const QString &fileName, Decompressor::Format format)
+        : mFile(fileName), mFormat(format)
+    {
+#ifdef CHARTIST_ZLIB
+        mGzip = nullptr;
+#endif
+#ifdef CHARTIST_ZSTD
+        mZstd = nullptr;
+#endif
+        if (format == Decompressor::Gzip) {
+#ifdef CHARTIST_ZLIB
+            mGzip = gzopen(QFile::encodeName(fileName).constData(), "wb6");
+            if (mGzip == nullptr) {
+                throw std::runtime_error("Can't create benchmark file");
+            }
+            return;
+#endif
+        }
+        if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            throw std::runtime_error("Can't create benchmark file");
+        }
+#ifdef CHARTIST_ZSTD
+        if (format == Decompressor::Zstd) {
+            mZstd = ZSTD_createCCtx();
+            mZstdBuffer.resize(ZSTD_CStreamOutSize());
+        }
+#endif
+    }
+
+    ~BenchFileWriter()
+    {
+#ifdef CHARTIST_ZLIB
+        if (mGzip != nullptr) {
+            gzclose(mGzip);
+        }
+#endif
+#ifdef CHARTIST_ZSTD
+        if (mZstd != nullptr) {
+            ZSTD_freeCCtx(mZstd);
+        }
+#endif
+    }
+
+    void write(const char *data, size_t size, bool isLast)
+    {
+#ifdef CHARTIST_ZLIB
+        if (mGzip != nullptr) {
+            if (size > 0 && gzwrite(mGzip, data, size) != (int)size) {
+                throw std::runtime_error("Can't write benchmark file");
+            }
+            if (isLast) {
+                int result = gzclose(mGzip);
+                mGzip = nullptr;
+                if (result != Z_OK) {
+                    throw std::runtime_error("Can't write benchmark file");
+                }
+            }
+            return;
+        }
+#endif
+#ifdef CHARTIST_ZSTD
+        if (mZstd != nullptr) {
+            ZSTD_inBuffer input = {data, size, 0};
+            ZSTD_EndDirective mode = isLast ? ZSTD_e_end : ZSTD_e_continue;
+            bool isDone = false;
+            while (!isDone) {
+                ZSTD_outBuffer output = {mZstdBuffer.data(), mZstdBuffer.size(), 0};
+                size_t remaining = ZSTD_compressStream2(mZstd, &output, &input, mode);
+                if (ZSTD_isError(remaining)) {
+                    throw std::runtime_error("Can't compress benchmark file");
+                }
+                writeFile(mZstdBuffer.data(), output.pos);
+                isDone = isLast ? remaining == 0 : input.pos == input.size;
+            }
+            if (isLast) {
+                mFile.close();
+            }
+            return;
+        }
+#endif
+        writeFile(data, size);
+        if (isLast) {
+            mFile.close();
+        }
+    }
+private:
+    void writeFile(const char *data, size_t size)
+    {
+        if (size > 0 && mFile.write(data, size) != (qint64)size) {
+            throw std::runtime_error("Can't write benchmark file");
+        }
+    }
+
+    QFile mFile;
+    Decompressor::Format mFormat;
+#ifdef CHARTIST_ZLIB
+    gzFile mGzip;
+#endif
+#ifdef CHARTIST_ZSTD
+    ZSTD_CCtx *mZstd;
+    std::vector<char> mZstdBuffer;
+#endif
+};
+
+static inline char *appendUnsigned(char *pos, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) {
+        *pos++ = digits[--count];
+    }
+    return pos;
+}
+
+// value ровно в width цифр с ведущими нулями
+static inline char *appendDigits(char *pos, uint64_t value, int width)
+{
+    for (int i = width - 1; i >= 0; --i) {
+        pos[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return pos + width;
+}
+
+// цена в копейках как 123.45
+static inline char *appendPrice(char *pos, uint64_t cents)
+{
+    pos = appendUnsigned(pos, cents / 100);
+    *pos++ = '.';
+    return appendDigits(pos, cents % 100, 2);
+}
+
+// минутные свечи случайного блуждания с постоянным зерном,
+// поэтому файл с теми же параметрами всегда одинаковый
+class BenchCandleGenerator
+{
+public:
+    BenchCandleGenerator() : mRandom(1)
+    {
+        mPrice = 10000;
+        // 2017-01-02 10:00:00
+        mSeconds = 1483351200;
+    }
+
+    // строка свечи в формате dialect без перевода строки, возвращает конец
+    char *nextLine(BenchDialect dialect, char *pos)
+    {
+        uint64_t open = mPrice;
+        uint64_t close = step(open);
+        uint64_t high = qMax(open, close) + mRandom.next() % 20;
+        uint64_t low = qMin(open, close) - mRandom.next() % 20;
+        uint64_t volume = 1 + mRandom.next() % 10000;
+        mPrice = close;
+        uint64_t date, time;
+        unixTimeToDateTime(mSeconds, &date, &time);
+        char delimiter = dialect == BenchMetaTrader ? '\t' : ',';
+        switch (dialect) {
+        case BenchFinam:
+            memcpy(pos, "BENCH,1,", 8);
+            pos += 8;
+            // дальше как в формате по умолчанию
+        case BenchNative:
+            pos = appendDigits(pos, date, 8);
+            *pos++ = ',';
+            pos = appendDigits(pos, time, 6);
+            break;
+        case BenchMetaTrader:
+            pos = appendDigits(pos, date / 10000, 4);
+            *pos++ = '.';
+            pos = appendDigits(pos, date / 100 % 100, 2);
+            *pos++ = '.';
+            pos = appendDigits(pos, date % 100, 2);
+            *pos++ = '\t';
+            pos = appendDigits(pos, time / 10000, 2);
+            *pos++ = ':';
+            pos = appendDigits(pos, time / 100 % 100, 2);
+            *pos++ = ':';
+            pos = appendDigits(pos, time % 100, 2);
+            break;
+        case BenchYahoo:
+            pos = appendDigits(pos, date / 10000, 4);
+            *pos++ = '-';
+            pos = appendDigits(pos, date / 100 % 100, 2);
+            *pos++ = '-';
+            pos = appendDigits(pos, date % 100, 2);
+            break;
+        default:
+            pos = appendUnsigned(pos, mSeconds);
+            break;
+        }
+        uint64_t prices[4] = {open, high, low, close};
+        for (int i = 0; i < 4; ++i) {
+            *pos++ = delimiter;
+            pos = appendPrice(pos, prices[i]);
+        }
+        if (dialect == BenchYahoo) {
+            // скорректированное закрытие
+            *pos++ = delimiter;
+            pos = appendPrice(pos, close);
+        }
+        if (dialect == BenchMetaTrader) {
+            // тиковый объем
+            *pos++ = delimiter;
+            pos = appendUnsigned(pos, volume / 10);
+        }
+        *pos++ = delimiter;
+        pos = appendUnsigned(pos, volume);
+        if (dialect == BenchMetaTrader) {
+            // спред
+            *pos++ = delimiter;
+            *pos++ = '0';
+        }
+        mSeconds += 60;
+        return pos;
+    }
+private:
+    // следующая цена, не ниже 1 рубля
+    uint64_t step(uint64_t price)
+    {
+        int64_t next = (int64_t)price + (int64_t)(mRandom.next() % 41) - 20;
+        return next < 100 ? 100 : next;
+    }
+
+    BenchRandom mRandom;
+    uint64_t mPrice;
+    uint64_t mSeconds;
+};
+
+// генерация файла, возвращает размер несжатого текста
+static uint64_t generateFile(
+    const QString &fileName,
+    uint64_t rows,
+    BenchDialect dialect,
+    bool isCrlf,
+    Decompressor::Format format
+)
+{
+    BenchFileWriter writer(fileName, format);
+    std::vector<char> block(writeBlockSize + 256);
+    char *pos = block.data();
+    const char *lineEnd = isCrlf ? "\r\n" : "\n";
+    int lineEndSize = isCrlf ? 2 : 1;
+    uint64_t textSize = 0;
+    const char *header = benchDialectHeader(dialect);
+    if (header != nullptr) {
+        size_t headerSize = strlen(header);
+        memcpy(pos, header, headerSize);
+        pos += headerSize;
+        memcpy(pos, lineEnd, lineEndSize);
+        pos += lineEndSize;
+    }
+    BenchCandleGenerator generator;
+    for (uint64_t row = 0; row < rows; ++row) {
+        pos = generator.nextLine(dialect, pos);
+        memcpy(pos, lineEnd, lineEndSize);
+        pos += lineEndSize;
+        if (pos - block.data() >= writeBlockSize) {
+            writer.write(block.data(), pos - block.data(), false);
+            textSize += pos - block.data();
+            pos = block.data();
+        }
+    }
+    writer.write(block.data(), pos - block.data(), true);
+    textSize += pos - block.data();
+    return textSize;
+}
+
+// значение в kB из /proc/self/status, -1 вне Linux
+static qint64 processStatusValue(const char *key)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    QList<QByteArray> lines = status.readAll().split('\n');
+    size_t keySize = strlen(key);
+    for (const QByteArray &line : lines) {
+        if (line.startsWith(key) && line.size() > (int)keySize && line.at(keySize) == ':') {
+            QByteArray value = line.mid(keySize + 1).trimmed();
+            int space = value.indexOf(' ');
+            return (space >= 0 ? value.left(space) : value).toLongLong();
+        }
+    }
+    return -1;
+}
+
+// сбросить пик памяти процесса до текущей (Linux 4.0 и новее)
+static void resetPeakMemory()
+{
+    QFile clearRefs("/proc/self/clear_refs");
+    if (clearRefs.open(QIODevice::WriteOnly)) {
+        clearRefs.write("5");
+    }
+}
+
+// список значений через запятую
+static bool parseList(const QString &text, const QStringList &allowed, QStringList *values)
+{
+    *values = text.split(',', Qt::SkipEmptyParts);
+    if (values->isEmpty()) {
+        return false;
+    }
+    for (const QString &value : *values) {
+        if (!allowed.isEmpty() && !allowed.contains(value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseNumbers(
+    const QString &text,
+    uint64_t min,
+    uint64_t max,
+    std::vector<uint64_t> *numbers
+)
+{
+    QStringList values;
+    if (!parseList(text, QStringList(), &values)) {
+        return false;
+    }
+    numbers->clear();
+    for (const QString &value : values) {
+        bool isValid = false;
+        uint64_t number = value.toULongLong(&isValid);
+        if (!isValid || number < min || number > max) {
+            return false;
+        }
+        numbers->push_back(number);
+    }
+    return true;
+}
+
+bool LoadBenchmark::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--bench-load");
+}
+
+int LoadBenchmark::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist data loading benchmark");
+    parser.addHelpOption();
+    QCommandLineOption benchOption(
+        "bench-load",
+        "Generate data files and measure how fast they are loaded."
+    );
+    QCommandLineOption rowsOption(
+        "rows",
+        "Comma separated row counts of generated files.",
+        "n,...",
+        "10000,100000,1000000"
+    );
+    QCommandLineOption dialectsOption(
+        "dialects",
+        "Comma separated formats: native, finam, metatrader, yahoo, unixtime.",
+        "names",
+        "native,finam,metatrader,yahoo,unixtime"
+    );
+    QCommandLineOption lineEndsOption(
+        "line-ends",
+        "Comma separated line ends: lf, crlf.",
+        "names",
+        "lf,crlf"
+    );
+    QCommandLineOption compressionOption(
+        "compression",
+        "Comma separated compression: none, gzip, zstd (all supported by default).",
+        "names"
+    );
+    QCommandLineOption partSizesOption(
+        "part-sizes",
+        "Comma separated numbers of candles appended at once by the reader.",
+        "n,...",
+        "256"
+    );
+    QCommandLineOption repeatOption(
+        "repeat",
+        "Loads of each file.",
+        "n",
+        "3"
+    );
+    QCommandLineOption dirOption(
+        "dir",
+        "Directory for generated files.",
+        "dir",
+        QDir(QDir::tempPath()).filePath("chartist-bench")
+    );
+    QCommandLineOption keepOption("keep", "Keep generated files.");
+    parser.addOption(benchOption);
+    parser.addOption(rowsOption);
+    parser.addOption(dialectsOption);
+    parser.addOption(lineEndsOption);
+    parser.addOption(compressionOption);
+    parser.addOption(partSizesOption);
+    parser.addOption(repeatOption);
+    parser.addOption(dirOption);
+    parser.addOption(keepOption);
+    parser.process(arguments);
+
+    std::vector<uint64_t> rowCounts, partSizes, repeats;
+    if (!parseNumbers(parser.value(rowsOption), 1, 1ULL << 40, &rowCounts)) {
+        printMessage("Invalid row counts: " + parser.value(rowsOption));
+        return 1;
+    }
+    if (!parseNumbers(parser.value(partSizesOption), 1, 65535, &partSizes)) {
+        printMessage("Invalid part sizes: " + parser.value(partSizesOption));
+        return 1;
+    }
+    if (!parseNumbers(parser.value(repeatOption), 1, 1000, &repeats) || repeats.size() != 1) {
+        printMessage("Invalid repeat count: " + parser.value(repeatOption));
+        return 1;
+    }
+    QStringList allDialects;
+    for (int i = 0; i < BenchDialectCount; ++i) {
+        allDialects << benchDialectNames[i];
+    }
+    QStringList dialects, lineEnds, compressions;
+    if (!parseList(parser.value(dialectsOption), allDialects, &dialects)) {
+        printMessage("Invalid formats: " + parser.value(dialectsOption));
+        return 1;
+    }
+    if (!parseList(parser.value(lineEndsOption), QStringList() << "lf" << "crlf", &lineEnds)) {
+        printMessage("Invalid line ends: " + parser.value(lineEndsOption));
+        return 1;
+    }
+    QStringList allCompressions;
+    allCompressions << compressionNames[Decompressor::NoCompression];
+    if (Decompressor::isSupported(Decompressor::Gzip)) {
+        allCompressions << compressionNames[Decompressor::Gzip];
+    }
+    if (Decompressor::isSupported(Decompressor::Zstd)) {
+        allCompressions << compressionNames[Decompressor::Zstd];
+    }
+    if (!parser.isSet(compressionOption)) {
+        compressions = allCompressions;
+    } else if (!parseList(parser.value(compressionOption), allCompressions, &compressions)) {
+        printMessage("Invalid or unsupported compression: " + parser.value(compressionOption));
+        return 1;
+    }
+    QDir dir(parser.value(dirOption));
+    if (!dir.mkpath(".")) {
+        printMessage("Can't create directory " + parser.value(dirOption));
+        return 1;
+    }
+
+    // результаты - по строке JSON на загрузку
+    QTextStream output(stdout);
+    for (uint64_t rows : rowCounts) {
+        for (const QString &dialectName : dialects) {
+            BenchDialect dialect = (BenchDialect)allDialects.indexOf(dialectName);
+            for (const QString &lineEnd : lineEnds) {
+                for (const QString &compressionName : compressions) {
+                    Decompressor::Format format = compressionName == "gzip" ?
+                        Decompressor::Gzip :
+                        compressionName == "zstd" ? Decompressor::Zstd : Decompressor::NoCompression;
+                    QString fileName = dir.filePath(
+                        QString("bench_%1_%2_%3.csv%4")
+                            .arg(rows)
+                            .arg(dialectName)
+                            .arg(lineEnd)
+                            .arg(format == Decompressor::Gzip ? ".gz" :
+                                format == Decompressor::Zstd ? ".zst" : "")
+                    );
+                    uint64_t textSize = 0;
+                    try {
+                        printMessage("Generating " + fileName);
+                        textSize = generateFile(fileName, rows, dialect, lineEnd == "crlf", format);
+                    } catch (const std::exception &e) {
+                        printMessage(fileName + ": " + QString::fromLocal8Bit(e.what()));
+                        return 2;
+                    }
+                    qint64 fileSize = QFileInfo(fileName).size();
+                    for (uint64_t partSize : partSizes) {
+                        for (uint64_t repeat = 0; repeat < repeats[0]; ++repeat) {
+                            resetPeakMemory();
+                            qint64 rssBefore = processStatusValue("VmRSS");
+                            uint64_t loadedRows = 0;
+                            uint64_t allocations = 0;
+                            uint64_t seriesBytes = 0;
+                            uint64_t indexBytes = 0;
+                            QElapsedTimer timer;
+                            timer.start();
+                            try {
+                                AllocationScope allocationScope;
+                                DataSeries dataSeries;
+                                Reader::readFromFile(fileName, &dataSeries, partSize);
+                                loadedRows = dataSeries.size();
+                                allocations = allocationScope.count();
+                                seriesBytes = dataSeries.memoryUsage();
+                                indexBytes = dataSeries.indexMemoryUsage();
+                            } catch (const std::exception &e) {
+                                printMessage(fileName + ": " + QString::fromLocal8Bit(e.what()));
+                                return 2;
+                            }
+                            double seconds = timer.nsecsElapsed() / 1e9;
+                            qint64 peakRss = processStatusValue("VmHWM");
+                            if (loadedRows != rows) {
+                                printMessage(
+                                    QString("%1: %2 rows loaded instead of %3")
+                                        .arg(fileName)
+                                        .arg(loadedRows)
+                                        .arg(rows)
+                                );
+                                return 2;
+                            }
+                            output << "{\"benchmark\":\"load\""
+                                << ",\"rows\":" << (quint64)rows
+                                << ",\"dialect\":\"" << dialectName << "\""
+                                << ",\"line_end\":\"" << lineEnd << "\""
+                                << ",\"compression\":\"" << compressionName << "\""
+                                << ",\"part_size\":" << (quint64)partSize
+                                << ",\"repeat\":" << (quint64)repeat
+                                << ",\"file_bytes\":" << fileSize
+                                << ",\"csv_bytes\":" << (quint64)textSize
+                                << ",\"seconds\":" << QString::number(seconds, 'f', 6)
+                                << ",\"csv_mb_per_s\":"
+                                << QString::number(textSize / 1e6 / seconds, 'f', 1)
+                                << ",\"rows_per_s\":"
+                                << QString::number(rows / seconds, 'f', 0)
+                                << ",\"rss_before_kb\":" << rssBefore
+                                << ",\"peak_rss_kb\":" << peakRss
+                                << ",\"series_bytes\":" << (quint64)seriesBytes
+                                << ",\"index_bytes\":" << (quint64)indexBytes
+                                << ",\"allocations\":";
+                            if (isAllocationCountEnabled()) {
+                                output << (quint64)allocations;
+                            } else {
+                                output << "null";
+                            }
+                            output << "}\n";
+                            output.flush();
+                        }
+                    }
+                    // ленивое открытие несжатого файла: время до первого кадра
+                    // (последние строки и выборка) и до разбора всего файла
+                    for (
+                        uint64_t repeat = 0;
+                        format == Decompressor::NoCompression && repeat < repeats[0];
+                        ++repeat
+                    ) {
+                        uint64_t tailRows = 0;
+                        uint64_t sampleRows = 0;
+                        uint64_t estimatedRows = 0;
+                        uint64_t loadedRows = 0;
+                        double openSeconds = 0;
+                        QElapsedTimer timer;
+                        timer.start();
+                        try {
+                            DataSeries tail;
+                            std::vector<Candle> samples;
+                            LazyReader reader;
+                            reader.open(fileName, &tail, &samples);
+                            openSeconds = timer.nsecsElapsed() / 1e9;
+                            tailRows = tail.size();
+                            sampleRows = samples.size();
+                            estimatedRows = reader.estimatedSize();
+                            if (!reader.error().isEmpty()) {
+                                throw std::runtime_error(reader.error().toStdString());
+                            }
+                            loadedRows = reader.takeSeries().size();
+                        } catch (const std::exception &e) {
+                            printMessage(fileName + ": " + QString::fromLocal8Bit(e.what()));
+                            return 2;
+                        }
+                        double seconds = timer.nsecsElapsed() / 1e9;
+                        if (loadedRows != rows) {
+                            printMessage(
+                                QString("%1: %2 rows loaded lazily instead of %3")
+                                    .arg(fileName)
+                                    .arg(loadedRows)
+                                    .arg(rows)
+                            );
+                            return 2;
+                        }
+                        output << "{\"benchmark\":\"lazy_open\""
+                            << ",\"rows\":" << (quint64)rows
+                            << ",\"dialect\":\"" << dialectName << "\""
+                            << ",\"line_end\":\"" << lineEnd << "\""
+                            << ",\"repeat\":" << (quint64)repeat
+                            << ",\"file_bytes\":" << fileSize
+                            << ",\"open_seconds\":" << QString::number(openSeconds, 'f', 6)
+                            << ",\"seconds\":" << QString::number(seconds, 'f', 6)
+                            << ",\"tail_rows\":" << (quint64)tailRows
+                            << ",\"sample_rows\":" << (quint64)sampleRows
+                            << ",\"estimated_rows\":" << (quint64)estimatedRows
+                            << "}\n";
+                        output.flush();
+                    }
+                    if (!parser.isSet(keepOption)) {
+                        QFile::remove(fileName);
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
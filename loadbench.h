@@ -0,0 +1,20 @@
+#ifndef LOADBENCH_H
+#define LOADBENCH_H
+
+#include <QString>
+#include <QStringList>
+
+// замер загрузки файлов (Reader::readFromFile и DataSeries::append):
+// генерирует одинаковые от запуска к запуску файлы свечей разных размеров,
+// форматов, переводов строк и сжатия, загружает каждый и печатает время,
+// скорость, пиковую память и кол-во выделений памяти строками JSON
+class LoadBenchmark
+{
+public:
+    // запрошен ли замер в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // замер по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+};
+
+#endif // LOADBENCH_H
@@ -0,0 +1,140 @@
+#include "lod.h"
+#include "core.h"
+
+#include <math.h>
+
+static inline void mergeCandle(CandleRange *range, const Candle &candle)
+{
+    if (candle.high > range->high) {
+        range->high = candle.high;
+    }
+    if (candle.low < range->low) {
+        range->low = candle.low;
+    }
+    if (candle.volume > range->maxVolume) {
+        range->maxVolume = candle.volume;
+    }
+}
+
+static inline void mergeRange(CandleRange *range, const CandleRange &other)
+{
+    if (other.high > range->high) {
+        range->high = other.high;
+    }
+    if (other.low < range->low) {
+        range->low = other.low;
+    }
+    if (other.maxVolume > range->maxVolume) {
+        range->maxVolume = other.maxVolume;
+    }
+}
+
+static inline CandleRange emptyRange()
+{
+    CandleRange range;
+    range.high = 0;
+    range.low = INFINITY;
+    range.maxVolume = 0;
+    return range;
+}
+
+DecimationIndex::DecimationIndex()
+{
+    mIndexedSize = 0;
+}
+
+void DecimationIndex::clear()
+{
+    mLevels.clear();
+    mIndexedSize = 0;
+}
+
+uint64_t DecimationIndex::memoryUsage() const
+{
+    uint64_t bytes = mLevels.capacity() * sizeof(Level);
+    for (const Level &level : mLevels) {
+        bytes += level.memoryUsage();
+    }
+    return bytes;
+}
+
+void DecimationIndex::update(const DataSeries &dataSeries)
+{
+    uint64_t size = dataSeries.size();
+    if (mLevels.empty()) {
+        mLevels.push_back(Level());
+    }
+    // нижний уровень: только полностью заполненные блоки,
+    // неполный хвост при запросе просматривается напрямую
+    uint64_t blockCount = size / BlockSize;
+    Level &blocks = mLevels[0];
+    for (uint64_t b = blocks.size(); b < blockCount; ++b) {
+        CandleRange range = emptyRange();
+        for (uint64_t i = b * BlockSize; i < (b + 1) * BlockSize; ++i) {
+            mergeCandle(&range, dataSeries.at(i));
+        }
+        blocks.push_back(range);
+    }
+    // верхние уровни: каждый узел объединяет два узла уровня ниже
+    for (size_t level = 1; mLevels[level - 1].size() >= 2; ++level) {
+        if (level == mLevels.size()) {
+            mLevels.push_back(Level());
+        }
+        const Level &lower = mLevels[level - 1];
+        Level &upper = mLevels[level];
+        for (uint64_t n = upper.size(); n < lower.size() / 2; ++n) {
+            CandleRange range = lower[2 * n];
+            mergeRange(&range, lower[2 * n + 1]);
+            upper.push_back(range);
+        }
+    }
+    mIndexedSize = size;
+}
+
+CandleRange DecimationIndex::query(
+    const DataSeries &dataSeries,
+    uint64_t first,
+    uint64_t last
+) const
+{
+    CandleRange range = emptyRange();
+    if (last > mIndexedSize) {
+        last = mIndexedSize;
+    }
+    if (first >= last) {
+        return range;
+    }
+    uint64_t blockCount = mLevels.empty() ? 0 : mLevels[0].size();
+    uint64_t firstBlock = (first + BlockSize - 1) / BlockSize;
+    uint64_t lastBlock = last / BlockSize;
+    if (lastBlock > blockCount) {
+        lastBlock = blockCount;
+    }
+    if (firstBlock >= lastBlock) {
+        // диапазон не покрывает ни одного блока целиком
+        for (uint64_t i = first; i < last; ++i) {
+            mergeCandle(&range, dataSeries.at(i));
+        }
+        return range;
+    }
+    // края диапазона, не попавшие в целые блоки
+    for (uint64_t i = first; i < firstBlock * BlockSize; ++i) {
+        mergeCandle(&range, dataSeries.at(i));
+    }
+    for (uint64_t i = lastBlock * BlockSize; i < last; ++i) {
+        mergeCandle(&range, dataSeries.at(i));
+    }
+    // целые блоки собираем снизу вверх по пирамиде
+    for (size_t level = 0; firstBlock < lastBlock; ++level) {
+        const Level &nodes = mLevels[level];
+        if (firstBlock & 1) {
+            mergeRange(&range, nodes[firstBlock++]);
+        }
+        if (lastBlock & 1) {
+            mergeRange(&range, nodes[--lastBlock]);
+        }
+        firstBlock /= 2;
+        lastBlock /= 2;
+    }
+    return range;
+}
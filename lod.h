@@ -0,0 +1,43 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "chunkedvector.h"
+
+#include <inttypes.h>
+#include <vector>
+
+struct Candle;
+class DataSeries;
+
+// сводные значения по диапазону свечей
+struct CandleRange {
+    float high;
+    float low;
+    float maxVolume;
+};
+
+// пирамида минимумов и максимумов по блокам свечей,
+// отвечает на запрос по любому диапазону за O(log n);
+// уровни хранятся блоками, поэтому копия индекса их разделяет
+class DecimationIndex {
+public:
+    DecimationIndex();
+    // достроить индекс по добавленным в конец свечам
+    void update(const DataSeries &dataSeries);
+    // сводные значения по свечам [first, last)
+    CandleRange query(const DataSeries &dataSeries, uint64_t first, uint64_t last) const;
+    void clear();
+    // занятая индексом память в байтах
+    uint64_t memoryUsage() const;
+private:
+    // кол-во свечей в блоке нижнего уровня пирамиды (степень двойки)
+    static const uint64_t BlockSize = 16;
+    // кол-во узлов в блоке уровня
+    static const uint64_t LevelChunkSize = 1 << 14;
+    typedef ChunkedVector<CandleRange, LevelChunkSize> Level;
+
+    std::vector<Level> mLevels;
+    uint64_t mIndexedSize;
+};
+
+#endif // LOD_H
@@ -1,17 +1,125 @@
 #include "window.h"
+#include "exporter.h"
+#include "replay.h"
+#include "correlation.h"
+#include "backtest.h"
+#include "loadbench.h"
+#include "alert.h"
+#include "memory.h"
+#include "framebench.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+#include <QGuiApplication>
 #include <QSurfaceFormat>
 
 int main(int argc, char *argv[])
 {
+    // пакетный экспорт графиков в PNG работает без дисплея
+    if (Exporter::isRequested(argc, argv)) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication app(argc, argv);
+        return Exporter::run(app.arguments());
+    }
+
+    // замер выделений памяти в кадрах, где двигаются только оси мышки
+    if (FrameBenchmark::isRequested(argc, argv)) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication app(argc, argv);
+        return FrameBenchmark::run(app.arguments());
+    }
+
+    // повтор файла с данными для графика, запущенного с --feed
+    if (Replay::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return Replay::run(app.arguments());
+    }
+
+    // таблица корреляций между файлами с данными в CSV
+    if (CorrelationReport::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return CorrelationReport::run(app.arguments());
+    }
+
+    // перебор параметров стратегии по файлу с данными
+    if (Backtest::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return Backtest::run(app.arguments());
+    }
+
+    // замер загрузки сгенерированных файлов с данными
+    if (LoadBenchmark::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return LoadBenchmark::run(app.arguments());
+    }
+
+    // замер проверки оповещений на дописываемых свечах
+    if (AlertBenchmark::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return AlertBenchmark::run(app.arguments());
+    }
+
     QApplication app(argc, argv);
 
     QSurfaceFormat fmt;
     fmt.setSamples(4);
     QSurfaceFormat::setDefaultFormat(fmt);
 
-    Window window;
+    // файлы с данными можно передать первыми аргументами, несколько файлов
+    // одного инструмента сливаются в один ряд, свечи с одним временем
+    // сводятся по --duplicates first|last|combine (по умолчанию last),
+    // с --feed port свечи принимаются от повтора,
+    // с --strategy ma:10:50 на графике показываются сделки стратегии,
+    // --indicator expr и --overlay expr добавляют индикаторы по выражениям
+    // в своем масштабе и в ценах свечей, --alert cross:123.5 добавляет
+    // оповещение, проверяемое на свечах от повтора, --memory-budget mb
+    // ограничивает память, сверх которой выбрасываются производные данные
+    QStringList arguments = app.arguments();
+    quint16 feedPort = 0;
+    int feedIndex = arguments.indexOf("--feed");
+    if (feedIndex >= 0) {
+        feedPort = feedIndex + 1 < arguments.size() ?
+            arguments.at(feedIndex + 1).toUShort() : 5555;
+    }
+    BacktestParams strategy;
+    int strategyIndex = arguments.indexOf("--strategy");
+    bool isStrategyValid = strategyIndex >= 0 &&
+        strategyIndex + 1 < arguments.size() &&
+        Backtest::parseParams(arguments.at(strategyIndex + 1), &strategy);
+    QStringList fileNames;
+    for (int i = 1; feedIndex < 0 && i < arguments.size(); ++i) {
+        if (arguments.at(i).startsWith("--")) {
+            break;
+        }
+        fileNames << arguments.at(i);
+    }
+    DuplicatePolicy duplicatePolicy = DuplicateKeepLast;
+    int duplicatesIndex = arguments.indexOf("--duplicates");
+    if (duplicatesIndex >= 0 && duplicatesIndex + 1 < arguments.size()) {
+        QString policy = arguments.at(duplicatesIndex + 1);
+        if (policy == "first") {
+            duplicatePolicy = DuplicateKeepFirst;
+        } else if (policy == "combine") {
+            duplicatePolicy = DuplicateCombine;
+        }
+    }
+    int budgetIndex = arguments.indexOf("--memory-budget");
+    if (budgetIndex >= 0 && budgetIndex + 1 < arguments.size()) {
+        MemoryBudget::setLimit(arguments.at(budgetIndex + 1).toULongLong() * 1000000);
+    }
+    Window window(fileNames, feedPort, duplicatePolicy);
+    if (isStrategyValid) {
+        window.showBacktest(strategy);
+    }
+    for (int i = 1; i + 1 < arguments.size(); ++i) {
+        if (arguments.at(i) == "--indicator" || arguments.at(i) == "--overlay") {
+            window.addIndicator(arguments.at(i + 1), arguments.at(i) == "--overlay");
+            ++i;
+        } else if (arguments.at(i) == "--alert") {
+            window.addAlert(arguments.at(i + 1));
+            ++i;
+        }
+    }
     window.show();
     return app.exec();
 }
@@ -0,0 +1,159 @@
+#include "memory.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include <algorithm>
+#include <vector>
+
+static const char *const memoryCategoryNames[MemoryCategoryCount] = {
+    "series",
+    "indexes",
+    "patterns",
+    "indicators",
+    "images"
+};
+
+static QAtomicInteger<quint64> categoryUsages[MemoryCategoryCount];
+static QAtomicInteger<quint64> budgetLimit;
+// счетчик использований, по нему выбираются давно не использованные данные
+static QAtomicInteger<quint64> useClock;
+// значение счетчика при прошлом выбрасывании
+static quint64 lastTrimClock = 0;
+// счета, данные которых можно выбросить
+static QMutex evictableMutex;
+static std::vector<MemoryAccount *> evictableAccounts;
+
+MemoryAccount::MemoryAccount(MemoryCategory category)
+{
+    mCategory = category;
+    mUsage.store(0);
+    mLastUse.store(0);
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    setUsage(0);
+    if (mEvict) {
+        QMutexLocker locker(&evictableMutex);
+        evictableAccounts.erase(
+            std::remove(evictableAccounts.begin(), evictableAccounts.end(), this),
+            evictableAccounts.end()
+        );
+    }
+}
+
+MemoryCategory MemoryAccount::category() const
+{
+    return mCategory;
+}
+
+uint64_t MemoryAccount::usage() const
+{
+    return mUsage.load();
+}
+
+void MemoryAccount::setUsage(uint64_t bytes)
+{
+    // разница прибавляется по модулю 2^64, так что уменьшение тоже верно
+    quint64 previous = mUsage.fetchAndStoreRelaxed(bytes);
+    categoryUsages[mCategory].fetchAndAddRelaxed(bytes - previous);
+}
+
+void MemoryAccount::setEvictable(const std::function<void()> &evict)
+{
+    QMutexLocker locker(&evictableMutex);
+    if (!mEvict) {
+        evictableAccounts.push_back(this);
+    }
+    mEvict = evict;
+}
+
+void MemoryAccount::touch() const
+{
+    mLastUse.store(useClock.fetchAndAddRelaxed(1) + 1);
+}
+
+uint64_t MemoryBudget::limit()
+{
+    return budgetLimit.load();
+}
+
+void MemoryBudget::setLimit(uint64_t bytes)
+{
+    budgetLimit.store(bytes);
+}
+
+uint64_t MemoryBudget::usage(MemoryCategory category)
+{
+    return categoryUsages[category].load();
+}
+
+uint64_t MemoryBudget::totalUsage()
+{
+    uint64_t total = 0;
+    for (int category = 0; category < MemoryCategoryCount; ++category) {
+        total += categoryUsages[category].load();
+    }
+    return total;
+}
+
+const char *MemoryBudget::categoryName(MemoryCategory category)
+{
+    return memoryCategoryNames[category];
+}
+
+QString MemoryBudget::report()
+{
+    QStringList parts;
+    for (int category = 0; category < MemoryCategoryCount; ++category) {
+        parts << QString("%1 %2")
+            .arg(memoryCategoryNames[category])
+            .arg(categoryUsages[category].load() / 1e6, 0, 'f', 1);
+    }
+    QString text = QString("%1 MB (%2)")
+        .arg(totalUsage() / 1e6, 0, 'f', 1)
+        .arg(parts.join(", "));
+    if (limit() > 0) {
+        text += QString(", budget %1 MB").arg(limit() / 1e6, 0, 'f', 1);
+    }
+    return text;
+}
+
+uint64_t MemoryBudget::trim()
+{
+    QMutexLocker locker(&evictableMutex);
+    quint64 trimClock = lastTrimClock;
+    lastTrimClock = useClock.load();
+    uint64_t budget = limit();
+    uint64_t total = totalUsage();
+    if (budget == 0 || total <= budget) {
+        return 0;
+    }
+    // использованные после прошлого вызова нужны сейчас, без этого
+    // данные, нужные каждому кадру, выбрасывались бы и строились заново
+    std::vector<MemoryAccount *> candidates;
+    for (MemoryAccount *account : evictableAccounts) {
+        if (account->usage() > 0 && account->mLastUse.load() <= trimClock) {
+            candidates.push_back(account);
+        }
+    }
+    std::sort(
+        candidates.begin(),
+        candidates.end(),
+        [](const MemoryAccount *a, const MemoryAccount *b) {
+            return a->mLastUse.load() < b->mLastUse.load();
+        }
+    );
+    uint64_t evicted = 0;
+    for (MemoryAccount *account : candidates) {
+        if (total - evicted <= budget) {
+            break;
+        }
+        evicted += account->usage();
+        account->mEvict();
+        account->setUsage(0);
+    }
+    return evicted;
+}
@@ -0,0 +1,71 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <QAtomicInteger>
+#include <QString>
+
+#include <inttypes.h>
+#include <functional>
+
+// категории учитываемой памяти
+enum MemoryCategory {
+    // свечи рядов
+    MemorySeries,
+    // индексы рядов: пирамида диапазонов и префиксные суммы
+    MemorySeriesIndexes,
+    // найденные свечные модели
+    MemoryPatterns,
+    // вычисленная история индикаторов
+    MemoryIndicators,
+    // кадры и кэши отрисовки графика
+    MemoryImages,
+    MemoryCategoryCount
+};
+
+// учет памяти одного ряда или кэша: владелец сообщает, сколько байт
+// занимает, производные данные, которые можно построить заново,
+// регистрируются с функцией выбрасывания
+class MemoryAccount
+{
+public:
+    MemoryAccount(MemoryCategory category);
+    ~MemoryAccount();
+    MemoryAccount(const MemoryAccount &) = delete;
+    MemoryAccount &operator=(const MemoryAccount &) = delete;
+    MemoryCategory category() const;
+    uint64_t usage() const;
+    void setUsage(uint64_t bytes);
+    // данные можно выбросить: evict освобождает их, учет обнуляется после
+    // вызова, evict не должен менять регистрацию счетов
+    void setEvictable(const std::function<void()> &evict);
+    // данные использованы, выбрасываются давно не использованные
+    void touch() const;
+private:
+    friend class MemoryBudget;
+
+    MemoryCategory mCategory;
+    QAtomicInteger<quint64> mUsage;
+    mutable QAtomicInteger<quint64> mLastUse;
+    std::function<void()> mEvict;
+};
+
+// общий учет памяти по категориям и бюджет на нее
+class MemoryBudget
+{
+public:
+    // бюджет в байтах, 0 - без ограничения
+    static uint64_t limit();
+    static void setLimit(uint64_t bytes);
+    static uint64_t usage(MemoryCategory category);
+    static uint64_t totalUsage();
+    static const char *categoryName(MemoryCategory category);
+    // учет по категориям одной строкой, в мегабайтах
+    static QString report();
+    // выбросить давно не использованные производные данные, пока учет больше
+    // бюджета, данные, использованные после прошлого вызова, не выбрасываются;
+    // вызывается там, где выбрасываемые данные никто не читает,
+    // возвращает кол-во освобожденных байт
+    static uint64_t trim();
+};
+
+#endif // MEMORY_H
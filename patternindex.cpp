@@ -0,0 +1,282 @@
+#include "patternindex.h"
+#include "core.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PATTERNINDEX_SSE2
+#include <emmintrin.h>
+#endif
+
+// кол-во свечей, маски которых считаются во временный буфер перед отбором
+static const uint64_t ScanBlockSize = 1024;
+
+// доля размаха, до которой тело считается доджи
+static const float DojiBodyRatio = 0.1f;
+
+// маски моделей свечи по ней и предыдущей свече, без ветвлений,
+// векторная версия считает так же, поэтому результаты совпадают
+static inline int candlePatterns(const Candle &candle, const Candle &prev)
+{
+    float body = fabsf(candle.close - candle.open);
+    float range = candle.high - candle.low;
+    float top = qMax(candle.open, candle.close);
+    float bottom = qMin(candle.open, candle.close);
+    bool isUp = candle.close > candle.open;
+    bool isDown = candle.close < candle.open;
+    bool isPrevUp = prev.close > prev.open;
+    bool isPrevDown = prev.close < prev.open;
+    return
+        ((range > 0) & (body <= DojiBodyRatio * range)) * PatternDoji |
+        ((range > 0) & (bottom - candle.low >= body + body) &
+            (candle.high - top <= body)) * PatternHammer |
+        (isPrevDown & isUp & (candle.open <= prev.close) &
+            (candle.close >= prev.open)) * PatternBullishEngulfing |
+        (isPrevUp & isDown & (candle.open >= prev.close) &
+            (candle.close <= prev.open)) * PatternBearishEngulfing |
+        ((candle.high < prev.high) & (candle.low > prev.low)) * PatternInsideBar |
+        (candle.low > prev.high) * PatternGapUp |
+        (candle.high < prev.low) * PatternGapDown;
+}
+
+#ifdef PATTERNINDEX_SSE2
+// значения предыдущих свечей: последнее из прошлой четверки и три первых
+// из текущей
+static inline __m128 previousLanes(__m128 last, __m128 current)
+{
+    __m128 edge = _mm_shuffle_ps(last, current, _MM_SHUFFLE(0, 0, 3, 3));
+    return _mm_shuffle_ps(edge, current, _MM_SHUFFLE(2, 1, 2, 0));
+}
+
+static inline __m128i patternBits(__m128 condition, int pattern)
+{
+    return _mm_and_si128(_mm_castps_si128(condition), _mm_set1_epi32(pattern));
+}
+#endif
+
+// маски моделей count подряд идущих свечей, prev - свеча перед первой
+static void scanCandles(
+    const Candle *data,
+    const Candle &prev,
+    uint64_t count,
+    uint8_t *patterns
+)
+{
+    uint64_t i = 0;
+#ifdef PATTERNINDEX_SSE2
+    // четверка свечей транспонируется из open, high, low, close каждой
+    // в четверки открытий, максимумов, минимумов и закрытий
+    __m128 lastOpen = _mm_set1_ps(prev.open);
+    __m128 lastHigh = _mm_set1_ps(prev.high);
+    __m128 lastLow = _mm_set1_ps(prev.low);
+    __m128 lastClose = _mm_set1_ps(prev.close);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 dojiRatio = _mm_set1_ps(DojiBodyRatio);
+    for (; i + 4 <= count; i += 4) {
+        __m128 open = _mm_loadu_ps(&data[i].open);
+        __m128 high = _mm_loadu_ps(&data[i + 1].open);
+        __m128 low = _mm_loadu_ps(&data[i + 2].open);
+        __m128 close = _mm_loadu_ps(&data[i + 3].open);
+        _MM_TRANSPOSE4_PS(open, high, low, close);
+        __m128 prevOpen = previousLanes(lastOpen, open);
+        __m128 prevHigh = previousLanes(lastHigh, high);
+        __m128 prevLow = previousLanes(lastLow, low);
+        __m128 prevClose = previousLanes(lastClose, close);
+
+        __m128 body = _mm_andnot_ps(signMask, _mm_sub_ps(close, open));
+        __m128 range = _mm_sub_ps(high, low);
+        __m128 top = _mm_max_ps(open, close);
+        __m128 bottom = _mm_min_ps(open, close);
+        __m128 isRange = _mm_cmpgt_ps(range, zero);
+        __m128 isUp = _mm_cmpgt_ps(close, open);
+        __m128 isDown = _mm_cmplt_ps(close, open);
+        __m128 isPrevUp = _mm_cmpgt_ps(prevClose, prevOpen);
+        __m128 isPrevDown = _mm_cmplt_ps(prevClose, prevOpen);
+
+        __m128i bits = patternBits(
+            _mm_and_ps(isRange, _mm_cmple_ps(body, _mm_mul_ps(dojiRatio, range))),
+            PatternDoji
+        );
+        bits = _mm_or_si128(bits, patternBits(
+            _mm_and_ps(
+                _mm_and_ps(isRange, _mm_cmpge_ps(_mm_sub_ps(bottom, low), _mm_add_ps(body, body))),
+                _mm_cmple_ps(_mm_sub_ps(high, top), body)
+            ),
+            PatternHammer
+        ));
+        bits = _mm_or_si128(bits, patternBits(
+            _mm_and_ps(
+                _mm_and_ps(isPrevDown, isUp),
+                _mm_and_ps(_mm_cmple_ps(open, prevClose), _mm_cmpge_ps(close, prevOpen))
+            ),
+            PatternBullishEngulfing
+        ));
+        bits = _mm_or_si128(bits, patternBits(
+            _mm_and_ps(
+                _mm_and_ps(isPrevUp, isDown),
+                _mm_and_ps(_mm_cmpge_ps(open, prevClose), _mm_cmple_ps(close, prevOpen))
+            ),
+            PatternBearishEngulfing
+        ));
+        bits = _mm_or_si128(bits, patternBits(
+            _mm_and_ps(_mm_cmplt_ps(high, prevHigh), _mm_cmpgt_ps(low, prevLow)),
+            PatternInsideBar
+        ));
+        bits = _mm_or_si128(bits, patternBits(_mm_cmpgt_ps(low, prevHigh), PatternGapUp));
+        bits = _mm_or_si128(bits, patternBits(_mm_cmplt_ps(high, prevLow), PatternGapDown));
+
+        // маски до 0x7f укладываются в байт без насыщения
+        bits = _mm_packs_epi32(bits, bits);
+        bits = _mm_packus_epi16(bits, bits);
+        int packed = _mm_cvtsi128_si32(bits);
+        memcpy(patterns + i, &packed, 4);
+
+        lastOpen = open;
+        lastHigh = high;
+        lastLow = low;
+        lastClose = close;
+    }
+#endif
+    for (; i < count; ++i) {
+        patterns[i] = candlePatterns(data[i], i > 0 ? data[i - 1] : prev);
+    }
+}
+
+// проверка свечей [begin, end) по блокам ряда, найденные дописываются
+static void scanRange(
+    const DataSeries &dataSeries,
+    uint64_t begin,
+    uint64_t end,
+    std::vector<uint64_t> *indexes,
+    std::vector<uint8_t> *patterns
+)
+{
+    uint8_t blockPatterns[ScanBlockSize];
+    uint64_t i = begin;
+    while (i < end) {
+        uint64_t chunk = i / DataSeries::ChunkSize;
+        uint64_t chunkBegin = chunk * DataSeries::ChunkSize;
+        const Candle *data = dataSeries.chunkData(chunk);
+        uint64_t last = qMin(end, chunkBegin + dataSeries.chunkSize(chunk));
+        while (i < last) {
+            uint64_t count = qMin(ScanBlockSize, last - i);
+            // у первой свечи ряда предыдущей нет, сравнение свечи с собой
+            // не дает ни одной модели из двух свечей
+            const Candle &prev = i > 0 ? dataSeries.at(i - 1) : dataSeries.at(0);
+            scanCandles(data + (i - chunkBegin), prev, count, blockPatterns);
+            // отбор без ветвлений: каждая свеча пишется на место следующей
+            // найденной, а счетчик сдвигается только для найденных
+            size_t hitCount = indexes->size();
+            indexes->resize(hitCount + count);
+            patterns->resize(hitCount + count);
+            uint64_t *hitIndexes = indexes->data();
+            uint8_t *hitPatterns = patterns->data();
+            for (uint64_t k = 0; k < count; ++k) {
+                hitIndexes[hitCount] = i + k;
+                hitPatterns[hitCount] = blockPatterns[k];
+                hitCount += blockPatterns[k] != 0;
+            }
+            indexes->resize(hitCount);
+            patterns->resize(hitCount);
+            i += count;
+        }
+    }
+}
+
+PatternIndex::PatternIndex()
+    : mMemory(MemoryPatterns)
+{
+    mUsedMemory = &mMemory;
+    clear();
+    mMemory.setEvictable([this]() { clear(); });
+}
+
+PatternIndex::PatternIndex(const PatternIndex &other)
+    : mMemory(MemoryPatterns)
+{
+    mScannedCount = other.mScannedCount;
+    mIndexes = other.mIndexes;
+    mPatterns = other.mPatterns;
+    mUsedMemory = other.mUsedMemory;
+}
+
+void PatternIndex::clear()
+{
+    mScannedCount = 0;
+    mIndexes.clear();
+    mPatterns.clear();
+    mMemory.setUsage(0);
+}
+
+size_t PatternIndex::size() const
+{
+    return mIndexes.size();
+}
+
+uint64_t PatternIndex::index(size_t hit) const
+{
+    return mIndexes[hit];
+}
+
+int PatternIndex::patterns(size_t hit) const
+{
+    return mPatterns[hit];
+}
+
+size_t PatternIndex::lowerBound(uint64_t candleIndex) const
+{
+    mUsedMemory->touch();
+    return std::lower_bound(mIndexes.begin(), mIndexes.end(), candleIndex) -
+        mIndexes.begin();
+}
+
+uint64_t PatternIndex::scannedCount() const
+{
+    return mScannedCount;
+}
+
+void PatternIndex::update(const DataSeries &dataSeries)
+{
+    uint64_t size = dataSeries.size();
+    if (size < mScannedCount) {
+        clear();
+    }
+    uint64_t begin = mScannedCount;
+    if (begin == size) {
+        return;
+    }
+    int threadCount = QThread::idealThreadCount();
+    if (size - begin < ParallelMinSize || threadCount < 2) {
+        std::vector<uint64_t> indexes;
+        std::vector<uint8_t> patterns;
+        scanRange(dataSeries, begin, size, &indexes, &patterns);
+        mIndexes.append(indexes.data(), indexes.size());
+        mPatterns.append(patterns.data(), patterns.size());
+        mScannedCount = size;
+        updateMemoryUsage();
+        return;
+    }
+    // найденное в частях склеивается по порядку
+    int partCount = parallelPartCount(size - begin, ParallelMinSize / 4);
+    std::vector<std::vector<uint64_t> > partIndexes(partCount);
+    std::vector<std::vector<uint8_t> > partPatterns(partCount);
+    parallelFor(begin, size, ParallelMinSize / 4, [&](int part, uint64_t first, uint64_t last) {
+        scanRange(dataSeries, first, last, &partIndexes[part], &partPatterns[part]);
+    });
+    for (int part = 0; part < partCount; ++part) {
+        mIndexes.append(partIndexes[part].data(), partIndexes[part].size());
+        mPatterns.append(partPatterns[part].data(), partPatterns[part].size());
+    }
+    mScannedCount = size;
+    updateMemoryUsage();
+}
+
+void PatternIndex::updateMemoryUsage()
+{
+    mMemory.setUsage(mIndexes.memoryUsage() + mPatterns.memoryUsage());
+}
@@ -0,0 +1,76 @@
+#ifndef PATTERNINDEX_H
+#define PATTERNINDEX_H
+
+#include "memory.h"
+#include "chunkedvector.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+class DataSeries;
+
+// свечные модели, свеча может подходить под несколько сразу
+enum CandlePattern {
+    // тело не больше десятой части размаха
+    PatternDoji = 0x01,
+    // нижняя тень не меньше двух тел, верхняя не больше тела
+    PatternHammer = 0x02,
+    // растущее тело поглощает падающее тело предыдущей свечи
+    PatternBullishEngulfing = 0x04,
+    // падающее тело поглощает растущее тело предыдущей свечи
+    PatternBearishEngulfing = 0x08,
+    // размах внутри размаха предыдущей свечи
+    PatternInsideBar = 0x10,
+    // минимум выше максимума предыдущей свечи
+    PatternGapUp = 0x20,
+    // максимум ниже минимума предыдущей свечи
+    PatternGapDown = 0x40,
+    PatternCount = 7,
+    PatternAll = 0x7f
+};
+
+// свечи ряда, подошедшие хотя бы под одну модель: индексы свечей
+// по возрастанию и маски моделей, свечи без моделей не хранятся;
+// при нехватке бюджета памяти индекс выбрасывается и потом строится заново
+class PatternIndex {
+public:
+    PatternIndex();
+    // снимок индекса: найденное разделяется блоками без копирования, снимок
+    // в учет памяти не входит и не выбрасывается, поэтому читается в другом
+    // потоке, пока исходный индекс дописывают или выбрасывают; использование
+    // снимка отмечается у исходного индекса, он должен жить дольше снимка
+    PatternIndex(const PatternIndex &other);
+    PatternIndex &operator=(const PatternIndex &) = delete;
+    // проверить свечи, добавленные в конец ряда с прошлого вызова,
+    // при большом кол-ве новых свечей проверка идет частями на всех ядрах,
+    // ряд меньше проверенного считается новым и проверяется заново
+    void update(const DataSeries &dataSeries);
+    void clear();
+    // кол-во найденных свечей
+    size_t size() const;
+    uint64_t index(size_t hit) const;
+    int patterns(size_t hit) const;
+    // первая найденная свеча с индексом не меньше candleIndex,
+    // отмечает индекс использованным
+    size_t lowerBound(uint64_t candleIndex) const;
+    // кол-во проверенных свечей ряда
+    uint64_t scannedCount() const;
+private:
+    // минимальное кол-во новых свечей для параллельной проверки
+    static const uint64_t ParallelMinSize = 1 << 18;
+    // кол-во найденных свечей в блоке
+    static const uint64_t HitChunkSize = 1 << 14;
+
+    void updateMemoryUsage();
+
+    uint64_t mScannedCount;
+    ChunkedVector<uint64_t, HitChunkSize> mIndexes;
+    ChunkedVector<uint8_t, HitChunkSize> mPatterns;
+    MemoryAccount mMemory;
+    // счет, использование которого отмечает lowerBound: свой у индекса
+    // и счет исходного индекса у снимка
+    const MemoryAccount *mUsedMemory;
+};
+
+#endif // PATTERNINDEX_H
@@ -0,0 +1,50 @@
+#include "prefixsum.h"
+#include "core.h"
+
+PrefixSumIndex::PrefixSumIndex()
+{
+    clear();
+}
+
+void PrefixSumIndex::update(const DataSeries &dataSeries)
+{
+    uint64_t size = dataSeries.size();
+    uint64_t indexedSize = mSums.size() - 1;
+    if (size <= indexedSize) {
+        return;
+    }
+    // суммы накапливаются в double, поэтому разность сумм для диапазона
+    // из миллионов свечей теряет только последние значащие цифры
+    CandleSums sums = mSums.back();
+    for (uint64_t i = indexedSize; i < size; ++i) {
+        const Candle &candle = dataSeries.at(i);
+        double typicalPrice = ((double)candle.high + candle.low + candle.close) / 3;
+        sums.volume += candle.volume;
+        sums.priceVolume += typicalPrice * candle.volume;
+        sums.range += (double)candle.high - candle.low;
+        mSums.push_back(sums);
+    }
+}
+
+CandleSums PrefixSumIndex::query(uint64_t first, uint64_t last) const
+{
+    const CandleSums &firstSums = mSums[first];
+    const CandleSums &lastSums = mSums[last];
+    CandleSums sums;
+    sums.volume = lastSums.volume - firstSums.volume;
+    sums.priceVolume = lastSums.priceVolume - firstSums.priceVolume;
+    sums.range = lastSums.range - firstSums.range;
+    return sums;
+}
+
+void PrefixSumIndex::clear()
+{
+    CandleSums zero = {0, 0, 0};
+    mSums.clear();
+    mSums.push_back(zero);
+}
+
+uint64_t PrefixSumIndex::memoryUsage() const
+{
+    return mSums.memoryUsage();
+}
@@ -0,0 +1,40 @@
+#ifndef PREFIXSUM_H
+#define PREFIXSUM_H
+
+#include "chunkedvector.h"
+
+#include <inttypes.h>
+
+class DataSeries;
+
+// суммы по диапазону свечей
+struct CandleSums {
+    double volume;
+    // сумма типичной цены (high + low + close) / 3, умноженной на объем
+    double priceVolume;
+    // сумма размахов high - low
+    double range;
+};
+
+// префиксные суммы объема, цены на объем и размаха свечей,
+// отвечают на запрос по любому диапазону за O(1); суммы хранятся блоками,
+// поэтому копия индекса их разделяет
+class PrefixSumIndex {
+public:
+    PrefixSumIndex();
+    // досчитать суммы по добавленным в конец свечам
+    void update(const DataSeries &dataSeries);
+    // суммы по свечам [first, last)
+    CandleSums query(uint64_t first, uint64_t last) const;
+    void clear();
+    // занятая суммами память в байтах
+    uint64_t memoryUsage() const;
+private:
+    // кол-во сумм в блоке
+    static const uint64_t SumsChunkSize = 1 << 14;
+
+    // суммы по первым i свечам, i от 0 до кол-ва свечей включительно
+    ChunkedVector<CandleSums, SumsChunkSize> mSums;
+};
+
+#endif // PREFIXSUM_H
@@ -1,8 +1,26 @@
 #include "reader.h"
+#include "dialect.h"
+#include "decompressor.h"
+#include "dataview.h"
 
 #include <QFile>
+#include <QBuffer>
+#include <QFileInfo>
 #include <QByteArray>
 #include <QList>
+#include <QScopedPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 Reader::Reader()
 {
@@ -12,42 +30,221 @@ Reader::~Reader()
 {
 }
 
-// чтение данных из CSV файла
-void Reader::readFromFile(
-    const QString &fileName,
-    DataSeries *data,
-    uint16_t partSize
+// размер начала файла, по которому определяется формат
+static const qint64 dialectSampleSize = 4096;
+// сколько строк начала файла проверяется при определении формата
+static const int dialectSampleLines = 16;
+
+// срезать "\r\n" или "\n" из конца строки
+static void chopLineEnd(QByteArray *line)
+{
+    int size = line->size();
+    while (size > 0 && (line->at(size - 1) == '\n' || line->at(size - 1) == '\r')) {
+        --size;
+    }
+    line->truncate(size);
+}
+
+// подходит ли формат Dialect к строкам начала файла: совпадает заголовок,
+// если он есть, и все строки данных разбираются без ошибок
+template<class Dialect>
+static bool isDialect(const QList<QByteArray> &lines)
+{
+    int first = 0;
+    if (Dialect::header() != nullptr) {
+        if (lines.isEmpty() || !isDialectHeader(lines.at(0), Dialect::header())) {
+            return false;
+        }
+        first = 1;
+    }
+    std::vector<uint32_t> separators;
+    for (int i = first; i < lines.size(); ++i) {
+        if (lines.at(i).isEmpty()) {
+            continue;
+        }
+        // строка разбирается так же, как при чтении файла
+        QByteArray line = lines.at(i);
+        line.append('\n');
+        int size = line.size();
+        line.append(QByteArray(csvScanPadding, '\0'));
+        separators.resize(size);
+        size_t count = scanCsvStructure(
+            line.constData(),
+            size,
+            Dialect::delimiter,
+            separators.data()
+        );
+        Candle candle;
+        if (
+            count != Dialect::columnCount ||
+            !Dialect::parseFields(
+                line.constData(),
+                line.constData(),
+                separators.data(),
+                &candle
+            )
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// размер блока, которым читается файл
+static const int readBlockSize = 1 << 20;
+
+// последний перевод строки в [data, data + size), -1 если его нет
+static int findLastNewline(const char *data, int size)
+{
+    for (int i = size - 1; i >= 0; --i) {
+        if (data[i] == '\n') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// свечи файла подряд без индексов ряда, для слияния нескольких файлов
+struct CandleBuffer {
+    std::vector<Candle> *candles;
+
+    void append(const Candle *data, uint64_t size)
+    {
+        candles->insert(candles->end(), data, data + size);
+    }
+};
+
+// разбор строк [block, block + linesEnd) в формате Dialect, строки
+// заканчиваются переводом строки, после них должно быть доступно
+// csvScanPadding байт; свечи копятся в candles и дописываются в data
+// частями по partSize, false - строка не разбирается
+template<class Dialect, class Target>
+static bool parseDialectLines(
+    const char *block,
+    uint32_t linesEnd,
+    std::vector<uint32_t> *separators,
+    Candle *candles,
+    uint16_t *candles_size,
+    uint16_t partSize,
+    Target *data
 )
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
-        throw std::logic_error("Can't open file with data");
+    if (separators->size() < (size_t)linesEnd) {
+        separators->resize(linesEnd);
+    }
+    const uint32_t *positions = separators->data();
+    size_t count = scanCsvStructure(block, linesEnd, Dialect::delimiter, separators->data());
+    uint32_t lineBegin = 0;
+    size_t i = 0;
+    while (i < count) {
+        uint32_t pos = positions[i];
+        // пустые строки пропускаем
+        if (
+            block[pos] == '\n' &&
+            (pos == lineBegin || (pos == lineBegin + 1 && block[lineBegin] == '\r'))
+        ) {
+            lineBegin = pos + 1;
+            ++i;
+            continue;
+        }
+        // колонок может не быть в формате, они остаются нулевыми
+        candles[*candles_size] = Candle();
+        if (
+            i + Dialect::columnCount > count ||
+            !Dialect::parseFields(
+                block,
+                block + lineBegin,
+                &positions[i],
+                &candles[*candles_size]
+            )
+        ) {
+            return false;
+        }
+        i += Dialect::columnCount;
+        lineBegin = positions[i - 1] + 1;
+        ++*candles_size;
+        if (*candles_size == partSize) {
+            // добавим накопленную часть данных к основным
+            data->append(candles, *candles_size);
+            *candles_size = 0;
+        }
+    }
+    return true;
+}
+
+// чтение файла в формате Dialect: файл читается блоками, в блоке сканером
+// находятся все разделители и переводы строк, и строки разбираются по ним,
+// разбор строки целиком определяется на этапе компиляции, поэтому
+// все форматы читаются одинаково быстро; свечи дописываются частями
+// в ряд или буфер свечей; заголовок есть только в начале файла,
+// часть файла с середины читается без него
+template<class Dialect, class Target>
+static void readDialect(
+    QIODevice *device,
+    Target *data,
+    uint16_t partSize,
+    bool isFileStart
+)
+{
+    if (Dialect::header() != nullptr && isFileStart) {
+        device->readLine();
     }
     uint16_t candles_size = 0;
     Candle *candles = (Candle *)malloc(partSize * sizeof(Candle));
     if (candles == nullptr) {
         throw std::runtime_error("Can't allocate memory for candles part");
     }
-    while (!file.atEnd()) {
-        QByteArray line = file.readLine();
-        // срезать "\r\n" из строки
-        line.chop(2);
-        QList<QByteArray> parsedLine = line.split(',');
-        if (parsedLine.length() != 7) {
+    QByteArray buffer;
+    std::vector<uint32_t> separators;
+    // неполная строка из конца прошлого блока переносится в начало буфера
+    int tailSize = 0;
+    bool isEnd = false;
+    while (!isEnd) {
+        // после строк остается место для перевода строки и запас для чтения
+        // цифр словами
+        buffer.resize(tailSize + readBlockSize + 1 + csvScanPadding);
+        qint64 readSize = device->read(buffer.data() + tailSize, readBlockSize);
+        if (readSize < 0) {
+            free(candles);
+            throw std::runtime_error("Can't read file with data");
+        }
+        int size = tailSize + readSize;
+        int linesEnd;
+        if (readSize == 0) {
+            // последняя строка может быть без перевода строки
+            isEnd = true;
+            if (size == 0) {
+                break;
+            }
+            buffer[size] = '\n';
+            linesEnd = size + 1;
+            memset(buffer.data() + linesEnd, 0, csvScanPadding);
+        } else {
+            linesEnd = findLastNewline(buffer.constData() + tailSize, readSize);
+            if (linesEnd < 0) {
+                // строка длиннее блока, дочитываем
+                tailSize = size;
+                continue;
+            }
+            linesEnd += tailSize + 1;
+        }
+
+        const char *block = buffer.constData();
+        if (!parseDialectLines<Dialect>(
+            block,
+            linesEnd,
+            &separators,
+            candles,
+            &candles_size,
+            partSize,
+            data
+        )) {
+            free(candles);
             throw std::logic_error("Corrupted data in file");
         }
-        candles[candles_size].date = (uint64_t)parsedLine.at(0).toULongLong();
-        candles[candles_size].time = (uint64_t)parsedLine.at(1).toULongLong();
-        candles[candles_size].open = parsedLine.at(2).toFloat();
-        candles[candles_size].high = parsedLine.at(3).toFloat();
-        candles[candles_size].low = parsedLine.at(4).toFloat();
-        candles[candles_size].close = parsedLine.at(5).toFloat();
-        candles[candles_size].volume = parsedLine.at(6).toFloat();
-        candles_size++;
-        if (candles_size == partSize) {
-            // добавим накопленную часть данных к основным
-            data->append(candles, candles_size);
-            candles_size = 0;
+        if (!isEnd) {
+            tailSize = size - linesEnd;
+            memmove(buffer.data(), block + linesEnd, tailSize);
         }
     }
     if (candles_size > 0) {
@@ -56,5 +253,603 @@ void Reader::readFromFile(
         candles_size = 0;
     }
     free(candles);
-    file.close();
+}
+
+// разбор строк [begin, end) отображенного в память файла data размером size
+// в формате Dialect на месте, без копирования в буфер: end - начало строки
+// или конец файла, заголовок пропускается, только если begin - начало файла;
+// строки, за которыми в файле нет запаса для чтения цифр словами, и
+// последняя строка без перевода строки разбираются из копии с запасом
+template<class Dialect, class Target>
+static void readDialectMapped(
+    const char *data,
+    qint64 size,
+    qint64 begin,
+    qint64 end,
+    Target *target,
+    uint16_t partSize
+)
+{
+    if (Dialect::header() != nullptr && begin == 0) {
+        const char *newline = (const char *)memchr(data, '\n', end);
+        begin = newline != nullptr ? newline - data + 1 : end;
+    }
+    uint16_t candles_size = 0;
+    Candle *candles = (Candle *)malloc(partSize * sizeof(Candle));
+    if (candles == nullptr) {
+        throw std::runtime_error("Can't allocate memory for candles part");
+    }
+    std::vector<uint32_t> separators;
+    bool isParsed = true;
+    qint64 inPlaceEnd = qMin(end, size - csvScanPadding);
+    qint64 pos = begin;
+    while (isParsed && pos < inPlaceEnd) {
+        // строки блока до последнего перевода строки в нем,
+        // строка длиннее блока берется целиком
+        qint64 blockEnd = qMin(pos + readBlockSize, inPlaceEnd);
+        int last = findLastNewline(data + pos, blockEnd - pos);
+        if (last < 0) {
+            const char *newline = (const char *)memchr(
+                data + blockEnd,
+                '\n',
+                inPlaceEnd - blockEnd
+            );
+            if (newline == nullptr) {
+                break;
+            }
+            last = newline - (data + pos);
+        }
+        isParsed = parseDialectLines<Dialect>(
+            data + pos,
+            last + 1,
+            &separators,
+            candles,
+            &candles_size,
+            partSize,
+            target
+        );
+        pos += last + 1;
+    }
+    if (isParsed && pos < end) {
+        QByteArray buffer(data + pos, end - pos);
+        if (buffer.at(buffer.size() - 1) != '\n') {
+            buffer.append('\n');
+        }
+        int linesEnd = buffer.size();
+        buffer.append(QByteArray(csvScanPadding, '\0'));
+        isParsed = parseDialectLines<Dialect>(
+            buffer.constData(),
+            linesEnd,
+            &separators,
+            candles,
+            &candles_size,
+            partSize,
+            target
+        );
+    }
+    if (!isParsed) {
+        free(candles);
+        throw std::logic_error("Corrupted data in file");
+    }
+    if (candles_size > 0) {
+        target->append(candles, candles_size);
+    }
+    free(candles);
+}
+
+struct ReaderDialect {
+    bool (*isDialect)(const QList<QByteArray> &lines);
+    void (*read)(QIODevice *device, DataSeries *data, uint16_t partSize, bool isFileStart);
+    void (*readBuffer)(QIODevice *device, CandleBuffer *data, uint16_t partSize, bool isFileStart);
+    void (*readMapped)(
+        const char *data,
+        qint64 size,
+        qint64 begin,
+        qint64 end,
+        DataSeries *target,
+        uint16_t partSize
+    );
+    void (*readMappedBuffer)(
+        const char *data,
+        qint64 size,
+        qint64 begin,
+        qint64 end,
+        CandleBuffer *target,
+        uint16_t partSize
+    );
+
+    void readTo(
+        QIODevice *device,
+        DataSeries *data,
+        uint16_t partSize,
+        bool isFileStart = true
+    ) const
+    {
+        read(device, data, partSize, isFileStart);
+    }
+
+    void readTo(
+        QIODevice *device,
+        CandleBuffer *data,
+        uint16_t partSize,
+        bool isFileStart = true
+    ) const
+    {
+        readBuffer(device, data, partSize, isFileStart);
+    }
+
+    // строки [begin, end) отображенного в память файла размером size
+    void readTo(
+        const char *data,
+        qint64 size,
+        qint64 begin,
+        qint64 end,
+        DataSeries *target,
+        uint16_t partSize
+    ) const
+    {
+        readMapped(data, size, begin, end, target, partSize);
+    }
+
+    void readTo(
+        const char *data,
+        qint64 size,
+        qint64 begin,
+        qint64 end,
+        CandleBuffer *target,
+        uint16_t partSize
+    ) const
+    {
+        readMappedBuffer(data, size, begin, end, target, partSize);
+    }
+};
+
+#define READER_DIALECT(Dialect) { \
+    &isDialect<Dialect>, \
+    &readDialect<Dialect, DataSeries>, \
+    &readDialect<Dialect, CandleBuffer>, \
+    &readDialectMapped<Dialect, DataSeries>, \
+    &readDialectMapped<Dialect, CandleBuffer> \
+}
+
+// известные форматы, форматы с заголовком проверяются первыми
+static const ReaderDialect readerDialects[] = {
+    READER_DIALECT(FinamDialect),
+    READER_DIALECT(FinamSemicolonDialect),
+    READER_DIALECT(FinamShortDialect),
+    READER_DIALECT(MetaTraderDialect),
+    READER_DIALECT(YahooDialect),
+    READER_DIALECT(UnixTimeDialect),
+    READER_DIALECT(NativeDialect),
+    READER_DIALECT(NativeNoVolumeDialect)
+};
+
+// формат файла по первым строкам, nullptr - формат неизвестен
+static const ReaderDialect *detectDialect(QIODevice *device)
+{
+    // строки начала файла без чтения, последняя строка может быть неполной
+    QByteArray sample = device->peek(dialectSampleSize);
+    QList<QByteArray> lines = sample.split('\n');
+    if (sample.size() == dialectSampleSize || lines.last().isEmpty()) {
+        lines.removeLast();
+    }
+    while (lines.size() > dialectSampleLines) {
+        lines.removeLast();
+    }
+    for (int i = 0; i < lines.size(); ++i) {
+        chopLineEnd(&lines[i]);
+    }
+    for (const ReaderDialect &dialect : readerDialects) {
+        if (dialect.isDialect(lines)) {
+            return &dialect;
+        }
+    }
+    return nullptr;
+}
+
+// чтение данных из CSV файла, формат определяется по первым строкам,
+// сжатые gzip и zstd файлы распаковываются в отдельном потоке по ходу чтения
+template<class Target>
+static void readFile(const QString &fileName, Target *data, uint16_t partSize)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::logic_error("Can't open file with data");
+    }
+    QIODevice *device = &file;
+    QScopedPointer<Decompressor> decompressor;
+    Decompressor::Format format = Decompressor::detectFormat(&file);
+    if (format != Decompressor::NoCompression) {
+        decompressor.reset(new Decompressor(&file, format));
+        if (!decompressor->open(QIODevice::ReadOnly)) {
+            throw std::logic_error("Unsupported compression of file with data");
+        }
+        device = decompressor.data();
+    }
+    const ReaderDialect *dialect = detectDialect(device);
+    if (dialect == nullptr) {
+        throw std::logic_error("Unknown data format in file");
+    }
+    dialect->readTo(device, data, partSize);
+    device->close();
+}
+
+void Reader::readFromFile(
+    const QString &fileName,
+    DataSeries *data,
+    uint16_t partSize
+)
+{
+    readFile(fileName, data, partSize);
+}
+
+void Reader::readFromFiles(
+    const QStringList &fileNames,
+    DataSeries *data,
+    DuplicatePolicy policy,
+    uint16_t partSize
+)
+{
+    // файлы разбираются параллельно, ошибка дополняется именем файла
+    std::vector<std::vector<Candle> > parts(fileNames.size());
+    parallelFor(fileNames.size(), [&](int file) {
+        try {
+            CandleBuffer buffer = {&parts[file]};
+            readFile(fileNames.at(file), &buffer, partSize);
+        } catch (const std::exception &e) {
+            QString error = QFileInfo(fileNames.at(file)).fileName() + ": " + e.what();
+            throw std::logic_error(error.toStdString());
+        }
+    });
+    mergeSeries(&parts, data, policy);
+}
+
+// позиция в сливаемых свечах
+struct MergeCursor {
+    int part;
+    uint64_t index;
+    uint64_t key;
+};
+
+// курсор a идет позже b: по времени, при равном - по порядку частей
+static bool isMergeCursorAfter(const MergeCursor &a, const MergeCursor &b)
+{
+    return a.key > b.key || (a.key == b.key && a.part > b.part);
+}
+
+// кол-во свечей, которые копятся перед дописыванием в ряд,
+// и длина куска, который дописывается сразу
+static const size_t mergeBlockSize = 1 << 16;
+static const uint64_t mergeDirectSize = 1 << 12;
+
+// слияние k частей кучей курсоров по времени: курсор с самой ранней свечой
+// идет по свечам подряд, пока они раньше свечи следующего курсора, и
+// дописывает их в ряд одним куском, поэтому части без перекрытия
+// дописываются целиком без операций с кучей, а свечи с одним временем
+// из разных частей сводятся в одну по policy
+void Reader::mergeSeries(
+    std::vector<std::vector<Candle> > *parts,
+    DataSeries *data,
+    DuplicatePolicy policy
+)
+{
+    std::vector<MergeCursor> heap;
+    for (size_t i = 0; i < parts->size(); ++i) {
+        if (!(*parts)[i].empty()) {
+            heap.push_back({(int)i, 0, candleTimeKey((*parts)[i][0])});
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), isMergeCursorAfter);
+    // короткие куски и сведенные свечи копятся в блоке,
+    // длинные куски дописываются сразу
+    std::vector<Candle> block;
+    block.reserve(mergeBlockSize);
+    auto flush = [&]() {
+        if (!block.empty()) {
+            data->append(block.data(), block.size());
+            block.clear();
+        }
+    };
+    auto output = [&](const Candle *candles, uint64_t count) {
+        if (count >= mergeDirectSize) {
+            flush();
+            data->append(candles, count);
+            return;
+        }
+        if (block.size() + count > mergeBlockSize) {
+            flush();
+        }
+        block.insert(block.end(), candles, candles + count);
+    };
+    // сдвинуть курсор на следующую свечу, false - часть кончилась и освобождена
+    auto advance = [parts](MergeCursor *cursor) {
+        std::vector<Candle> &part = (*parts)[cursor->part];
+        if (++cursor->index == part.size()) {
+            std::vector<Candle>().swap(part);
+            return false;
+        }
+        cursor->key = candleTimeKey(part[cursor->index]);
+        return true;
+    };
+    std::vector<MergeCursor> duplicates;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), isMergeCursorAfter);
+        MergeCursor cursor = heap.back();
+        heap.pop_back();
+        // свечи раньше, чем у следующего курсора, дописываются одним куском
+        uint64_t nextKey = heap.empty() ? UINT64_MAX : heap.front().key;
+        const std::vector<Candle> &part = (*parts)[cursor.part];
+        uint64_t runBegin = cursor.index;
+        uint64_t runEnd = runBegin;
+        while (runEnd < part.size() && candleTimeKey(part[runEnd]) < nextKey) {
+            ++runEnd;
+        }
+        bool isLeft = true;
+        if (runEnd > runBegin) {
+            output(part.data() + runBegin, runEnd - runBegin);
+            cursor.index = runEnd - 1;
+            isLeft = advance(&cursor);
+        }
+        if (isLeft && cursor.key == nextKey) {
+            // одно время в нескольких частях: все такие курсоры по порядку частей
+            duplicates.clear();
+            duplicates.push_back(cursor);
+            while (!heap.empty() && heap.front().key == cursor.key) {
+                std::pop_heap(heap.begin(), heap.end(), isMergeCursorAfter);
+                duplicates.push_back(heap.back());
+                heap.pop_back();
+            }
+            std::sort(
+                duplicates.begin(),
+                duplicates.end(),
+                [](const MergeCursor &a, const MergeCursor &b) { return a.part < b.part; }
+            );
+            const Candle &first = (*parts)[duplicates.front().part][duplicates.front().index];
+            const Candle &last = (*parts)[duplicates.back().part][duplicates.back().index];
+            Candle candle = policy == DuplicateKeepFirst ? first : last;
+            if (policy == DuplicateCombine) {
+                candle.open = first.open;
+                for (const MergeCursor &duplicate : duplicates) {
+                    const Candle &other = (*parts)[duplicate.part][duplicate.index];
+                    candle.high = qMax(candle.high, other.high);
+                    candle.low = qMin(candle.low, other.low);
+                    candle.volume = qMax(candle.volume, other.volume);
+                }
+            }
+            output(&candle, 1);
+            for (MergeCursor &duplicate : duplicates) {
+                if (advance(&duplicate)) {
+                    heap.push_back(duplicate);
+                    std::push_heap(heap.begin(), heap.end(), isMergeCursorAfter);
+                }
+            }
+        } else if (isLeft) {
+            heap.push_back(cursor);
+            std::push_heap(heap.begin(), heap.end(), isMergeCursorAfter);
+        }
+    }
+    flush();
+}
+
+// наибольший размер части файла при фоновом разборе
+static const qint64 lazyPartMaxSize = 64 << 20;
+
+// начало первой строки после позиции pos (размер файла, если строк нет)
+static qint64 nextLineStart(const char *data, qint64 size, qint64 pos)
+{
+    const char *newline = (const char *)memchr(data + pos, '\n', size - pos);
+    return newline != nullptr ? newline - data + 1 : size;
+}
+
+// фоновый разбор всего файла: части разбираются параллельно, затем
+// дописываются в ряд по порядку
+struct LazyRead {
+    LazyReader *reader;
+    const ReaderDialect *dialect;
+    const char *data;
+    qint64 size;
+    // начала частей по границам строк, последнее - размер файла
+    std::vector<qint64> offsets;
+    std::vector<std::vector<Candle> > parts;
+    std::function<void(const DataSeries &)> prepare;
+    DataSeries series;
+    QAtomicInteger<int> isAbort;
+    QMutex mutex;
+    QWaitCondition doneCondition;
+    bool isDone;
+    QString error;
+
+    void process()
+    {
+        // после остановки части не разбираются
+        try {
+            parallelFor(parts.size(), [this](int part) {
+                if (!isAbort.loadAcquire()) {
+                    CandleBuffer buffer = {&parts[part]};
+                    dialect->readTo(data, size, offsets[part], offsets[part + 1], &buffer, 256);
+                }
+            });
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        if (isAbort.loadAcquire()) {
+            finish();
+            return;
+        }
+        if (error.isEmpty()) {
+            for (std::vector<Candle> &part : parts) {
+                if (!part.empty()) {
+                    series.append(part.data(), part.size());
+                }
+                std::vector<Candle>().swap(part);
+            }
+            if (prepare) {
+                prepare(series);
+            }
+        }
+        emit reader->finished();
+        finish();
+    }
+
+    void finish()
+    {
+        QMutexLocker locker(&mutex);
+        isDone = true;
+        doneCondition.wakeAll();
+    }
+
+    void wait()
+    {
+        QMutexLocker locker(&mutex);
+        while (!isDone) {
+            doneCondition.wait(&mutex);
+        }
+    }
+};
+
+class LazyReadTask : public QRunnable
+{
+public:
+    LazyReadTask(const std::shared_ptr<LazyRead> &read)
+        : mRead(read)
+    {
+    }
+
+    void run() override
+    {
+        mRead->process();
+    }
+private:
+    std::shared_ptr<LazyRead> mRead;
+};
+
+LazyReader::LazyReader(QObject *parent)
+    : QObject(parent)
+{
+    mEstimatedSize = 0;
+}
+
+LazyReader::~LazyReader()
+{
+    // фоновый разбор читает отображенный файл, дождемся его
+    if (mRead) {
+        mRead->isAbort.storeRelease(1);
+        mRead->wait();
+        mFile.unmap((uchar *)mRead->data);
+    }
+}
+
+bool LazyReader::isSupported(const QString &fileName, qint64 minFileSize)
+{
+    // файл отображается в память целиком
+    if (sizeof(void *) < 8) {
+        return false;
+    }
+    QFileInfo info(fileName);
+    if (!info.isFile() || info.size() < minFileSize) {
+        return false;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return Decompressor::detectFormat(&file) == Decompressor::NoCompression;
+}
+
+void LazyReader::open(
+    const QString &fileName,
+    DataSeries *tail,
+    std::vector<Candle> *samples,
+    const std::function<void(const DataSeries &)> &prepare,
+    uint64_t tailCount,
+    int sampleCount
+)
+{
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        throw std::logic_error("Can't open file with data");
+    }
+    const ReaderDialect *dialect = detectDialect(&mFile);
+    if (dialect == nullptr) {
+        throw std::logic_error("Unknown data format in file");
+    }
+    qint64 size = mFile.size();
+    const char *data = (const char *)mFile.map(0, size);
+    if (data == nullptr) {
+        throw std::runtime_error("Can't map file with data");
+    }
+
+    // начало последних tailCount строк по переводам строк с конца,
+    // перевод строки в самом конце файла новую строку не начинает
+    qint64 tailBegin = size > 0 && data[size - 1] == '\n' ? size - 1 : size;
+    uint64_t lineCount = 0;
+    while (tailBegin > 0) {
+        if (data[tailBegin - 1] == '\n' && ++lineCount == tailCount) {
+            break;
+        }
+        --tailBegin;
+    }
+    dialect->readTo(data, size, tailBegin, size, tail, 256);
+    mEstimatedSize = tailBegin < size ?
+        tail->size() * (double)size / (size - tailBegin) : tail->size();
+
+    // строка выборки - первая строка после очередной доли файла,
+    // строки выборки собираются в один буфер и разбираются разом
+    QByteArray sampleLines;
+    qint64 previous = -1;
+    for (int i = 0; i < sampleCount; ++i) {
+        qint64 begin = nextLineStart(data, size, (qint64)((double)size * i / sampleCount));
+        if (begin >= size) {
+            break;
+        }
+        if (begin == previous) {
+            continue;
+        }
+        qint64 end = nextLineStart(data, size, begin);
+        sampleLines.append(data + begin, end - begin);
+        if (data[end - 1] != '\n') {
+            sampleLines.append('\n');
+        }
+        previous = begin;
+    }
+    CandleBuffer sampleBuffer = {samples};
+    QBuffer sampleDevice(&sampleLines);
+    sampleDevice.open(QIODevice::ReadOnly);
+    dialect->readTo(&sampleDevice, &sampleBuffer, 256, false);
+
+    // части для фонового разбора не больше lazyPartMaxSize
+    int partCount = parallelPartCount(size, 1, lazyPartMaxSize);
+    mRead.reset(new LazyRead());
+    mRead->reader = this;
+    mRead->dialect = dialect;
+    mRead->data = data;
+    mRead->size = size;
+    mRead->offsets.push_back(0);
+    for (int i = 1; i < partCount; ++i) {
+        qint64 offset = nextLineStart(data, size, (qint64)((double)size * i / partCount));
+        mRead->offsets.push_back(qMax(offset, mRead->offsets.back()));
+    }
+    mRead->offsets.push_back(size);
+    mRead->parts.resize(partCount);
+    mRead->prepare = prepare;
+    mRead->isAbort.store(0);
+    mRead->isDone = false;
+    QThreadPool::globalInstance()->start(new LazyReadTask(mRead));
+}
+
+uint64_t LazyReader::estimatedSize() const
+{
+    return mEstimatedSize;
+}
+
+DataSeries LazyReader::takeSeries()
+{
+    mRead->wait();
+    return std::move(mRead->series);
+}
+
+QString LazyReader::error() const
+{
+    mRead->wait();
+    return mRead->error;
 }
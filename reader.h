@@ -3,7 +3,25 @@
 
 #include "core.h"
 
+#include <QObject>
+#include <QFile>
 #include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// какую свечу оставить, если несколько файлов содержат свечу с одним временем
+enum DuplicatePolicy {
+    // из файла, идущего раньше в списке
+    DuplicateKeepFirst,
+    // из файла, идущего позже в списке
+    DuplicateKeepLast,
+    // открытие первой, закрытие последней, наибольшие максимум и объем,
+    // наименьший минимум
+    DuplicateCombine
+};
 
 class Reader
 {
@@ -17,6 +35,66 @@ public:
         DataSeries *data,
         uint16_t partSize = 256
     );
+    // чтение нескольких файлов одного инструмента (например, по периодам
+    // с перекрытием на границах) как одного ряда: файлы разбираются
+    // параллельно, затем сливаются по времени без повторов свечей
+    static void readFromFiles(
+        const QStringList &fileNames,
+        DataSeries *data,
+        DuplicatePolicy policy = DuplicateKeepLast,
+        uint16_t partSize = 256
+    );
+    // слияние частей, в каждой из которых свечи идут по времени, в data,
+    // части освобождаются по мере слияния
+    static void mergeSeries(
+        std::vector<std::vector<Candle> > *parts,
+        DataSeries *data,
+        DuplicatePolicy policy
+    );
+};
+
+struct LazyRead;
+
+// открытие большого файла без полного разбора: по переводам строк с конца
+// файла сразу разбираются только его последние строки (для первого кадра)
+// и по строке на каждую долю файла (упрощенная история для скроллбара),
+// весь файл разбирается в фоне частями по границам строк на всех ядрах
+class LazyReader : public QObject
+{
+    Q_OBJECT
+public:
+    // файлы меньше этого размера быстрее разобрать сразу целиком
+    static const qint64 MinFileSize = 512LL << 20;
+
+    LazyReader(QObject *parent = nullptr);
+    ~LazyReader();
+    // можно ли открыть файл лениво: несжатый и не меньше minFileSize байт
+    static bool isSupported(const QString &fileName, qint64 minFileSize = MinFileSize);
+    // разбор tailCount последних строк в tail и sampleCount строк,
+    // равномерно по всему файлу, в samples, затем запуск фонового разбора
+    // всего файла; prepare вызывается в фоновом потоке с разобранным рядом,
+    // например для построения индексов; std::logic_error, если файл
+    // не открыть или формат неизвестен
+    void open(
+        const QString &fileName,
+        DataSeries *tail,
+        std::vector<Candle> *samples,
+        const std::function<void(const DataSeries &)> &prepare = nullptr,
+        uint64_t tailCount = 1 << 16,
+        int sampleCount = 2048
+    );
+    // оценка кол-ва строк файла по длине последних строк
+    uint64_t estimatedSize() const;
+    // после finished: весь ряд (забирается один раз) или текст ошибки
+    DataSeries takeSeries();
+    QString error() const;
+signals:
+    // весь файл разобран или разбор не удался, вызывается из фонового потока
+    void finished();
+private:
+    QFile mFile;
+    std::shared_ptr<LazyRead> mRead;
+    uint64_t mEstimatedSize;
 };
 
 #endif // READER_H
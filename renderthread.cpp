@@ -0,0 +1,176 @@
+#include "renderthread.h"
+#include "alloccounter.h"
+
+#include <QPainter>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+RenderThread::RenderThread(QObject *parent)
+    : QThread(parent), mFrameMemory(MemoryImages), mCacheMemory(MemoryImages)
+{
+    mPendingChart = nullptr;
+    mRenderChart = nullptr;
+    mIsPending = false;
+    mIsAbort = false;
+    mIsCacheReleasePending = false;
+    mFrameAllocations = 0;
+    mFrameDataSize = 0;
+    mFrameTime = 0;
+    // кэш читается при отрисовке без блокировки, поэтому выбрасывается
+    // самим потоком отрисовки между кадрами
+    mCacheMemory.setEvictable([this]() {
+        QMutexLocker locker(&mMutex);
+        mIsCacheReleasePending = true;
+        mCondition.wakeOne();
+    });
+}
+
+RenderThread::~RenderThread()
+{
+    mMutex.lock();
+    mIsAbort = true;
+    mCondition.wakeOne();
+    mMutex.unlock();
+    wait();
+    delete mPendingChart;
+    delete mRenderChart;
+}
+
+void RenderThread::requestFrame(
+    const Chart &chart,
+    const std::shared_ptr<const ChartData> &data,
+    const QSize &size,
+    const QRegion &region
+)
+{
+    QMutexLocker locker(&mMutex);
+    if (mPendingChart == nullptr) {
+        mPendingChart = new Chart(chart);
+    } else {
+        *mPendingChart = chart;
+    }
+    mPendingData = data;
+    mPendingSize = size;
+    mPendingRegion += region;
+    mIsPending = true;
+    if (!isRunning()) {
+        start();
+    } else {
+        mCondition.wakeOne();
+    }
+}
+
+QImage RenderThread::frame() const
+{
+    QMutexLocker locker(&mMutex);
+    return mFrame;
+}
+
+uint64_t RenderThread::lastFrameAllocations() const
+{
+    QMutexLocker locker(&mMutex);
+    return mFrameAllocations;
+}
+
+uint64_t RenderThread::lastFrameDataSize() const
+{
+    QMutexLocker locker(&mMutex);
+    return mFrameDataSize;
+}
+
+qint64 RenderThread::lastFrameTime() const
+{
+    QMutexLocker locker(&mMutex);
+    return mFrameTime;
+}
+
+QRegion RenderThread::takeReadyRegion()
+{
+    QMutexLocker locker(&mMutex);
+    QRegion region = mReadyRegion;
+    mReadyRegion = QRegion();
+    return region;
+}
+
+void RenderThread::run()
+{
+    forever {
+        mMutex.lock();
+        while (!mIsPending && !mIsAbort && !mIsCacheReleasePending) {
+            mCondition.wait(&mMutex);
+        }
+        if (mIsAbort) {
+            mMutex.unlock();
+            return;
+        }
+        bool isCacheRelease = mIsCacheReleasePending;
+        bool isFrame = mIsPending;
+        mIsCacheReleasePending = false;
+        // забираем последний запрос, новые запросы копятся, пока рисуем
+        std::shared_ptr<const ChartData> data;
+        QSize size;
+        QRegion region;
+        if (isFrame) {
+            qSwap(mPendingChart, mRenderChart);
+            data.swap(mPendingData);
+            size = mPendingSize;
+            region = mPendingRegion;
+            mPendingRegion = QRegion();
+            mIsPending = false;
+        }
+        mMutex.unlock();
+
+        if (isCacheRelease) {
+            mCache.release();
+            mCacheMemory.setUsage(0);
+        }
+        // снимок данных держим только до конца кадра: пока он жив,
+        // дописывание в ряд копирует разделяемые с ним последние блоки
+        if (isFrame && data) {
+            mRenderChart->setData(data.get());
+        }
+        if (isFrame && !size.isEmpty()) {
+            // задний буфер отстает от выведенного кадра на один кадр, поэтому
+            // в нем перерисовываем и область, изменившуюся в выведенном кадре
+            QRegion paintRegion = region + mFrameRegion;
+            if (mBackFrame.size() != size) {
+                mBackFrame = QImage(size, QImage::Format_ARGB32_Premultiplied);
+                paintRegion = QRegion(mBackFrame.rect());
+            }
+            QElapsedTimer frameTimer;
+            frameTimer.start();
+            QPainter painter;
+            painter.begin(&mBackFrame);
+            // при взаимодействии с графиком кадр рисуется без сглаживания
+            painter.setRenderHint(
+                QPainter::HighQualityAntialiasing,
+                !mRenderChart->isInteractive()
+            );
+            // считаются выделения памяти самим рисованием кадра, когда данные
+            // не менялись, их быть не должно
+            uint64_t frameAllocations;
+            {
+                AllocationScope allocations;
+                mRenderChart->render(&painter, mBackFrame.rect(), paintRegion, &mCache);
+                frameAllocations = allocations.count();
+            }
+            uint64_t frameDataSize = mRenderChart->dataSeries()->size();
+            mCacheMemory.setUsage(mCache.memoryUsage());
+            mCacheMemory.touch();
+            painter.end();
+            qint64 frameTime = frameTimer.nsecsElapsed();
+            mFrameRegion = region;
+
+            // готовый кадр меняем местами с выведенным ранее
+            mMutex.lock();
+            mFrame.swap(mBackFrame);
+            mReadyRegion += region;
+            mFrameAllocations = frameAllocations;
+            mFrameDataSize = frameDataSize;
+            mFrameTime = frameTime;
+            mMutex.unlock();
+            mFrameMemory.setUsage(2 * (uint64_t)mBackFrame.bytesPerLine() * mBackFrame.height());
+            emit frameReady();
+        }
+    }
+}
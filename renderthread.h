@@ -0,0 +1,78 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include "chart.h"
+#include "memory.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QRegion>
+#include <QSize>
+
+#include <memory>
+
+// поток отрисовки кадров графика: получает снимок состояния графика и его
+// данных и рисует кадр в QImage без блокировки данных, поток интерфейса
+// только выводит последний готовый кадр
+class RenderThread : public QThread
+{
+    Q_OBJECT
+public:
+    RenderThread(QObject *parent = nullptr);
+    ~RenderThread();
+    // запрос кадра по снимку состояния графика с изменившейся областью region,
+    // еще не начатый запрос заменяется новым (области объединяются),
+    // поэтому устаревшие кадры не рисуются; график рисуется по снимку данных
+    // data, без снимка - по своим данным, которые тогда не должны меняться
+    void requestFrame(
+        const Chart &chart,
+        const std::shared_ptr<const ChartData> &data,
+        const QSize &size,
+        const QRegion &region
+    );
+    // последний готовый кадр
+    QImage frame() const;
+    // область, изменившаяся в готовых кадрах с прошлого вызова
+    QRegion takeReadyRegion();
+    // кол-во выделений памяти при рисовании последнего готового кадра,
+    // считается только в сборке с CONFIG += alloc_count
+    uint64_t lastFrameAllocations() const;
+    // кол-во свечей в данных при рисовании последнего готового кадра
+    uint64_t lastFrameDataSize() const;
+    // время рисования последнего готового кадра в наносекундах
+    qint64 lastFrameTime() const;
+signals:
+    void frameReady();
+protected:
+    void run() override;
+private:
+    mutable QMutex mMutex;
+    QWaitCondition mCondition;
+    Chart *mPendingChart;
+    std::shared_ptr<const ChartData> mPendingData;
+    QSize mPendingSize;
+    QRegion mPendingRegion;
+    bool mIsPending;
+    bool mIsAbort;
+    // кэш выброшен по бюджету памяти, поток отрисовки освободит его,
+    // когда не рисует
+    bool mIsCacheReleasePending;
+    QImage mFrame;
+    QRegion mReadyRegion;
+    uint64_t mFrameAllocations;
+    uint64_t mFrameDataSize;
+    qint64 mFrameTime;
+    // используются только потоком отрисовки
+    Chart *mRenderChart;
+    QImage mBackFrame;
+    // область, изменившаяся в mFrame относительно mBackFrame
+    QRegion mFrameRegion;
+    ChartCache mCache;
+    // два кадра и кэш графика
+    MemoryAccount mFrameMemory;
+    MemoryAccount mCacheMemory;
+};
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,166 @@
+#include "replay.h"
+#include "reader.h"
+#include "dialect.h"
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+int64_t feedClockNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+bool Replay::isRequested(int argc, char *argv[])
+{
+    return isOptionRequested(argc, argv, "--replay");
+}
+
+int Replay::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chartist replay of a data file over a local socket");
+    parser.addHelpOption();
+    QCommandLineOption replayOption(
+        "replay",
+        "Serve candles of the given CSV file to one client (chartist --feed)."
+    );
+    QCommandLineOption portOption(
+        QStringList() << "p" << "port",
+        "Local TCP port.",
+        "port",
+        "5555"
+    );
+    QCommandLineOption speedOption(
+        "speed",
+        "Replay speed multiple of candle times, or max.",
+        "n",
+        "1"
+    );
+    parser.addOption(replayOption);
+    parser.addOption(portOption);
+    parser.addOption(speedOption);
+    parser.addPositionalArgument("file", "CSV file to replay.", "file");
+    parser.process(arguments);
+
+    bool isPortValid = false;
+    quint16 port = parser.value(portOption).toUShort(&isPortValid);
+    if (!isPortValid || port == 0) {
+        printMessage("Invalid port: " + parser.value(portOption));
+        return 1;
+    }
+    double speed = 0;
+    if (parser.value(speedOption) != "max") {
+        bool isSpeedValid = false;
+        speed = parser.value(speedOption).toDouble(&isSpeedValid);
+        if (!isSpeedValid || speed <= 0) {
+            printMessage("Invalid speed: " + parser.value(speedOption));
+            return 1;
+        }
+    }
+    QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        printMessage("One file to replay is expected");
+        return 1;
+    }
+    try {
+        DataSeries dataSeries;
+        Reader::readFromFile(files.at(0), &dataSeries);
+        serve(dataSeries, port, speed);
+    } catch (const std::exception &e) {
+        printMessage(files.at(0) + ": " + QString::fromLocal8Bit(e.what()));
+        return 2;
+    }
+    return 0;
+}
+
+void Replay::serve(const DataSeries &dataSeries, quint16 port, double speed)
+{
+    QTcpServer server;
+    if (!server.listen(QHostAddress::LocalHost, port)) {
+        throw std::runtime_error(server.errorString().toStdString());
+    }
+    printMessage(QString("Waiting for a client on port %1").arg(port));
+    if (!server.waitForNewConnection(-1)) {
+        throw std::runtime_error(server.errorString().toStdString());
+    }
+    QTcpSocket *socket = server.nextPendingConnection();
+    server.close();
+
+    // сообщения копятся пачкой и отправляются, когда пачка заполнена или
+    // следующая свеча еще не наступила, в сокете держим не больше
+    // нескольких пачек, чтобы медленный клиент притормаживал повтор
+    const size_t batchSize = 4096;
+    const qint64 maxBytesToWrite = 16 * batchSize * sizeof(FeedMessage);
+    std::vector<FeedMessage> batch;
+    batch.reserve(batchSize);
+    uint64_t size = dataSeries.size();
+    int64_t firstSeconds = size > 0 ? candleSeconds(dataSeries.at(0)) : 0;
+    QElapsedTimer clock;
+    clock.start();
+    uint64_t sent = 0;
+    while (sent < size && socket->state() == QAbstractSocket::ConnectedState) {
+        uint64_t i = sent + batch.size();
+        bool isDue = true;
+        if (speed > 0 && i < size) {
+            double due = (candleSeconds(dataSeries.at(i)) - firstSeconds) * 1e9 / speed;
+            isDue = clock.nsecsElapsed() >= due;
+        }
+        if (isDue && i < size && batch.size() < batchSize) {
+            FeedMessage message;
+            message.candle = dataSeries.at(i);
+            message.sentTime = feedClockNow();
+            batch.push_back(message);
+            continue;
+        }
+        if (!batch.empty()) {
+            socket->write(
+                (const char *)batch.data(),
+                batch.size() * sizeof(FeedMessage)
+            );
+            sent += batch.size();
+            batch.clear();
+        }
+        socket->flush();
+        while (
+            socket->bytesToWrite() > maxBytesToWrite &&
+            socket->state() == QAbstractSocket::ConnectedState
+        ) {
+            socket->waitForBytesWritten(100);
+        }
+        if (!isDue) {
+            // до следующей свечи спим, но не дольше 1 мс, чтоб не опоздать
+            socket->waitForBytesWritten(0);
+            QThread::usleep(1000);
+        }
+    }
+    while (
+        socket->bytesToWrite() > 0 &&
+        socket->state() == QAbstractSocket::ConnectedState
+    ) {
+        socket->waitForBytesWritten(100);
+    }
+    double seconds = clock.nsecsElapsed() / 1e9;
+    printMessage(
+        QString("Sent %1 candles in %2 s (%3 candles/s)")
+            .arg(sent)
+            .arg(seconds, 0, 'f', 3)
+            .arg(seconds > 0 ? sent / seconds : 0, 0, 'f', 0)
+    );
+    socket->disconnectFromHost();
+    if (socket->state() != QAbstractSocket::UnconnectedState) {
+        socket->waitForDisconnected(1000);
+    }
+    delete socket;
+}
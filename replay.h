@@ -0,0 +1,33 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "core.h"
+
+#include <QString>
+#include <QStringList>
+
+// сообщение потока свечей: свеча и время отправки по feedClockNow(),
+// передается как есть, поэтому сервер и клиент - одна сборка на одной машине
+struct FeedMessage {
+    Candle candle;
+    int64_t sentTime;
+};
+
+// монотонное время в наносекундах, общее для процессов одной машины
+int64_t feedClockNow();
+
+// повтор файла с данными через локальный сокет: свечи отправляются
+// с интервалами между их временами, ускоренными в speed раз
+class Replay
+{
+public:
+    // запрошен ли режим повтора в аргументах командной строки
+    static bool isRequested(int argc, char *argv[]);
+    // повтор по аргументам командной строки, возвращает код завершения
+    static int run(const QStringList &arguments);
+    // повтор свечей dataSeries первому подключившемуся к порту port клиенту,
+    // speed = 0 - без пауз, с наибольшей скоростью
+    static void serve(const DataSeries &dataSeries, quint16 port, double speed);
+};
+
+#endif // REPLAY_H
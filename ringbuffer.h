@@ -0,0 +1,87 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+// кольцевой буфер без блокировок для одного писателя и одного читателя:
+// писатель меняет только mTail, читатель - только mHead, каждый хранит
+// копию чужого индекса и перечитывает ее, только когда места (или данных)
+// по копии не хватает, поэтому строки кэша с индексами почти не передаются
+// между ядрами
+template<typename T>
+class SpscRingBuffer {
+public:
+    // емкость округляется вверх до степени двойки
+    explicit SpscRingBuffer(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mBuffer.resize(size);
+        mMask = size - 1;
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(0, std::memory_order_relaxed);
+        mCachedHead = 0;
+        mCachedTail = 0;
+    }
+
+    size_t capacity() const
+    {
+        return mBuffer.size();
+    }
+
+    // запись до size значений, вызывается только писателем,
+    // возвращает, сколько поместилось
+    size_t push(const T *values, size_t size)
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        size_t free = mBuffer.size() - (tail - mCachedHead);
+        if (free < size) {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            free = mBuffer.size() - (tail - mCachedHead);
+        }
+        if (size > free) {
+            size = free;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            mBuffer[(tail + i) & mMask] = values[i];
+        }
+        mTail.store(tail + size, std::memory_order_release);
+        return size;
+    }
+
+    // чтение до size значений, вызывается только читателем,
+    // возвращает, сколько прочитано
+    size_t pop(T *values, size_t size)
+    {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        size_t available = mCachedTail - head;
+        if (available < size) {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+            available = mCachedTail - head;
+        }
+        if (size > available) {
+            size = available;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            values[i] = mBuffer[(head + i) & mMask];
+        }
+        mHead.store(head + size, std::memory_order_release);
+        return size;
+    }
+private:
+    std::vector<T> mBuffer;
+    size_t mMask;
+    // индексы растут неограниченно, позиция в буфере - индекс & mMask
+    alignas(64) std::atomic<size_t> mHead;
+    // копия mTail у читателя
+    size_t mCachedTail;
+    alignas(64) std::atomic<size_t> mTail;
+    // копия mHead у писателя
+    size_t mCachedHead;
+};
+
+#endif // RINGBUFFER_H
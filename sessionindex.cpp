@@ -0,0 +1,203 @@
+#include "sessionindex.h"
+#include "core.h"
+#include "dialect.h"
+
+#include <algorithm>
+
+// время свечи в секундах, дата в дни переводится только при ее смене,
+// подряд идущие свечи чаще всего одного дня
+static inline int64_t sequentialCandleSeconds(
+    const Candle &candle,
+    uint64_t *date,
+    int64_t *dayStart
+)
+{
+    if (candle.date != *date) {
+        Candle day = {};
+        day.date = candle.date;
+        *dayStart = candleSeconds(day);
+        *date = candle.date;
+    }
+    int64_t time = candle.time;
+    return *dayStart + time / 10000 * 3600 + time / 100 % 100 * 60 + time % 100;
+}
+
+SessionIndex::SessionIndex()
+    : mMemory(MemorySeriesIndexes)
+{
+    clear();
+}
+
+SessionIndex::SessionIndex(const SessionIndex &other)
+    : mMemory(MemorySeriesIndexes)
+{
+    mScannedCount = other.mScannedCount;
+    mStep = other.mStep;
+    mLastTime = other.mLastTime;
+    mFirsts = other.mFirsts;
+    mFirstTimes = other.mFirstTimes;
+    mIsRegular = other.mIsRegular;
+}
+
+void SessionIndex::clear()
+{
+    mScannedCount = 0;
+    mStep = 0;
+    mLastTime = 0;
+    mFirsts.clear();
+    mFirstTimes.clear();
+    mIsRegular.clear();
+    mMemory.setUsage(0);
+}
+
+void SessionIndex::swap(SessionIndex &other)
+{
+    std::swap(mScannedCount, other.mScannedCount);
+    std::swap(mStep, other.mStep);
+    std::swap(mLastTime, other.mLastTime);
+    mFirsts.swap(other.mFirsts);
+    mFirstTimes.swap(other.mFirstTimes);
+    mIsRegular.swap(other.mIsRegular);
+    updateMemoryUsage();
+    other.updateMemoryUsage();
+}
+
+size_t SessionIndex::size() const
+{
+    return mFirsts.size();
+}
+
+uint64_t SessionIndex::first(size_t session) const
+{
+    return mFirsts[session];
+}
+
+int64_t SessionIndex::firstTime(size_t session) const
+{
+    return mFirstTimes[session];
+}
+
+uint64_t SessionIndex::end(size_t session) const
+{
+    return session + 1 < mFirsts.size() ? mFirsts[session + 1] : mScannedCount;
+}
+
+size_t SessionIndex::sessionOf(uint64_t candleIndex) const
+{
+    size_t session = std::upper_bound(mFirsts.begin(), mFirsts.end(), candleIndex) -
+        mFirsts.begin();
+    return session > 0 ? session - 1 : 0;
+}
+
+size_t SessionIndex::lowerBound(uint64_t candleIndex) const
+{
+    return std::lower_bound(mFirsts.begin(), mFirsts.end(), candleIndex) -
+        mFirsts.begin();
+}
+
+int64_t SessionIndex::step() const
+{
+    return mStep;
+}
+
+uint64_t SessionIndex::scannedCount() const
+{
+    return mScannedCount;
+}
+
+int64_t SessionIndex::timeAt(const DataSeries &dataSeries, int64_t candleIndex) const
+{
+    if (mScannedCount == 0) {
+        return 0;
+    }
+    if (candleIndex < 0) {
+        return mFirstTimes[0] + candleIndex * mStep;
+    }
+    if ((uint64_t)candleIndex >= mScannedCount) {
+        return mLastTime + (candleIndex - (int64_t)mScannedCount + 1) * mStep;
+    }
+    return candleSeconds(dataSeries.at(candleIndex));
+}
+
+uint64_t SessionIndex::indexAt(const DataSeries &dataSeries, int64_t time) const
+{
+    if (mScannedCount == 0 || time <= mFirstTimes[0]) {
+        return 0;
+    }
+    if (time > mLastTime) {
+        return mScannedCount;
+    }
+    // последняя сессия, начавшаяся не позже time
+    size_t session = std::upper_bound(mFirstTimes.begin(), mFirstTimes.end(), time) -
+        mFirstTimes.begin() - 1;
+    uint64_t begin = mFirsts[session];
+    uint64_t end = this->end(session);
+    if (mIsRegular[session] && mStep > 0) {
+        // время в разрыве после сессии дает первую свечу следующей
+        uint64_t offset = (time - mFirstTimes[session] + mStep - 1) / mStep;
+        return qMin(begin + offset, end);
+    }
+    while (begin < end) {
+        uint64_t middle = begin + (end - begin) / 2;
+        if (candleSeconds(dataSeries.at(middle)) < time) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return begin;
+}
+
+void SessionIndex::update(const DataSeries &dataSeries)
+{
+    uint64_t size = dataSeries.size();
+    if (size < mScannedCount) {
+        clear();
+    }
+    uint64_t begin = mScannedCount;
+    if (begin == size) {
+        return;
+    }
+    // шаг уточняется по новым свечам до разбора, иначе при загрузке
+    // первые интервалы сравнивались бы с еще неизвестным шагом;
+    // разобранные сессии с уменьшением шага не пересчитываются
+    uint64_t date = 0;
+    int64_t dayStart = 0;
+    int64_t previous = begin > 0 ? mLastTime : candleSeconds(dataSeries.at(0));
+    int64_t step = mStep;
+    for (uint64_t i = qMax<uint64_t>(begin, 1); i < size; ++i) {
+        int64_t time = sequentialCandleSeconds(dataSeries.at(i), &date, &dayStart);
+        int64_t delta = time - previous;
+        if (delta > 0 && (mStep == 0 || delta < mStep)) {
+            mStep = delta;
+        }
+        previous = time;
+    }
+    // сессии шли прежним шагом, свечи в них теперь только ищутся
+    if (mStep != step) {
+        for (uint64_t session = 0; session < mIsRegular.size(); ++session) {
+            mIsRegular.set(session, 0);
+        }
+    }
+    int64_t gap = qMax(GapSteps * mStep, GapMinSeconds);
+    for (uint64_t i = begin; i < size; ++i) {
+        int64_t time = sequentialCandleSeconds(dataSeries.at(i), &date, &dayStart);
+        if (i == 0 || time - mLastTime > gap) {
+            mFirsts.push_back(i);
+            mFirstTimes.push_back(time);
+            mIsRegular.push_back(1);
+        } else if (time - mLastTime != mStep) {
+            mIsRegular.set(mIsRegular.size() - 1, 0);
+        }
+        mLastTime = time;
+    }
+    mScannedCount = size;
+    updateMemoryUsage();
+}
+
+void SessionIndex::updateMemoryUsage()
+{
+    mMemory.setUsage(
+        mFirsts.memoryUsage() + mFirstTimes.memoryUsage() + mIsRegular.memoryUsage()
+    );
+}
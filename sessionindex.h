@@ -0,0 +1,72 @@
+#ifndef SESSIONINDEX_H
+#define SESSIONINDEX_H
+
+#include "memory.h"
+#include "chunkedvector.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+
+class DataSeries;
+
+// торговые сессии ряда: отрезки свечей без разрывов по времени, разрыв -
+// интервал между свечами больше GapSteps обычных шагов и не меньше
+// GapMinSeconds; хранятся только начала сессий, поэтому ось времени
+// со сжатыми разрывами переводит свечу во время и обратно за O(log сессий)
+class SessionIndex {
+public:
+    SessionIndex();
+    // снимок индекса: сессии разделяются блоками без копирования, снимок
+    // в учет памяти не входит и читается в другом потоке, пока исходный
+    // индекс дописывают
+    SessionIndex(const SessionIndex &other);
+    SessionIndex &operator=(const SessionIndex &) = delete;
+    // разобрать свечи, добавленные в конец ряда с прошлого вызова,
+    // ряд меньше разобранного считается новым и разбирается заново
+    void update(const DataSeries &dataSeries);
+    void clear();
+    // обменяться разбором с индексом, построенным по другому ряду,
+    // например в фоне
+    void swap(SessionIndex &other);
+    // кол-во сессий
+    size_t size() const;
+    // первая свеча сессии и ее время в секундах от 1970-01-01
+    uint64_t first(size_t session) const;
+    int64_t firstTime(size_t session) const;
+    // свеча за последней свечой сессии
+    uint64_t end(size_t session) const;
+    // сессия свечи candleIndex
+    size_t sessionOf(uint64_t candleIndex) const;
+    // первая сессия, начинающаяся со свечи не раньше candleIndex
+    size_t lowerBound(uint64_t candleIndex) const;
+    // обычный шаг между свечами в секундах (наименьший), 0 - еще неизвестен
+    int64_t step() const;
+    // время свечи в секундах, за концами ряда продолжается обычным шагом
+    int64_t timeAt(const DataSeries &dataSeries, int64_t candleIndex) const;
+    // первая свеча со временем не меньше time (время в разрыве - первая
+    // свеча следующей сессии), кол-во разобранных свечей, если таких нет
+    uint64_t indexAt(const DataSeries &dataSeries, int64_t time) const;
+    // кол-во разобранных свечей ряда
+    uint64_t scannedCount() const;
+private:
+    // разрыв длиннее стольких обычных шагов
+    static const int64_t GapSteps = 4;
+    // и не короче получаса, чтобы паузы в секундных данных не делили сессию
+    static const int64_t GapMinSeconds = 30 * 60;
+    // кол-во сессий в блоке
+    static const uint64_t SessionChunkSize = 1 << 12;
+
+    void updateMemoryUsage();
+
+    uint64_t mScannedCount;
+    int64_t mStep;
+    int64_t mLastTime;
+    ChunkedVector<uint64_t, SessionChunkSize> mFirsts;
+    ChunkedVector<int64_t, SessionChunkSize> mFirstTimes;
+    // все свечи сессии идут обычным шагом, свеча по времени считается
+    // без поиска
+    ChunkedVector<uint8_t, SessionChunkSize> mIsRegular;
+    MemoryAccount mMemory;
+};
+
+#endif // SESSIONINDEX_H
@@ -0,0 +1,44 @@
+QT += core testlib
+QT -= gui
+
+# запуск: qmake && make check
+CONFIG += testcase console
+CONFIG -= app_bundle
+TARGET = tst_reader
+
+INCLUDEPATH += ..
+
+HEADERS = \
+    ../reader.h \
+    ../core.h \
+    ../lod.h \
+    ../prefixsum.h \
+    ../memory.h \
+    ../dataview.h \
+    ../dialect.h \
+    ../csvscan.h \
+    ../decompressor.h \
+    ../chunkedvector.h
+
+SOURCES = \
+    tst_reader.cpp \
+    ../reader.cpp \
+    ../core.cpp \
+    ../lod.cpp \
+    ../prefixsum.cpp \
+    ../memory.cpp \
+    ../dataview.cpp \
+    ../dialect.cpp \
+    ../csvscan.cpp \
+    ../decompressor.cpp
+
+# как в chartist.pro: сжатые файлы, если библиотеки найдены
+CONFIG += link_pkgconfig
+packagesExist(zlib) {
+    PKGCONFIG += zlib
+    DEFINES += CHARTIST_ZLIB
+}
+packagesExist(libzstd) {
+    PKGCONFIG += libzstd
+    DEFINES += CHARTIST_ZSTD
+}
@@ -0,0 +1,232 @@
+#include "reader.h"
+#include "csvscan.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+// разбор CSV сканером разделителей и разбором чисел словами сверяется
+// с прежним разбором: строка делится split(','), поля переводятся
+// QByteArray::toULongLong и QByteArray::toFloat; числа сравниваются до бита
+class TestReader : public QObject
+{
+    Q_OBJECT
+private slots:
+    void parseFloat_data();
+    void parseFloat();
+    void parseRandomFloats();
+    void readFile_data();
+    void readFile();
+};
+
+// строки с особыми случаями: короткие дроби, ведущие нули, целые без точки,
+// граница в 8 цифр, после которой число разбирается не одним словом
+static const char *const fixtureLines[] = {
+    "20170329,100000,1.5,2,0.1,1.25,100",
+    "20170329,100100,0001.2500,007,00.5,000.75,0000",
+    "20170329,100200,64.04,64.1,63.99,64.0,3",
+    "20170329,100300,1234567,12345678,1234567.8,1234567.12345678,99999999",
+    "20170329,100400,12345678.12345678,0.12345678,0.1234567,99999999.99999999,12345678",
+    "20170329,100500,123456789,1.123456789,123456789.123456789,0.000000001,123456789012",
+    "20170329,100600,0.3,0.7,16777217,9007199254740993,1.5e3"
+};
+
+static bool isSameBits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// поле с тем, что в файле может идти за ним: разделитель и цифры следующего
+// поля, числа разбираются словами по 8 байт и лишнее должно отбрасываться
+static QByteArray paddedField(const QByteArray &field)
+{
+    QByteArray padded = field;
+    padded.append(',');
+    padded.append(QByteArray(csvScanPadding, '9'));
+    return padded;
+}
+
+// десятичное число со случайным кол-вом цифр до и после точки, иногда
+// с ведущими нулями и знаком
+static QByteArray randomDecimal(std::mt19937 &random)
+{
+    QByteArray number;
+    if (random() % 8 == 0) {
+        number.append('-');
+    }
+    int zeros = random() % 6 == 0 ? random() % 4 : 0;
+    number.append(QByteArray(zeros, '0'));
+    int intDigits = 1 + random() % 12;
+    for (int i = 0; i < intDigits; ++i) {
+        number.append(char('0' + random() % 10));
+    }
+    int fraction = random() % 12;
+    if (fraction > 0) {
+        number.append('.');
+        for (int i = 0; i < fraction; ++i) {
+            number.append(char('0' + random() % 10));
+        }
+    }
+    return number;
+}
+
+// прежний разбор файла: строки без перевода строки, поля через split(',')
+static std::vector<Candle> readReference(const QByteArray &text)
+{
+    std::vector<Candle> candles;
+    for (QByteArray line : text.split('\n')) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        QList<QByteArray> fields = line.split(',');
+        if (fields.size() != 7) {
+            throw std::logic_error("Corrupted data in fixture");
+        }
+        Candle candle;
+        candle.date = (uint64_t)fields.at(0).toULongLong();
+        candle.time = (uint64_t)fields.at(1).toULongLong();
+        candle.open = fields.at(2).toFloat();
+        candle.high = fields.at(3).toFloat();
+        candle.low = fields.at(4).toFloat();
+        candle.close = fields.at(5).toFloat();
+        candle.volume = fields.at(6).toFloat();
+        candles.push_back(candle);
+    }
+    return candles;
+}
+
+void TestReader::parseFloat_data()
+{
+    QTest::addColumn<QByteArray>("field");
+    const char *const fields[] = {
+        "0", "1", "7", "1.5", "0.1", "0.3", "12.03", "64.04",
+        "0001.2500", "007", "00.5", "000.75", "-0.5", "-12.25", "-007.10",
+        "1234567", "12345678", "123456789", "99999999", "100000000",
+        "0.1234567", "0.12345678", "0.123456789", "0.00000001",
+        "12345678.12345678", "99999999.99999999", "123456789.123456789",
+        "1.123456789", "16777217", "9007199254740993", "9007199254740992.5",
+        "12345678901234567890", "0.1234567890123456789012",
+        "3.4028235e38", "1.5e3", "1.", ".5", "-", "", "1,5"
+    };
+    for (const char *field : fields) {
+        QTest::newRow(*field != '\0' ? field : "empty") << QByteArray(field);
+    }
+}
+
+void TestReader::parseFloat()
+{
+    QFETCH(QByteArray, field);
+    QByteArray padded = paddedField(field);
+    float value = 0;
+    bool isParsed = parseCsvFloat(
+        padded.constData(),
+        padded.constData() + field.size(),
+        &value
+    );
+    bool isExpectedParsed;
+    float expected = field.toFloat(&isExpectedParsed);
+    QCOMPARE(isParsed, isExpectedParsed);
+    if (isParsed) {
+        QVERIFY2(
+            isSameBits(value, expected),
+            qPrintable(QString("%1 != %2").arg(value, 0, 'g', 9).arg(expected, 0, 'g', 9))
+        );
+    }
+}
+
+void TestReader::parseRandomFloats()
+{
+    std::mt19937 random(20170329);
+    for (int i = 0; i < 1000000; ++i) {
+        QByteArray field = randomDecimal(random);
+        QByteArray padded = paddedField(field);
+        float value = 0;
+        bool isParsed = parseCsvFloat(
+            padded.constData(),
+            padded.constData() + field.size(),
+            &value
+        );
+        float expected = field.toFloat();
+        QVERIFY2(isParsed && isSameBits(value, expected), field.constData());
+    }
+}
+
+void TestReader::readFile_data()
+{
+    QTest::addColumn<QByteArray>("lineEnd");
+    QTest::addColumn<bool>("isLastLineEnded");
+    QTest::newRow("lf") << QByteArray("\n") << true;
+    QTest::newRow("crlf") << QByteArray("\r\n") << true;
+    QTest::newRow("lf without last newline") << QByteArray("\n") << false;
+    QTest::newRow("crlf without last newline") << QByteArray("\r\n") << false;
+}
+
+void TestReader::readFile()
+{
+    QFETCH(QByteArray, lineEnd);
+    QFETCH(bool, isLastLineEnded);
+
+    // особые строки и случайные свечи, файл больше блока чтения,
+    // чтобы строки попадали на границы блоков
+    QByteArray text;
+    for (const char *line : fixtureLines) {
+        text.append(line);
+        text.append(lineEnd);
+    }
+    std::mt19937 random(20170330);
+    for (int i = 0; i < 40000; ++i) {
+        text.append(QByteArray::number(20170331 + i / 1440));
+        text.append(',');
+        text.append(QByteArray::number(i % 1440 / 60 * 10000 + i % 60 * 100));
+        for (int column = 0; column < 5; ++column) {
+            text.append(',');
+            text.append(randomDecimal(random));
+        }
+        text.append(lineEnd);
+    }
+    text.append(fixtureLines[0]);
+    if (isLastLineEnded) {
+        text.append(lineEnd);
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString fileName = dir.filePath("candles.csv");
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(text), (qint64)text.size());
+    file.close();
+
+    std::vector<Candle> expected = readReference(text);
+    // части разного размера, чтобы проверить и дописывание частей в ряд
+    for (uint16_t partSize : {(uint16_t)1, (uint16_t)256}) {
+        DataSeries series;
+        Reader::readFromFile(fileName, &series, partSize);
+        QCOMPARE(series.size(), (uint64_t)expected.size());
+        for (uint64_t i = 0; i < series.size(); ++i) {
+            const Candle &candle = series.at(i);
+            const Candle &reference = expected[i];
+            QString row = QString("row %1").arg(i);
+            QVERIFY2(candle.date == reference.date, qPrintable(row));
+            QVERIFY2(candle.time == reference.time, qPrintable(row));
+            QVERIFY2(isSameBits(candle.open, reference.open), qPrintable(row));
+            QVERIFY2(isSameBits(candle.high, reference.high), qPrintable(row));
+            QVERIFY2(isSameBits(candle.low, reference.low), qPrintable(row));
+            QVERIFY2(isSameBits(candle.close, reference.close), qPrintable(row));
+            QVERIFY2(isSameBits(candle.volume, reference.volume), qPrintable(row));
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(TestReader)
+
+#include "tst_reader.moc"
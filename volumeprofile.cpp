@@ -0,0 +1,211 @@
+#include "volumeprofile.h"
+#include "core.h"
+
+#include <QThread>
+
+#include <math.h>
+
+// объем свечи делится между корзинами пропорционально перекрытию
+// корзины с диапазоном [low, high] свечи, volumes начинается с firstBucket
+static inline void addCandleVolume(
+    const Candle &candle,
+    double bucketSize,
+    int64_t firstBucket,
+    double sign,
+    double *volumes
+)
+{
+    double low = candle.low / bucketSize;
+    double high = candle.high / bucketSize;
+    int64_t lowBucket = floor(low);
+    int64_t highBucket = floor(high);
+    double volume = sign * candle.volume;
+    if (lowBucket >= highBucket) {
+        volumes[lowBucket - firstBucket] += volume;
+        return;
+    }
+    double perBucket = volume / (high - low);
+    volumes[lowBucket - firstBucket] += perBucket * (lowBucket + 1 - low);
+    for (int64_t b = lowBucket + 1; b < highBucket; ++b) {
+        volumes[b - firstBucket] += perBucket;
+    }
+    volumes[highBucket - firstBucket] += perBucket * (high - highBucket);
+}
+
+VolumeProfile::VolumeProfile()
+{
+    clear();
+}
+
+void VolumeProfile::clear()
+{
+    mDataSeries = nullptr;
+    mBegin = 0;
+    mEnd = 0;
+    mBucketSize = 0;
+    mFirstBucket = 0;
+    mVolumes.clear();
+    mMaxVolume = 0;
+}
+
+double VolumeProfile::bucketSize() const
+{
+    return mBucketSize;
+}
+
+int64_t VolumeProfile::firstBucket() const
+{
+    return mFirstBucket;
+}
+
+const std::vector<double> &VolumeProfile::volumes() const
+{
+    return mVolumes;
+}
+
+double VolumeProfile::maxVolume() const
+{
+    return mMaxVolume;
+}
+
+double VolumeProfile::niceBucketSize(double minSize)
+{
+    double power = pow(10, floor(log10(minSize)));
+    double steps[] = {1, 2, 5, 10};
+    for (double step : steps) {
+        if (step * power >= minSize) {
+            return step * power;
+        }
+    }
+    return 10 * power;
+}
+
+void VolumeProfile::update(
+    const DataSeries *dataSeries,
+    uint64_t begin,
+    uint64_t end,
+    double bucketSize
+)
+{
+    if (
+        dataSeries == mDataSeries &&
+        bucketSize == mBucketSize &&
+        begin == mBegin &&
+        end == mEnd
+    ) {
+        return;
+    }
+    // края, которые нужно добавить и вычесть, дешевле построения заново,
+    // пока их меньше половины диапазона
+    bool isSameGrid = dataSeries == mDataSeries &&
+        bucketSize == mBucketSize &&
+        !mVolumes.empty();
+    mBucketSize = bucketSize;
+    if (begin >= end || bucketSize <= 0) {
+        mDataSeries = dataSeries;
+        mBegin = begin;
+        mEnd = end;
+        mVolumes.clear();
+        mMaxVolume = 0;
+        return;
+    }
+    bool isOverlap = begin < mEnd && mBegin < end;
+    uint64_t changed = (begin > mBegin ? begin - mBegin : mBegin - begin) +
+        (end > mEnd ? end - mEnd : mEnd - end);
+    if (!isSameGrid || !isOverlap || changed > (end - begin) / 2) {
+        rebuild(dataSeries, begin, end);
+    } else {
+        if (begin < mBegin) {
+            addCandles(dataSeries, begin, mBegin, 1);
+        } else if (begin > mBegin) {
+            addCandles(dataSeries, mBegin, begin, -1);
+        }
+        if (end > mEnd) {
+            addCandles(dataSeries, mEnd, end, 1);
+        } else if (end < mEnd) {
+            addCandles(dataSeries, end, mEnd, -1);
+        }
+        updateMaxVolume();
+    }
+    mDataSeries = dataSeries;
+    mBegin = begin;
+    mEnd = end;
+}
+
+// добавление (sign = 1) или вычитание (sign = -1) объема свечей [begin, end),
+// при добавлении сетка корзин расширяется под цены этих свечей
+void VolumeProfile::addCandles(
+    const DataSeries *dataSeries,
+    uint64_t begin,
+    uint64_t end,
+    double sign
+)
+{
+    if (sign > 0) {
+        CandleRange range = dataSeries->range(begin, end);
+        int64_t lowBucket = floor(range.low / mBucketSize);
+        int64_t highBucket = floor(range.high / mBucketSize);
+        if (lowBucket < mFirstBucket) {
+            mVolumes.insert(mVolumes.begin(), mFirstBucket - lowBucket, 0);
+            mFirstBucket = lowBucket;
+        }
+        int64_t lastBucket = mFirstBucket + (int64_t)mVolumes.size() - 1;
+        if (highBucket > lastBucket) {
+            mVolumes.resize(mVolumes.size() + (highBucket - lastBucket), 0);
+        }
+    }
+    for (uint64_t i = begin; i < end; ++i) {
+        addCandleVolume(dataSeries->at(i), mBucketSize, mFirstBucket, sign, mVolumes.data());
+    }
+}
+
+void VolumeProfile::rebuild(
+    const DataSeries *dataSeries,
+    uint64_t begin,
+    uint64_t end
+)
+{
+    CandleRange range = dataSeries->range(begin, end);
+    mFirstBucket = floor(range.low / mBucketSize);
+    int64_t lastBucket = floor(range.high / mBucketSize);
+    size_t bucketCount = lastBucket - mFirstBucket + 1;
+    uint64_t size = end - begin;
+    int threadCount = QThread::idealThreadCount();
+    if (size < ParallelMinSize || threadCount < 2) {
+        mVolumes.assign(bucketCount, 0);
+        for (uint64_t i = begin; i < end; ++i) {
+            addCandleVolume(dataSeries->at(i), mBucketSize, mFirstBucket, 1, mVolumes.data());
+        }
+        updateMaxVolume();
+        return;
+    }
+    // у каждой части своя гистограмма
+    int chunkCount = parallelPartCount(size, ParallelMinSize / 4);
+    std::vector<std::vector<double> > chunkVolumes(chunkCount);
+    parallelFor(begin, end, ParallelMinSize / 4, [&](int chunk, uint64_t first, uint64_t last) {
+        std::vector<double> &volumes = chunkVolumes[chunk];
+        volumes.assign(bucketCount, 0);
+        for (uint64_t i = first; i < last; ++i) {
+            addCandleVolume(dataSeries->at(i), mBucketSize, mFirstBucket, 1, volumes.data());
+        }
+    });
+    // сведение гистограмм частей
+    mVolumes.assign(bucketCount, 0);
+    for (int chunk = 0; chunk < chunkCount; ++chunk) {
+        const std::vector<double> &volumes = chunkVolumes[chunk];
+        for (size_t b = 0; b < bucketCount; ++b) {
+            mVolumes[b] += volumes[b];
+        }
+    }
+    updateMaxVolume();
+}
+
+void VolumeProfile::updateMaxVolume()
+{
+    mMaxVolume = 0;
+    for (size_t b = 0; b < mVolumes.size(); ++b) {
+        if (mVolumes[b] > mMaxVolume) {
+            mMaxVolume = mVolumes[b];
+        }
+    }
+}
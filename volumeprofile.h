@@ -0,0 +1,58 @@
+#ifndef VOLUMEPROFILE_H
+#define VOLUMEPROFILE_H
+
+#include <inttypes.h>
+#include <vector>
+
+struct Candle;
+class DataSeries;
+
+// профиль объема по ценам: объем свечей диапазона, распределенный по корзинам
+// цены, корзина i покрывает цены [i * bucketSize, (i + 1) * bucketSize),
+// поэтому сетка корзин не зависит от диапазона цен на экране
+class VolumeProfile {
+public:
+    VolumeProfile();
+    // профиль свечей [begin, end) с корзинами bucketSize: при том же размере
+    // корзин и пересекающемся диапазоне добавляются и вычитаются только свечи
+    // на краях, иначе профиль строится заново параллельно по частям диапазона
+    void update(
+        const DataSeries *dataSeries,
+        uint64_t begin,
+        uint64_t end,
+        double bucketSize
+    );
+    double bucketSize() const;
+    // номер корзины, с которой начинается volumes()
+    int64_t firstBucket() const;
+    const std::vector<double> &volumes() const;
+    // наибольший объем корзины
+    double maxVolume() const;
+    void clear();
+
+    // размер корзины из ряда 1, 2, 5 * 10^k, не меньше minSize, поэтому
+    // при небольших изменениях диапазона цен размер корзин не меняется
+    static double niceBucketSize(double minSize);
+private:
+    void rebuild(const DataSeries *dataSeries, uint64_t begin, uint64_t end);
+    void addCandles(
+        const DataSeries *dataSeries,
+        uint64_t begin,
+        uint64_t end,
+        double sign
+    );
+    void updateMaxVolume();
+
+    // минимальное кол-во свечей для параллельного построения
+    static const uint64_t ParallelMinSize = 1 << 16;
+
+    const DataSeries *mDataSeries;
+    uint64_t mBegin;
+    uint64_t mEnd;
+    double mBucketSize;
+    int64_t mFirstBucket;
+    std::vector<double> mVolumes;
+    double mMaxVolume;
+};
+
+#endif // VOLUMEPROFILE_H
@@ -1,941 +1,680 @@
 #include "widget.h"
 #include "reader.h"
+#include "renderthread.h"
+#include "framescheduler.h"
+#include "feedclient.h"
+#include "memory.h"
 
 #include <QPainter>
 #include <QPaintEvent>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QResizeEvent>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTextStream>
+
+#include <math.h>
+#include <stdexcept>
+
+Widget::Widget(
+    QWidget *parent,
+    const QStringList &fileNames,
+    DuplicatePolicy duplicatePolicy
+)
+    : QWidget(parent), mChart(&mDataSeries)
+{
+    setMinimumSize(640, 480);
+    setMouseTracking(true);
+
+    mIsScrollBarPressed = false;
+    mIsRmbMousePressed = false;
+    mPanLastPos = QPoint(-1, -1);
+    mPanPressPos = QPoint(-1, -1);
+    mPanClickDistance = 3;
+    mPanVelocity = 0;
+    mKineticRemainder = 0;
+    mKineticFriction = 0.95;
+    mKineticMinVelocity = 0.05;
+    mKineticInterval = 16;
+    mKineticMaxIdle = 50;
+    mKineticTimer = new QTimer(this);
+    mKineticTimer->setInterval(mKineticInterval);
+    connect(mKineticTimer, &QTimer::timeout, this, &Widget::onKineticTimer);
+    mZoomFactor = 1.25;
+    mInteractionIdleDelay = 150;
+    mInteractiveFrameBudget = 8;
+    mMemoryTrimInterval = 1000;
+    mInteractionTimer = new QTimer(this);
+    mInteractionTimer->setSingleShot(true);
+    mInteractionTimer->setInterval(mInteractionIdleDelay);
+    connect(mInteractionTimer, &QTimer::timeout, this, &Widget::onInteractionIdle);
+
+    // кадр целиком рисуется в потоке отрисовки
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    mRenderThread = new RenderThread(this);
+    connect(mRenderThread, &RenderThread::frameReady, this, &Widget::onFrameReady);
+    // кадры запрашиваются не чаще обновления экрана
+    mFrameScheduler = new FrameScheduler(this);
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (screen != nullptr && screen->refreshRate() > 0) {
+        mFrameScheduler->setFrameInterval(qRound(1000 / screen->refreshRate()));
+    }
+    connect(
+        mFrameScheduler,
+        &FrameScheduler::frameRequested,
+        this,
+        &Widget::onFrameRequested
+    );
+
+    mFeedClient = nullptr;
+    mFeedStatsCandles = 0;
+    mFeedLatencySum = 0;
+    mFeedLatencyMax = 0;
+    mFeedLatencyCount = 0;
+    mFeedAlertTime = 0;
+    mLazyReader = nullptr;
+    mIsBacktestPending = false;
+
+    // читаем данные из файлов, без файлов свечи придут от повтора
+    if (fileNames.size() == 1 && LazyReader::isSupported(fileNames.first())) {
+        openLazily(fileNames.first());
+    } else if (fileNames.size() == 1) {
+        Reader::readFromFile(fileNames.first(), &mDataSeries);
+    } else if (fileNames.size() > 1) {
+        Reader::readFromFiles(fileNames, &mDataSeries, duplicatePolicy);
+    }
+    mPatternIndex.update(mDataSeries);
+    mChart.setPatternIndex(&mPatternIndex);
+    mSessionIndex.update(mDataSeries);
+    mChart.setSessionIndex(&mSessionIndex);
+    mIndicators.setDataSeries(&mDataSeries);
+    // история индикаторов досчитана, перерисуем их по ней
+    connect(
+        &mIndicators,
+        &IndicatorSet::historyReady,
+        this,
+        [this]() { invalidate(ChartViewportChange); },
+        Qt::QueuedConnection
+    );
+}
 
-Widget::Widget(QWidget *parent, const QString &fileName)
-    : QWidget(parent)
+Widget::~Widget()
 {
-    optShowLabelsWithMouse = true;
-    optSelectAreaWithMouse = true;
-    optShowVolumeGraph = true;
-    optShowScrollArea = true;
+    // поток отрисовки читает данные виджета, остановим его раньше
+    delete mRenderThread;
+    // фоновый разбор файла пишет в сессии виджета
+    delete mLazyReader;
+    delete mFeedClient;
+}
 
-    setMinimumSize(640, 480);
+void Widget::showBacktest(const BacktestParams &params)
+{
+    if (mLazyReader != nullptr) {
+        mIsBacktestPending = true;
+        mPendingBacktest = params;
+        return;
+    }
+    std::shared_ptr<std::vector<BacktestTrade> > trades(
+        new std::vector<BacktestTrade>()
+    );
+    BacktestResult result = Backtest::runStrategy(mDataSeries, params, trades.get());
+    mChart.setTrades(trades);
+    invalidate(ChartViewportChange);
+    QTextStream(stderr) << QString("Backtest: %1 trades, return %2 %, max drawdown %3 %")
+        .arg(result.tradeCount)
+        .arg(result.totalReturn * 100, 0, 'f', 2)
+        .arg(result.maxDrawdown * 100, 0, 'f', 2) << "\n";
+}
+
+bool Widget::addIndicator(const QString &text, bool isOverlay)
+{
+    try {
+        mIndicators.add(text, isOverlay);
+        // видимые свечи считаются при отрисовке, вся история - в фоне
+        mIndicators.startHistory();
+    } catch (const std::logic_error &e) {
+        QTextStream(stderr) << "Indicator " << text << ": " << e.what() << "\n";
+        return false;
+    }
+    invalidate(ChartViewportChange);
+    return true;
+}
 
-    mDataXBounds = QPointF(-1000, 1000);
-    mDataYBounds = QPointF(0, 1);
-    mVolumeBounds = QPointF(0, 1);
+bool Widget::addAlert(const QString &text)
+{
+    AlertCondition condition;
+    if (!AlertTable::parse(text, &condition)) {
+        QTextStream(stderr) << "Invalid alert: " << text << "\n";
+        return false;
+    }
+    // уровень сравнивается с последней загруженной свечой
+    mAlerts.update(mDataSeries);
+    mAlerts.add(condition);
+    return true;
+}
 
-    mMousePos = QPoint(-1, -1);
-    setMouseTracking(true);
-    mMousePressPos = QPoint(-1, -1);
-    mMouseReleasePos = QPoint(-1, -1);
-    mMouseGraphPressPos = QPoint(-1, -1);
-    mMouseGraphReleasePos = QPoint(-1, -1);
-    mIsMouseEnter = false;
-    mIsLmbMousePressed = false;
-    mIsLmbMousePress = false;
-    mIsLmbMouseRelease = false;
-    mIsResize = false;
-    mIsCandleWidthChanged = false;
-    mIsNeedClearArea = false;
-    mIsMousePressInGraph = false;
-
-    mBackgroundBrush = QBrush(Qt::white);
-    mAxisPen = QPen(Qt::black, 1);
-    mMouseAxisPen = QPen(Qt::blue, 1);
-    mMouseAxisPen.setStyle(Qt::DashLine);
-    mMouseAxisVolumePen = QPen(Qt::red, 1);
-    mMouseAxisVolumePen.setStyle(Qt::DashLine);
-    mMouseLabelPen = QPen(Qt::blue, 1);
-    mMouseVolumeLabelPen = QPen(Qt::red, 1);
-    mMouseSelectAreaPen = QPen(Qt::darkBlue, 1);
-    mMouseSelectAreaPen.setStyle(Qt::DashLine);
-    mMouseSelectAreaLabelsPen = QPen(mMouseSelectAreaPen.color(), 1);
-    mMouseSelectAreaBrushAlpha = 80;
-    mCandlePen = QPen(Qt::black, 1);
-    mCandleUpBrush = QBrush(Qt::green);
-    mCandleDownBrush = QBrush(Qt::red);
-    mCandleBrushAlpha = 80;
-    mScrollBarPen = QPen(Qt::darkGray, 1);
-
-    mAxisXLeftBorderLength = 0;
-    mAxisXRightBorderLength = 52;
-    mAxisYTopBorderLength = 0;
-    mAxisYBottomBorderLength = 20;
-    mAxisXDashCount = 10;
-    mAxisYDashCount = 10;
-    mAxisYVolumeDashCount = 4;
-    mAxisXDashLen = 4;
-    mAxisYDashLen = 4;
-    mAxisXDashSpace = 2;
-    mAxisYDashSpace = 4;
-    mAxisLabelHalfWidth = 20;
-    mAxisLabelHalfHeight = 5;
-    mMaxAxisLabelLength = 6;
-    mAxisLabelXAdditionalLength = 1;
-    mAxisLabelYAdditionalLength = 1;
-    mCandleWidth = 15;
-    mBetweenCandlesWidth = 2;
-    mViewedCandleCount = 0;
-    mCandleOffsetFromEnd = 0;
-    mCandleMinWidth = 3;
-    mCandleMaxWidth = 50;
-    mAxisYVolumeHeight = 100;
-    mAxisYScrollBarHeight = 30;
-
-    mDataSeries = DataSeries();
-    // читаем данные из файла
-    Reader::readFromFile(fileName, &mDataSeries);
+void Widget::connectFeed(const QString &host, quint16 port)
+{
+    delete mFeedClient;
+    mFeedClient = new FeedClient(host, port);
+    mFeedMessages.resize(1 << 16);
+    // свечи забираются при подготовке кадра, так что за кадр к данным
+    // дописывается все, что пришло, одной пачкой
+    connect(
+        mFeedClient,
+        &FeedClient::messagesAvailable,
+        this,
+        [this]() { invalidate(ChartAppendChange); },
+        Qt::QueuedConnection
+    );
+    connect(
+        mFeedClient,
+        &FeedClient::finished,
+        this,
+        &Widget::onFeedFinished,
+        Qt::QueuedConnection
+    );
+    mFeedStatsTimer.start();
+    mFeedClient->start();
 }
 
 bool Widget::showLabelsWithMouse() const
 {
-    return optShowLabelsWithMouse;
+    return mChart.showLabelsWithMouse();
 }
 
 void Widget::setShowLabelsWithMouse(bool newValue)
 {
-    if (optShowLabelsWithMouse != newValue) {
-        optShowLabelsWithMouse = newValue;
-    }
+    mChart.setShowLabelsWithMouse(newValue);
+    invalidate(ChartCrosshairChange);
 }
 
 bool Widget::selectAreaWithMouse() const
 {
-    return optSelectAreaWithMouse;
+    return mChart.selectAreaWithMouse();
 }
 
 void Widget::setSelectAreaWithMouse(bool newValue)
 {
-    if (optSelectAreaWithMouse != newValue) {
-        optSelectAreaWithMouse = newValue;
-    }
+    mChart.setSelectAreaWithMouse(newValue);
+    invalidate(ChartSelectionChange);
 }
 
 bool Widget::showVolumeGraph() const
 {
-    return optShowVolumeGraph;
+    return mChart.showVolumeGraph();
 }
 
 void Widget::setShowVolumeGraph(bool newValue)
 {
-    if (optShowVolumeGraph != newValue) {
-        optShowVolumeGraph = newValue;
-    }
+    mChart.setShowVolumeGraph(newValue);
+    invalidate(ChartLayoutChange);
 }
 
 bool Widget::showScrollArea() const
 {
-    return optShowScrollArea;
+    return mChart.showScrollArea();
 }
 
 void Widget::setShowScrollArea(bool newValue)
 {
-    if (optShowScrollArea != newValue) {
-        optShowScrollArea = newValue;
-    }
+    mChart.setShowScrollArea(newValue);
+    invalidate(ChartLayoutChange);
+}
+
+bool Widget::showSelectionStats() const
+{
+    return mChart.showSelectionStats();
+}
+
+void Widget::setShowSelectionStats(bool newValue)
+{
+    mChart.setShowSelectionStats(newValue);
+    invalidate(ChartSelectionChange);
+}
+
+bool Widget::showVolumeProfile() const
+{
+    return mChart.showVolumeProfile();
+}
+
+void Widget::setShowVolumeProfile(bool newValue)
+{
+    mChart.setShowVolumeProfile(newValue);
+    invalidate(ChartViewportChange);
 }
 
+bool Widget::showPatterns() const
+{
+    return mChart.showPatterns();
+}
+
+void Widget::setShowPatterns(bool newValue)
+{
+    mChart.setShowPatterns(newValue);
+    invalidate(ChartViewportChange);
+}
+
+// выводим последний готовый кадр, пока новый кадр рисуется в потоке отрисовки
 void Widget::paintEvent(QPaintEvent *event)
 {
+    Q_UNUSED(event);
+    QImage frame = mRenderThread->frame();
     QPainter painter;
     painter.begin(this);
-    painter.setRenderHint(QPainter::HighQualityAntialiasing);
-    paint(&painter, event);
+    if (frame.size() != size()) {
+        // при ресайзе кадр нового размера еще не готов
+        painter.fillRect(rect(), mChart.backgroundBrush());
+    }
+    painter.drawImage(QPoint(0, 0), frame);
     painter.end();
 }
 
-void Widget::mouseMoveEvent(QMouseEvent *event)
+// изменения, затрагивающие весь виджет
+void Widget::invalidate(int changes)
 {
-    mMousePos = event->pos();
-    if (optShowLabelsWithMouse) {
-        update();
-    }
+    mFrameScheduler->invalidate(changes, QRegion(rect()));
 }
 
-void Widget::leaveEvent(QEvent *event)
+void Widget::invalidate(int changes, const QRegion &region)
 {
-    Q_UNUSED(event);
-    mIsMouseEnter = false;
-    if (optShowLabelsWithMouse) {
-        // перерисовка, чтоб стереть оси мышки с метками
-        update();
-    }
+    mFrameScheduler->invalidate(changes, region);
 }
 
-void Widget::enterEvent(QEvent *event)
+// подготовка состояния графика по накопленным изменениям
+// и запрос нового кадра у потока отрисовки
+void Widget::onFrameRequested(int changes, const QRegion &region)
 {
-    Q_UNUSED(event);
-    mIsMouseEnter = true;
+    if (takeFeedCandles()) {
+        changes |= ChartAppendChange;
+    }
+    updateDerivedData();
+    mChart.prepare(size(), changes);
+    setCursor(mChart.cursorShape());
+    // данные дописываются только этим потоком, поэтому снимок берется
+    // без блокировки, а кадр рисуется по нему, пока приходят новые свечи
+    mRenderThread->requestFrame(
+        mChart,
+        std::make_shared<ChartData>(mDataSeries, mPatternIndex, mSessionIndex, mIndicators),
+        size(),
+        region
+    );
 }
 
-void Widget::mousePressEvent(QMouseEvent *event)
+void Widget::onFrameReady()
 {
-    mMousePressPos = event->pos();
-    if (optSelectAreaWithMouse) {
-        if (event->button() == Qt::LeftButton) {
-            mIsLmbMousePressed = true;
-            mIsLmbMousePress = true;
-            update();
-        } else if (event->button() == Qt::RightButton) {
-            mIsNeedClearArea = true;
-            update();
+    update(mRenderThread->takeReadyRegion());
+    // при взаимодействии огибающая вместо свечей включается с такого шага
+    // свечи, чтоб кадр укладывался в бюджет: при превышении порог быстро
+    // растет, при большом запасе медленно снижается
+    if (mChart.isInteractive()) {
+        qint64 frameTime = mRenderThread->lastFrameTime();
+        qint64 budget = mInteractiveFrameBudget * 1000000LL;
+        float step = mChart.interactiveCandleMinStep();
+        if (frameTime > budget) {
+            mChart.setInteractiveCandleMinStep(step * 1.5);
+        } else if (frameTime < budget / 2) {
+            mChart.setInteractiveCandleMinStep(step / 1.1);
         }
     }
+    if (mFeedClient != nullptr) {
+        updateFeedStats(mRenderThread->lastFrameDataSize());
+    }
 }
 
-void Widget::mouseReleaseEvent(QMouseEvent *event)
+// взаимодействие закончилось, перерисуем график полностью
+void Widget::onInteractionIdle()
 {
-    mIsLmbMousePressed = false;
-    mIsLmbMouseRelease = true;
-    mMouseReleasePos = event->pos();
+    mChart.setInteractive(false);
+    invalidate(ChartViewportChange);
 }
 
-void Widget::resizeEvent(QResizeEvent *event)
+void Widget::onFeedFinished(const QString &error)
 {
-    Q_UNUSED(event);
-    mIsResize = true;
-    update();
+    QTextStream(stderr) << "Feed finished" <<
+        (error.isEmpty() ? QString() : ": " + error) << "\n";
 }
 
-void Widget::wheelEvent(QWheelEvent *event)
+// первый кадр строится по последним строкам файла, скроллбар - по выборке
+// строк всего файла, весь файл разбирается в фоне вместе с сессиями
+void Widget::openLazily(const QString &fileName)
 {
-    if (event->angleDelta().y() > 0) {
-        if (mCandleWidth < mCandleMaxWidth / 2) {
-            mCandleWidth *= 2;
-            mIsCandleWidthChanged = true;
-        } else if (mCandleWidth < mCandleMaxWidth) {
-            mCandleWidth = mCandleMaxWidth;
-            mIsCandleWidthChanged = true;
+    mLazyReader = new LazyReader(this);
+    connect(
+        mLazyReader,
+        &LazyReader::finished,
+        this,
+        &Widget::onLazyReadFinished,
+        Qt::QueuedConnection
+    );
+    std::shared_ptr<std::vector<Candle> > samples(new std::vector<Candle>());
+    mLazyReader->open(
+        fileName,
+        &mDataSeries,
+        samples.get(),
+        [this](const DataSeries &dataSeries) { mLazySessionIndex.update(dataSeries); }
+    );
+    mChart.setOverview(samples, mLazyReader->estimatedSize());
+}
+
+// весь файл разобран: последние строки заменяются всем рядом, окно
+// просмотра отсчитывается от конца, поэтому на экране те же свечи;
+// модели строятся заново, когда понадобятся, индикаторы - в фоне
+void Widget::onLazyReadFinished()
+{
+    QString error = mLazyReader->error();
+    if (error.isEmpty()) {
+        mDataSeries = mLazyReader->takeSeries();
+        mSessionIndex.swap(mLazySessionIndex);
+        mLazySessionIndex.clear();
+        mPatternIndex.clear();
+        if (mIndicators.size() > 0) {
+            mIndicators.startHistory();
         }
     } else {
-        if (mCandleWidth > mCandleMinWidth * 2) {
-            mCandleWidth /= 2;
-            mIsCandleWidthChanged = true;
-        } else if (mCandleWidth > mCandleMinWidth) {
-            mCandleWidth = mCandleMinWidth;
-            mIsCandleWidthChanged = true;
-        }
+        QTextStream(stderr) << "Can't read the whole file: " << error << "\n";
     }
-    if (mIsCandleWidthChanged) {
-        update();
+    mChart.setOverview(nullptr, 0);
+    delete mLazyReader;
+    mLazyReader = nullptr;
+    if (mIsBacktestPending) {
+        mIsBacktestPending = false;
+        showBacktest(mPendingBacktest);
     }
+    invalidate(ChartAllChanges);
 }
 
-void Widget::paint(QPainter *painter, QPaintEvent *event)
+// дописывание пришедших свечей к данным, false - новых свечей нет
+bool Widget::takeFeedCandles()
 {
-    // сотрем все предыдущее залив область фоном
-    painter->fillRect(event->rect(), mBackgroundBrush);
-
-    int minX = 0;
-    int minY = 0;
-    int maxX = event->rect().width();
-    int maxY = event->rect().height();
-    int axisMinX = minX + mAxisXLeftBorderLength;
-    int axisMinY = minY + mAxisYTopBorderLength;
-    int axisMaxX = maxX - mAxisXRightBorderLength;
-    int axisMaxY = maxY - mAxisYBottomBorderLength;
-    if (optShowVolumeGraph) {
-        // если включено отображение графика объема, то
-        // сократим область графика по высоте
-        axisMaxY -= mAxisYVolumeHeight;
+    if (mFeedClient == nullptr) {
+        return false;
     }
-    int candleWidth = mCandleWidth + mBetweenCandlesWidth;
-
-    // пересчитаем диапазоны значений на осях
-    // ((при ресайзе окна или изменении ширины свечи) и наличии данных)
-    if ((mIsResize || mIsCandleWidthChanged) && mDataSeries.size() > 0) {
-        if (mIsResize) {
-            mIsResize = false;
-        } else {
-            mIsCandleWidthChanged = false;
-        }
-        // место крайней правой свечи не занимаем
-        mViewedCandleCount = (axisMaxX - axisMinX - candleWidth) / candleWidth;
-        if (mViewedCandleCount > (int)mDataSeries.size()) {
-            mViewedCandleCount = mDataSeries.size();
+    mFeedCandles.clear();
+    int64_t firstSentTime = 0;
+    size_t size;
+    while ((size = mFeedClient->take(mFeedMessages.data(), mFeedMessages.size())) > 0) {
+        if (mFeedCandles.empty()) {
+            firstSentTime = mFeedMessages[0].sentTime;
         }
-        float ymin = INFINITY, ymax = 0, volmax = 0;
-        for (int i = 0; i < mViewedCandleCount; ++i) {
-            Candle currCandle = mDataSeries.data()[mDataSeries.size() - 1 - i];
-            if (currCandle.low < ymin) {
-                ymin = currCandle.low;
-            }
-            if (currCandle.high > ymax) {
-                ymax = currCandle.high;
-            }
-            if (optShowVolumeGraph) {
-                if (currCandle.volume > volmax) {
-                    volmax = currCandle.volume;
-                }
-            }
-        }
-        mDataYBounds = QPointF(ymin, ymax);
-        mDataXBounds = QPointF(-mViewedCandleCount, 0);
-        if (optShowVolumeGraph) {
-            mVolumeBounds = QPointF(0, volmax);
+        for (size_t i = 0; i < size; ++i) {
+            mFeedCandles.push_back(mFeedMessages[i].candle);
         }
     }
-
-    // если отображается область скролла и кол-во видимых свечей меньше общего
-    // кол-ва свечей, то сократим область графика по высоте
-    if (optShowScrollArea && mViewedCandleCount < (int)mDataSeries.size()) {
-        // если отображается область скролла,
-        // то сократим область графика по высоте
-        axisMaxY -= mAxisYScrollBarHeight;
+    if (mFeedCandles.empty()) {
+        return false;
+    }
+    // поток отрисовки рисует по снимку данных, поэтому дописывание его не ждет
+    mDataSeries.append(mFeedCandles.data(), mFeedCandles.size());
+    mSessionIndex.update(mDataSeries);
+    // невидимые модели досчитываются, когда снова понадобятся
+    if (mChart.isPatternsDrawn()) {
+        mPatternIndex.update(mDataSeries);
     }
+    QElapsedTimer alertTimer;
+    alertTimer.start();
+    mAlerts.update(mDataSeries);
+    mFeedAlertTime += alertTimer.nsecsElapsed();
+    for (const AlertEvent &event : mAlerts.events()) {
+        const Candle &candle = mDataSeries.at(event.index);
+        QTextStream(stderr) << QString("Alert %1: %2 %3, close %4")
+            .arg(AlertTable::toString(mAlerts.condition(event.alert)))
+            .arg(candle.date)
+            .arg(candle.time, 6, 10, QChar('0'))
+            .arg(candle.close) << "\n";
+    }
+    mFeedStatsCandles += mFeedCandles.size();
+    mFeedLatencyMarks.enqueue(qMakePair(mDataSeries.size(), firstSentTime));
+    return true;
+}
 
-    // нарисуем оси
-    painter->setPen(mAxisPen);
-    // ось Х рисуем под графиком объема, если он задан
-    int offset = optShowVolumeGraph ? mAxisYVolumeHeight : 0;
-    painter->drawLine(
-        QPoint(axisMinX, axisMaxY + offset),
-        QPoint(axisMaxX, axisMaxY + offset)
-    );
-    painter->drawLine(
-        QPoint(axisMaxX, axisMinY),
-        QPoint(axisMaxX, axisMaxY + offset)
+// при превышении бюджета памяти выбрасываются давно не использованные
+// производные данные, а выброшенные, которые снова нужны графику,
+// строятся заново
+void Widget::updateDerivedData()
+{
+    // если в бюджет не уложиться, проверка идет не на каждом кадре
+    uint64_t limit = MemoryBudget::limit();
+    bool isOverBudget = limit > 0 && MemoryBudget::totalUsage() > limit && (
+        !mMemoryTrimTimer.isValid() || mMemoryTrimTimer.elapsed() >= mMemoryTrimInterval
     );
+    if (isOverBudget) {
+        // снимки данных у потока отрисовки выбрасывание не затрагивает
+        MemoryBudget::trim();
+        mMemoryTrimTimer.start();
+    }
+    // проверяется после выбрасывания, чтобы модели, выброшенные сейчас,
+    // построились к этому же кадру; история индикаторов запускается заново,
+    // только когда отрисовка считала индикаторы без нее
+    bool isPatternsStale = mChart.isPatternsDrawn() &&
+        mPatternIndex.scannedCount() < mDataSeries.size();
+    bool isHistoryMissing = mIndicators.size() > 0 && !mIndicators.hasHistory() &&
+        mIndicators.isHistoryRequested();
+    if (isPatternsStale) {
+        mPatternIndex.update(mDataSeries);
+    }
+    if (isHistoryMissing) {
+        mIndicators.startHistory();
+    }
+}
 
-    // нарисуем риски и данные на осях координат
-    // (не забываем про смещение оси вниз, если рисуется объем)
-    float deltaX = 1.0 * (axisMaxX - axisMinX) / mAxisXDashCount;
-    float dataDeltaX = (mDataXBounds.y() - mDataXBounds.x()) / mAxisXDashCount;
-    for (int i = 1; i < mAxisXDashCount; ++i) {
-        float x = axisMinX + i*deltaX;
-        painter->drawLine(QPointF(x, axisMaxY + offset), QPointF(x, axisMaxY + offset + mAxisXDashLen));
-        painter->drawText(
-            QRect(
-                QPoint(
-                    x - mAxisLabelHalfWidth,
-                    axisMaxY + offset + mAxisXDashLen + mAxisXDashSpace
-                ),
-                QPoint(
-                    x + mAxisLabelHalfWidth,
-                    axisMaxY + offset + mAxisXDashLen + 2*mAxisLabelHalfHeight + mAxisXDashSpace
-                )
-            ),
-            Qt::AlignCenter,
-            makeAxisLabel(mDataXBounds.x() + i*dataDeltaX)
-        );
-    }
-    float deltaY = 1.0 * (axisMaxY - axisMinY) / mAxisYDashCount;
-    float dataDeltaY = (mDataYBounds.y() - mDataYBounds.x()) / mAxisYDashCount;
-    for (int i = 1; i < mAxisYDashCount; ++i) {
-        float y = axisMaxY - (axisMinY + i*deltaY);
-        painter->drawLine(QPointF(axisMaxX, y), QPointF(axisMaxX + mAxisYDashLen, y));
-        painter->drawText(
-            QRect(
-                QPoint(
-                    axisMaxX + mAxisYDashLen + mAxisYDashSpace,
-                    y - mAxisLabelHalfHeight
-                ),
-                QPoint(
-                    axisMaxX + mAxisYDashLen + 2*mAxisLabelHalfWidth + mAxisYDashSpace,
-                    y + mAxisLabelHalfHeight
-                )
-            ),
-            Qt::AlignLeft,
-            makeAxisLabel(mDataYBounds.x() + i*dataDeltaY)
-        );
-    }
-    // риски графика объема
-    if (optShowVolumeGraph) {
-        float deltaY = 1.0 * mAxisYVolumeHeight / mAxisYVolumeDashCount;
-        float dataDeltaY = (mVolumeBounds.y() - mVolumeBounds.x()) / mAxisYVolumeDashCount;
-        for (int i = 1; i < mAxisYVolumeDashCount; ++i) {
-            float y = axisMaxY + mAxisYVolumeHeight - i*deltaY;
-            painter->drawLine(QPointF(axisMaxX, y), QPointF(axisMaxX + mAxisYDashLen, y));
-            painter->drawText(
-                QRect(
-                    QPoint(
-                        axisMaxX + mAxisYDashLen + mAxisYDashSpace,
-                        y - mAxisLabelHalfHeight
-                    ),
-                    QPoint(
-                        axisMaxX + mAxisYDashLen + 2*mAxisLabelHalfWidth + mAxisYDashSpace,
-                        y + mAxisLabelHalfHeight
-                    )
-                ),
-                Qt::AlignLeft,
-                makeAxisLabel(mVolumeBounds.x() + i*dataDeltaY)
-            );
-        }
+// задержка от отправки свечи повтором до готового кадра с ней,
+// раз в секунду печатается вместе с кол-вом принятых свечей
+void Widget::updateFeedStats(uint64_t frameDataSize)
+{
+    int64_t now = feedClockNow();
+    while (
+        !mFeedLatencyMarks.isEmpty() &&
+        mFeedLatencyMarks.head().first <= frameDataSize
+    ) {
+        int64_t latency = now - mFeedLatencyMarks.dequeue().second;
+        mFeedLatencySum += latency;
+        mFeedLatencyMax = qMax(mFeedLatencyMax, latency);
+        ++mFeedLatencyCount;
     }
+    qint64 elapsed = mFeedStatsTimer.elapsed();
+    if (elapsed < 1000) {
+        return;
+    }
+    QTextStream(stderr) <<
+        QString("Feed: %1 candles/s, latency avg %2 ms, max %3 ms, alerts %4 ns/candle")
+            .arg(mFeedStatsCandles * 1000.0 / elapsed, 0, 'f', 0)
+            .arg(mFeedLatencyCount > 0 ? mFeedLatencySum / 1e6 / mFeedLatencyCount : 0, 0, 'f', 2)
+            .arg(mFeedLatencyMax / 1e6, 0, 'f', 2)
+            .arg(mFeedStatsCandles > 0 ? mFeedAlertTime / mFeedStatsCandles : 0) << "\n";
+    QTextStream(stderr) << "Memory: " << MemoryBudget::report() << "\n";
+    mFeedStatsTimer.restart();
+    mFeedStatsCandles = 0;
+    mFeedLatencySum = 0;
+    mFeedLatencyMax = 0;
+    mFeedLatencyCount = 0;
+    mFeedAlertTime = 0;
+}
 
-    // нарисуем график, если задана опция
-    for (int i = 0; i < mViewedCandleCount; ++i) {
-        Candle currCandle = mDataSeries.data()[mDataSeries.size() - 1 - i];
-        // место крайней правой свечи не занимаем
-        int xmax = axisMaxX - (i + 1) * candleWidth;
-        int xmin = xmax - mCandleWidth;
-        painter->setPen(mCandlePen);
-        // так как ось Y расположена сверху вниз, а рисуем мы ее снизу вверх
-        // значения надо отображать "зеркально"
-        float xavg = (xmin + xmax) / 2;
-        // объем свечи
-        if (optShowVolumeGraph) {
-            // если включено график объемов, нужно помнить,
-            // что axisMaxY скорректирована, используем "реальный" axisMaxY
-            int axisMaxYReal = axisMaxY + mAxisYVolumeHeight;
-            float yvol = getCurrentAxisValue(
-                QPoint(0, mAxisYVolumeHeight),
-                mVolumeBounds,
-                currCandle.volume
-            );
-            QRectF volumeRect = QRectF(
-                QPointF(xmin, axisMaxYReal - yvol),
-                QPointF(xmax, axisMaxYReal)
-            );
-            QColor volumeColor = (
-                currCandle.close > currCandle.open ?
-                    mCandleUpBrush :
-                    mCandleDownBrush
-                ).color();
-            volumeColor.setAlpha(mCandleBrushAlpha);
-            QBrush volumeBrush = QBrush(volumeColor, Qt::SolidPattern);
-            painter->fillRect(
-                volumeRect,
-                volumeBrush
-            );
-        }
-        // тень свечи
-        QPoint yScale = QPoint(axisMinY, axisMaxY);
-        float ymax = getCurrentAxisValue(yScale, mDataYBounds, currCandle.high);
-        float ymin = getCurrentAxisValue(yScale, mDataYBounds, currCandle.low);
-        float yopn = getCurrentAxisValue(yScale, mDataYBounds, currCandle.open);
-        float ycls = getCurrentAxisValue(yScale, mDataYBounds, currCandle.close);
-        painter->drawLine(
-            QPointF(xavg, yScale.y() - (ymin - yScale.x())),
-            QPointF(xavg, yScale.y() - (ymax - yScale.x()))
-        );
-        QRectF candleRect = QRectF(
-            QPointF(xmin, yScale.y() - (yopn - yScale.x())),
-            QPointF(xmax, yScale.y() - (ycls - yScale.x()))
-        );
-        // цветоное тело свечи
-        painter->fillRect(
-            candleRect,
-            currCandle.close > currCandle.open ? mCandleUpBrush : mCandleDownBrush
-        );
-        // контур свечи
-        painter->drawRect(candleRect);
-    }
-
-    // нарисуем выделение области на графике
-    if (optSelectAreaWithMouse) {
-        // обработаем команду стирания области
-        if (mIsNeedClearArea) {
-            mMouseGraphPressPos = QPoint(-1, -1);
-            mMouseGraphReleasePos = QPoint(-1, -1);
-            mIsMousePressInGraph = false;
-            mIsNeedClearArea = false;
-        }
-        // обработаем команду нажатия лкм
-        if (mIsLmbMousePress) {
-            if (
-                mMousePressPos.x() >= axisMinX &&
-                mMousePressPos.x() < axisMaxX &&
-                mMousePressPos.y() >= axisMinY &&
-                mMousePressPos.y() < axisMaxY
-            ) {
-                mMouseGraphPressPos = mMousePressPos;
-                mIsMousePressInGraph = true;
-            } else {
-                mIsMousePressInGraph = false;
-            }
-        }
-        // обработаем команду снятия нажатия лкм
-        if (mIsLmbMouseRelease) {
-            if (mIsMousePressInGraph) {
-                mMouseGraphReleasePos = mMouseReleasePos;
-            }
+void Widget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (mIsScrollBarPressed) {
+        // перетаскивание окна просмотра по скроллбару
+        if (mChart.scrollToScrollBarPosition(event->pos().x())) {
+            startInteraction();
+            invalidate(ChartViewportChange);
         }
-        int mx1 = mMouseGraphPressPos.x();
-        int my1 = mMouseGraphPressPos.y();
-        if (mx1 != -1 && my1 != -1) {
-            // оси и риски
-            drawAxisLines(
-                painter,
-                mMouseSelectAreaLabelsPen,
-                QPoint(mx1, my1),
-                QPoint(axisMinX, axisMaxX),
-                QPoint(axisMinY, axisMaxY),
-                offset,
-                true
-            );
-            // метки на осях координат
-            drawAxisLabels(
-                painter,
-                QPoint(mx1, my1),
-                QPoint(axisMinX, axisMaxX),
-                QPoint(axisMinY, axisMaxY),
-                mDataYBounds,
-                offset
-            );
+    } else if (mIsRmbMousePressed) {
+        // перетаскивание графика, запоминаем скорость для кинетической прокрутки
+        int dx = event->pos().x() - mPanLastPos.x();
+        qint64 dt = mPanTimer.restart();
+        if (dt > 0) {
+            mPanVelocity = 0.8 * dx / dt + 0.2 * mPanVelocity;
         }
-        int mx2 = mIsLmbMousePressed && mIsMousePressInGraph ?
-            mMousePos.x() : mMouseGraphReleasePos.x();
-        int my2 = mIsLmbMousePressed && mIsMousePressInGraph ?
-            mMousePos.y() : mMouseGraphReleasePos.y();
-        if (mx2 != -1 && my2 != -1) {
-            // оси выделенной области не должны выходить за основные оси
-            // поэтому скорректируем их значение, если нужно
-            if (mx2 < axisMinX) {
-                mx2 = axisMinX;
-            }
-            if (mx2 > axisMaxX - 1) {
-                mx2 = axisMaxX - 1;
-            }
-            if (my2 < axisMinY) {
-                my2 = axisMinY;
-            }
-            if (my2 > axisMaxY - 1) {
-                my2 = axisMaxY - 1;
-            }
-            // оси и риски
-            drawAxisLines(
-                painter,
-                mMouseSelectAreaLabelsPen,
-                QPoint(mx2, my2),
-                QPoint(axisMinX, axisMaxX),
-                QPoint(axisMinY, axisMaxY),
-                offset,
-                true
-            );
-            // метки на осях координат
-            drawAxisLabels(
-                painter,
-                QPoint(mx2, my2),
-                QPoint(axisMinX, axisMaxX),
-                QPoint(axisMinY, axisMaxY),
-                mDataYBounds,
-                offset
-            );
-            // вывести метки на графике
-            // область вывода правее и ниже пересечения осей
-            QPoint lefttop = QPoint(
-                mx2 + 1,
-                my2
-            );
-            QPoint rightbottom = QPoint(
-                mx2 + 4*mAxisLabelHalfWidth + 1,
-                my2 + 2*mAxisLabelHalfHeight
-            );
-            // надпись не выходит за область графика (lefttop не проверяем на
-            // границы, поскольку изначально пробуем отображать метку правее и ниже)
-            if (rightbottom.x() >= axisMaxX - 1) {
-                rightbottom.setX(axisMaxX - 1);
-                lefttop.setX(rightbottom.x() - 4*mAxisLabelHalfWidth);
-            }
-            if (rightbottom.y() >= axisMaxY - 1) {
-                rightbottom.setY(axisMaxY - 1);
-                lefttop.setY(rightbottom.y() - 2*mAxisLabelHalfHeight);
-            }
-            // найти пройденное расстояние, для отображения на графике
-            float xVal1 = getCurrentDataValue(
-                QPoint(axisMinX, axisMaxX),
-                mDataXBounds,
-                mx1
-            );
-            float yVal1 = getCurrentDataValue(
-                QPoint(axisMinY, axisMaxY),
-                mDataYBounds,
-                my1
-            );
-            float xVal2 = getCurrentDataValue(
-                QPoint(axisMinX, axisMaxX),
-                mDataXBounds,
-                mx2
-            );
-            float yVal2 = getCurrentDataValue(
-                QPoint(axisMinY, axisMaxY),
-                mDataYBounds,
-                my2
-            );
-            // рисуем значения в точке отпускания кнопки мыши
-            painter->drawText(
-                QRect(lefttop, rightbottom),
-                Qt::AlignCenter,
-                makeAxisLabel(qAbs(xVal2 - xVal1)) +
-                    QString(";") +
-                    makeAxisLabel(qAbs(yVal2 - yVal1))
-            );
-            // зальем область между метками
-            QColor mouseSelectAreaBrushColor = mMouseSelectAreaPen.color();
-            mouseSelectAreaBrushColor.setAlpha(mMouseSelectAreaBrushAlpha);
-            QBrush mouseSelectAreaBrush = QBrush(
-                mouseSelectAreaBrushColor,
-                Qt::SolidPattern
-            );
-            painter->fillRect(
-                QRect(QPoint(mx1, my1), QPoint(mx2, my2)),
-                mouseSelectAreaBrush
-            );
+        mPanLastPos = event->pos();
+        panByPixels(dx);
+    } else if (mChart.selectAreaWithMouse() && (event->buttons() & Qt::LeftButton)) {
+        // выделение области
+        startInteraction();
+    }
+    // оси мышки и выделяемая область перерисовываются
+    // только в прежнем и новом положении
+    QRegion region = mChart.crosshairRegion() + mChart.selectionRegion();
+    mChart.setMousePos(event->pos());
+    region += mChart.crosshairRegion() + mChart.selectionRegion();
+    invalidate(ChartCrosshairChange | ChartSelectionChange, region);
+}
+
+void Widget::leaveEvent(QEvent *event)
+{
+    Q_UNUSED(event);
+    // перерисовка, чтоб стереть оси мышки с метками
+    QRegion region = mChart.crosshairRegion();
+    mChart.setMouseEnter(false);
+    invalidate(ChartCrosshairChange, region);
+}
+
+void Widget::enterEvent(QEvent *event)
+{
+    Q_UNUSED(event);
+    mChart.setMouseEnter(true);
+    invalidate(ChartCrosshairChange, mChart.crosshairRegion());
+}
+
+void Widget::mousePressEvent(QMouseEvent *event)
+{
+    // клик по скроллбару переносит окно просмотра в выбранное место истории
+    if (
+        event->button() == Qt::LeftButton &&
+        mChart.showScrollArea() &&
+        mChart.scrollAreaRect().contains(event->pos())
+    ) {
+        stopKineticScroll();
+        mIsScrollBarPressed = true;
+        if (mChart.scrollToScrollBarPosition(event->pos().x())) {
+            invalidate(ChartViewportChange);
         }
+        return;
+    }
+    // правой кнопкой мыши график перетаскивается
+    if (event->button() == Qt::RightButton) {
+        stopKineticScroll();
+        mIsRmbMousePressed = true;
+        mPanLastPos = event->pos();
+        mPanPressPos = event->pos();
+        mPanVelocity = 0;
+        mPanTimer.start();
     }
+    if (mChart.selectAreaWithMouse() && event->button() == Qt::LeftButton) {
+        QRegion region = mChart.crosshairRegion() + mChart.selectionRegion();
+        mChart.pressLeftButton(event->pos());
+        region += mChart.crosshairRegion() + mChart.selectionRegion();
+        invalidate(ChartCrosshairChange | ChartSelectionChange, region);
+    }
+}
 
-    // нарисуем оси курсора мыши с метками текущих значений
-    if (optShowLabelsWithMouse) {
-        int mx = mMousePos.x();
-        int my = mMousePos.y();
-        if (mx >= axisMinX &&
-            mx < axisMaxX &&
-            my >= axisMinY &&
-            my < axisMaxY &&
-            mIsMouseEnter
+void Widget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && mIsScrollBarPressed) {
+        mIsScrollBarPressed = false;
+        finishPan();
+        return;
+    }
+    if (event->button() == Qt::RightButton && mIsRmbMousePressed) {
+        mIsRmbMousePressed = false;
+        // щелчок правой кнопкой без перетаскивания снимает выделение
+        if (
+            mChart.selectAreaWithMouse() &&
+            (event->pos() - mPanPressPos).manhattanLength() <= mPanClickDistance
         ) {
-            setCursor(Qt::CrossCursor);
-            // если включено выделение области мышкой, и нажата кнопка мыши
-            // не будем рисовать оси и риски, потому что они затрутся
-            if (optSelectAreaWithMouse && mIsLmbMousePressed) {
-                painter->setPen(mMouseSelectAreaLabelsPen);
-            } else {
-                // оси и риски
-                drawAxisLines(
-                    painter,
-                    mMouseLabelPen,
-                    QPoint(mx, my),
-                    QPoint(axisMinX, axisMaxX),
-                    QPoint(axisMinY, axisMaxY),
-                    offset
-                );
-                // метки на осях координат
-                drawAxisLabels(
-                    painter,
-                    QPoint(mx, my),
-                    QPoint(axisMinX, axisMaxX),
-                    QPoint(axisMinY, axisMaxY),
-                    mDataYBounds,
-                    offset
-                );
-            }
-        } else if (optShowVolumeGraph &&
-            mx >= axisMinX &&
-            mx < axisMaxX &&
-            my >= axisMaxY &&
-            my < axisMaxY + mAxisYVolumeHeight &&
-            mIsMouseEnter
+            QRegion region = mChart.crosshairRegion() + mChart.selectionRegion();
+            mChart.clearSelectedArea();
+            region += mChart.crosshairRegion() + mChart.selectionRegion();
+            invalidate(ChartCrosshairChange | ChartSelectionChange, region);
+        }
+        // если мышь отпустили в движении, продолжаем прокрутку по инерции
+        if (
+            mPanTimer.elapsed() < mKineticMaxIdle &&
+            qAbs(mPanVelocity) > mKineticMinVelocity
         ) {
-            // если отображаем график объема и находимся в его области
-            setCursor(Qt::CrossCursor);
-            // оси и риски
-            drawAxisLines(
-                painter,
-                mMouseVolumeLabelPen,
-                QPoint(mx, my),
-                QPoint(axisMinX, axisMaxX),
-                QPoint(axisMinY, axisMaxY),
-                offset
-            );
-            // метки на осях координат
-            drawAxisLabels(
-                painter,
-                QPoint(mx, my),
-                QPoint(axisMinX, axisMaxX),
-                QPoint(axisMaxY, axisMaxY + mAxisYVolumeHeight),
-                mVolumeBounds,
-                0
-            );
+            mKineticRemainder = 0;
+            mKineticElapsed.start();
+            mKineticTimer->start();
         } else {
-            setCursor(Qt::ArrowCursor);
+            finishPan();
         }
     }
-
-    // нарисуем скроллбар, если нужно
-    if (optShowScrollArea) {
-        QPoint xScale = QPoint (axisMinX, axisMaxX);
-        QPoint yScale = QPoint(maxY - mAxisYScrollBarHeight, maxY);
-
-        // обработаем клик про скроллбару
-        if (mIsLmbMousePress) {
-            if (true) {}
-        }
-        if (mViewedCandleCount < (int)mDataSeries.size()) {
-            float scaledCandleWidth = 1.0 * (xScale.y() - xScale.x()) /
-                mDataSeries.size();
-            int mergedCounter = 1;
-            if (scaledCandleWidth < 1) {
-                mergedCounter = ceil(1 / scaledCandleWidth);
-                scaledCandleWidth *= mergedCounter;
-            }
-            // рисуем с конца графика
-            float startX = xScale.y();
-            int startIndex = mDataSeries.size() - 1;
-            int windowsCount = ceil(1.0 * mDataSeries.size() / mergedCounter);
-            QPointF dataBounds = QPointF(
-                mDataSeries.globalLow(),
-                mDataSeries.globalHigh()
-            );
-            for (int i = 0; i < windowsCount; ++i) {
-                // мержим свечи, для того чтоб получить упрощенную свечу окна
-                float high = 0, low = INFINITY;
-                float open = mDataSeries.data()[startIndex].open;
-                for (int j = 0; j < mergedCounter; ++j) {
-                    if (mDataSeries.data()[startIndex].high > high) {
-                        high = mDataSeries.data()[startIndex].high;
-                    }
-                    if (mDataSeries.data()[startIndex].low < low) {
-                        low = mDataSeries.data()[startIndex].low;
-                    }
-                    startIndex--;
-                    // количевство свечей в окнах округлено, поэтому последнее окно
-                    // может быть неполным, проверяем чтоб не выйти за границы
-                    if (startIndex < 0) {
-                        break;
-                    }
-                }
-                float close = mDataSeries.data()[startIndex].close;
-                // определим цвет свечи по разнице открытия и закрытия
-                QColor color = (
-                        close > open ? mCandleUpBrush : mCandleDownBrush
-                    ).color();
-                // скроллбар расположен в самом низу виджета, поэтому область для
-                // рисования определяем от самого низа
-                float ymax = getCurrentAxisValue(yScale, dataBounds, high);
-                float ymin = getCurrentAxisValue(yScale, dataBounds, low);
-                QRectF candleRect = QRectF(
-                    QPointF(
-                        startX,
-                        yScale.y() - (ymax - yScale.x())
-                    ),
-                    QPointF(
-                        startX - scaledCandleWidth,
-                        yScale.y() - (ymin - yScale.x())
-                    )
-                );
-                // цветоное тело свечи
-                painter->fillRect(
-                    candleRect,
-                    QBrush(color)
-                );
-                // контур свечи
-                painter->setPen(QPen(color));
-                painter->drawRect(candleRect);
-                // скорректируем текущую координату для рисования
-                startX -= scaledCandleWidth;
-            }
-            // нарисуем текущее отображаемое окно на скроллбаре
-            float areaWidth = 1.0 * mViewedCandleCount / mDataSeries.size() *
-                (xScale.y() - xScale.x());
-            float areaStart = 1.0 * mCandleOffsetFromEnd / mDataSeries.size() *
-                (xScale.y() - xScale.x());
-            // рисуем с правого края, поэтому координаты по Х инвертим
-            painter->setPen(mScrollBarPen);
-            painter->drawRect(
-                QRectF(
-                    QPointF(xScale.y() - areaStart, yScale.y() - 1),
-                    QPointF(xScale.y() - areaWidth, yScale.x())
-                )
-            );
-        }
+    if (event->button() == Qt::LeftButton) {
+        QRegion region = mChart.crosshairRegion() + mChart.selectionRegion();
+        mChart.releaseLeftButton(event->pos());
+        region += mChart.crosshairRegion() + mChart.selectionRegion();
+        invalidate(ChartCrosshairChange | ChartSelectionChange, region);
     }
+}
 
-    // завершим обработку нажатия лкм
-    if (mIsLmbMousePress) {
-        mIsLmbMousePress = false;
+void Widget::resizeEvent(QResizeEvent *event)
+{
+    Q_UNUSED(event);
+    invalidate(ChartLayoutChange);
+}
+
+void Widget::wheelEvent(QWheelEvent *event)
+{
+    stopKineticScroll();
+    if (event->angleDelta().y() == 0) {
+        return;
     }
-    // завершим обработку снятия нажатия лкм
-    if (mIsLmbMouseRelease) {
-        mIsLmbMouseRelease = false;
+    // плавное масштабирование: шаг свечи меняется в mZoomFactor раз за щелчок,
+    // свеча под курсором остается на месте
+    float factor = pow(mZoomFactor, event->angleDelta().y() / 120.0);
+    if (mChart.zoom(factor, event->position().x())) {
+        startInteraction();
+        invalidate(ChartViewportChange);
     }
 }
 
-QString Widget::makeAxisLabel(const float value) const
+void Widget::onKineticTimer()
 {
-    QString label = QString::number(value, 'f');
-    if (label.length() > mMaxAxisLabelLength) {
-        int dotPos = label.indexOf('.');
-        if (dotPos != -1) {
-            while (label.length() > mMaxAxisLabelLength && dotPos < label.length() - 2) {
-                label.remove(label.length() - 1, 1);
-            }
-            while (label.at(label.length() - 1) == '0' && dotPos < label.length() - 2) {
-                label.remove(label.length() - 1, 1);
-            }
-        }
-    } else {
-        while (label.length() <= mMaxAxisLabelLength) {
-            label.append(' ');
-        }
+    // шаг кинетической прокрутки: сдвигаем график на пройденное расстояние
+    // и гасим скорость, дробная часть пикселя копится до следующего шага
+    qint64 dt = mKineticElapsed.restart();
+    float dx = mPanVelocity * dt + mKineticRemainder;
+    int step = (int)dx;
+    mKineticRemainder = dx - step;
+    mPanVelocity *= pow(mKineticFriction, 1.0 * dt / mKineticInterval);
+    bool isMoved = step == 0 || mChart.panByPixels(step);
+    if (isMoved) {
+        startInteraction();
+        invalidate(ChartViewportChange);
+    }
+    if (!isMoved || qAbs(mPanVelocity) < mKineticMinVelocity) {
+        stopKineticScroll();
     }
-    return label;
 }
 
-float Widget::getCurrentDataValue(
-    const QPoint &axisBounds,
-    const QPointF &dataBounds,
-    const int currentAxisValue
-) const
+void Widget::panByPixels(int dx)
 {
-    if (currentAxisValue != axisBounds.x()) {
-        return (dataBounds.y() - dataBounds.x()) *
-            (currentAxisValue - axisBounds.x()) /
-            (axisBounds.y() - axisBounds.x()) +
-            dataBounds.x();
-    } else {
-        return dataBounds.x();
-    }
-}
-
-float Widget::getCurrentAxisValue(
-    const QPoint &axisBounds,
-    const QPointF &dataBounds,
-    const float currentDataValue
-) const
-{
-    return 1.0 * (currentDataValue - dataBounds.x()) /
-        (dataBounds.y() - dataBounds.x()) *
-        (axisBounds.y() - axisBounds.x()) +
-        axisBounds.x();
-}
-
-QRect Widget::getRectForAxisLabel(
-    int val,
-    const QPoint &axisXBounds,
-    const QPoint &axisYBounds,
-    bool isAxisLabelX
-) const
-{
-    QPoint lefttop, rightbottom;
-    if (isAxisLabelX) {
-        lefttop = QPoint(
-            val - mAxisLabelHalfWidth,
-            axisYBounds.y() + mAxisXDashLen + mAxisXDashSpace
-        );
-        rightbottom = QPoint(
-            val + mAxisLabelHalfWidth,
-            axisYBounds.y() + mAxisXDashLen + 2*mAxisLabelHalfHeight + mAxisXDashSpace
-        );
-        // область вывода не выводим за границы графика
-        if (lefttop.x() <= axisXBounds.x() + 1) {
-            lefttop.setX(axisXBounds.x() + 1);
-            rightbottom.setX(lefttop.x() + 2*mAxisLabelHalfWidth);
-        }
-        if (rightbottom.x() >= axisXBounds.y() - 1) {
-            rightbottom.setX(axisXBounds.y() - 1);
-            lefttop.setX(rightbottom.x() - 2*mAxisLabelHalfWidth);
-        }
-    } else {
-        lefttop = QPoint(
-            axisXBounds.y() + mAxisYDashLen + mAxisYDashSpace,
-            val - mAxisLabelHalfHeight
-        );
-        rightbottom = QPoint(
-            axisXBounds.y() + mAxisYDashLen + 2*mAxisLabelHalfWidth + mAxisYDashSpace,
-            val + mAxisLabelHalfHeight
-        );
-        // область вывода не выводим за границы графика
-        if (lefttop.y() <= axisYBounds.x() + 1) {
-            lefttop.setY(axisYBounds.x() + 1);
-            rightbottom.setY(lefttop.y() + 2*mAxisLabelHalfHeight);
-        }
-        if (rightbottom.y() >= axisYBounds.y() - 1) {
-            rightbottom.setY(axisYBounds.y() - 1);
-            lefttop.setY(rightbottom.y() - 2*mAxisLabelHalfHeight);
-        }
+    if (mChart.panByPixels(dx)) {
+        startInteraction();
+        invalidate(ChartViewportChange);
     }
-    return QRect(lefttop, rightbottom);
 }
 
-QRect Widget::getOuterRectForAxisLabel(
-    const QRect &labelRect
-) const
+// завершение перетаскивания: диапазон по Y подгоняется под видимые свечи
+void Widget::finishPan()
 {
-    return QRect(
-        QPoint(
-            labelRect.topLeft().x() - mAxisLabelXAdditionalLength,
-            labelRect.topLeft().y() - mAxisLabelYAdditionalLength
-        ),
-        QPoint(
-            labelRect.bottomRight().x() + mAxisLabelXAdditionalLength,
-            labelRect.bottomRight().y() + mAxisLabelYAdditionalLength
-        )
-    );
+    mChart.finishPan();
+    invalidate(ChartViewportChange);
 }
 
-void Widget::drawAxisLabels(
-    QPainter *painter,
-    const QPoint &pos,
-    const QPoint &axisXBounds,
-    const QPoint &axisYBounds,
-    const QPointF dataYBounds,
-    int offset
-) const
-{
-    // нарисуем метку на оси Х
-    QRect labelRect = getRectForAxisLabel(
-        pos.x(),
-        axisXBounds,
-        QPoint(axisYBounds.x(), axisYBounds.y() + offset),
-        true
-    );
-    QRect biggerRect = getOuterRectForAxisLabel(labelRect);
-    painter->fillRect(biggerRect, mBackgroundBrush);
-    painter->drawRect(biggerRect);
-    float valueX = getCurrentDataValue(
-        axisXBounds,
-        mDataXBounds,
-        pos.x()
-    );
-    painter->drawText(
-        labelRect,
-        Qt::AlignCenter,
-        makeAxisLabel(valueX)
-    );
-    // нарисуем метку на оси Y
-    labelRect = getRectForAxisLabel(
-        pos.y(),
-        axisXBounds,
-        axisYBounds,
-        false
-    );
-    biggerRect = getOuterRectForAxisLabel(labelRect);
-    painter->fillRect(biggerRect, mBackgroundBrush);
-    painter->drawRect(biggerRect);
-    // так как ось Y расположена сверху вниз, а рисуем мы ее снизу вверх
-    // значения надо отображать "зеркально"
-    float valueY = getCurrentDataValue(
-        axisYBounds,
-        dataYBounds,
-        axisYBounds.y() - (pos.y() - axisYBounds.x())
-    );
-    painter->drawText(
-        labelRect,
-        Qt::AlignCenter,
-        makeAxisLabel(valueY)
-    );
+// кадры рисуются упрощенно до паузы во взаимодействии
+void Widget::startInteraction()
+{
+    mChart.setInteractive(true);
+    mInteractionTimer->start();
 }
 
-void Widget::drawAxisLines(
-    QPainter *painter,
-    const QPen &axisLabelsPen,
-    const QPoint &pos,
-    const QPoint &axisXBounds,
-    const QPoint &axisYBounds,
-    int offset,
-    bool isDrawDashs
-) const
-{
-    QPen axisPen = QPen(axisLabelsPen);
-    axisPen.setStyle(Qt::DashLine);
-    painter->setPen(axisPen);
-    // оси
-    painter->drawLine(
-        QPoint(pos.x(), axisYBounds.x()),
-        QPoint(pos.x(), axisYBounds.y() + offset + mAxisXDashLen)
-    );
-    painter->drawLine(
-        QPoint(axisXBounds.x(), pos.y()),
-        QPoint(axisXBounds.y() + mAxisYDashLen, pos.y())
-    );
-    painter->setPen(axisLabelsPen);
-    // риски
-    if (isDrawDashs) {
-        painter->drawLine(
-            QPoint(pos.x(), axisYBounds.y() + offset),
-            QPoint(pos.x(), axisYBounds.y() + offset + mAxisXDashLen)
-        );
-        painter->drawLine(
-            QPoint(axisXBounds.y(), pos.y()),
-            QPoint(axisXBounds.y() + mAxisYDashLen, pos.y())
-        );
+void Widget::stopKineticScroll()
+{
+    if (mKineticTimer->isActive()) {
+        mKineticTimer->stop();
+        mPanVelocity = 0;
+        finishPan();
     }
 }
@@ -2,21 +2,44 @@
 #define WIDGET_H
 
 #include "core.h"
+#include "chart.h"
+#include "replay.h"
+#include "backtest.h"
+#include "patternindex.h"
+#include "sessionindex.h"
+#include "indicator.h"
+#include "reader.h"
+#include "alert.h"
 
 #include <QWidget>
-#include <QBrush>
-#include <QPen>
 #include <QString>
+#include <QStringList>
 #include <QPoint>
-#include <QRect>
-#include <QPointF>
-#include <QRectF>
+#include <QRegion>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QPair>
+
+#include <vector>
+
+class RenderThread;
+class FrameScheduler;
+class FeedClient;
 
 class Widget : public QWidget
 {
     Q_OBJECT
 public:
-    Widget(QWidget *parent, const QString &fileName);
+    // несколько файлов одного инструмента сливаются в один ряд по времени,
+    // свечи с одним временем сводятся по duplicatePolicy; большой файл
+    // открывается по последним строкам и дочитывается в фоне
+    Widget(
+        QWidget *parent,
+        const QStringList &fileNames,
+        DuplicatePolicy duplicatePolicy = DuplicateKeepLast
+    );
+    ~Widget();
     bool showLabelsWithMouse() const;
     void setShowLabelsWithMouse(bool newValue);
     bool selectAreaWithMouse() const;
@@ -25,6 +48,23 @@ public:
     void setShowVolumeGraph(bool newValue);
     bool showScrollArea() const;
     void setShowScrollArea(bool newValue);
+    bool showSelectionStats() const;
+    void setShowSelectionStats(bool newValue);
+    bool showVolumeProfile() const;
+    void setShowVolumeProfile(bool newValue);
+    bool showPatterns() const;
+    void setShowPatterns(bool newValue);
+    // прием свечей от повтора (chartist --replay) с дописыванием их к графику
+    void connectFeed(const QString &host, quint16 port);
+    // прогон стратегии по данным графика с показом ее сделок,
+    // при ленивом открытии - после разбора всего файла
+    void showBacktest(const BacktestParams &params);
+    // индикатор по выражению над колонками свечей, false - ошибка в выражении;
+    // isOverlay - рисовать в ценах свечей
+    bool addIndicator(const QString &text, bool isOverlay);
+    // оповещение по условию вида cross:123.5 (AlertTable::parse), проверяется
+    // на свечах от повтора, false - ошибка в условии
+    bool addAlert(const QString &text);
 protected:
     void paintEvent(QPaintEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
@@ -34,108 +74,85 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+private slots:
+    void onKineticTimer();
+    void onFrameRequested(int changes, const QRegion &region);
+    void onFrameReady();
+    void onFeedFinished(const QString &error);
+    void onInteractionIdle();
+    void onLazyReadFinished();
 private:
-    void paint(QPainter *painter, QPaintEvent *event);
-    QString makeAxisLabel(const float value) const;
-    float getCurrentDataValue(
-        const QPoint &axisBounds,
-        const QPointF &dataBounds,
-        const int currentAxisValue
-    ) const;
-    float getCurrentAxisValue(
-        const QPoint &axisBounds,
-        const QPointF &dataBounds,
-        const float currentDataValue
-    ) const;
-    QRect getRectForAxisLabel(
-        int val,
-        const QPoint &axisXBounds,
-        const QPoint &axisYBounds,
-        bool isAxisLabelX
-    ) const;
-    QRect getOuterRectForAxisLabel(
-        const QRect &labelRect
-    ) const;
-    void drawAxisLabels(
-        QPainter *painter,
-        const QPoint &pos,
-        const QPoint &axisXBounds,
-        const QPoint &axisYBounds, const QPointF dataYBounds,
-        int offset
-    ) const;
-    void drawAxisLines(
-        QPainter *painter,
-        const QPen &axisLabelsPen,
-        const QPoint &pos,
-        const QPoint &axisXBounds,
-        const QPoint &axisYBounds,
-        int offset,
-        bool isDrawDashs=true
-    ) const;
-
-    QPointF mDataXBounds;
-    QPointF mDataYBounds;
-    QPointF mVolumeBounds;
-    QPoint mMousePos;
-    QPoint mMousePressPos;
-    QPoint mMouseReleasePos;
-    QPoint mMouseGraphPressPos;
-    QPoint mMouseGraphReleasePos;
-    bool mIsMouseEnter;
-    bool mIsLmbMousePressed;
-    bool mIsLmbMousePress;
-    bool mIsLmbMouseRelease;
-    bool mIsResize;
-    bool mIsCandleWidthChanged;
-    bool mIsNeedClearArea;
-    bool mIsMousePressInGraph;
-
-    QBrush mBackgroundBrush;
-    QPen mAxisPen;
-    QPen mMouseAxisPen;
-    QPen mMouseAxisVolumePen;
-    QPen mMouseLabelPen;
-    QPen mMouseVolumeLabelPen;
-    QPen mMouseSelectAreaPen;
-    int mMouseSelectAreaBrushAlpha;
-    QPen mMouseSelectAreaLabelsPen;
-    QPen mCandlePen;
-    QPen mScrollBarPen;
-    QBrush mCandleUpBrush;
-    QBrush mCandleDownBrush;
-    int mCandleBrushAlpha;
-
-    int mAxisXLeftBorderLength;
-    int mAxisXRightBorderLength;
-    int mAxisYTopBorderLength;
-    int mAxisYBottomBorderLength;
-    int mAxisXDashCount;
-    int mAxisYDashCount;
-    int mAxisYVolumeDashCount;
-    int mAxisXDashLen;
-    int mAxisYDashLen;
-    int mAxisXDashSpace;
-    int mAxisYDashSpace;
-    int mAxisLabelHalfWidth;
-    int mAxisLabelHalfHeight;
-    int mMaxAxisLabelLength;
-    int mAxisLabelXAdditionalLength;
-    int mAxisLabelYAdditionalLength;
-    int mCandleWidth;
-    int mBetweenCandlesWidth;
-    int mViewedCandleCount;
-    int mCandleMinWidth;
-    int mCandleMaxWidth;
-    int mAxisYVolumeHeight;
-    int mAxisYScrollBarHeight;
-    int mCandleOffsetFromEnd;
+    void invalidate(int changes);
+    void invalidate(int changes, const QRegion &region);
+    void panByPixels(int dx);
+    void finishPan();
+    void stopKineticScroll();
+    void startInteraction();
+    void openLazily(const QString &fileName);
+    bool takeFeedCandles();
+    void updateDerivedData();
+    void updateFeedStats(uint64_t frameDataSize);
 
-    bool optShowLabelsWithMouse;
-    bool optSelectAreaWithMouse;
-    bool optShowVolumeGraph;
-    bool optShowScrollArea;
+    bool mIsScrollBarPressed;
+    bool mIsRmbMousePressed;
+    QPoint mPanLastPos;
+    QPoint mPanPressPos;
+    // сдвиг мыши между нажатием и отпусканием правой кнопки, при котором
+    // это еще щелчок, а не перетаскивание
+    int mPanClickDistance;
+    QElapsedTimer mPanTimer;
+    float mPanVelocity;
+    float mKineticRemainder;
+    float mKineticFriction;
+    float mKineticMinVelocity;
+    int mKineticInterval;
+    int mKineticMaxIdle;
+    QTimer *mKineticTimer;
+    QElapsedTimer mKineticElapsed;
+    float mZoomFactor;
+    // пока график масштабируют или двигают, кадры рисуются упрощенно,
+    // полностью - после mInteractionIdleDelay мс без взаимодействия
+    QTimer *mInteractionTimer;
+    int mInteractionIdleDelay;
+    // бюджет времени кадра при взаимодействии в мс
+    int mInteractiveFrameBudget;
+    // выбрасывание данных по бюджету памяти не чаще раза в интервал, мс
+    int mMemoryTrimInterval;
+    QElapsedTimer mMemoryTrimTimer;
 
+    // данные дописываются потоком интерфейса, поток отрисовки рисует
+    // по их снимку (ChartData)
     DataSeries mDataSeries;
+    // свечные модели по всей истории, дописываются вместе с данными
+    PatternIndex mPatternIndex;
+    // сессии торгов для оси времени, дописываются вместе с данными
+    SessionIndex mSessionIndex;
+    // фоновый разбор всего файла при ленивом открытии и сессии, построенные
+    // по нему в фоне, до конца разбора ряд - последние строки файла
+    LazyReader *mLazyReader;
+    SessionIndex mLazySessionIndex;
+    bool mIsBacktestPending;
+    BacktestParams mPendingBacktest;
+    // индикаторы читают ряд в фоне, поэтому удаляются раньше него
+    IndicatorSet mIndicators;
+    // оповещения проверяются на свечах от повтора
+    AlertTable mAlerts;
+    FeedClient *mFeedClient;
+    std::vector<FeedMessage> mFeedMessages;
+    std::vector<Candle> mFeedCandles;
+    // кол-во свечей после дописывания и время отправки самой ранней из них,
+    // задержка считается, когда кадр с этими свечами готов
+    QQueue<QPair<uint64_t, int64_t> > mFeedLatencyMarks;
+    QElapsedTimer mFeedStatsTimer;
+    uint64_t mFeedStatsCandles;
+    int64_t mFeedLatencySum;
+    int64_t mFeedLatencyMax;
+    int mFeedLatencyCount;
+    // время проверки оповещений на принятых свечах
+    int64_t mFeedAlertTime;
+    Chart mChart;
+    RenderThread *mRenderThread;
+    FrameScheduler *mFrameScheduler;
 };
 
 #endif
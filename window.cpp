@@ -4,18 +4,51 @@
 #include <QGridLayout>
 #include <QLabel>
 #include <QString>
+#include <QFileInfo>
 
-Window::Window()
+Window::Window(
+    const QStringList &fileNames,
+    quint16 feedPort,
+    DuplicatePolicy duplicatePolicy
+)
 {
-    QString fileName = "GAZP_170329_170413.csv";
-    setWindowTitle("Chartist - " + fileName);
+    QStringList filePaths = fileNames;
+    if (filePaths.isEmpty() && feedPort == 0) {
+        filePaths << "C:\\Works\\chartist\\data\\GAZP_170329_170413.csv";
+    }
+    if (feedPort != 0) {
+        setWindowTitle(QString("Chartist - feed :%1").arg(feedPort));
+    } else if (filePaths.size() > 1) {
+        setWindowTitle(
+            QString("Chartist - %1 (+%2 files)")
+                .arg(QFileInfo(filePaths.first()).fileName())
+                .arg(filePaths.size() - 1)
+        );
+    } else {
+        setWindowTitle("Chartist - " + QFileInfo(filePaths.first()).fileName());
+    }
 
-    Widget *widget = new Widget(
-        this,
-        "C:\\Works\\chartist\\data\\" + fileName
-    );
+    mWidget = new Widget(this, filePaths, duplicatePolicy);
+    if (feedPort != 0) {
+        mWidget->connectFeed("127.0.0.1", feedPort);
+    }
 
     QGridLayout *layout = new QGridLayout;
-    layout->addWidget(widget);
+    layout->addWidget(mWidget);
     setLayout(layout);
 }
+
+void Window::showBacktest(const BacktestParams &params)
+{
+    mWidget->showBacktest(params);
+}
+
+bool Window::addIndicator(const QString &text, bool isOverlay)
+{
+    return mWidget->addIndicator(text, isOverlay);
+}
+
+bool Window::addAlert(const QString &text)
+{
+    return mWidget->addAlert(text);
+}
@@ -1,13 +1,31 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 
+#include "backtest.h"
+#include "reader.h"
+
 #include <QWidget>
+#include <QString>
+#include <QStringList>
+
+class Widget;
 
 class Window : public QWidget
 {
     Q_OBJECT
 public:
-    Window();
+    // feedPort != 0 - свечи принимаются от повтора на этом порту вместо файлов,
+    // несколько файлов сливаются в один ряд
+    Window(
+        const QStringList &fileNames = QStringList(),
+        quint16 feedPort = 0,
+        DuplicatePolicy duplicatePolicy = DuplicateKeepLast
+    );
+    void showBacktest(const BacktestParams &params);
+    bool addIndicator(const QString &text, bool isOverlay);
+    bool addAlert(const QString &text);
+private:
+    Widget *mWidget;
 };
 
 #endif